@@ -0,0 +1,138 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+// Compare the posix and io_uring file accessors by writing and reading a
+// file block by block through stream_accessor, hashing each block.
+
+#include <tpie/tpie.h>
+#include <tpie/file_accessor/file_accessor.h>
+#include <tpie/file_accessor/uring.h>
+#include <tpie/tempname.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "testtime.h"
+#include "stat.h"
+#include "testinfo.h"
+
+using namespace tpie;
+using namespace tpie::test;
+
+typedef tpie::uint64_t test_t;
+
+void usage() {
+	std::cout << "Parameters: [times] [mb] [block kb]" << std::endl;
+}
+
+template <typename accessor_t>
+void run(size_t mb, size_t blockKB, tpie::test::stat & s) {
+	const memory_size_type blockSize = blockKB * 1024;
+	const memory_size_type blockItems = blockSize / sizeof(test_t);
+	const stream_size_type blocks = static_cast<stream_size_type>(mb) * 1024 / blockKB;
+	std::vector<test_t> block(blockItems);
+	temp_file tmp;
+
+	test_realtime_t start;
+	test_realtime_t end;
+
+	getTestRealtime(start);
+	{
+		file_accessor::stream_accessor<accessor_t> fa;
+		fa.open(tmp.path(), false, true, sizeof(test_t), blockSize, 0, access_sequential, 0);
+		for (stream_size_type b = 0; b < blocks; ++b) {
+			for (memory_size_type i = 0; i < blockItems; ++i) block[i] = b * blockItems + i;
+			fa.write_block(block.data(), b, blockItems);
+		}
+		fa.close();
+	}
+	getTestRealtime(end);
+	double writeTime = testRealtimeDiff(start, end);
+
+	test_t hash = 0;
+	getTestRealtime(start);
+	{
+		file_accessor::stream_accessor<accessor_t> fa;
+		fa.open(tmp.path(), true, false, sizeof(test_t), blockSize, 0, access_sequential, 0);
+		for (stream_size_type b = 0; b < blocks; ++b) {
+			fa.read_block(block.data(), b, blockItems);
+			for (memory_size_type i = 0; i < blockItems; ++i) hash = hash * 13 + block[i];
+		}
+		fa.close();
+	}
+	getTestRealtime(end);
+	double readTime = testRealtimeDiff(start, end);
+
+	s(writeTime);
+	s(readTime);
+	s(hash % 100000000000000ull);
+}
+
+void test(size_t mb, size_t times, size_t blockKB) {
+	std::vector<const char *> names;
+	names.push_back("Posix write");
+	names.push_back("Posix read");
+	names.push_back("Posix hash");
+	names.push_back("Uring write");
+	names.push_back("Uring read");
+	names.push_back("Uring hash");
+	tpie::test::stat s(names);
+	for (size_t i = 0; i < times; ++i) {
+		run<file_accessor::posix>(mb, blockKB, s);
+#ifdef TPIE_HAS_IO_URING
+		run<file_accessor::uring>(mb, blockKB, s);
+#else
+		s(0); s(0); s(0);
+#endif
+	}
+}
+
+int main(int argc, char **argv) {
+	size_t times = 10;
+	size_t mb = 256;
+	size_t blockKB = 2048;
+
+	if (argc > 1) {
+		std::stringstream(argv[1]) >> times;
+		if (!times) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc > 2) {
+		std::stringstream(argv[2]) >> mb;
+		if (!mb) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc > 3) {
+		std::stringstream(argv[3]) >> blockKB;
+		if (!blockKB) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	testinfo t("file accessor speed test", 0, mb, times);
+#ifndef TPIE_HAS_IO_URING
+	std::cout << "io_uring is not available; only posix is measured." << std::endl;
+#endif
+	::test(mb, times, blockKB);
+	return EXIT_SUCCESS;
+}
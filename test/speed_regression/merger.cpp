@@ -0,0 +1,136 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file merger.cpp
+/// Compare the binary heap and the loser tree when merging sorted runs in
+/// internal memory, so only the cost of selecting the next item is measured.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/tpie.h>
+#include <tpie/internal_priority_queue.h>
+#include <tpie/loser_tree.h>
+#include <tpie/array.h>
+#include <tpie/stats.h>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <string>
+#include "testtime.h"
+#include "stat.h"
+#include "testinfo.h"
+
+using namespace tpie;
+using namespace tpie::test;
+
+typedef std::pair<uint64_t, size_t> item_type;
+
+struct item_less {
+	bool operator()(const item_type & a, const item_type & b) const {
+		return a.first < b.first;
+	}
+};
+
+void usage() {
+	std::cout << "Parameters: [times] [mb]" << std::endl;
+}
+
+template <template <typename, typename> class queue_t>
+uint64_t merge(const tpie::array<uint64_t> & data, size_t fanout, uint64_t & checksum) {
+	const size_t runLength = data.size() / fanout;
+	tpie::array<size_t> pos(fanout);
+	queue_t<item_type, item_less> q(fanout);
+	for (size_t i = 0; i < fanout; ++i) {
+		pos[i] = i*runLength;
+		q.unsafe_push(item_type(data[pos[i]++], i));
+	}
+	q.make_safe();
+
+	test_realtime_t start;
+	test_realtime_t end;
+	getTestRealtime(start);
+	while (!q.empty()) {
+		const item_type & top = q.top();
+		checksum = checksum * 31 + top.first;
+		size_t i = top.second;
+		if (pos[i] < (i+1)*runLength)
+			q.pop_and_push(item_type(data[pos[i]++], i));
+		else
+			q.pop();
+	}
+	getTestRealtime(end);
+	return testRealtimeDiff(start, end);
+}
+
+void test(size_t mb, size_t times) {
+	const size_t fanouts[] = {16, 64, 256, 1024};
+	const size_t count = mb*1024*1024/sizeof(uint64_t);
+
+	std::vector<std::string> labels;
+	for (size_t fanout : fanouts) {
+		labels.push_back("Heap " + std::to_string(fanout));
+		labels.push_back("Loser " + std::to_string(fanout));
+	}
+	std::vector<const char *> names;
+	for (const std::string & l : labels) names.push_back(l.c_str());
+
+	std::mt19937_64 rng(42);
+	stat s(names);
+	for (size_t t = 0; t < times; ++t) {
+		for (size_t fanout : fanouts) {
+			// Sorted runs of random numbers
+			tpie::array<uint64_t> data(count - count % fanout);
+			for (size_t i = 0; i < data.size(); ++i) data[i] = rng();
+			const size_t runLength = data.size() / fanout;
+			for (size_t i = 0; i < fanout; ++i)
+				std::sort(data.begin() + i*runLength, data.begin() + (i+1)*runLength);
+
+			uint64_t heapChecksum = 0;
+			uint64_t loserChecksum = 0;
+			s(merge<internal_priority_queue>(data, fanout, heapChecksum));
+			s(merge<loser_tree>(data, fanout, loserChecksum));
+			if (heapChecksum != loserChecksum)
+				std::cout << "Checksum mismatch at fanout " << fanout << std::endl;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	size_t times = 10;
+	size_t mb = 64;
+
+	if (argc > 1) {
+		std::stringstream(argv[1]) >> times;
+		if (!times) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc > 2) {
+		std::stringstream(argv[2]) >> mb;
+		if (!mb) {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	testinfo t("Merger speed test", 0, mb, times);
+	::test(mb, times);
+	return EXIT_SUCCESS;
+}
@@ -36,7 +36,9 @@ const size_t count_default=1024*1024*1024/sizeof(test_t);
 static std::string prog;
 
 static inline void usage() {
-	std::cout << "Usage: " << prog << " [times [count]]\n"
+	std::cout << "Usage: " << prog << " [--parallel] [times [count]]\n"
+		<< "--parallel: Time parallel() with 1 to 32 workers and\n"
+		<< "            parallel_adaptive() with up to 32 workers instead\n"
 		<< "times: Number of trials\n"
 		<< "count: Number of elements in each trial"
 		<< std::endl;
@@ -54,7 +56,7 @@ struct number_generator_t : public node {
 		set_steps(count);
 	}
 
-	inline void operator()() {
+	void go() override {
 		for (size_t i = 1; i <= count; ++i) {
 			dest.push(i);
 			step();
@@ -109,9 +111,49 @@ static void test(size_t count) {
 	std::cout << " " << testRealtimeDiff(start,end) << ' ' << res << std::endl;
 }
 
+static const size_t maxWorkers = 32;
+
+inline static test_t do_parallel(size_t count, size_t workers) {
+	test_t res = 0;
+	pipeline p = pipe_begin<factory<number_generator_t, size_t> >(count)
+		| parallel(map([](test_t x) { return x * 3 + 1; }), arbitrary_order, workers)
+		| pipe_end<termfactory<number_sink_t, test_t &> >(res);
+	p();
+	return res;
+}
+
+inline static test_t do_parallel_adaptive(size_t count) {
+	test_t res = 0;
+	pipeline p = pipe_begin<factory<number_generator_t, size_t> >(count)
+		| parallel_adaptive(map([](test_t x) { return x * 3 + 1; }), arbitrary_order, maxWorkers)
+		| pipe_end<termfactory<number_sink_t, test_t &> >(res);
+	p();
+	return res;
+}
+
+// Cheap work per item, so the time is dominated by handing the items
+// between the main thread and the workers.
+static void test_parallel(size_t count) {
+	test_realtime_t start;
+	test_realtime_t end;
+	test_t res = 0;
+
+	for (size_t workers = 1; workers <= maxWorkers; workers *= 2) {
+		getTestRealtime(start);
+		res = do_parallel(count, workers);
+		getTestRealtime(end);
+		std::cout << testRealtimeDiff(start,end) << ' ' << std::flush;
+	}
+	getTestRealtime(start);
+	res = do_parallel_adaptive(count);
+	getTestRealtime(end);
+	std::cout << testRealtimeDiff(start,end) << ' ' << res << std::endl;
+}
+
 int main(int argc, char **argv) {
 	size_t times = 10;
 	size_t count = count_default;
+	bool parallelTest = false;
 	prog = argv[0];
 
 	while (argc > 1) {
@@ -119,6 +161,8 @@ int main(int argc, char **argv) {
 
 		if (arg == "--help" || arg == "-h")
 			usage();
+		else if (arg == "--parallel")
+			parallelTest = true;
 
 		else break;
 
@@ -138,12 +182,21 @@ int main(int argc, char **argv) {
 		if (!count) usage();
 	}
 
-	std::cout << "Writing " << count << " items, reading them" << std::endl;
+	if (parallelTest) {
+		std::cout << "Mapping " << count << " items with 1, 2, 4, ..., "
+			<< maxWorkers << " workers, and adaptively" << std::endl;
+	} else {
+		std::cout << "Writing " << count << " items, reading them" << std::endl;
+	}
 
 	tpie::tpie_init();
+	tpie::get_memory_manager().set_limit(1000 * 1024 * 1024);
 
 	for (size_t i = 0; i < times || !times; ++i) {
-		::test(count);
+		if (parallelTest)
+			::test_parallel(count);
+		else
+			::test(count);
 	}
 
 	tpie::tpie_finish();
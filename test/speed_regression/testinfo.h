@@ -66,6 +66,10 @@ struct testinfo {
 			"Uncompressing",
 			"Snappy-blocks",
 			"None-blocks",
+			"LZ4-blocks",
+			"Zstd-blocks",
+			"Queue-wait",
+			"Requests",
 			NULL};
 		for (size_t i = 0; labels[i]; ++i) {
 			m_sysinfo.printinfo(labels[i], get_user(i));
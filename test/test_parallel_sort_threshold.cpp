@@ -25,6 +25,8 @@
 
 typedef int test_t;
 
+tpie::parallel_sort_algorithm algorithm = tpie::parallel_sort_algorithm::quicksort;
+
 struct sort_timer {
 	virtual ~sort_timer() {}
 	virtual double run(std::vector<test_t> & items) = 0;
@@ -36,6 +38,7 @@ struct sort_timer_impl : public sort_timer {
 	double run(std::vector<test_t> & items) {
 		tpie::test_time start=tpie::test_now();
 		tpie::parallel_sort_impl<std::vector<test_t>::iterator, std::less<test_t>, false, stdSortThreshold > s(0);
+		s.set_algorithm(algorithm);
 		s(items.begin(), items.end());
 		tpie::test_time end=tpie::test_now();
 		return tpie::test_secs(start, end);
@@ -104,7 +107,14 @@ size_t find_threshold(size_t center, size_t radius, std::vector<test_t> & data)
 int main(int argc, char ** argv) {
 	// argument parsing
 	if (argc < 2) {
-		std::cout << "Usage: " << argv[0] << " mb" << std::endl;
+		std::cout << "Usage: " << argv[0] << " mb [quicksort|parallel_partition|compare]" << std::endl;
+		return 1;
+	}
+	std::string mode = argc > 2 ? argv[2] : "quicksort";
+	if (mode == "parallel_partition") {
+		algorithm = tpie::parallel_sort_algorithm::parallel_partition;
+	} else if (mode != "quicksort" && mode != "compare") {
+		std::cout << "Unknown algorithm " << mode << std::endl;
 		return 1;
 	}
 	tpie::sysinfo si;
@@ -117,6 +127,22 @@ int main(int argc, char ** argv) {
 
 	// program
 	tpie::tpie_init();
+	if (mode == "compare") {
+		// Time both algorithms with the default std::sort threshold.
+		const tpie::parallel_sort_algorithm algorithms[] = {
+			tpie::parallel_sort_algorithm::quicksort,
+			tpie::parallel_sort_algorithm::parallel_partition};
+		const char * names[] = {"quicksort", "parallel_partition"};
+		for (size_t i = 0; i < 2; ++i) {
+			algorithm = algorithms[i];
+			sort_timer * t = get_sort_timer(1024*1024*8/sizeof(test_t));
+			fill_data(data);
+			std::cout << si.custominfo(names[i], t->run(data)) << std::endl;
+			delete t;
+		}
+		tpie::tpie_finish();
+		return 0;
+	}
 	size_t center = thresholdMax/2;
 	size_t radius = thresholdMax/2;
 
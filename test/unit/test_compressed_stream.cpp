@@ -19,7 +19,15 @@
 
 #include "common.h"
 #include <tpie/compressed/stream.h>
+#include <tpie/compressed/thread.h>
 #include <tpie/file_stream.h>
+#include <tpie/stats.h>
+#include <tpie/stream_header.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
 
 template <tpie::compression_flags flags>
 class tests {
@@ -783,6 +791,44 @@ static bool backwards_test(size_t n) {
 	return true;
 }
 
+// Two streams discarding what they read, each reading its half of the file
+// as merges of two adjacent runs would. The first block a stream reads is
+// kept, so the second half is read first without corrupting the first.
+static bool discard_consumed_test(size_t n) {
+	tpie::temp_file tf;
+	tpie::stream_position middle;
+	{
+		tpie::file_stream<size_t> s;
+		s.open(tf, tpie::access_write, 0, tpie::access_sequential, flags);
+		for (size_t i = 0; i < n; ++i) {
+			if (i == n/2) middle = s.get_position();
+			s.write(i);
+		}
+	}
+	tpie::stream_size_type before = tpie::get_temp_file_usage();
+
+	tpie::file_stream<size_t> a;
+	tpie::file_stream<size_t> b;
+	a.set_discard_consumed(true);
+	b.set_discard_consumed(true);
+	a.open(tf, tpie::access_read, 0, tpie::access_sequential, flags);
+	b.open(tf, tpie::access_read, 0, tpie::access_sequential, flags);
+	b.set_position(middle);
+	for (size_t i = n/2; i < n; ++i)
+		TEST_ENSURE_EQUALITY(i, b.read(), "Wrong item in second half");
+	for (size_t i = 0; i < n/2; ++i)
+		TEST_ENSURE_EQUALITY(i, a.read(), "Wrong item in first half");
+
+	tpie::stream_size_type after = tpie::get_temp_file_usage();
+	if (after == before) {
+		tpie::log_info() << "Punching holes is not supported by the file system" << std::endl;
+		return true;
+	}
+	TEST_ENSURE(after < before && before - after > before / 2,
+				"Temp file usage did not drop: " << before << " before, " << after << " after");
+	return true;
+}
+
 };
 
 static bool backwards_file_stream_test(size_t n) {
@@ -998,6 +1044,288 @@ bool stack_test() {
 	return true;
 }
 
+void set_preferred_compression(tpie::compression_scheme::type t) {
+	tpie::compressor_thread_lock lock(tpie::the_compressor_thread());
+	tpie::the_compressor_thread().set_preferred_compression(lock, t);
+}
+
+bool scheme_test(tpie::compression_scheme::type t, size_t n) {
+	tpie::temp_file tf;
+	set_preferred_compression(t);
+	{
+		tpie::file_stream<size_t> s;
+		s.open(tf, tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_all);
+		for (size_t i = 0; i < n; ++i) s.write(i % 1000);
+	}
+	// Blocks record their scheme, so they can be read back after the
+	// preferred scheme has changed.
+	set_preferred_compression(tpie::compression_scheme::snappy);
+	tpie::file_stream<size_t> s;
+	s.open(tf, tpie::access_read, 0, tpie::access_sequential, tpie::compression_all);
+	if (s.size() != n) {
+		tpie::log_error() << "size() == " << s.size() << ", expected " << n << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		size_t r = s.read();
+		if (r != i % 1000) {
+			tpie::log_error() << "Read " << r << " at " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool schemes_test(size_t n) {
+	const tpie::compression_scheme::type schemes[] = {
+		tpie::compression_scheme::none,
+		tpie::compression_scheme::snappy,
+		tpie::compression_scheme::lz4,
+		tpie::compression_scheme::zstd
+	};
+	for (tpie::compression_scheme::type t : schemes) {
+		tpie::log_debug() << "Scheme " << t << " available: "
+						  << tpie::compression_scheme_available(t) << std::endl;
+		if (!scheme_test(t, n)) {
+			tpie::log_error() << "Scheme " << t << " failed" << std::endl;
+			return false;
+		}
+	}
+	tpie::set_zstd_compression_level(9);
+	bool result = scheme_test(tpie::compression_scheme::zstd, n);
+	tpie::set_zstd_compression_level(1);
+	return result;
+}
+
+bool adaptive_test(size_t n) {
+	// Alternate between runs of random and of compressible items, so the
+	// stream consists of a mix of compressed and uncompressed blocks.
+	const size_t run = 1 << 14;
+	std::mt19937_64 rng(42);
+	tpie::file_stream<uint64_t> s;
+	s.open(0, tpie::access_sequential, tpie::compression_normal);
+	for (size_t i = 0; i < n; ++i)
+		s.write((i / run) % 2 ? rng() : i % 7);
+	s.seek(0);
+	rng.seed(42);
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t expected = (i / run) % 2 ? rng() : i % 7;
+		uint64_t r = s.read();
+		if (r != expected) {
+			tpie::log_error() << "Read " << r << " at " << i
+							  << ", expected " << expected << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool adaptive_streams_test(size_t n) {
+	// A stream of incompressible items written at the same time must not
+	// turn off compression of a compressible stream.
+	const tpie::compression_scheme::type schemes[] = {
+		tpie::compression_scheme::lz4, tpie::compression_scheme::snappy, tpie::compression_scheme::zstd};
+	const tpie::compression_scheme::type * scheme = std::find_if(
+		std::begin(schemes), std::end(schemes), tpie::compression_scheme_available);
+	if (scheme == std::end(schemes)) {
+		tpie::log_info() << "No compression scheme available" << std::endl;
+		return true;
+	}
+	set_preferred_compression(*scheme);
+	// Enough threads that the backlog does not disable compression.
+	tpie::set_compressor_thread_count(2);
+	tpie::temp_file random;
+	tpie::temp_file regular;
+	{
+		std::mt19937_64 rng(42);
+		tpie::file_stream<uint64_t> a;
+		tpie::file_stream<uint64_t> b;
+		a.open(random, tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_normal);
+		b.open(regular, tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < n; ++i) {
+			a.write(rng());
+			b.write(i % 7);
+		}
+	}
+	tpie::set_compressor_thread_count(1);
+	set_preferred_compression(tpie::compression_scheme::snappy);
+	const uintmax_t size = std::filesystem::file_size(regular.path());
+	tpie::log_debug() << "Compressible stream of " << n * sizeof(uint64_t)
+					  << " bytes stored in " << size << " bytes" << std::endl;
+	TEST_ENSURE(size < n * sizeof(uint64_t) / 2, "Compressible stream was not compressed");
+	return true;
+}
+
+bool thread_pool_test(size_t n) {
+	const size_t streams = 8;
+	tpie::set_compressor_thread_count(4);
+	bool result = true;
+	{
+		std::vector<tpie::file_stream<size_t> > s(streams);
+		for (size_t j = 0; j < streams; ++j) s[j].open(0, tpie::access_sequential, tpie::compression_all);
+		for (size_t i = 0; i < n; ++i)
+			for (size_t j = 0; j < streams; ++j)
+				s[j].write(i * streams + j);
+		for (size_t j = 0; j < streams; ++j) s[j].seek(0);
+		for (size_t i = 0; i < n && result; ++i) {
+			for (size_t j = 0; j < streams; ++j) {
+				size_t r = s[j].read();
+				if (r != i * streams + j) {
+					tpie::log_error() << "Read " << r << " at " << i
+									  << " in stream " << j << std::endl;
+					result = false;
+					break;
+				}
+			}
+		}
+	}
+	tpie::set_compressor_thread_count(1);
+	return result;
+}
+
+bool read_checked(tpie::temp_file & tf, size_t n) {
+	tpie::file_stream<size_t> s;
+	s.open(tf, tpie::access_read, 0, tpie::access_sequential, tpie::compression_normal);
+	for (size_t i = 0; i < n; ++i) {
+		size_t r = s.read();
+		if (r != i) {
+			tpie::log_error() << "Read " << r << " at " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool checksums_test(size_t n) {
+	tpie::temp_file withChecksums;
+	tpie::temp_file without;
+	tpie::temp_file * files[] = {&without, &withChecksums};
+	for (int c = 0; c < 2; ++c) {
+		tpie::set_block_checksums(c == 1);
+		tpie::file_stream<size_t> s;
+		s.open(*files[c], tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < n; ++i) s.write(i);
+	}
+	// The header records whether there are checksums.
+	tpie::set_block_checksums(false);
+	if (!read_checked(withChecksums, n)) return false;
+	tpie::set_block_checksums(true);
+	if (!read_checked(without, n)) return false;
+	tpie::set_block_checksums(false);
+
+	// Flip a bit in the middle of the file
+	{
+		std::fstream f(withChecksums.path(), std::ios::in | std::ios::out | std::ios::binary);
+		std::streamoff middle = std::filesystem::file_size(withChecksums.path()) / 2;
+		char c;
+		f.seekg(middle);
+		f.read(&c, 1);
+		c ^= 4;
+		f.seekp(middle);
+		f.write(&c, 1);
+	}
+	try {
+		read_checked(withChecksums, n);
+	} catch (const tpie::exception & e) {
+		tpie::log_debug() << "Got " << e.what() << std::endl;
+		return true;
+	}
+	tpie::log_error() << "The corrupted block was not detected" << std::endl;
+	return false;
+}
+
+tpie::stream_header_t read_stream_header(const std::string & path) {
+	tpie::stream_header_t header;
+	std::ifstream f(path, std::ios::binary);
+	f.read(reinterpret_cast<char *>(&header), sizeof(header));
+	return header;
+}
+
+void write_stream_header(const std::string & path, const tpie::stream_header_t & header) {
+	std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+	f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+bool rejected(tpie::temp_file & tf, size_t n) {
+	try {
+		read_checked(tf, n);
+	} catch (const tpie::invalid_file_exception & e) {
+		tpie::log_debug() << "Got " << e.what() << std::endl;
+		return true;
+	}
+	return false;
+}
+
+bool checksums_header_test(size_t n) {
+	tpie::temp_file withChecksums;
+	tpie::temp_file without;
+	tpie::temp_file * files[] = {&without, &withChecksums};
+	for (int c = 0; c < 2; ++c) {
+		tpie::set_block_checksums(c == 1);
+		tpie::file_stream<size_t> s;
+		s.open(*files[c], tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < n; ++i) s.write(i);
+	}
+	tpie::set_block_checksums(false);
+
+	// Readers from before checksums were added only accept the old version.
+	tpie::stream_header_t header = read_stream_header(without.path());
+	TEST_ENSURE_EQUALITY(tpie::stream_header_t::oldestVersionConst, header.version, "Wrong version without checksums");
+	header = read_stream_header(withChecksums.path());
+	TEST_ENSURE_EQUALITY(tpie::stream_header_t::versionConst, header.version, "Wrong version with checksums");
+	TEST_ENSURE(header.get_checksums(), "Checksums flag not set");
+
+	// Checksums disabled only affects new files.
+	TEST_ENSURE(read_checked(withChecksums, n), "Checksummed file not read with checksums disabled");
+
+	tpie::stream_header_t old = header;
+	old.version = tpie::stream_header_t::oldestVersionConst;
+	write_stream_header(withChecksums.path(), old);
+	TEST_ENSURE(rejected(withChecksums, n), "Checksums accepted in old version");
+
+	tpie::stream_header_t unknown = header;
+	unknown.flags |= 0x100;
+	write_stream_header(withChecksums.path(), unknown);
+	TEST_ENSURE(rejected(withChecksums, n), "Unknown flag accepted");
+
+	write_stream_header(withChecksums.path(), header);
+	TEST_ENSURE(read_checked(withChecksums, n), "Restored file not read");
+	return true;
+}
+
+bool batch_test(size_t n) {
+	tpie::temp_file tf;
+	{
+		std::vector<size_t> items(1000);
+		tpie::file_stream<size_t> s;
+		s.open(tf, tpie::access_read_write, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < n; i += items.size()) {
+			size_t m = std::min(items.size(), n - i);
+			for (size_t j = 0; j < m; ++j) items[j] = i + j;
+			s.write(&items[0], &items[0] + m);
+		}
+		TEST_ENSURE_EQUALITY(n, s.size(), "Wrong size after writing");
+	}
+	tpie::file_stream<size_t> s;
+	s.open(tf, tpie::access_read, 0, tpie::access_sequential, tpie::compression_normal);
+	size_t i = 0;
+	size_t batches = 0;
+	while (s.can_read()) {
+		// Alternate between whole and partial blocks
+		tpie::array_view<const size_t> items = s.read_batch(batches % 2 ? 100 : n);
+		TEST_ENSURE(items.size() > 0, "Empty batch");
+		for (size_t j = 0; j < items.size(); ++j) {
+			TEST_ENSURE_EQUALITY(i, items[j], "Wrong item");
+			++i;
+		}
+		TEST_ENSURE_EQUALITY(i, s.offset(), "Wrong offset");
+		++batches;
+	}
+	TEST_ENSURE_EQUALITY(n, i, "Wrong number of items read");
+	TEST_ENSURE(batches < n / 100, "Batches should span many items");
+	return true;
+}
+
 template <tpie::compression_flags flags>
 tpie::tests & add_tests(tpie::tests & t, std::string suffix) {
 	typedef tests<flags> T;
@@ -1027,6 +1355,7 @@ tpie::tests & add_tests(tpie::tests & t, std::string suffix) {
 		.test(T::uncompressed_test, "uncompressed" + suffix, "n", static_cast<size_t>(1000000))
 		.test(T::uncompressed_new_test, "uncompressed_new" + suffix, "n", static_cast<size_t>(1000000))
 		.test(T::backwards_test, "backwards" + suffix, "n", static_cast<size_t>(1 << 23))
+		.test(T::discard_consumed_test, "discard_consumed" + suffix, "n", static_cast<size_t>(1 << 22))
 		;
 }
 
@@ -1040,5 +1369,12 @@ int main(int argc, char ** argv) {
 		.test(write_peek_test, "write_peek", "n", static_cast<size_t>(1 << 23))
 		/* .test(read_only_test, "read_only") */
 		.test(write_only_test, "write_only")
+		.test(schemes_test, "schemes", "n", static_cast<size_t>(1 << 20))
+		.test(thread_pool_test, "thread_pool", "n", static_cast<size_t>(1 << 18))
+		.test(adaptive_test, "adaptive", "n", static_cast<size_t>(1 << 20))
+		.test(adaptive_streams_test, "adaptive_streams", "n", static_cast<size_t>(1 << 20))
+		.test(checksums_test, "checksums", "n", static_cast<size_t>(1 << 20))
+		.test(checksums_header_test, "checksums_header", "n", static_cast<size_t>(1 << 16))
+		.test(batch_test, "batch", "n", static_cast<size_t>(1 << 20))
 		.test(stack_test, "lockstep_reverse");
 }
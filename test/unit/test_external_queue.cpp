@@ -121,6 +121,27 @@ bool empty_size_test() {
 	return result;
 }
 
+// The reservation moves between the streams as they are swapped.
+bool reserved_test(size_t n) {
+	queue<uint64_t> q(access_sequential, compression_none);
+	q.reserve(n);
+	size_t pushed = 0;
+	size_t popped = 0;
+	for (size_t round = 0; round < 4; ++round) {
+		while (pushed < (round + 1) * n / 4) q.push(element(pushed++));
+		for (; popped < pushed / 2; ++popped) {
+			uint64_t got = q.pop();
+			TEST_ENSURE_EQUALITY(element(popped), got, "Wrong element popped, round " << round);
+		}
+	}
+	for (; popped < pushed; ++popped) {
+		uint64_t got = q.pop();
+		TEST_ENSURE_EQUALITY(element(popped), got, "Wrong element popped");
+	}
+	TEST_ENSURE(q.empty(), "Queue not empty");
+	return true;
+}
+
 double pop_probability(uint64_t i, uint64_t max_size) {
 	double factor = 3.14159f / max_size;
 	return (1-cos(factor * i))/2;
@@ -160,5 +181,6 @@ int main(int argc, char ** argv) {
 		.test(empty_size_test, "empty_size")
 		.test(queue_test, "sized", "n", static_cast<size_t>(32*1024*1024/sizeof(uint64_t)))
 		.test(large_test, "large")
+		.test(reserved_test, "reserved", "n", static_cast<size_t>(1024*1024))
 		;
 }
@@ -60,8 +60,51 @@ bool repeat_test() {
 	return true;
 }
 
+class nested_job : public tpie::job {
+	size_t * ctr;
+	size_t children;
+public:
+	nested_job(size_t * ctr, size_t children)
+		: ctr(ctr)
+		, children(children)
+	{
+	}
+
+	void operator()() {
+		tpie::array<tpie::unique_ptr<test_job> > jobs(children);
+		for (size_t i = 0; i < children; ++i) {
+			jobs[i].reset(tpie::tpie_new<test_job>(&ctr[i]));
+			jobs[i]->enqueue();
+		}
+		for (size_t i = 0; i < children; ++i) {
+			jobs[i]->join();
+		}
+	}
+};
+
+bool nested_join_test() {
+	// With a single worker busy running the outer job, the subjobs can only
+	// run if join() runs them.
+	size_t workers = tpie::get_worker_count();
+	tpie::set_worker_count(1);
+	size_t children = 20;
+	tpie::array<size_t> counters(children, 0);
+	nested_job j(counters.get(), children);
+	j.enqueue();
+	j.join();
+	tpie::set_worker_count(workers);
+	for (size_t i = 0; i < children; ++i) {
+		if (counters[i] != 1) {
+			tpie::log_error() << "Subjob " << i << " ran " << counters[i] << " times" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 int main(int argc, char **argv) {
 	return tpie::tests(argc, argv)
 		.test(repeat_test, "repeat")
+		.test(nested_join_test, "nested_join")
 		;
 }
@@ -0,0 +1,161 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+#include "common.h"
+#include <tpie/loser_tree.h>
+#include <tpie/internal_priority_queue.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace tpie;
+
+typedef std::pair<uint64_t, size_t> run_item;
+
+struct run_item_less {
+	bool operator()(const run_item & a, const run_item & b) const {
+		return a.first < b.first;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Make `fanout` sorted runs of random length. If `distinct`, no two items
+/// are equal.
+///////////////////////////////////////////////////////////////////////////////
+std::vector<std::vector<uint64_t> > make_runs(size_t fanout, bool distinct) {
+	std::mt19937 rng(fanout);
+	std::vector<std::vector<uint64_t> > runs(fanout);
+	for (size_t i = 0; i < fanout; ++i) {
+		// Leave some runs empty
+		size_t n = rng() % 3 == 0 ? 0 : rng() % 1000;
+		for (size_t j = 0; j < n; ++j) {
+			uint64_t x = rng() % 10000;
+			runs[i].push_back(distinct ? (x * 1000 + j) * fanout + i : x);
+		}
+		std::sort(runs[i].begin(), runs[i].end());
+	}
+	return runs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Merge the runs using queue_t and return the items in the order they were
+/// popped.
+///////////////////////////////////////////////////////////////////////////////
+template <template <typename, typename> class queue_t>
+std::vector<run_item> merge(const std::vector<std::vector<uint64_t> > & runs) {
+	const size_t fanout = runs.size();
+	queue_t<run_item, run_item_less> q(fanout);
+	std::vector<size_t> pos(fanout, 0);
+	for (size_t i = 0; i < fanout; ++i)
+		if (!runs[i].empty()) q.unsafe_push(run_item(runs[i][pos[i]++], i));
+	q.make_safe();
+
+	std::vector<run_item> output;
+	while (!q.empty()) {
+		run_item top = q.top();
+		output.push_back(top);
+		size_t i = top.second;
+		if (pos[i] < runs[i].size())
+			q.pop_and_push(run_item(runs[i][pos[i]++], i));
+		else
+			q.pop();
+	}
+	return output;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Merge `fanout` sorted runs of random length using queue_t and check that
+/// the output is sorted and complete.
+///////////////////////////////////////////////////////////////////////////////
+template <template <typename, typename> class queue_t>
+bool merge_test(size_t fanout) {
+	std::vector<std::vector<uint64_t> > runs = make_runs(fanout, false);
+	std::vector<uint64_t> expected;
+	for (size_t i = 0; i < fanout; ++i)
+		expected.insert(expected.end(), runs[i].begin(), runs[i].end());
+	std::sort(expected.begin(), expected.end());
+
+	std::vector<run_item> merged = merge<queue_t>(runs);
+	std::vector<uint64_t> output;
+	for (const run_item & x : merged) output.push_back(x.first);
+	TEST_ENSURE(output == expected, "Merged output differs from sorted input");
+	return true;
+}
+
+bool basic_test() {
+	const size_t fanouts[] = {1, 2, 3, 7, 16, 100, 255, 1024};
+	for (size_t fanout : fanouts) {
+		if (!merge_test<loser_tree>(fanout)) {
+			log_error() << "Loser tree failed with fanout " << fanout << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// The loser tree pops the same items as internal_priority_queue. Equal
+/// items may be popped in any order, so the runs have distinct items.
+///////////////////////////////////////////////////////////////////////////////
+bool heap_equivalence_test() {
+	const size_t fanouts[] = {1, 2, 3, 7, 16, 100, 250};
+	for (size_t fanout : fanouts) {
+		std::vector<std::vector<uint64_t> > runs = make_runs(fanout, true);
+		std::vector<run_item> tree = merge<loser_tree>(runs);
+		std::vector<run_item> heap = merge<internal_priority_queue>(runs);
+		TEST_ENSURE_EQUALITY(heap.size(), tree.size(), "Loser tree popped a different number of items");
+		for (size_t i = 0; i < heap.size(); ++i) {
+			TEST_ENSURE_EQUALITY(heap[i].first, tree[i].first, "Loser tree popped a different item");
+			TEST_ENSURE_EQUALITY(heap[i].second, tree[i].second, "Loser tree popped from a different run");
+		}
+	}
+	return true;
+}
+
+bool empty_test() {
+	loser_tree<int> q(4);
+	q.make_safe();
+	TEST_ENSURE(q.empty(), "Tree without elements is not empty");
+	q.resize(3);
+	q.unsafe_push(3);
+	q.unsafe_push(1);
+	q.make_safe();
+	TEST_ENSURE_EQUALITY(2u, q.size(), "Wrong size");
+	TEST_ENSURE_EQUALITY(1, q.top(), "Wrong top");
+	q.pop();
+	TEST_ENSURE_EQUALITY(3, q.top(), "Wrong top");
+	q.pop();
+	TEST_ENSURE(q.empty(), "Tree is not empty");
+	return true;
+}
+
+class my_memory_test: public memory_test {
+public:
+	loser_tree<int> * a;
+	virtual void alloc() {a = tpie_new<loser_tree<int> >(123456);}
+	virtual void free() {tpie_delete(a);}
+	virtual size_type claimed_size() {return static_cast<size_type>(loser_tree<int>::memory_usage(123456));}
+};
+
+int main(int argc, char **argv) {
+	return tpie::tests(argc, argv)
+		.test(basic_test, "basic")
+		.test(heap_equivalence_test, "heap_equivalence")
+		.test(empty_test, "empty")
+		.test(my_memory_test(), "memory");
+}
@@ -158,6 +158,117 @@ bool tall_tree_test(size_t fanout, size_t height) {
 	return true;
 }
 
+bool check_sorted_output(merge_sorter<size_t, false> & s, size_t items) {
+	dummy_progress_indicator pi;
+	s.calc(pi);
+	for (size_t i = 0; i < items; ++i) {
+		if (!s.can_pull()) {
+			log_error() << "Sorter ran out of items after " << i << std::endl;
+			return false;
+		}
+		size_t x = s.pull();
+		if (x != i) {
+			log_error() << "Expected " << i << ", got " << x << std::endl;
+			return false;
+		}
+	}
+	TEST_ENSURE(!s.can_pull(), "Sorter produced too many items");
+	return true;
+}
+
+bool parallel_run_formation_test(size_t runs) {
+	merge_sorter<size_t, false> s;
+	const memory_size_type runLength = get_block_size() / sizeof(size_t);
+	s.set_parameters(runLength, 4);
+	s.set_parallel_run_formation(true);
+	// Make sure the run formation job can overlap with pushing.
+	set_worker_count(std::max<memory_size_type>(get_worker_count(), 2));
+	const size_t items = runs * runLength + runLength / 2;
+	s.begin();
+	for (size_t i = items; i--;) {
+		s.push(i);
+	}
+	s.end();
+	return check_sorted_output(s, items);
+}
+
+bool parallel_merge_test(size_t runs, size_t jobs) {
+	merge_sorter<size_t, false> s;
+	const memory_size_type runLength = get_block_size() / sizeof(size_t);
+	s.set_parameters(runLength, 4);
+	s.set_parallel_merge(jobs);
+	set_worker_count(std::max<memory_size_type>(get_worker_count(), jobs));
+	const size_t items = runs * runLength + runLength / 3;
+	s.begin();
+	for (size_t i = items; i--;) {
+		s.push(i);
+	}
+	s.end();
+	return check_sorted_output(s, items);
+}
+
+// The run files written while merging are preallocated from the size on
+// disk of the runs they merge.
+bool reserve_test(size_t runs, size_t jobs) {
+	merge_sorter<size_t, false> s;
+	const memory_size_type runLength = get_block_size() / sizeof(size_t);
+	s.set_parameters(runLength, 4);
+	s.set_parallel_merge(jobs);
+	set_worker_count(std::max<memory_size_type>(get_worker_count(), jobs));
+	const size_t items = runs * runLength + runLength / 3;
+	s.begin();
+	for (size_t i = items; i--;) {
+		s.push(i);
+	}
+	s.end();
+	const stream_size_type before = get_bytes_preallocated();
+	if (!check_sorted_output(s, items)) return false;
+	const stream_size_type preallocated = get_bytes_preallocated() - before;
+	log_debug() << "Preallocated " << preallocated << " bytes for " << items << " items" << std::endl;
+	// 41 runs with fanout 4 are merged into 11 and then 3 runs before the
+	// final merge, so all items are written to disk twice.
+	TEST_ENSURE(preallocated >= items * sizeof(size_t), "Merge outputs not preallocated");
+	return true;
+}
+
+struct radix_item {
+	int64_t key;
+	size_t index;
+};
+
+struct radix_item_key {
+	int64_t operator()(const radix_item & item) const {
+		return item.key;
+	}
+};
+
+bool radix_test(size_t runs) {
+	typedef radix_pred<radix_item_key> pred_t;
+	merge_sorter<radix_item, false, pred_t> s;
+	const memory_size_type runLength = get_block_size() / sizeof(radix_item);
+	s.set_parameters(runLength, 4);
+	const size_t items = runs * runLength + runLength / 2;
+	// Keys are pushed in decreasing order and include negative keys.
+	s.begin();
+	for (size_t i = items; i--;) {
+		radix_item item = {static_cast<int64_t>(i) - static_cast<int64_t>(items / 2), i};
+		s.push(item);
+	}
+	s.end();
+	dummy_progress_indicator pi;
+	s.calc(pi);
+	for (size_t i = 0; i < items; ++i) {
+		TEST_ENSURE(s.can_pull(), "Sorter ran out of items");
+		radix_item x = s.pull();
+		if (x.index != i) {
+			log_error() << "Expected " << i << ", got " << x.index << std::endl;
+			return false;
+		}
+	}
+	TEST_ENSURE(!s.can_pull(), "Sorter produced too many items");
+	return true;
+}
+
 int main(int argc, char ** argv) {
 	tests t(argc, argv);
 	return
@@ -166,5 +277,10 @@ int main(int argc, char ** argv) {
 		.test(sort_faulty_upper_bound_test, "sort_faulty_upper_bound")
 		.test(temp_file_usage_test, "temp_file_usage")
 		.test(tall_tree_test, "tall_tree", "fanout", static_cast<size_t>(6), "height", static_cast<size_t>(1))
+		.test(parallel_run_formation_test, "parallel_run_formation", "runs", static_cast<size_t>(9))
+		.test(parallel_merge_test, "parallel_merge", "runs", static_cast<size_t>(41), "jobs", static_cast<size_t>(3))
+		.test(reserve_test, "reserve", "runs", static_cast<size_t>(41), "jobs", static_cast<size_t>(1))
+		.test(reserve_test, "reserve_parallel", "runs", static_cast<size_t>(41), "jobs", static_cast<size_t>(3))
+		.test(radix_test, "radix", "runs", static_cast<size_t>(9))
 		;
 }
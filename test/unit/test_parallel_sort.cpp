@@ -284,6 +284,32 @@ bool large_item_test_chooser(size_t mb, size_t itemSize) {
 	return large_item_test_helper<0, 8>::go(mb, itemSize);
 }
 
+bool parallel_partition_test(size_t n) {
+	// Force several workers so the partitioning runs in parallel even on a
+	// single core.
+	memory_size_type workers = get_worker_count();
+	set_worker_count(4);
+	bool result = true;
+	void (* generators[])(std::vector<int> &) = {
+		make_random_data, make_equal_elements_data, make_bad_case_data};
+	for (auto generator : generators) {
+		std::vector<int> v1(n);
+		generator(v1);
+		std::vector<int> v2(v1);
+		std::sort(v1.begin(), v1.end());
+		parallel_sort_impl<std::vector<int>::iterator, std::less<int>, false, 1024> s(0);
+		s.set_algorithm(parallel_sort_algorithm::parallel_partition);
+		s(v2.begin(), v2.end());
+		if (v1 != v2) {
+			tpie::log_error() << "std::sort and parallel_sort disagree" << std::endl;
+			result = false;
+			break;
+		}
+	}
+	set_worker_count(workers);
+	return result;
+}
+
 template <size_t stdsort_limit>
 struct sort_tester {
 	bool operator()(size_t n) {
@@ -304,6 +330,7 @@ int main(int argc, char **argv) {
 #endif
 		.test(adversarial<make_equal_elements_data>(), "equal_elements", "n", 1234567, "seconds", 1.0)
 		.test(bad_case, "bad_case", "n", 1024*1024, "seconds", 1.0)
+		.test(parallel_partition_test, "parallel_partition", "n", 1024*1024+123)
 		.test(adversarial<make_random_data>(), "general2", "n", 1024*1024, "seconds", 1.0)
 		.test(stress_test, "stress_test")
 		.test(large_item_test_chooser, "large_item", "mb", static_cast<size_t>(2048), "item-size", static_cast<size_t>(32))
@@ -31,8 +31,10 @@
 #include <tpie/progress_indicator_arrow.h>
 #include <tpie/pipelining/helpers.h>
 #include <tpie/pipelining/split.h>
+#include <tpie/pipelining/filter.h>
 #include <tpie/resource_manager.h>
 #include <numeric>
+#include <thread>
 
 using namespace tpie;
 using namespace tpie::pipelining;
@@ -626,6 +628,20 @@ bool fork_test() {
 	return check_test_vectors();
 }
 
+// The phases merging the first sort and writing its output can run at the
+// same time as the phases of the second sort.
+bool concurrent_phases_test() {
+	const size_t elements = 300*1024;
+	bool result[2] = {false, false};
+	pipeline p = sequence_generator(elements, true)
+		| fork(sort().name("First") | sequence_verifier(elements, &result[0]))
+		| sort().name("Second")
+		| sequence_verifier(elements, &result[1]);
+	p.set_concurrent_phases(true);
+	p();
+	return result[0] && result[1];
+}
+
 template <typename dest_t>
 struct buffer_node_t : public node {
 	typedef typename dest_t::item_type item_type;
@@ -1434,6 +1450,335 @@ bool parallel_ordered_test(size_t modulo) {
 	return result;
 }
 
+bool parallel_adaptive_test(size_t modulo) {
+	bool result = false;
+	pipeline p = sequence_generator(modulo-1, true)
+		| parallel_adaptive(multiplicative_inverter(modulo), arbitrary_order, 4)
+		| sort()
+		| sequence_verifier(modulo-1, &result);
+	p.plot(log_info());
+	tpie::progress_indicator_arrow pi("Parallel", 1);
+	p(modulo-1, pi, TPIE_FSI);
+	return result;
+}
+
+bool parallel_adaptive_ordered_test(size_t modulo) {
+	bool result = false;
+	pipeline p = sequence_generator(modulo-1, false)
+		| parallel_adaptive(multiplicative_inverter(modulo) | multiplicative_inverter(modulo), maintain_order, 4, 256)
+		| sequence_verifier(modulo-1, &result);
+	p.plot(log_info());
+	tpie::progress_indicator_arrow pi("Parallel", 1);
+	p(modulo-1, pi, TPIE_FSI);
+	return result;
+}
+
+bool parallel_adaptive_tuning_test() {
+	typedef parallel_bits::adaptive_tuning tuning_t;
+	tuning_t t(8, 4096);
+	TEST_ENSURE_EQUALITY(1u, t.active_jobs(), "Should start with one worker");
+	TEST_ENSURE_EQUALITY(2048u, t.batch_size(), "Wrong initial batch size");
+
+	// Cheap batches: the batch size grows, up to the maximum.
+	tuning_t::window w;
+	w.seconds = 1;
+	w.stallSeconds = 0;
+	w.busySeconds = 1;
+	w.batches = 100000;
+	w.items = 1000000;
+	t.update(w);
+	TEST_ENSURE_EQUALITY(4096u, t.batch_size(), "Batch size should double");
+	t.update(w);
+	TEST_ENSURE_EQUALITY(4096u, t.batch_size(), "Batch size should not exceed maximum");
+	TEST_ENSURE_EQUALITY(1u, t.active_jobs(), "Worker count should not change");
+
+	// Expensive batches: the batch size shrinks.
+	w.batches = 10;
+	t.update(w);
+	TEST_ENSURE_EQUALITY(2048u, t.batch_size(), "Batch size should halve");
+
+	// The producer waits for the workers: more workers are activated, and
+	// kept when the throughput improves.
+	w.batches = 1000;
+	w.stallSeconds = 0.5;
+	t.update(w);
+	TEST_ENSURE_EQUALITY(2u, t.active_jobs(), "Should activate workers");
+	w.items = 2000000;
+	t.update(w);
+	TEST_ENSURE_EQUALITY(2u, t.active_jobs(), "Should keep workers that help");
+
+	// ... and parked again when it does not.
+	t.update(w);
+	TEST_ENSURE_EQUALITY(4u, t.active_jobs(), "Should activate workers");
+	t.update(w);
+	TEST_ENSURE_EQUALITY(2u, t.active_jobs(), "Should park workers that do not help");
+	for (size_t i = 0; i + 1 < tuning_t::holdUpdates; ++i) {
+		t.update(w);
+		TEST_ENSURE_EQUALITY(2u, t.active_jobs(), "Should hold the worker count");
+	}
+
+	// The workers are mostly idle: one is parked.
+	w.stallSeconds = 0;
+	w.busySeconds = 0.5;
+	t.update(w);
+	TEST_ENSURE_EQUALITY(1u, t.active_jobs(), "Should park an idle worker");
+	t.update(w);
+	TEST_ENSURE_EQUALITY(1u, t.active_jobs(), "Should keep one worker");
+	return true;
+}
+
+// Pass the given number of items through a batch_ring between two threads,
+// in batches of varying size, and check that they arrive in order and that
+// the reader sees the end of the stream.
+bool batch_ring_transfer(size_t items) {
+	typedef parallel_bits::batch_ring<size_t> ring_t;
+	const memory_size_type batchSize = 7;
+	ring_t ring(batchSize);
+	parallel_bits::wakeup writerWakeup;
+	parallel_bits::wakeup readerWakeup;
+
+	std::thread writer([&]() {
+		size_t next = 0;
+		for (size_t batchNumber = 0; ; ++batchNumber) {
+			ring_t::batch * b = nullptr;
+			writerWakeup.wait([&]() {return (b = ring.back()) != nullptr;});
+			// Every eighth batch is empty.
+			b->size = std::min<size_t>(batchNumber % (batchSize + 1), items - next);
+			for (size_t i = 0; i < b->size; ++i) b->items[i] = next++;
+			const bool last = next == items;
+			b->last = last;
+			ring.push();
+			readerWakeup.notify();
+			if (last) return;
+		}
+	});
+
+	size_t expected = 0;
+	bool ordered = true;
+	bool done = false;
+	while (!done) {
+		ring_t::batch * b = nullptr;
+		readerWakeup.wait([&]() {return (b = ring.front()) != nullptr;});
+		for (size_t i = 0; i < b->size; ++i) {
+			if (b->items[i] != expected) ordered = false;
+			++expected;
+		}
+		done = b->last;
+		ring.pop();
+		writerWakeup.notify();
+	}
+	writer.join();
+	TEST_ENSURE(ordered, "Items out of order");
+	TEST_ENSURE_EQUALITY(items, expected, "Wrong number of items");
+	TEST_ENSURE(ring.front() == nullptr, "Batches after the last one");
+	return true;
+}
+
+bool parallel_batch_ring_test(size_t items) {
+	typedef parallel_bits::batch_ring<size_t> ring_t;
+	ring_t ring(4);
+	TEST_ENSURE(ring.front() == nullptr, "New ring not empty");
+	for (size_t i = 0; i < ring_t::slots; ++i) {
+		ring_t::batch * b = ring.back();
+		TEST_ENSURE(b != nullptr, "Ring full too early");
+		b->size = 1;
+		b->items[0] = i;
+		ring.push();
+	}
+	TEST_ENSURE(ring.back() == nullptr, "Ring not full");
+	for (size_t i = 0; i < ring_t::slots; ++i) {
+		ring_t::batch * b = ring.front();
+		TEST_ENSURE(b != nullptr, "Ring empty too early");
+		TEST_ENSURE_EQUALITY(i, b->items[0], "Batches out of order");
+		ring.pop();
+	}
+	TEST_ENSURE(ring.front() == nullptr, "Ring not empty");
+
+	return batch_ring_transfer(0) && batch_ring_transfer(1) && batch_ring_transfer(items);
+}
+
+// Node taking its items by non-const reference.
+template <typename dest_t>
+class increment_in_place_t : public node {
+	dest_t dest;
+public:
+	typedef test_t item_type;
+
+	increment_in_place_t(dest_t dest)
+		: dest(std::move(dest))
+	{
+		add_push_destination(this->dest);
+	}
+
+	void push(test_t & item) {
+		++item;
+		dest.push(item);
+	}
+};
+
+typedef pipe_middle<factory<increment_in_place_t> > increment_in_place;
+
+template <typename dest_t>
+class batch_counter_t : public node {
+	dest_t dest;
+	size_t * m_batches;
+public:
+	typedef test_t item_type;
+
+	batch_counter_t(dest_t dest, size_t * batches)
+		: dest(std::move(dest))
+		, m_batches(batches)
+	{
+		add_push_destination(this->dest);
+	}
+
+	void push(const test_t & item) {
+		dest.push(item);
+	}
+
+	void push_batch(array_view<const test_t> items) {
+		++*m_batches;
+		pipelining::push_batch(dest, items);
+	}
+};
+
+typedef pipe_middle<factory<batch_counter_t, size_t *> > batch_counter;
+
+void write_sequence(const std::string & path, stream_size_type items) {
+	file_stream<test_t> in;
+	in.open(path);
+	for (stream_size_type i = 0; i < items; ++i) in.write(i);
+}
+
+bool push_batch_test(stream_size_type items) {
+	tpie::temp_file input_file;
+	tpie::temp_file output_file;
+	write_sequence(input_file.path(), items);
+	size_t inputBatches = 0;
+	size_t outputBatches = 0;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		file_stream<test_t> out;
+		out.open(output_file.path());
+		pipeline p = input(in)
+			| batch_counter(&inputBatches)
+			| map([](test_t x) { return 3 * x; })
+			| filter([](test_t x) { return x % 2 == 0; })
+			| batch_counter(&outputBatches)
+			| output(out);
+		p();
+	}
+	log_debug() << inputBatches << " input batches, " << outputBatches << " output batches" << std::endl;
+	TEST_ENSURE(inputBatches > 0 && inputBatches <= items / 100, "Input should be pushed in batches");
+	TEST_ENSURE(outputBatches > 0 && outputBatches <= items / 100, "Output should be pushed in batches");
+	file_stream<test_t> out;
+	out.open(output_file.path());
+	TEST_ENSURE_EQUALITY((items + 1) / 2, out.size(), "Wrong number of items");
+	for (stream_size_type i = 0; i < items; i += 2) {
+		TEST_ENSURE_EQUALITY(3 * i, out.read(), "Wrong item");
+	}
+	return true;
+}
+
+bool push_batch_sort_test(stream_size_type items) {
+	tpie::temp_file input_file;
+	write_sequence(input_file.path(), items);
+	size_t batches = 0;
+	bool result = false;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		pipeline p = input(in)
+			| map([items](test_t x) { return items - x; })
+			| batch_counter(&batches)
+			| sort()
+			| sequence_verifier(items, &result);
+		p();
+	}
+	TEST_ENSURE(batches > 0 && batches <= items / 100, "Sort input should be pushed in batches");
+	return result;
+}
+
+bool push_batch_fallback_test(stream_size_type items) {
+	tpie::temp_file input_file;
+	tpie::temp_file output_file;
+	write_sequence(input_file.path(), items);
+	size_t batches = 0;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		file_stream<test_t> out;
+		out.open(output_file.path());
+		// multiply only accepts single items, so map pushes one at a time.
+		pipeline p = input(in)
+			| map([](test_t x) { return x + 1; })
+			| multiply(2)
+			| batch_counter(&batches)
+			| output(out);
+		p();
+	}
+	TEST_ENSURE_EQUALITY(0u, batches, "multiply should not push batches");
+	file_stream<test_t> out;
+	out.open(output_file.path());
+	TEST_ENSURE_EQUALITY(items, out.size(), "Wrong number of items");
+	for (stream_size_type i = 0; i < items; ++i) {
+		TEST_ENSURE_EQUALITY(2 * (i + 1), out.read(), "Wrong item");
+	}
+	return true;
+}
+
+bool push_batch_virtual_test(stream_size_type items) {
+	tpie::temp_file input_file;
+	tpie::temp_file output_file;
+	write_sequence(input_file.path(), items);
+	size_t batches = 0;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		file_stream<test_t> out;
+		out.open(output_file.path());
+		pipeline p = virtual_chunk_begin<test_t>(input(in))
+			| virtual_chunk<test_t, test_t>(map([](test_t x) { return 5 * x; }))
+			| virtual_chunk_end<test_t>(batch_counter(&batches) | output(out));
+		p();
+	}
+	TEST_ENSURE(batches > 0 && batches <= items / 100, "Batches should cross virtual chunks");
+	file_stream<test_t> out;
+	out.open(output_file.path());
+	TEST_ENSURE_EQUALITY(items, out.size(), "Wrong number of items");
+	for (stream_size_type i = 0; i < items; ++i) {
+		TEST_ENSURE_EQUALITY(5 * i, out.read(), "Wrong item");
+	}
+	return true;
+}
+
+// Batches reaching a virtual chunk of non-const references are pushed item
+// by item.
+bool push_batch_virtual_reference_test(stream_size_type items) {
+	tpie::temp_file input_file;
+	tpie::temp_file output_file;
+	write_sequence(input_file.path(), items);
+	size_t batches = 0;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		file_stream<test_t> out;
+		out.open(output_file.path());
+		pipeline p = virtual_chunk_begin<test_t &>(input(in) | batch_counter(&batches))
+			| virtual_chunk_end<test_t &>(increment_in_place() | output(out));
+		p();
+	}
+	TEST_ENSURE(batches > 0, "Input should be pushed in batches");
+	file_stream<test_t> out;
+	out.open(output_file.path());
+	TEST_ENSURE_EQUALITY(items, out.size(), "Wrong number of items");
+	for (stream_size_type i = 0; i < items; ++i) {
+		TEST_ENSURE_EQUALITY(i + 1, out.read(), "Wrong item");
+	}
+	return true;
+}
+
 template <typename dest_t>
 class Monotonic : public node {
 	dest_t dest;
@@ -2626,6 +2971,11 @@ int main(int argc, char ** argv) {
 	.test(vector_multiply_test, "vector")
 	.test(file_stream_test, "filestream", "n", static_cast<stream_size_type>(3))
 	.test(file_stream_pull_test, "fspull")
+	.test(push_batch_test, "push_batch", "n", static_cast<stream_size_type>(1000000))
+	.test(push_batch_sort_test, "push_batch_sort", "n", static_cast<stream_size_type>(200000))
+	.test(push_batch_fallback_test, "push_batch_fallback", "n", static_cast<stream_size_type>(100000))
+	.test(push_batch_virtual_test, "push_batch_virtual", "n", static_cast<stream_size_type>(100000))
+	.test(push_batch_virtual_reference_test, "push_batch_virtual_reference", "n", static_cast<stream_size_type>(100000))
 		//.test(file_stream_alt_push_test, "fsaltpush")
 	.test(pull_test, "pull")
 	.test(merge_test, "merge")
@@ -2640,6 +2990,7 @@ int main(int argc, char ** argv) {
 	.test(uniq_test, "uniq")
 	.multi_test(memory_test_multi, "memory")
 	.test(fork_test, "fork")
+	.test(concurrent_phases_test, "concurrent_phases")
 	.test(merger_memory_test, "merger_memory", "n", static_cast<size_t>(10))
 	.test(fetch_forward_test, "fetch_forward")
 	.test(bound_fetch_forward_test, "bound_fetch_forward")
@@ -2656,6 +3007,10 @@ int main(int argc, char ** argv) {
 	.test(push_iterator_test, "push_iterator")
 	.test(parallel_test, "parallel", "modulo", static_cast<size_t>(20011))
 	.test(parallel_ordered_test, "parallel_ordered", "modulo", static_cast<size_t>(20011))
+	.test(parallel_adaptive_test, "parallel_adaptive", "modulo", static_cast<size_t>(20011))
+	.test(parallel_adaptive_ordered_test, "parallel_adaptive_ordered", "modulo", static_cast<size_t>(20011))
+	.test(parallel_adaptive_tuning_test, "parallel_adaptive_tuning")
+	.test(parallel_batch_ring_test, "parallel_batch_ring", "items", static_cast<size_t>(1000000))
 	.test(parallel_step_test, "parallel_step")
 	.test(parallel_multiple_test, "parallel_multiple")
 	.test(parallel_own_buffer_test, "parallel_own_buffer")
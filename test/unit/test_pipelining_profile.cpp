@@ -0,0 +1,304 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet cino+=(0 :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+// Wrap the nodes of this test in bits::profiled regardless of the build
+// configuration.
+#ifndef TPIE_PIPELINING_PROFILE
+#define TPIE_PIPELINING_PROFILE
+#endif
+
+#include "common.h"
+#include <tpie/pipelining.h>
+#include <tpie/pipelining/filter.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <sstream>
+
+using namespace tpie;
+using namespace tpie::pipelining;
+
+typedef uint64_t test_t;
+
+namespace {
+
+// Spend the given time on the CPU.
+void spin(double seconds) {
+	auto start = std::chrono::steady_clock::now();
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds) {}
+}
+
+std::vector<test_t> make_input(size_t n) {
+	std::vector<test_t> v(n);
+	for (size_t i = 0; i < n; ++i) v[i] = i;
+	return v;
+}
+
+} // unnamed namespace
+
+///////////////////////////////////////////////////////////////////////////////
+/// Node passing on its items, spending the given time on each, and storing
+/// the address of its profile when the pipeline begins.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t>
+class probe_t : public node {
+public:
+	typedef test_t item_type;
+
+	probe_t(dest_t dest, const node_profile ** profile, double secondsPerItem)
+		: m_dest(std::move(dest))
+		, m_profile(profile)
+		, m_secondsPerItem(secondsPerItem)
+	{
+		add_push_destination(m_dest);
+		set_name("Probe");
+	}
+
+	void begin() override {
+		*m_profile = &get_profile();
+	}
+
+	void push(const test_t & item) {
+		spin(m_secondsPerItem);
+		m_dest.push(item);
+	}
+
+	void push_batch(array_view<const test_t> items) {
+		pipelining::push_batch(m_dest, items);
+	}
+
+private:
+	dest_t m_dest;
+	const node_profile ** m_profile;
+	double m_secondsPerItem;
+};
+
+typedef pipe_middle<factory<probe_t, const node_profile **, double> > probe;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Node pushing the items of a vector as a single batch.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t>
+class batch_input_t : public node {
+public:
+	batch_input_t(dest_t dest, const std::vector<test_t> & input)
+		: m_dest(std::move(dest))
+		, m_input(input)
+	{
+		add_push_destination(m_dest);
+	}
+
+	void go() override {
+		push_batch(m_dest, m_input.data(), m_input.data() + m_input.size());
+	}
+
+private:
+	dest_t m_dest;
+	const std::vector<test_t> & m_input;
+};
+
+typedef pipe_begin<factory<batch_input_t, const std::vector<test_t> &> > batch_input;
+
+template <typename src_t>
+class pull_probe_t : public node {
+public:
+	typedef test_t item_type;
+
+	pull_probe_t(src_t src, const node_profile ** profile)
+		: m_src(std::move(src))
+		, m_profile(profile)
+	{
+		add_pull_source(m_src);
+	}
+
+	void begin() override {
+		*m_profile = &get_profile();
+	}
+
+	bool can_pull() {return m_src.can_pull();}
+
+	test_t pull() {return m_src.pull();}
+
+private:
+	src_t m_src;
+	const node_profile ** m_profile;
+};
+
+typedef pullpipe_middle<factory<pull_probe_t, const node_profile **> > pull_probe;
+
+bool counts_test(size_t n) {
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * before = nullptr;
+	const node_profile * after = nullptr;
+	pipeline p = input_vector(input)
+		| probe(&before, 0.0)
+		| filter([](test_t x) {return x % 2 == 0;})
+		| probe(&after, 0.0)
+		| output_vector(output);
+	p();
+	TEST_ENSURE(before && after, "Probes did not begin");
+	TEST_ENSURE(before->callsTimed && after->callsTimed, "Calls not timed");
+	TEST_ENSURE_EQUALITY(n, before->itemsPushed, "Wrong number of items pushed before filter");
+	TEST_ENSURE_EQUALITY((n + 1) / 2, after->itemsPushed, "Wrong number of items pushed after filter");
+	TEST_ENSURE_EQUALITY(static_cast<stream_size_type>(0), before->itemsPulled, "Items pulled from push node");
+	TEST_ENSURE_EQUALITY((n + 1) / 2, output.size(), "Wrong output size");
+	return true;
+}
+
+bool batch_test(size_t n) {
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * profile = nullptr;
+	pipeline p = batch_input(input) | probe(&profile, 0.0) | output_vector(output);
+	p();
+	TEST_ENSURE(profile, "Probe did not begin");
+	TEST_ENSURE_EQUALITY(n, profile->itemsPushed, "Wrong number of items pushed in batch");
+	TEST_ENSURE(output == input, "Wrong output");
+	return true;
+}
+
+bool pull_test(size_t n) {
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * profile = nullptr;
+	pipeline p = pull_input_vector(input) | pull_probe(&profile) | pull_output_iterator(std::back_inserter(output));
+	p();
+	TEST_ENSURE(profile, "Probe did not begin");
+	TEST_ENSURE_EQUALITY(n, profile->itemsPulled, "Wrong number of items pulled");
+	TEST_ENSURE_EQUALITY(static_cast<stream_size_type>(0), profile->itemsPushed, "Items pushed to pull node");
+	TEST_ENSURE(output == input, "Wrong output");
+	return true;
+}
+
+bool sort_test(size_t n) {
+	std::vector<test_t> input = make_input(n);
+	std::reverse(input.begin(), input.end());
+	std::vector<test_t> output;
+	const node_profile * profile = nullptr;
+	pipeline p = input_vector(input) | sort() | probe(&profile, 0.0) | output_vector(output);
+	p();
+	TEST_ENSURE(profile, "Probe did not begin");
+	TEST_ENSURE_EQUALITY(n, profile->itemsPushed, "Wrong number of sorted items pushed");
+	TEST_ENSURE(std::is_sorted(output.begin(), output.end()), "Output not sorted");
+	return true;
+}
+
+bool self_time_test(size_t n) {
+	const double secondsPerItem = 20e-6;
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * fast = nullptr;
+	const node_profile * slow = nullptr;
+	pipeline p = input_vector(input)
+		| probe(&fast, 0.0)
+		| probe(&slow, secondsPerItem)
+		| output_vector(output);
+	p();
+	TEST_ENSURE(fast && slow, "Probes did not begin");
+	log_debug() << "fast: wall " << fast->wallSeconds << " self " << fast->selfSeconds
+				<< "; slow: wall " << slow->wallSeconds << " self " << slow->selfSeconds
+				<< " CPU " << slow->cpuSeconds << std::endl;
+	// Beyond the first calls, push is timed in samples.
+	TEST_ENSURE(slow->selfSeconds >= 0.9 * n * secondsPerItem, "Self time of slow node too small");
+	TEST_ENSURE(fast->wallSeconds >= slow->wallSeconds, "Wall time excludes time in destination");
+	TEST_ENSURE(fast->selfSeconds < slow->selfSeconds, "Time of destination counted as self time");
+	TEST_ENSURE(slow->cpuSeconds > 0, "No CPU time measured");
+
+	std::stringstream table;
+	p.output_profile(table);
+	log_debug() << table.str();
+	std::string s = table.str();
+	TEST_ENSURE(s.find("Pipelining profile") != std::string::npos, "No table header");
+	TEST_ENSURE(s.find("Probe") != std::string::npos, "Node missing from table");
+	TEST_ENSURE(s.find(std::to_string(n)) != std::string::npos, "Item count missing from table");
+	return true;
+}
+
+// Most calls are not timed, but the estimates add up.
+bool sampling_test(size_t n) {
+	const double secondsPerItem = 10e-6;
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * fast = nullptr;
+	const node_profile * slow = nullptr;
+	pipeline p = input_vector(input)
+		| probe(&fast, 0.0)
+		| probe(&slow, secondsPerItem)
+		| output_vector(output);
+	p();
+	TEST_ENSURE(fast && slow, "Probes did not begin");
+	log_debug() << "fast: wall " << fast->wallSeconds << " self " << fast->selfSeconds
+				<< "; slow: wall " << slow->wallSeconds << " self " << slow->selfSeconds << std::endl;
+	TEST_ENSURE_EQUALITY(n, slow->itemsPushed, "Items not counted exactly");
+	TEST_ENSURE(slow->selfSeconds >= 0.8 * n * secondsPerItem, "Self time of slow node underestimated");
+	TEST_ENSURE(slow->selfSeconds <= 2 * n * secondsPerItem, "Self time of slow node overestimated");
+	TEST_ENSURE(fast->wallSeconds >= slow->wallSeconds, "Wall time excludes time in destination");
+	TEST_ENSURE(fast->selfSeconds < slow->selfSeconds, "Time of destination counted as self time");
+	return true;
+}
+
+bool plot_test(size_t n) {
+	std::vector<test_t> input = make_input(n);
+	std::vector<test_t> output;
+	const node_profile * profile = nullptr;
+	pipeline p = input_vector(input) | probe(&profile, 0.0) | output_vector(output);
+	p();
+	std::stringstream graph;
+	p.plot_profile(graph);
+	log_debug() << graph.str();
+	std::string s = graph.str();
+	TEST_ENSURE(s.find("digraph") != std::string::npos, "No graph");
+	TEST_ENSURE(s.find("Input vector") != std::string::npos, "Wrapped node not named after its type");
+	TEST_ENSURE(s.find("\\nself ") != std::string::npos, "No times in graph");
+	TEST_ENSURE(s.find("items in " + std::to_string(n)) != std::string::npos, "No item counts in graph");
+	return true;
+}
+
+bool scope_test() {
+	node_profile outer;
+	node_profile inner;
+	{
+		profile_scope a(outer);
+		spin(0.01);
+		{
+			profile_scope b(inner);
+			spin(0.02);
+		}
+	}
+	log_debug() << "outer: wall " << outer.wallSeconds << " self " << outer.selfSeconds
+				<< "; inner: wall " << inner.wallSeconds << " self " << inner.selfSeconds << std::endl;
+	TEST_ENSURE(inner.wallSeconds >= 0.02, "Inner wall time too small");
+	TEST_ENSURE_EQUALITY(inner.wallSeconds, inner.selfSeconds, "Inner self time differs from wall time");
+	TEST_ENSURE(outer.wallSeconds >= outer.selfSeconds + inner.wallSeconds - 1e-9, "Inner time counted as outer self time");
+	TEST_ENSURE(outer.selfSeconds >= 0.01, "Outer self time too small");
+	return true;
+}
+
+int main(int argc, char ** argv) {
+	return tpie::tests(argc, argv)
+	.test(counts_test, "counts", "n", static_cast<size_t>(10001))
+	.test(batch_test, "batch", "n", static_cast<size_t>(10000))
+	.test(pull_test, "pull", "n", static_cast<size_t>(10000))
+	.test(sort_test, "sort", "n", static_cast<size_t>(10000))
+	.test(self_time_test, "self_time", "n", static_cast<size_t>(2000))
+	.test(sampling_test, "sampling", "n", static_cast<size_t>(64*200))
+	.test(plot_test, "plot", "n", static_cast<size_t>(1000))
+	.test(scope_test, "scope");
+}
@@ -21,6 +21,11 @@
 #include <tpie/pipelining/runtime.h>
 #include <tpie/pipelining/runtime.cpp>
 #include <tpie/pipelining/node.h>
+#include <tpie/progress_indicator_null.h>
+#include <tpie/file_manager.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 using namespace tpie;
 using namespace tpie::pipelining;
@@ -187,6 +192,105 @@ void print_vector(std::ostream & out, const std::vector<T> & vec, const std::str
 	out << "}" << std::endl;
 }
 
+bool concurrent_groups_test() {
+	const size_t N = 8;
+	evac_node nodes[N];
+	node_map::id_t ids[N];
+	for (size_t i = 0; i < N; ++i) ids[i] = nodes[i].get_id();
+
+	node_map::ptr nodeMap = nodes[0].get_node_map();
+	for (size_t i = 1; i < N; ++i) nodes[i].get_node_map()->union_set(nodeMap);
+	nodeMap = nodeMap->find_authority();
+
+	// Phase {0,1,2} is followed by the independent phases {3} and {4},
+	// which are followed by phase {5,6,7}.
+	nodeMap->add_relation(ids[0], ids[1], pushes);
+	nodeMap->add_relation(ids[0], ids[2], pushes);
+	nodeMap->add_relation(ids[3], ids[1], depends);
+	nodeMap->add_relation(ids[4], ids[2], depends);
+	nodeMap->add_relation(ids[5], ids[3], depends);
+	nodeMap->add_relation(ids[6], ids[4], depends);
+	nodeMap->add_relation(ids[5], ids[7], pushes);
+	nodeMap->add_relation(ids[6], ids[7], pushes);
+
+	runtime rt(nodeMap);
+	std::map<node *, size_t> phaseMap;
+	graph<size_t> phaseGraph;
+	std::unordered_set<node_map::id_t> evacuateWhenDone;
+	std::vector<std::vector<node *> > phases;
+	rt.get_phase_map(phaseMap);
+	rt.get_phase_graph(phaseMap, phaseGraph);
+	rt.get_phases(phaseMap, phaseGraph, evacuateWhenDone, phases);
+	datastructure_runtime drt(phases, *nodeMap);
+
+	std::vector<size_t> groups;
+	rt.get_concurrent_phases(phaseMap, phaseGraph, phases, drt, 1, groups);
+	if (groups != std::vector<size_t>{1, 1, 1, 1}) {
+		log_error() << "Phases grouped without concurrency" << std::endl;
+		return false;
+	}
+	rt.get_concurrent_phases(phaseMap, phaseGraph, phases, drt, 4, groups);
+	if (groups != std::vector<size_t>{1, 2, 0, 1}) {
+		print_vector(log_error(), groups, "Wrong groups");
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Initiator that waits in go() until all nodes sharing the rendezvous
+/// have started their go(), or until a timeout.
+///////////////////////////////////////////////////////////////////////////////
+class rendezvous_node : public node {
+public:
+	struct rendezvous {
+		std::mutex mutex;
+		std::condition_variable cond;
+		size_t arrived = 0;
+	};
+
+	rendezvous_node(rendezvous & r, size_t count, bool & met)
+		: m_rendezvous(r)
+		, m_count(count)
+		, m_met(met)
+	{
+	}
+
+	void go() override {
+		std::unique_lock<std::mutex> lock(m_rendezvous.mutex);
+		++m_rendezvous.arrived;
+		m_rendezvous.cond.notify_all();
+		m_met = m_rendezvous.cond.wait_for(lock, std::chrono::seconds(30), [&] {
+			return m_rendezvous.arrived >= m_count;
+		});
+	}
+
+private:
+	rendezvous & m_rendezvous;
+	size_t m_count;
+	bool & m_met;
+};
+
+bool concurrent_phases_test() {
+	rendezvous_node::rendezvous r;
+	bool met[2] = {false, false};
+	rendezvous_node a(r, 2, met[0]);
+	rendezvous_node b(r, 2, met[1]);
+	b.get_node_map()->union_set(a.get_node_map());
+
+	runtime rt(a.get_node_map()->find_authority());
+	rt.set_concurrent_phases(true);
+	progress_indicator_null pi;
+	rt.go(1, pi, get_file_manager().available(), get_memory_manager().available(),
+		  nullptr, nullptr);
+
+	if (!met[0] || !met[1]) {
+		log_error() << "Independent phases did not run at the same time" << std::endl;
+		return false;
+	}
+	return true;
+}
+
 struct satisfiable_edge_t {
 	size_t from;
 	size_t to;
@@ -574,6 +678,8 @@ int main(int argc, char ** argv) {
 	return tpie::tests(argc, argv)
 	.test(evacuate_test, "evacuate")
 	.test(get_phase_graph_test, "get_phase_graph")
+	.test(concurrent_groups_test, "concurrent_groups")
+	.test(concurrent_phases_test, "concurrent_phases")
 	.multi_test(optimal_satisfiable_ordering_test, "optimal_satisfiable_ordering")
 	.multi_test(evacuate_phase_graph_multi, "evacuate_phase_graph")
 	;
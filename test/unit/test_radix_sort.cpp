@@ -0,0 +1,70 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include "common.h"
+#include <tpie/radix_sort.h>
+#include <random>
+#include <vector>
+
+template <typename T, typename gen_t>
+bool check_radix_sort(size_t n, gen_t gen) {
+	std::vector<T> v1(n);
+	for (size_t i = 0; i < n; ++i) v1[i] = gen();
+	std::vector<T> v2(v1);
+	std::sort(v1.begin(), v1.end());
+	tpie::radix_sort(v2.begin(), v2.end(), tpie::identity_key());
+	if (v1 != v2) {
+		tpie::log_error() << "std::sort and radix_sort disagree" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool basic_test(size_t n) {
+	std::mt19937_64 rng(42);
+	return check_radix_sort<uint64_t>(n, [&]() { return rng(); });
+}
+
+bool signed_test(size_t n) {
+	std::mt19937_64 rng(42);
+	return check_radix_sort<int32_t>(n, [&]() { return static_cast<int32_t>(rng()); })
+		&& check_radix_sort<int64_t>(n, [&]() { return static_cast<int64_t>(rng()); });
+}
+
+bool small_keys_test(size_t n) {
+	// Keys differing only in the least significant byte.
+	std::mt19937_64 rng(42);
+	return check_radix_sort<uint64_t>(n, [&]() { return (uint64_t(1) << 40) + rng() % 200; })
+		&& check_radix_sort<uint8_t>(n, [&]() { return static_cast<uint8_t>(rng()); });
+}
+
+bool equal_keys_test(size_t n) {
+	std::mt19937_64 rng(42);
+	return check_radix_sort<uint64_t>(n, [&]() { return uint64_t(42); })
+		&& check_radix_sort<uint64_t>(n, [&]() { return rng() % 2; });
+}
+
+int main(int argc, char ** argv) {
+	return tpie::tests(argc, argv)
+		.test(basic_test, "basic", "n", static_cast<size_t>(1000000))
+		.test(signed_test, "signed", "n", static_cast<size_t>(100000))
+		.test(small_keys_test, "small_keys", "n", static_cast<size_t>(100000))
+		.test(equal_keys_test, "equal_keys", "n", static_cast<size_t>(100000))
+		;
+}
@@ -19,16 +19,24 @@
 
 #include "common.h"
 #include <tpie/file_accessor/file_accessor.h>
+#include <tpie/file_accessor/uring.h>
 #include <tpie/tempname.h>
+#include <tpie/file_manager.h>
+#include <filesystem>
+#include <thread>
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
 
 using namespace tpie;
 
+template <typename accessor_t>
 bool open_rw_new_test() {
 	std::string test_str = "foobar";
 
 	temp_file tmp;
 
-	tpie::default_raw_file_accessor fa;
+	accessor_t fa;
 
 	fa.open_rw_new(tmp.path());
 	fa.write_i(test_str.c_str(), test_str.size());
@@ -42,10 +50,11 @@ bool open_rw_new_test() {
 	return std::equal(test_str.begin(), test_str.end(), result.begin(), result.end());
 }
 
+template <typename accessor_t>
 bool try_open_rw_test() {
 	temp_file tmp;
 
-	tpie::default_raw_file_accessor fa;
+	accessor_t fa;
 	if (fa.try_open_rw(tmp.path())) return false;
 
 	fa.open_wo(tmp.path());
@@ -56,9 +65,310 @@ bool try_open_rw_test() {
 	return true;
 }
 
+// Write chunks, overwrite some of them and read them back in order, in
+// reverse order and after truncating.
+template <typename accessor_t>
+bool chunks_test() {
+	const size_t chunkItems = 4096;
+	const size_t chunks = 64;
+	temp_file tmp;
+
+	accessor_t fa;
+	fa.open_rw_new(tmp.path());
+	std::vector<uint64_t> chunk(chunkItems);
+	for (size_t c = 0; c < chunks; ++c) {
+		for (size_t i = 0; i < chunkItems; ++i) chunk[i] = c*chunkItems + i;
+		fa.write_i(chunk.data(), sizeof(uint64_t)*chunkItems);
+	}
+	for (size_t c = 1; c < chunks; c += 7) {
+		for (size_t i = 0; i < chunkItems; ++i) chunk[i] = c;
+		fa.seek_i(c*chunkItems*sizeof(uint64_t));
+		fa.write_i(chunk.data(), sizeof(uint64_t)*chunkItems);
+	}
+	TEST_ENSURE_EQUALITY(chunks*chunkItems*sizeof(uint64_t), fa.file_size_i(), "Wrong file size");
+
+	for (size_t pass = 0; pass < 2; ++pass) {
+		for (size_t k = 0; k < chunks; ++k) {
+			size_t c = pass == 0 ? k : chunks - 1 - k;
+			fa.seek_i(c*chunkItems*sizeof(uint64_t));
+			fa.read_i(chunk.data(), sizeof(uint64_t)*chunkItems);
+			for (size_t i = 0; i < chunkItems; ++i) {
+				uint64_t expected = (c % 7 == 1) ? c : c*chunkItems + i;
+				TEST_ENSURE_EQUALITY(expected, chunk[i], "Wrong item read");
+			}
+		}
+	}
+
+	fa.seek_i(0);
+	fa.read_i(chunk.data(), sizeof(uint64_t)*chunkItems);
+	fa.truncate_i(chunkItems*sizeof(uint64_t));
+	TEST_ENSURE_EQUALITY(chunkItems*sizeof(uint64_t), fa.file_size_i(), "Wrong file size after truncate");
+	fa.seek_i(0);
+	fa.read_i(chunk.data(), sizeof(uint64_t)*chunkItems);
+	TEST_ENSURE_EQUALITY(uint64_t(chunkItems-1), chunk[chunkItems-1], "Wrong item after truncate");
+	fa.close_i();
+	return true;
+}
+
+template <typename accessor_t>
+bool stream_accessor_test() {
+	const memory_size_type blockItems = 8192;
+	const memory_size_type blockSize = blockItems*sizeof(uint64_t);
+	const stream_size_type blocks = 40;
+	const memory_size_type lastItems = 123;
+	temp_file tmp;
+	std::vector<uint64_t> block(blockItems);
+
+	file_accessor::stream_accessor<accessor_t> fa;
+	fa.open(tmp.path(), true, true, sizeof(uint64_t), blockSize, 0, access_sequential, 0);
+	for (stream_size_type b = 0; b < blocks; ++b) {
+		for (size_t i = 0; i < blockItems; ++i) block[i] = b*blockItems + i;
+		fa.write_block(block.data(), b, b + 1 == blocks ? lastItems : blockItems);
+	}
+	fa.close();
+
+	fa.open(tmp.path(), true, false, sizeof(uint64_t), blockSize, 0, access_sequential, 0);
+	TEST_ENSURE_EQUALITY((blocks-1)*blockItems + lastItems, fa.size(), "Wrong size after reopen");
+	for (stream_size_type b = 0; b < blocks; ++b) {
+		memory_size_type items = b + 1 == blocks ? lastItems : blockItems;
+		TEST_ENSURE_EQUALITY(items, fa.read_block(block.data(), b, items), "Wrong number of items read");
+		for (size_t i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(uint64_t(b*blockItems + i), block[i], "Wrong item read");
+	}
+	fa.close();
+	return true;
+}
+
+#ifdef WIN32
+typedef file_accessor::win32 positional_accessor;
+#else
+typedef file_accessor::posix positional_accessor;
+#endif
+
+// Several threads read blocks through one open stream accessor.
+bool shared_reads_test() {
+	const memory_size_type blockItems = 4096;
+	const memory_size_type blockSize = blockItems*sizeof(uint64_t);
+	const stream_size_type blocks = 64;
+	const size_t threads = 4;
+	temp_file tmp;
+
+	file_accessor::stream_accessor<positional_accessor> fa;
+	fa.open(tmp.path(), true, true, sizeof(uint64_t), blockSize, 0, access_sequential, 0);
+	{
+		std::vector<uint64_t> block(blockItems);
+		for (stream_size_type b = 0; b < blocks; ++b) {
+			for (size_t i = 0; i < blockItems; ++i) block[i] = b*blockItems + i;
+			fa.write_block(block.data(), b, blockItems);
+		}
+	}
+
+	std::vector<std::thread> readers;
+	std::vector<char> ok(threads, 0);
+	for (size_t t = 0; t < threads; ++t) {
+		readers.push_back(std::thread([&, t]() {
+			std::vector<uint64_t> block(blockItems);
+			bool good = true;
+			for (size_t round = 0; round < 4; ++round) {
+				for (stream_size_type b = t; b < blocks; b += threads) {
+					if (fa.read_block(block.data(), b, blockItems) != blockItems) good = false;
+					for (size_t i = 0; i < blockItems; ++i)
+						if (block[i] != b*blockItems + i) good = false;
+				}
+			}
+			ok[t] = good;
+		}));
+	}
+	for (size_t t = 0; t < threads; ++t) readers[t].join();
+	fa.close();
+	for (size_t t = 0; t < threads; ++t)
+		TEST_ENSURE(ok[t], "Wrong data read by thread " << t);
+	return true;
+}
+
+#ifndef WIN32
+stream_size_type allocated_bytes(const std::string & path) {
+	struct ::stat buf;
+	if (::stat(path.c_str(), &buf) != 0) return 0;
+	return static_cast<stream_size_type>(buf.st_blocks) * 512;
+}
+#endif
+
+// Preallocated space does not change the file size and is released on close.
+template <typename accessor_t>
+bool preallocate_test() {
+	temp_file tmp;
+	const memory_size_type bytes = 8*1024*1024;
+	accessor_t fa;
+	fa.open_rw_new(tmp.path());
+	char data[100] = {1};
+	fa.write_i(data, sizeof(data));
+	fa.preallocate_i(bytes);
+	TEST_ENSURE_EQUALITY(stream_size_type(sizeof(data)), fa.file_size_i(), "Preallocation changed the file size");
+	fa.write_i(data, sizeof(data));
+	TEST_ENSURE_EQUALITY(stream_size_type(2*sizeof(data)), fa.file_size_i(), "Wrong file size after write");
+#ifndef WIN32
+	if (allocated_bytes(tmp.path()) < bytes) {
+		tpie::log_info() << "fallocate is not supported by the file system" << std::endl;
+		return true;
+	}
+#endif
+	fa.close_i();
+#ifndef WIN32
+	TEST_ENSURE(allocated_bytes(tmp.path()) < bytes/2, "Preallocated space not released on close");
+#endif
+	// A smaller hint releases the space beyond the end of the file
+	fa.open_rw_new(tmp.path());
+	fa.preallocate_i(bytes);
+	fa.preallocate_i(fa.file_size_i());
+#ifndef WIN32
+	TEST_ENSURE(allocated_bytes(tmp.path()) < bytes/2, "Preallocated space not released by a smaller hint");
+#endif
+	fa.close_i();
+	fa.open_ro(tmp.path());
+	TEST_ENSURE_EQUALITY(stream_size_type(2*sizeof(data)), fa.file_size_i(), "Wrong file size after reopen");
+	fa.close_i();
+	return true;
+}
+
+// Punching a hole frees the whole pages of the range in a file opened for
+// reading, and leaves the file size and the rest of the contents alone.
+template <typename accessor_t>
+bool punch_hole_test() {
+	temp_file tmp;
+	const memory_size_type bytes = 1024*1024;
+	std::vector<char> data(bytes);
+	for (memory_size_type i = 0; i < bytes; ++i) data[i] = static_cast<char>(i % 251 + 1);
+	{
+		accessor_t fa;
+		fa.open_rw_new(tmp.path());
+		fa.write_i(&data[0], bytes);
+		fa.close_i();
+	}
+	accessor_t fa;
+	fa.set_punch_holes(true);
+	fa.open_ro(tmp.path());
+	const stream_size_type begin = 1000;
+	const stream_size_type end = bytes - 1000;
+	stream_size_type freedTo = fa.punch_hole_i(begin, end);
+	if (freedTo == begin) {
+		tpie::log_info() << "Punching holes is not supported by the file system" << std::endl;
+		return true;
+	}
+	TEST_ENSURE_EQUALITY(end / file_accessor::block_alignment * file_accessor::block_alignment, freedTo, "Wrong end of freed range");
+	TEST_ENSURE_EQUALITY(stream_size_type(bytes), fa.file_size_i(), "Punching a hole changed the file size");
+#ifndef WIN32
+	TEST_ENSURE(allocated_bytes(tmp.path()) < bytes/2, "Punched space not freed");
+#endif
+	std::vector<char> buf(bytes);
+	fa.pread_i(&buf[0], bytes, 0);
+	for (memory_size_type i = 0; i < bytes; ++i) {
+		char expected = (i < 4096 || i >= freedTo) ? data[i] : 0;
+		TEST_ENSURE_EQUALITY(int(expected), int(buf[i]), "Wrong byte at " << i);
+	}
+	TEST_ENSURE_EQUALITY(freedTo, fa.punch_hole_i(freedTo, end), "Freed a partial page");
+	fa.close_i();
+	return true;
+}
+
+#ifdef __linux__
+memory_size_type process_fds() {
+	memory_size_type n = 0;
+	for (const auto & entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+		unused(entry);
+		++n;
+	}
+	return n;
+}
+
+// Every descriptor an accessor holds, including an io_uring ring, counts as
+// an open file until the accessor is closed.
+template <typename accessor_t>
+bool open_files_test() {
+	temp_file tmp;
+	const memory_size_type files = get_file_manager().used();
+	const memory_size_type fds = process_fds();
+	accessor_t fa;
+	fa.open_rw_new(tmp.path());
+	char data[100] = {1};
+	fa.write_i(data, sizeof(data));
+	fa.seek_i(0);
+	fa.read_i(data, sizeof(data));
+	log_debug() << "Open files: " << get_file_manager().used() - files
+				<< ", descriptors: " << process_fds() - fds << std::endl;
+	TEST_ENSURE_EQUALITY(process_fds() - fds, get_file_manager().used() - files, "Descriptors not counted as open files");
+	fa.close_i();
+	TEST_ENSURE_EQUALITY(files, get_file_manager().used(), "Open files not released on close");
+	TEST_ENSURE_EQUALITY(fds, process_fds(), "Descriptors not closed");
+	return true;
+}
+
+// A copy of an open accessor has its own descriptor, so closing either one
+// leaves the other usable.
+bool copy_test() {
+	const std::string data = "foobar";
+	temp_file tmp;
+	const memory_size_type files = get_file_manager().used();
+	const memory_size_type fds = process_fds();
+	file_accessor::posix fa;
+	fa.open_rw_new(tmp.path());
+	fa.write_i(data.c_str(), data.size());
+	TEST_ENSURE(fa.map_i(data.size()) != 0, "map_i failed");
+	{
+		file_accessor::posix copy(fa);
+		TEST_ENSURE_EQUALITY(files + 2, get_file_manager().used(), "Copy not counted as an open file");
+		TEST_ENSURE_EQUALITY(fds + 2, process_fds(), "Copy does not have its own descriptor");
+		fa.close_i();
+		std::vector<char> result(data.size());
+		copy.seek_i(0);
+		copy.read_i(result.data(), result.size());
+		TEST_ENSURE(std::equal(data.begin(), data.end(), result.begin()), "Wrong data read through the copy");
+		fa = copy;
+	}
+	TEST_ENSURE_EQUALITY(files + 1, get_file_manager().used(), "Assigned accessor not counted as an open file");
+	std::vector<char> result(data.size());
+	fa.pread_i(result.data(), result.size(), 0);
+	TEST_ENSURE(std::equal(data.begin(), data.end(), result.begin()), "Wrong data read after assignment");
+	fa.close_i();
+	TEST_ENSURE_EQUALITY(files, get_file_manager().used(), "Open files not released on close");
+	TEST_ENSURE_EQUALITY(fds, process_fds(), "Descriptors not closed");
+	return true;
+}
+#else
+template <typename accessor_t>
+bool open_files_test() {
+	return true;
+}
+
+bool copy_test() {
+	return true;
+}
+#endif
+
+#ifdef TPIE_HAS_IO_URING
+typedef file_accessor::uring uring_accessor;
+#else
+// Without io_uring, the uring tests exercise the default accessor.
+typedef default_raw_file_accessor uring_accessor;
+#endif
+
 int main(int argc, char ** argv) {
 	return tpie::tests(argc, argv)
-		.test(open_rw_new_test, "open_rw_new")
-		.test(try_open_rw_test, "try_open_rw")
+		.test(open_rw_new_test<default_raw_file_accessor>, "open_rw_new")
+		.test(try_open_rw_test<default_raw_file_accessor>, "try_open_rw")
+		.test(chunks_test<default_raw_file_accessor>, "chunks")
+		.test(stream_accessor_test<default_raw_file_accessor>, "stream_accessor")
+		.test(shared_reads_test, "shared_reads")
+		.test(open_rw_new_test<uring_accessor>, "open_rw_new_uring")
+		.test(try_open_rw_test<uring_accessor>, "try_open_rw_uring")
+		.test(chunks_test<uring_accessor>, "chunks_uring")
+		.test(stream_accessor_test<uring_accessor>, "stream_accessor_uring")
+		.test(preallocate_test<positional_accessor>, "preallocate")
+		.test(preallocate_test<uring_accessor>, "preallocate_uring")
+		.test(punch_hole_test<positional_accessor>, "punch_hole")
+		.test(punch_hole_test<uring_accessor>, "punch_hole_uring")
+		.test(open_files_test<default_raw_file_accessor>, "open_files")
+		.test(open_files_test<uring_accessor>, "open_files_uring")
+		.test(copy_test, "copy")
 		;
 }
@@ -28,6 +28,12 @@
 #include <tpie/file_stream.h>
 #include <tpie/util.h>
 #include <tpie/stats.h>
+#include <tpie/tempname.h>
+#include <tpie/pipelining.h>
+#include <filesystem>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace tpie;
 
@@ -75,7 +81,192 @@ bool simple_test(size_type size) {
 	return true;
 }
 
+bool directories_test(size_type size, temp_placement placement) {
+	const memory_size_type dirs = 3;
+	std::filesystem::path base = tempname::tpie_dir_name();
+	std::filesystem::create_directory(base);
+	std::vector<std::string> paths;
+	for (memory_size_type i = 0; i < dirs; ++i) {
+		paths.push_back((base / std::to_string(i)).string());
+		std::filesystem::create_directory(paths.back());
+	}
+	tempname::set_default_paths(paths);
+	tempname::set_placement(placement);
+	if (tempname::get_directory_count() != dirs) {
+		tpie::log_error() << "Wrong directory count" << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+	{
+		std::vector<temp_file> files(2*dirs);
+		for (memory_size_type i = 0; i < files.size(); ++i) {
+			file_stream<uint64_t> s;
+			s.open(files[i]);
+			for (size_t j = 0; j < size; ++j) s.write(j);
+		}
+		stream_size_type asize = size*sizeof(uint64_t);
+		for (memory_size_type d = 0; d < dirs; ++d) {
+			memory_size_type count = 0;
+			for (auto & e: std::filesystem::recursive_directory_iterator(paths[d]))
+				if (e.is_regular_file()) ++count;
+			tpie::log_debug() << "Directory " << d << ": " << count << " files, "
+							  << get_temp_file_usage(d) << " bytes" << std::endl;
+			if (placement == placement_round_robin) {
+				if (count != 2) {
+					tpie::log_error() << "Expected two files in directory " << d << std::endl;
+					ok = false;
+				}
+				if (!test_about(get_temp_file_usage(d), 2*asize, "directory usage")) ok = false;
+			}
+		}
+		if (!test_about(get_temp_file_usage(), files.size()*asize, "temp file usage")) ok = false;
+
+		// Requested directories override the placement
+		temp_file tf;
+		tf.set_directory(dirs+1);
+		if (tf.path().compare(0, paths[1].size(), paths[1]) != 0) {
+			tpie::log_error() << tf.path() << " is not in " << paths[1] << std::endl;
+			ok = false;
+		}
+		tf.free();
+		if (tf.path().compare(0, paths[1].size(), paths[1]) != 0) {
+			tpie::log_error() << "free did not keep the directory" << std::endl;
+			ok = false;
+		}
+		std::string path = tf.path();
+		tf.set_directory(2);
+		if (tf.path() != path) {
+			tpie::log_error() << "set_directory changed a generated path" << std::endl;
+			ok = false;
+		}
+
+		// Names may be generated concurrently by the jobs of the sorters
+		const memory_size_type threads = 4;
+		const memory_size_type names = 30;
+		std::vector<std::vector<std::string> > generated(threads);
+		std::vector<std::thread> workers;
+		for (memory_size_type t = 0; t < threads; ++t)
+			workers.emplace_back([&generated, t]() {
+				for (memory_size_type i = 0; i < names; ++i)
+					generated[t].push_back(tempname::tpie_name());
+			});
+		for (std::thread & w: workers) w.join();
+		std::vector<std::set<std::string> > parents(dirs);
+		std::vector<memory_size_type> counts(dirs);
+		for (const std::vector<std::string> & v: generated) {
+			for (const std::string & name: v) {
+				for (memory_size_type d = 0; d < dirs; ++d) {
+					if (name.compare(0, paths[d].size(), paths[d]) != 0) continue;
+					parents[d].insert(std::filesystem::path(name).parent_path().string());
+					++counts[d];
+				}
+			}
+		}
+		for (memory_size_type d = 0; d < dirs; ++d) {
+			if (parents[d].size() > 1) {
+				tpie::log_error() << "Several subdirectories created in directory " << d << std::endl;
+				ok = false;
+			}
+			if (placement == placement_round_robin && counts[d] != threads*names/dirs) {
+				tpie::log_error() << "Expected " << threads*names/dirs << " names in directory "
+								  << d << ", got " << counts[d] << std::endl;
+				ok = false;
+			}
+		}
+	}
+	for (memory_size_type d = 0; d < dirs; ++d)
+		if (!test_about(get_temp_file_usage(d), 0, "directory usage")) ok = false;
+
+	tempname::set_default_path("");
+	std::error_code c;
+	std::filesystem::remove_all(base, c);
+	return ok;
+}
+
+bool round_robin_test(size_type size) {
+	return directories_test(size, placement_round_robin);
+}
+
+bool free_space_test(size_type size) {
+	return directories_test(size, placement_free_space);
+}
+
+bool io_counters_test(size_type size) {
+	stream_size_type asize = size*sizeof(uint64_t);
+	temp_file tf;
+	bool ok = true;
+	{
+		file_stream<uint64_t> s;
+		s.open(tf);
+		for (size_t i = 0; i < size; ++i) s.write(i);
+		s.close();
+		io_counters c = s.get_io_counters();
+		if (!test_about(c.bytesWritten, asize, "stream bytes written")) ok = false;
+		if (!test_about(c.itemBytesWritten, asize, "stream item bytes written")) ok = false;
+		if (c.blocksWritten == 0 || c.bytesRead != 0) {
+			tpie::log_error() << "Wrong stream block counts" << std::endl;
+			ok = false;
+		}
+	}
+	{
+		std::shared_ptr<io_stats> sink = std::make_shared<io_stats>();
+		file_stream<uint64_t> s;
+		s.set_io_stats_sink(sink);
+		s.open(tf);
+		for (size_t i = 0; i < size; ++i) s.read();
+		s.close();
+		io_counters c = sink->get();
+		if (!test_about(c.bytesRead, asize, "sink bytes read")) ok = false;
+		if (!test_about(c.bytesWritten, 0, "sink bytes written")) ok = false;
+		if (c.blocksRead != s.get_io_counters().blocksRead) {
+			tpie::log_error() << "The sink and the stream disagree" << std::endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool node_io_test(size_type size) {
+	using namespace tpie::pipelining;
+	stream_size_type asize = size*sizeof(uint64_t);
+	temp_file tf;
+	file_stream<uint64_t> in;
+	file_stream<uint64_t> out;
+	in.open(tf);
+	for (size_t i = 0; i < size; ++i) in.write(i);
+	// Wait for the blocks to be written before the node counts them
+	in.close();
+	in.open(tf);
+	out.open();
+
+	pipeline p = input(in) | output(out);
+	p();
+	out.close();
+
+	io_counters c;
+	tpie::pipelining::bits::node_map::ptr nodeMap = p.get_node_map()->find_authority();
+	for (auto i = nodeMap->begin(); i != nodeMap->end(); ++i)
+		c += nodeMap->get(i->first)->get_io_stats()->get();
+	bool ok = true;
+	if (!test_about(c.bytesRead, asize, "node bytes read")) ok = false;
+	if (!test_about(c.bytesWritten, asize, "node bytes written")) ok = false;
+
+	std::stringstream ss;
+	p.output_io(ss);
+	tpie::log_debug() << ss.str();
+	if (ss.str().find("Written MB") == std::string::npos) {
+		tpie::log_error() << "No I/O table" << std::endl;
+		ok = false;
+	}
+	return ok;
+}
+
 int main(int argc, char ** argv) {
 	return tpie::tests(argc, argv)
-		.test(simple_test, "simple", "size", 1024*1024*10);
+		.test(simple_test, "simple", "size", 1024*1024*10)
+		.test(round_robin_test, "directories", "size", 1024*256)
+		.test(free_space_test, "directories_free_space", "size", 1024*256)
+		.test(io_counters_test, "io_counters", "size", 1024*1024)
+		.test(node_io_test, "node_io", "size", 1024*1024);
 }
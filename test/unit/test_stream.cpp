@@ -27,6 +27,7 @@
 #include <vector>
 #include <array>
 #include <random>
+#include <filesystem>
 #include <tpie/tpie_log.h>
 #include <tpie/progress_indicator_arrow.h>
 
@@ -116,6 +117,20 @@ struct file_stream {
 	void open(tpie::temp_file & tf, tpie::access_type a, tpie::memory_size_type uds) { file().open(tf, a, uds); }
 };
 
+template <typename T>
+struct read_ahead_stream: public file_stream<T> {
+	read_ahead_stream() {
+		this->m_fs.set_read_ahead(3);
+	}
+};
+
+template <typename T>
+struct write_behind_stream: public file_stream<T> {
+	write_behind_stream() {
+		this->m_fs.set_write_behind(3);
+	}
+};
+
 template <typename T>
 struct compressed_stream {
 	tpie::file_stream<T> m_fs;
@@ -769,6 +784,349 @@ bool peek_skip_test_2() {
 	return true;
 }
 
+bool read_ahead_test() {
+	const tpie::memory_size_type blockSize = 64*1024;
+	const double blockFactor = tpie::uncompressed_stream<uint64_t>::calculate_block_factor(blockSize);
+	const tpie::memory_size_type blockItems = blockSize/sizeof(uint64_t);
+	const tpie::memory_size_type blocks = 4;
+	const size_t items = 40*blockItems + 17;
+
+	tpie::uncompressed_stream<uint64_t> s(blockFactor);
+	s.set_read_ahead(blocks);
+	s.open();
+	for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+
+	tpie::memory_size_type used = tpie::get_memory_manager().used();
+	s.seek(0);
+	for (size_t i = 0; i < 10*blockItems; ++i)
+		TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong");
+	TEST_ENSURE(tpie::get_memory_manager().used() >= used + blocks*blockSize,
+				"Read-ahead buffers not counted by the memory manager");
+
+	// Overwrite the middle of a block that has been read ahead
+	s.seek(12*blockItems + 5);
+	s.write(42);
+	s.seek(10*blockItems);
+	for (size_t i = 10*blockItems; i < items; ++i) {
+		uint64_t expected = (i == 12*blockItems + 5) ? 42 : ITEM(i);
+		TEST_ENSURE_EQUALITY(expected, s.read(), "read() wrong after write");
+	}
+	TEST_ENSURE(!s.can_read(), "can_read() at end of stream");
+
+	// Read backwards, then forwards again from the middle
+	s.seek(0, tpie::file_stream_base::end);
+	for (size_t i = items; i-- > 30*blockItems;) {
+		uint64_t expected = (i == 12*blockItems + 5) ? 42 : ITEM(i);
+		TEST_ENSURE_EQUALITY(expected, s.read_back(), "read_back() wrong");
+	}
+	s.seek(5*blockItems + 3);
+	for (size_t i = 5*blockItems + 3; i < items; ++i) {
+		uint64_t expected = (i == 12*blockItems + 5) ? 42 : ITEM(i);
+		TEST_ENSURE_EQUALITY(expected, s.read(), "read() wrong after seek");
+	}
+
+	// Truncating must not hand out blocks read before the truncate
+	s.truncate(20*blockItems);
+	s.seek(0);
+	tpie::stream_size_type n = 0;
+	while (s.can_read()) {
+		s.read();
+		++n;
+	}
+	TEST_ENSURE_EQUALITY(20*blockItems, n, "Wrong number of items after truncate");
+	return true;
+}
+
+bool mmap_test() {
+	const tpie::memory_size_type blockSize = 64*1024;
+	const double blockFactor = tpie::uncompressed_stream<uint64_t>::calculate_block_factor(blockSize);
+	const tpie::memory_size_type blockItems = blockSize/sizeof(uint64_t);
+	const size_t items = 10*blockItems + 17;
+
+	tpie::temp_file tf;
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.set_mmap(true);
+		s.open(tf, tpie::access_read_write);
+		TEST_ENSURE(!s.is_mapped(), "Writable stream mapped");
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+	}
+
+	tpie::uncompressed_stream<uint64_t> s(blockFactor);
+	s.set_mmap(true);
+	tpie::memory_size_type used = tpie::get_memory_manager().used();
+	s.open(tf, tpie::access_read);
+	TEST_ENSURE(s.is_mapped(), "Read-only stream not mapped");
+	TEST_ENSURE(tpie::get_memory_manager().used() < used + blockSize,
+				"Mapped stream allocated a block buffer");
+	TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size");
+
+	for (size_t i = 0; i < items; ++i)
+		TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong");
+	TEST_ENSURE(!s.can_read(), "can_read() at end of stream");
+
+	// Items are read in place, so consecutive items are adjacent in memory.
+	s.seek(3*blockItems + 5);
+	const uint64_t * a = &s.read();
+	const uint64_t * b = &s.read();
+	TEST_ENSURE(a + 1 == b, "Items not read in place");
+
+	s.seek(0, tpie::file_stream_base::end);
+	for (size_t i = items; i-- > 0;)
+		TEST_ENSURE_EQUALITY(ITEM(i), s.read_back(), "read_back() wrong");
+
+	std::mt19937 rng(42);
+	for (size_t j = 0; j < 1000; ++j) {
+		size_t i = rng() % items;
+		s.seek(i);
+		TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong after seek");
+	}
+
+	s.close();
+
+	// Reopening for writing reads blocks as usual.
+	s.open(tf, tpie::access_read_write);
+	TEST_ENSURE(!s.is_mapped(), "Writable stream mapped after reopen");
+	s.seek(7);
+	s.write(42);
+	s.seek(0);
+	for (size_t i = 0; i < items; ++i)
+		TEST_ENSURE_EQUALITY(i == 7 ? 42 : ITEM(i), s.read(), "read() wrong after reopen");
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Run the given test with direct I/O for temporary streams.
+///////////////////////////////////////////////////////////////////////////////
+template <bool (*test)()>
+bool with_direct_io() {
+	tpie::set_direct_io(true);
+	bool result = test();
+	tpie::set_direct_io(false);
+	return result;
+}
+
+bool direct_io_test() {
+	const tpie::memory_size_type blockSize = 64*1024;
+	const double blockFactor = tpie::uncompressed_stream<uint64_t>::calculate_block_factor(blockSize);
+	const tpie::memory_size_type blockItems = blockSize/sizeof(uint64_t);
+	// The final block is partial and its size is not a multiple of the
+	// alignment, so it goes through the page cache.
+	const size_t items = 10*blockItems + 17;
+
+	tpie::temp_file tf;
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.open(tf, tpie::access_write, sizeof(uint64_t));
+		uint64_t userData = 1234;
+		s.write_user_data(userData);
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+	}
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.open(tf, tpie::access_read_write, sizeof(uint64_t));
+		TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size after reopen");
+		uint64_t userData = 0;
+		s.read_user_data(userData);
+		TEST_ENSURE_EQUALITY(1234u, userData, "Wrong user data");
+		for (size_t i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong");
+
+		// Overwrite an item in a full block and extend the partial block.
+		s.seek(3*blockItems + 1);
+		s.write(42);
+		s.seek(0, tpie::file_stream_base::end);
+		s.write(43);
+		s.seek(0);
+		for (size_t i = 0; i <= items; ++i) {
+			uint64_t expected = (i == 3*blockItems + 1) ? 42 : (i == items) ? 43 : ITEM(i);
+			TEST_ENSURE_EQUALITY(expected, s.read(), "read() wrong after write");
+		}
+	}
+
+	// Compressed streams with compression disabled write their blocks
+	// directly from the stream buffers.
+	tpie::temp_file tf2;
+	{
+		tpie::file_stream<uint64_t> s(blockFactor);
+		s.open(tf2, tpie::access_write, 0, tpie::access_sequential, tpie::compression_none);
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+	}
+	{
+		tpie::file_stream<uint64_t> s(blockFactor);
+		s.open(tf2, tpie::access_read, 0, tpie::access_sequential, tpie::compression_none);
+		TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size of compressed stream");
+		for (size_t i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong in compressed stream");
+	}
+
+	// Compressed blocks are packed at unaligned offsets, so the O_DIRECT
+	// descriptor is never opened for them.
+	tpie::temp_file tf3;
+	{
+		tpie::file_stream<uint64_t> s(blockFactor);
+		s.open(tf3, tpie::access_write, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+	}
+	{
+		const tpie::memory_size_type files = tpie::get_file_manager().used();
+		tpie::file_stream<uint64_t> s(blockFactor);
+		s.open(tf3, tpie::access_read, 0, tpie::access_sequential, tpie::compression_normal);
+		for (size_t i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong in compressed stream");
+		TEST_ENSURE_EQUALITY(files + 1, tpie::get_file_manager().used(), "Compressed stream opened a second descriptor");
+	}
+	return true;
+}
+
+// File accessor failing to write the given block once.
+class failing_file_accessor: public tpie::default_file_accessor {
+public:
+	failing_file_accessor(tpie::stream_size_type block): m_block(block) {}
+
+	void write_block_data(const void * data,
+						  tpie::stream_size_type blockNumber,
+						  tpie::memory_size_type itemCount) override {
+		if (blockNumber == m_block) {
+			m_block = std::numeric_limits<tpie::stream_size_type>::max();
+			throw tpie::io_exception("Injected write error");
+		}
+		tpie::default_file_accessor::write_block_data(data, blockNumber, itemCount);
+	}
+
+private:
+	tpie::stream_size_type m_block;
+};
+
+bool write_behind_test() {
+	const tpie::memory_size_type blockSize = 64*1024;
+	const double blockFactor = tpie::uncompressed_stream<uint64_t>::calculate_block_factor(blockSize);
+	const tpie::memory_size_type blockItems = blockSize/sizeof(uint64_t);
+	const tpie::memory_size_type blocks = 4;
+	const size_t items = 40*blockItems + 17;
+
+	tpie::temp_file tf;
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.set_write_behind(blocks);
+		s.open(tf);
+		tpie::memory_size_type used = tpie::get_memory_manager().used();
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+		TEST_ENSURE(tpie::get_memory_manager().used() >= used + blocks*blockSize,
+					"Write-behind buffers not counted by the memory manager");
+		TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size");
+
+		// Read blocks that may still be waiting to be written
+		s.seek(2*blockItems + 1);
+		for (size_t i = 2*blockItems + 1; i < 3*blockItems; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong while writing");
+
+		// Overwrite a range of blocks sequentially, then append
+		s.seek(10*blockItems + 5);
+		for (size_t i = 10*blockItems + 5; i < 20*blockItems; ++i) s.write(ITEM(i) + 1);
+		s.seek(0, tpie::file_stream_base::end);
+		for (size_t i = items; i < items + 3*blockItems; ++i) s.write(ITEM(i));
+	}
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.open(tf, tpie::access_read);
+		TEST_ENSURE_EQUALITY(items + 3*blockItems, s.size(), "Wrong size after reopen");
+		for (size_t i = 0; i < items + 3*blockItems; ++i) {
+			bool overwritten = 10*blockItems + 5 <= i && i < 20*blockItems;
+			uint64_t expected = overwritten ? ITEM(i) + 1 : ITEM(i);
+			TEST_ENSURE_EQUALITY(expected, s.read(), "read() wrong after reopen");
+		}
+	}
+
+	const tpie::memory_size_type defaultUsage = tpie::uncompressed_stream<uint64_t>::memory_usage(
+		blockFactor, true, tpie::get_read_ahead_blocks(), tpie::get_write_behind_blocks());
+	TEST_ENSURE_EQUALITY(defaultUsage, tpie::uncompressed_stream<uint64_t>::memory_usage(blockFactor),
+						 "memory_usage does not default to the global buffer counts");
+	TEST_ENSURE(tpie::uncompressed_stream<uint64_t>::memory_usage(blockFactor, true, 0, blocks)
+				>= tpie::uncompressed_stream<uint64_t>::memory_usage(blockFactor, true, 0, 0) + blocks*blockSize,
+				"Write-behind buffers not included in memory_usage");
+
+	// A failed write shrinks the stream to the start of the lost block, and
+	// the stream can be written again from there.
+	const tpie::stream_size_type failBlock = 7;
+	failing_file_accessor accessor(failBlock);
+	tpie::temp_file tf2;
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor, &accessor);
+		s.set_write_behind(blocks);
+		s.open(tf2);
+		bool thrown = false;
+		try {
+			for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+			// Wait for the blocks written in the background.
+			s.set_write_behind(blocks);
+		} catch (const tpie::io_exception &) {
+			thrown = true;
+		}
+		TEST_ENSURE(thrown, "Write error not thrown");
+		TEST_ENSURE_EQUALITY(failBlock*blockItems, s.size(), "Size not rolled back");
+		TEST_ENSURE(s.offset() <= s.size(), "Offset beyond the end of the stream");
+		s.seek(0, tpie::file_stream_base::end);
+		for (size_t i = failBlock*blockItems; i < items; ++i) s.write(ITEM(i));
+	}
+	{
+		tpie::uncompressed_stream<uint64_t> s(blockFactor);
+		s.open(tf2, tpie::access_read);
+		TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size after write error");
+		for (size_t i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong after write error");
+	}
+
+	// An error from the last blocks is thrown by close(), which still
+	// closes the stream, and only logged when the stream is destroyed.
+	const tpie::stream_size_type lastBlock = items/blockItems;
+	for (int explicitClose = 0; explicitClose < 2; ++explicitClose) {
+		failing_file_accessor lastAccessor(lastBlock);
+		tpie::temp_file tf3;
+		tpie::uncompressed_stream<uint64_t> s(blockFactor, &lastAccessor);
+		s.set_write_behind(blocks);
+		s.open(tf3);
+		for (size_t i = 0; i < items; ++i) s.write(ITEM(i));
+		if (!explicitClose) continue;
+		bool thrown = false;
+		try {
+			s.close();
+		} catch (const tpie::io_exception &) {
+			thrown = true;
+		}
+		TEST_ENSURE(thrown, "Write error not thrown by close()");
+		TEST_ENSURE(!s.is_open(), "Stream still open after failed close()");
+	}
+	return true;
+}
+
+// Reserving space for more items than are written does not change the
+// stream, and the space is released on close.
+template <typename stream_t>
+bool reserve_test() {
+	const tpie::stream_size_type items = 10000;
+	tpie::temp_file tf;
+	{
+		stream_t s;
+		s.open(tf);
+		s.reserve(1024*1024);
+		TEST_ENSURE_EQUALITY(0u, s.size(), "reserve changed the size");
+		for (tpie::stream_size_type i = 0; i < items; ++i) s.write(ITEM(i));
+		// Reserving less than has been reserved releases the rest
+		s.reserve(items);
+	}
+	{
+		stream_t s;
+		s.open(tf, tpie::access_read);
+		TEST_ENSURE_EQUALITY(items, s.size(), "Wrong size after reopen");
+		for (tpie::stream_size_type i = 0; i < items; ++i)
+			TEST_ENSURE_EQUALITY(ITEM(i), s.read(), "read() wrong");
+	}
+	TEST_ENSURE(std::filesystem::file_size(tf.path()) < 1024*1024*sizeof(uint64_t)/2,
+				"File grew to the reserved size");
+	return true;
+}
+
 bool reopen() {
 	tpie::temp_file tf;
 
@@ -818,5 +1176,31 @@ int main(int argc, char **argv) {
 		.test(stream_tester<file_colon_colon_stream>::user_data_test, "user_data_file")
 		.test(peek_skip_test_1, "peek_skip_1")
 		.test(peek_skip_test_2, "peek_skip_2")
+		.test(read_ahead_test, "read_ahead")
+		.test(stream_tester<read_ahead_stream>::array_test, "array_read_ahead")
+		.test(stream_tester<read_ahead_stream>::odd_block_test, "odd_read_ahead")
+		.test(stream_tester<read_ahead_stream>::truncate_test, "truncate_read_ahead")
+		.test(stream_tester<read_ahead_stream>::extend_test, "extend_read_ahead")
+		.test(stream_tester<read_ahead_stream>::backwards_test, "backwards_read_ahead")
+		.test(stream_tester<read_ahead_stream>::user_data_test, "user_data_read_ahead")
+		.test(mmap_test, "mmap")
+		.test(with_direct_io<direct_io_test>, "direct_io")
+		.test(with_direct_io<stream_tester<file_stream>::array_test>, "array_direct_io")
+		.test(with_direct_io<stream_tester<file_colon_colon_stream>::array_test>, "array_file_direct_io")
+		.test(with_direct_io<stream_tester<compressed_stream>::array_test>, "array_compressed_direct_io")
+		.test(with_direct_io<stream_tester<file_stream>::odd_block_test>, "odd_direct_io")
+		.test(with_direct_io<stream_tester<file_stream>::truncate_test>, "truncate_direct_io")
+		.test(with_direct_io<stream_tester<file_stream>::backwards_test>, "backwards_direct_io")
+		.test(stream_tester<read_ahead_stream>::stress_test, "stress_read_ahead", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
+		.test(write_behind_test, "write_behind")
+		.test(stream_tester<write_behind_stream>::array_test, "array_write_behind")
+		.test(stream_tester<write_behind_stream>::odd_block_test, "odd_write_behind")
+		.test(stream_tester<write_behind_stream>::truncate_test, "truncate_write_behind")
+		.test(stream_tester<write_behind_stream>::extend_test, "extend_write_behind")
+		.test(stream_tester<write_behind_stream>::backwards_test, "backwards_write_behind")
+		.test(stream_tester<write_behind_stream>::user_data_test, "user_data_write_behind")
+		.test(stream_tester<write_behind_stream>::stress_test, "stress_write_behind", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
+		.test(reserve_test<tpie::uncompressed_stream<uint64_t> >, "reserve")
+		.test(reserve_test<tpie::file_stream<uint64_t> >, "reserve_compressed")
 		;
 }
@@ -107,6 +107,12 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	inline size_t size() const {return m_end - m_start;}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Get a pointer to the first element.
+	/// \return Pointer to the contiguous elements of the array.
+	///////////////////////////////////////////////////////////////////////////
+	inline T * data() const {return m_start;}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Return a reference to an array entry.
 	///
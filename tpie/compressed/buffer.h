@@ -25,6 +25,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <tpie/array.h>
+#include <tpie/memory.h>
+#include <tpie/file_accessor/stream_accessor_base.h>
 #include <tpie/tpie_assert.h>
 #include <tpie/compressed/thread.h>
 #include <map>
@@ -84,9 +86,10 @@ struct compressor_buffer_state {
 ///////////////////////////////////////////////////////////////////////////////
 class compressor_buffer {
 private:
-	typedef array<char> storage_t;
-
-	storage_t m_storage;
+	/** Aligned to file_accessor::block_alignment, so that uncompressed
+	 * blocks can be read and written with direct I/O. */
+	char * m_storage;
+	memory_size_type m_capacity;
 	memory_size_type m_size;
 	compressor_buffer_state::type m_state;
 	stream_size_type m_readOffset;
@@ -94,17 +97,25 @@ private:
 
 public:
 	compressor_buffer(memory_size_type capacity)
-		: m_storage(capacity)
+		: m_storage(tpie_new_aligned_array<char>(capacity, file_accessor::block_alignment))
+		, m_capacity(capacity)
 		, m_size(0)
 		, m_state(compressor_buffer_state::dirty)
 		, m_readOffset(1111111111111111111ull)
 		, m_blockSize(std::numeric_limits<memory_size_type>::max())
 	{
 		#ifndef NDEBUG
-		std::fill(m_storage.begin(), m_storage.end(), 0);
+		std::fill(m_storage, m_storage + m_capacity, 0);
 		#endif
 	}
 
+	~compressor_buffer() {
+		tpie_delete_aligned_array(m_storage, m_capacity, file_accessor::block_alignment);
+	}
+
+	compressor_buffer(const compressor_buffer &) = delete;
+	compressor_buffer & operator=(const compressor_buffer &) = delete;
+
 	compressor_buffer_state::type get_state() const {
 		return m_state;
 	}
@@ -136,14 +147,14 @@ public:
 	/// \brief  Get pointer to buffer storage.
 	///////////////////////////////////////////////////////////////////////////////
 	char * get() {
-		return m_storage.get();
+		return m_storage;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////
 	/// \brief  Get pointer to buffer storage.
 	///////////////////////////////////////////////////////////////////////////////
 	const char * get() const {
-		return m_storage.get();
+		return m_storage;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////
@@ -157,7 +168,7 @@ public:
 	/// \brief  Get maximal byte size of buffer.
 	///////////////////////////////////////////////////////////////////////////////
 	memory_size_type capacity() const {
-		return m_storage.size();
+		return m_capacity;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////
@@ -171,7 +182,10 @@ public:
 	/// \brief  Resize internal buffer, clearing all elements.
 	///////////////////////////////////////////////////////////////////////////////
 	void set_capacity(memory_size_type capacity) {
-		m_storage.resize(capacity);
+		char * storage = tpie_new_aligned_array<char>(capacity, file_accessor::block_alignment);
+		tpie_delete_aligned_array(m_storage, m_capacity, file_accessor::block_alignment);
+		m_storage = storage;
+		m_capacity = capacity;
 		m_size = 0;
 	}
 
@@ -0,0 +1,108 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/compressed/checksum.h>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TPIE_CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+// Reflected CRC32C polynomial.
+const tpie::uint32_t polynomial = 0x82f63b78;
+
+// table[k][b] is the checksum of byte b followed by k zero bytes, so that
+// eight bytes can be processed at a time (slicing-by-8).
+struct crc32c_table {
+	crc32c_table() {
+		for (tpie::uint32_t b = 0; b < 256; ++b) {
+			tpie::uint32_t crc = b;
+			for (int i = 0; i < 8; ++i)
+				crc = (crc >> 1) ^ (polynomial & (0 - (crc & 1)));
+			table[0][b] = crc;
+		}
+		for (tpie::uint32_t b = 0; b < 256; ++b)
+			for (int k = 1; k < 8; ++k)
+				table[k][b] = (table[k-1][b] >> 8) ^ table[0][table[k-1][b] & 0xff];
+	}
+
+	tpie::uint32_t table[8][256];
+};
+
+const crc32c_table the_table;
+
+tpie::uint32_t crc32c_software(const unsigned char * p, tpie::memory_size_type size, tpie::uint32_t crc) {
+	const tpie::uint32_t (&t)[8][256] = the_table.table;
+	for (; size >= 8; p += 8, size -= 8) {
+		tpie::uint32_t lo;
+		tpie::uint32_t hi;
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + 4, 4);
+		lo ^= crc;
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+			^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+			^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff]
+			^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	for (; size > 0; ++p, --size)
+		crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+	return crc;
+}
+
+#ifdef TPIE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+tpie::uint32_t crc32c_sse42(const unsigned char * p, tpie::memory_size_type size, tpie::uint32_t crc) {
+	unsigned long long c = crc;
+	for (; size >= 8; p += 8, size -= 8) {
+		unsigned long long v;
+		memcpy(&v, p, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+	tpie::uint32_t c32 = static_cast<tpie::uint32_t>(c);
+	for (; size > 0; ++p, --size)
+		c32 = _mm_crc32_u8(c32, *p);
+	return c32;
+}
+
+bool detect_sse42() {
+	// Needed since this runs in a static initializer.
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.2");
+}
+
+const bool has_sse42 = detect_sse42();
+#endif // TPIE_CRC32C_SSE42
+
+} // unnamed namespace
+
+namespace tpie {
+
+uint32_t crc32c(const void * data, memory_size_type size, uint32_t crc) {
+	const unsigned char * p = static_cast<const unsigned char *>(data);
+	crc = ~crc;
+#ifdef TPIE_CRC32C_SSE42
+	if (has_sse42) return ~crc32c_sse42(p, size, crc);
+#endif // TPIE_CRC32C_SSE42
+	return ~crc32c_software(p, size, crc);
+}
+
+} // namespace tpie
@@ -0,0 +1,45 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef TPIE_COMPRESSED_CHECKSUM_H
+#define TPIE_COMPRESSED_CHECKSUM_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file compressed/checksum.h  CRC32C checksums of stream blocks.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/tpie_export.h>
+#include <tpie/types.h>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Compute the CRC32C (Castagnoli) checksum of the given bytes.
+///
+/// Uses the SSE 4.2 crc32 instruction when the processor has it, and a
+/// table-driven implementation otherwise.
+///
+/// \param crc  The checksum of the preceding bytes, to checksum a range
+/// in several pieces, or 0.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT uint32_t crc32c(const void * data, memory_size_type size, uint32_t crc = 0);
+
+} // namespace tpie
+
+#endif // TPIE_COMPRESSED_CHECKSUM_H
@@ -24,6 +24,7 @@
 /// \file compressed/request.h  Compressor thread requests and responses.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <exception>
 #include <memory>
 #include <thread>
 #include <condition_variable>
@@ -48,6 +49,18 @@ namespace tpie {
 /// request, and whether the stream object (main thread) or the compressor
 /// thread should call it.
 ///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  How well the recent blocks of a compression_normal stream
+/// compressed. The compressor uses it to decide whether to compress the
+/// next block of the stream.
+///////////////////////////////////////////////////////////////////////////////
+struct compression_history {
+	/** Running average of the compressed size over the uncompressed size. */
+	double ratio = 0.5;
+	/** Blocks written uncompressed since a block was last compressed. */
+	memory_size_type skipped = 0;
+};
+
 class compressor_response {
 public:
 	compressor_response()
@@ -69,6 +82,7 @@ public:
 	void initiate_request() {
 		m_done = m_endOfStream = false;
 		m_nextReadOffset = m_nextBlockSize = 0;
+		m_error = nullptr;
 	}
 
 	// write, stream
@@ -153,6 +167,30 @@ public:
 		m_changed.notify_all();
 	}
 
+	// read, thread
+	// The block could not be read, e.g. since its checksum did not match.
+	void set_error(std::exception_ptr error) {
+		m_done = true;
+		m_error = error;
+		m_changed.notify_all();
+	}
+
+	// read, stream
+	// Throws the error from the compressor thread, if any.
+	void rethrow_error() {
+		if (m_error) std::rethrow_exception(m_error);
+	}
+
+	// write, thread -- must have lock!
+	compression_history & get_compression_history() {
+		return m_compressionHistory;
+	}
+
+	// write, stream
+	void reset_compression_history() {
+		m_compressionHistory = compression_history();
+	}
+
 private:
 	std::condition_variable m_changed;
 
@@ -168,6 +206,9 @@ private:
 	bool m_endOfStream;
 	stream_size_type m_nextReadOffset;
 	memory_size_type m_nextBlockSize;
+	std::exception_ptr m_error;
+
+	compression_history m_compressionHistory;
 };
 
 #ifdef __GNUC__
@@ -237,6 +278,10 @@ public:
 		m_response->set_next_block_offset(offset);
 	}
 
+	void set_error(std::exception_ptr error) {
+		m_response->set_error(error);
+	}
+
 private:
 	buffer_t m_buffer;
 	file_accessor_t * m_fileAccessor;
@@ -297,6 +342,11 @@ public:
 		m_response->set_block_info(m_blockNumber, readOffset, blockSize);
 	}
 
+	// must have lock!
+	compression_history & get_compression_history() {
+		return m_response->get_compression_history();
+	}
+
 	// must have lock!
 	void update_recorded_size() {
 		m_response->set_done();
@@ -24,6 +24,10 @@
 /// \file compressed/scheme.h  Compression scheme virtual interface.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <tpie/config.h>
+#include <tpie/tpie_export.h>
+#include <cstddef>
+
 namespace tpie {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -36,7 +40,10 @@ enum compression_flags {
 	 * it will support seek(n) and truncate(n) for arbitrary n. */
 	compression_none = 0,
 	/** Compress some blocks
-	 * according to available resources (time, memory). */
+	 * according to available resources (time, memory).
+	 * A block is written uncompressed when the compressor threads are
+	 * behind, when it does not shrink, or when recent blocks did not
+	 * shrink. */
 	compression_normal = 1,
 	/** Compress all blocks according to the preferred compression scheme
 	 * which can be set using
@@ -51,7 +58,9 @@ class compression_scheme {
 public:
 	enum type {
 		none = 0,
-		snappy = 1
+		snappy = 1,
+		lz4 = 2,
+		zstd = 3
 	};
 
 	///////////////////////////////////////////////////////////////////////////
@@ -85,6 +94,8 @@ protected:
 
 const compression_scheme & get_compression_scheme_none();
 const compression_scheme & get_compression_scheme_snappy();
+const compression_scheme & get_compression_scheme_lz4();
+const compression_scheme & get_compression_scheme_zstd();
 
 inline const compression_scheme & get_compression_scheme(compression_scheme::type t) {
 	switch (t) {
@@ -92,10 +103,55 @@ inline const compression_scheme & get_compression_scheme(compression_scheme::typ
 			return get_compression_scheme_none();
 		case compression_scheme::snappy:
 			return get_compression_scheme_snappy();
+		case compression_scheme::lz4:
+			return get_compression_scheme_lz4();
+		case compression_scheme::zstd:
+			return get_compression_scheme_zstd();
 	}
 	return get_compression_scheme_none();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Return true if TPIE was built with support for the given scheme.
+///////////////////////////////////////////////////////////////////////////////
+inline bool compression_scheme_available(compression_scheme::type t) {
+	switch (t) {
+		case compression_scheme::none:
+			return true;
+		case compression_scheme::snappy:
+#ifdef TPIE_HAS_SNAPPY
+			return true;
+#else
+			return false;
+#endif
+		case compression_scheme::lz4:
+#ifdef TPIE_HAS_LZ4
+			return true;
+#else
+			return false;
+#endif
+		case compression_scheme::zstd:
+#ifdef TPIE_HAS_ZSTD
+			return true;
+#else
+			return false;
+#endif
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Set the level used by the zstd compression scheme for blocks
+/// written from now on. Higher levels compress better but slower.
+/// The default level is 1.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_zstd_compression_level(int level);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get the level used by the zstd compression scheme.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT int get_zstd_compression_level();
+
 }
 
 #endif // TPIE_COMPRESSED_SCHEME_H
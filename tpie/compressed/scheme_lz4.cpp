@@ -0,0 +1,128 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/config.h>
+#ifdef TPIE_HAS_LZ4
+#include <lz4.h>
+#endif // TPIE_HAS_LZ4
+#include <tpie/exception.h>
+#include <tpie/tpie_log.h>
+#include <tpie/compressed/scheme.h>
+#include <tpie/stats.h>
+#include <cstdint>
+#include <cstring>
+
+#ifdef TPIE_HAS_LZ4
+
+namespace {
+
+// A raw LZ4 block does not contain its uncompressed length,
+// so we store it in front of the compressed data.
+const size_t header_size = sizeof(std::uint32_t);
+
+class compression_scheme_impl : public tpie::compression_scheme {
+public:
+
+virtual size_t max_compressed_length(size_t srcSize) const override {
+	return header_size + LZ4_compressBound(static_cast<int>(srcSize));
+}
+
+virtual void compress(char * dest, const char * src, size_t srcSize, size_t * destSize) const override {
+	tpie::stat_timer t(5); // Time compressing
+	std::uint32_t length = static_cast<std::uint32_t>(srcSize);
+	memcpy(dest, &length, header_size);
+	int res = LZ4_compress_fast(src, dest + header_size,
+								static_cast<int>(srcSize),
+								LZ4_compressBound(static_cast<int>(srcSize)),
+								1);
+	if (res <= 0)
+		throw tpie::stream_exception("Internal error; LZ4_compress_fast failed");
+	*destSize = header_size + static_cast<size_t>(res);
+}
+
+virtual size_t uncompressed_length(const char * src, size_t srcSize) const override {
+	if (srcSize < header_size)
+		throw tpie::stream_exception("Internal error; LZ4 block is too short");
+	std::uint32_t length;
+	memcpy(&length, src, header_size);
+	return length;
+}
+
+virtual void uncompress(char * dest, const char * src, size_t srcSize) const override {
+	tpie::stat_timer t(6); // Time uncompressing
+	int length = static_cast<int>(uncompressed_length(src, srcSize));
+	int res = LZ4_decompress_safe(src + header_size, dest,
+								  static_cast<int>(srcSize - header_size),
+								  length);
+	if (res != length)
+		throw tpie::stream_exception("Internal error; LZ4_decompress_safe failed");
+}
+
+};
+
+compression_scheme_impl the_compression_scheme;
+
+} // unnamed namespace
+
+namespace tpie {
+
+const compression_scheme & get_compression_scheme_lz4() {
+	return the_compression_scheme;
+}
+
+} // namespace tpie
+
+#else // TPIE_HAS_LZ4
+
+namespace {
+
+class compression_scheme_impl : public tpie::compression_scheme {
+public:
+
+virtual size_t max_compressed_length(size_t) const override {
+	throw tpie::stream_exception("No LZ4 support");
+}
+
+virtual void compress(char *, const char *, size_t, size_t *) const override {
+	throw tpie::stream_exception("No LZ4 support");
+}
+
+virtual size_t uncompressed_length(const char *, size_t) const override {
+	throw tpie::stream_exception("No LZ4 support; cannot read LZ4 compressed block");
+}
+
+virtual void uncompress(char *, const char *, size_t) const override {
+	throw tpie::stream_exception("No LZ4 support; cannot read LZ4 compressed block");
+}
+
+};
+
+compression_scheme_impl the_compression_scheme;
+
+} // unnamed namespace
+
+namespace tpie {
+
+const compression_scheme & get_compression_scheme_lz4() {
+	return the_compression_scheme;
+}
+
+} // namespace tpie
+
+#endif // TPIE_HAS_LZ4
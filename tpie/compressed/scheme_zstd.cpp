@@ -0,0 +1,135 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/config.h>
+#ifdef TPIE_HAS_ZSTD
+#include <zstd.h>
+#endif // TPIE_HAS_ZSTD
+#include <tpie/exception.h>
+#include <tpie/tpie_log.h>
+#include <tpie/compressed/scheme.h>
+#include <tpie/stats.h>
+#include <atomic>
+
+namespace {
+
+std::atomic<int> compression_level(1);
+
+} // unnamed namespace
+
+namespace tpie {
+
+void set_zstd_compression_level(int level) {
+	compression_level = level;
+}
+
+int get_zstd_compression_level() {
+	return compression_level;
+}
+
+} // namespace tpie
+
+#ifdef TPIE_HAS_ZSTD
+
+namespace {
+
+class compression_scheme_impl : public tpie::compression_scheme {
+public:
+
+virtual size_t max_compressed_length(size_t srcSize) const override {
+	return ZSTD_compressBound(srcSize);
+}
+
+virtual void compress(char * dest, const char * src, size_t srcSize, size_t * destSize) const override {
+	tpie::stat_timer t(5); // Time compressing
+	size_t res = ZSTD_compress(dest, ZSTD_compressBound(srcSize), src, srcSize,
+							   compression_level.load());
+	if (ZSTD_isError(res))
+		throw tpie::stream_exception(std::string("Internal error; ZSTD_compress failed: ")
+									 + ZSTD_getErrorName(res));
+	*destSize = res;
+}
+
+virtual size_t uncompressed_length(const char * src, size_t srcSize) const override {
+	unsigned long long length = ZSTD_getFrameContentSize(src, srcSize);
+	if (length == ZSTD_CONTENTSIZE_UNKNOWN || length == ZSTD_CONTENTSIZE_ERROR)
+		throw tpie::stream_exception("Internal error; ZSTD_getFrameContentSize failed");
+	return static_cast<size_t>(length);
+}
+
+virtual void uncompress(char * dest, const char * src, size_t srcSize) const override {
+	tpie::stat_timer t(6); // Time uncompressing
+	size_t length = uncompressed_length(src, srcSize);
+	size_t res = ZSTD_decompress(dest, length, src, srcSize);
+	if (ZSTD_isError(res) || res != length)
+		throw tpie::stream_exception("Internal error; ZSTD_decompress failed");
+}
+
+};
+
+compression_scheme_impl the_compression_scheme;
+
+} // unnamed namespace
+
+namespace tpie {
+
+const compression_scheme & get_compression_scheme_zstd() {
+	return the_compression_scheme;
+}
+
+} // namespace tpie
+
+#else // TPIE_HAS_ZSTD
+
+namespace {
+
+class compression_scheme_impl : public tpie::compression_scheme {
+public:
+
+virtual size_t max_compressed_length(size_t) const override {
+	throw tpie::stream_exception("No zstd support");
+}
+
+virtual void compress(char *, const char *, size_t, size_t *) const override {
+	throw tpie::stream_exception("No zstd support");
+}
+
+virtual size_t uncompressed_length(const char *, size_t) const override {
+	throw tpie::stream_exception("No zstd support; cannot read zstd compressed block");
+}
+
+virtual void uncompress(char *, const char *, size_t) const override {
+	throw tpie::stream_exception("No zstd support; cannot read zstd compressed block");
+}
+
+};
+
+compression_scheme_impl the_compression_scheme;
+
+} // unnamed namespace
+
+namespace tpie {
+
+const compression_scheme & get_compression_scheme_zstd() {
+	return the_compression_scheme;
+}
+
+} // namespace tpie
+
+#endif // TPIE_HAS_ZSTD
@@ -26,6 +26,9 @@
 
 #include <tpie/tpie_export.h>
 #include <tpie/array.h>
+#include <tpie/array_view.h>
+#include <algorithm>
+#include <limits>
 #include <tpie/tpie_assert.h>
 #include <tpie/tempname.h>
 #include <tpie/file_base_crtp.h>
@@ -321,6 +324,59 @@ public:
 
 	stream_size_type file_size() const { return size(); }
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Hint that the stream will grow to the given number of items.
+	///
+	/// Disk space is allocated up front, so the file is not fragmented as it
+	/// grows block by block; see file_accessor::posix::preallocate_i. Does
+	/// nothing when the stream is compressed, since the size of the
+	/// compressed blocks is not known up front (see reserve_bytes), or
+	/// unless the stream is writable.
+	///////////////////////////////////////////////////////////////////////////
+	void reserve(stream_size_type items);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Hint that about the given number of bytes will be written to
+	/// the end of the file.
+	///
+	/// Unlike reserve, this also preallocates space for compressed streams,
+	/// for callers that can estimate the compressed size, e.g. from the size
+	/// on disk of the data they copy. Does nothing unless the stream is
+	/// writable.
+	///////////////////////////////////////////////////////////////////////////
+	void reserve_bytes(stream_size_type bytes);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Free the disk space of blocks as they are read.
+	///
+	/// When the stream is opened for reading only, each time reading
+	/// proceeds to the next block, the space of the blocks read since the
+	/// last seek is freed, except for the first one, which may hold items
+	/// that other streams read from the same file; see
+	/// file_accessor::posix::punch_hole_i. Freed space is subtracted from
+	/// the recorded size of the temporary file, so get_temp_file_usage()
+	/// drops as the file is consumed. Reading the freed blocks again yields
+	/// garbage, so only use this for files that are read once, such as
+	/// merge inputs. Takes effect in the next open.
+	///////////////////////////////////////////////////////////////////////////
+	void set_discard_consumed(bool discard);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  The blocks read and written by this stream object, over all
+	/// files it has opened; see io_stats.
+	///
+	/// Blocks are read and written by the compressor thread, so the counts
+	/// include blocks that are still being written.
+	///////////////////////////////////////////////////////////////////////////
+	io_counters get_io_counters() const;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Add the blocks read and written from now on to the given
+	/// io_stats as well, e.g. those of a pipelining node, or stop doing so
+	/// if it is null.
+	///////////////////////////////////////////////////////////////////////////
+	void set_io_stats_sink(std::shared_ptr<io_stats> sink);
+
 	
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Check if the next call to read() will succeed or not.
@@ -471,6 +527,25 @@ public:
 	void read(IT const a, IT const b) {
 		for (IT i = a; i != b; ++i) *i = read();
 	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Reads up to maxItems items from the current block without copying
+	/// them, if can_read() == true. At least one item is read.
+	///
+	/// If can_read() == false, throws an end_of_stream_exception.
+	///
+	/// The items are only valid until the next operation on the stream.
+	///////////////////////////////////////////////////////////////////////////
+	array_view<const T> read_batch(memory_size_type maxItems = std::numeric_limits<memory_size_type>::max()) {
+		// read() loads the next block if needed and sets m_cachedReads to
+		// the number of items that follow in the block.
+		const T * first = &read();
+		memory_size_type n = std::min(maxItems - 1, m_cachedReads);
+		m_cachedReads -= n;
+		m_offset += n;
+		m_nextItem += n * sizeof(T);
+		return array_view<const T>(first, n + 1);
+	}
 	
 	const T & read_back() {
 		if (m_seekState != seek_state::none || m_nextItem == m_bufferBegin) read_back_unlikely();
@@ -497,6 +572,26 @@ public:
 	void write(IT const a, IT const b) {
 		for (IT i = a; i != b; ++i) write(*i);
 	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Writes the items in [a, b), copying as many items at a time as fit in
+	/// the current block.
+	///////////////////////////////////////////////////////////////////////////
+	void write(const T * a, const T * b) {
+		while (a != b) {
+			if (m_cachedWrites == 0) {
+				write(*a++);
+				continue;
+			}
+			memory_size_type n = std::min(static_cast<memory_size_type>(b - a), m_cachedWrites);
+			memcpy(m_nextItem, a, n * sizeof(T));
+			m_nextItem += n * sizeof(T);
+			m_size += n;
+			m_offset += n;
+			m_cachedWrites -= n;
+			a += n;
+		}
+	}
 };
 
 } // namespace tpie
@@ -173,6 +173,15 @@ public:
 
 	stream_size_type m_nextReadOffset;
 
+	/** Whether to free the space of blocks as they are read. */
+	bool m_discardConsumed;
+
+	/** When discarding, the start of the range read but not yet freed, or
+	 * no_discard if no block has been read since the last seek. */
+	stream_size_type m_discardFrom;
+
+	static const stream_size_type no_discard = std::numeric_limits<stream_size_type>::max();
+
 	compressed_stream_base * m_o;
 	
 	compressed_stream_base_p(memory_size_type itemSize, double blockFactor, compressed_stream_base * outer)
@@ -195,6 +204,8 @@ public:
 		, m_readOffset(0)
 		, m_nextPosition(/* not a position */)
 		, m_nextReadOffset(0)
+		, m_discardConsumed(false)
+		, m_discardFrom(no_discard)
 		, m_o(outer)
 		{}
 
@@ -212,6 +223,9 @@ public:
 		const cache_hint cacheHint = translate_cache(openFlags);
 		const compression_flags compressionFlags = translate_compression(openFlags);
 		
+		m_byteStreamAccessor.set_direct_io(m_tempFile != NULL && get_direct_io());
+		m_byteStreamAccessor.set_punch_holes(discarding());
+		m_byteStreamAccessor.set_checksums(get_block_checksums());
 		m_byteStreamAccessor.open(path, m_canRead, m_canWrite, m_itemSize,
 								  m_blockSize, userDataSize, cacheHint,
 								  compressionFlags);
@@ -221,10 +235,36 @@ public:
 		m_lastBlockReadOffset = m_byteStreamAccessor.get_last_block_read_offset();
 		m_currentFileSize = m_byteStreamAccessor.file_size();
 		m_response.clear_block_info();
+		m_response.reset_compression_history();
 		
 		m_o->seek(0);
 	}
 
+	bool discarding() const {
+		return m_discardConsumed && !m_canWrite;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Free the blocks read before the given block, which has just
+	/// been read, if the stream discards consumed blocks.
+	///
+	/// The first block read after a seek is kept, since the items before
+	/// the seek position may belong to another stream.
+	///////////////////////////////////////////////////////////////////////////
+	void discard_consumed(stream_size_type blockNumber) {
+		if (!discarding()) return;
+		stream_size_type begin = use_compression() ? m_readOffset : blockNumber * m_blockSize;
+		if (m_discardFrom == no_discard) {
+			m_discardFrom = use_compression() ? m_nextReadOffset : begin + m_blockSize;
+			return;
+		}
+		if (begin <= m_discardFrom) return;
+		stream_size_type freedTo = m_byteStreamAccessor.discard_bytes(m_discardFrom, begin);
+		if (m_tempFile && freedTo > m_discardFrom)
+			m_tempFile->release_recorded_size(freedTo - m_discardFrom);
+		m_discardFrom = freedTo;
+	}
+
 	static memory_size_type block_size(double blockFactor) noexcept {
 		return static_cast<memory_size_type>(get_block_size() * blockFactor);
 	}
@@ -577,6 +617,8 @@ public:
 				// nextReadOffset is not used.
 			}
 		}
+
+		discard_consumed(blockNumber);
 	
 		m_o->m_nextItem = m_o->m_bufferBegin;
 	}
@@ -623,6 +665,7 @@ public:
 		while (!m_response.done()) {
 			m_response.wait(lock);
 		}
+		m_response.rethrow_error();
 	}
 
 	///////////////////////////////////////////////////////////////////////////
@@ -647,6 +690,7 @@ public:
 		compressor_thread_lock l(compressor());
 	
 		m_updateReadOffsetFromWrite = false;
+		m_discardFrom = no_discard;
 	
 		if (this->m_bufferDirty)
 			flush_block(l);
@@ -1102,6 +1146,31 @@ void compressed_stream_base::seek(stream_offset_type offset, offset_type whence)
 	tp_assert(false, "seek: Unknown whence");
 }
 
+void compressed_stream_base::reserve(stream_size_type items) {
+	tp_assert(is_open(), "reserve: !is_open");
+	if (!m_p->m_canWrite || m_p->use_compression()) return;
+	stream_size_type blocks = (items + m_p->m_blockItems - 1) / m_p->m_blockItems;
+	m_p->m_byteStreamAccessor.reserve_bytes(blocks * m_p->m_blockSize);
+}
+
+void compressed_stream_base::reserve_bytes(stream_size_type bytes) {
+	tp_assert(is_open(), "reserve_bytes: !is_open");
+	if (!m_p->m_canWrite || bytes == 0) return;
+	m_p->m_byteStreamAccessor.reserve_bytes(m_p->m_byteStreamAccessor.file_size() + bytes);
+}
+
+void compressed_stream_base::set_discard_consumed(bool discard) {
+	m_p->m_discardConsumed = discard;
+}
+
+io_counters compressed_stream_base::get_io_counters() const {
+	return m_p->m_byteStreamAccessor.stats().get();
+}
+
+void compressed_stream_base::set_io_stats_sink(std::shared_ptr<io_stats> sink) {
+	m_p->m_byteStreamAccessor.stats().set_sink(std::move(sink));
+}
+
 void compressed_stream_base::truncate(stream_size_type offset) {
 	tp_assert(is_open(), "truncate: !is_open");
 	m_p->uncache_read_writes();
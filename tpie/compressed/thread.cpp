@@ -17,12 +17,16 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with TPIE.  If not, see <http://www.gnu.org/licenses/>
 
-#include <queue>
+#include <list>
+#include <vector>
+#include <algorithm>
 #include <tpie/compressed/thread.h>
 #include <tpie/compressed/request.h>
 #include <tpie/compressed/buffer.h>
 #include <tpie/compressed/scheme.h>
+#include <tpie/compressed/checksum.h>
 #include <condition_variable>
+#include <sstream>
 namespace {
 
 class block_header {
@@ -77,6 +81,48 @@ private:
 
 namespace tpie {
 
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Decides which blocks of compression_normal streams to compress.
+///
+/// A block is written uncompressed when the compressor is behind, that is,
+/// when more requests are queued than there are threads to serve them, or
+/// when recently compressed blocks of the same stream did not shrink. In the
+/// latter case, an occasional block is still compressed to notice when the
+/// data changes. Each stream has its own compression_history, so a stream
+/// of incompressible data does not turn off compression of other streams.
+///
+/// The compressor lock must be held when calling the methods.
+///////////////////////////////////////////////////////////////////////////////
+class adaptive_compression {
+public:
+	static bool should_compress(compression_history & history,
+								memory_size_type backlog, memory_size_type threads) {
+		if (backlog > threads) return false;
+		if (history.ratio < max_ratio) return true;
+		if (++history.skipped < probe_interval) return false;
+		history.skipped = 0;
+		return true;
+	}
+
+	static void record(compression_history & history,
+					   memory_size_type uncompressedSize, memory_size_type compressedSize) {
+		if (uncompressedSize == 0) return;
+		double ratio = static_cast<double>(compressedSize) / static_cast<double>(uncompressedSize);
+		history.ratio = (1 - weight) * history.ratio + weight * ratio;
+	}
+
+private:
+	// Blocks compressing worse than this on average are not worth the time.
+	static constexpr double max_ratio = 0.9;
+	// Weight of the newest block in the running average of the ratio.
+	static constexpr double weight = 0.25;
+	static const memory_size_type probe_interval = 16;
+};
+
+} // unnamed namespace
+
 /*static*/ stream_size_type compressor_thread::subtract_block_header(stream_size_type dataOffset) {
 	return dataOffset - sizeof(block_header);
 }
@@ -89,9 +135,13 @@ public:
 	{
 	}
 
+	void start(compressor_thread_lock & /*lock*/) {
+		m_done = false;
+	}
+
 	void stop(compressor_thread_lock & /*lock*/) {
 		m_done = true;
-		m_newRequest.notify_one();
+		m_newRequest.notify_all();
 	}
 
 	bool request_valid(const compressor_request & r) {
@@ -105,32 +155,59 @@ public:
 		tp_assert(false, "Unknown request type");
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Process requests until stop() is called and the queue is empty.
+	///
+	/// Several threads may run this concurrently. Requests for the same
+	/// stream are processed one at a time in the order they were made, since
+	/// a thread only takes the first queued request of a stream that no other
+	/// thread is working on.
+	///////////////////////////////////////////////////////////////////////////
 	void run() {
+		compressor_thread_lock::lock_t lock(mutex());
 		while (true) {
-			compressor_thread_lock::lock_t lock(mutex());
-			m_idle = false;
-			while (!m_done && m_requests.empty()) {
-				m_idle = true;
+			std::list<queued_request>::iterator i = next_request();
+			while (i == m_requests.end() && !(m_done && m_requests.empty())) {
 				m_newRequest.wait(lock);
+				i = next_request();
 			}
-			if (m_done && m_requests.empty()) break;
-			{
-				compressor_request r = m_requests.front();
-				m_requests.pop();
-				lock.unlock();
-
-				switch (r.kind()) {
-					case compressor_request_kind::NONE:
-						throw exception("Invalid request");
-					case compressor_request_kind::READ:
+			if (i == m_requests.end()) break;
+
+			compressor_request r = i->request;
+			const void * stream = i->stream;
+			// Time spent in the queue, and number of requests
+			increment_user(11, (stream_size_type)(ptime::seconds(i->enqueued, ptime::now())*1000000));
+			increment_user(12, 1);
+			m_requests.erase(i);
+			m_activeStreams.push_back(stream);
+			bool compress = true;
+			if (r.kind() == compressor_request_kind::WRITE
+				&& r.get_write_request().file_accessor().get_compression_flags() == compression_normal)
+				compress = adaptive_compression::should_compress(
+					r.get_write_request().get_compression_history(),
+					m_requests.size(), get_compressor_thread_count());
+			lock.unlock();
+
+			switch (r.kind()) {
+				case compressor_request_kind::NONE:
+					throw exception("Invalid request");
+				case compressor_request_kind::READ:
+					try {
 						process_read_request(r.get_read_request());
-						break;
-					case compressor_request_kind::WRITE:
-						process_write_request(r.get_write_request());
-						break;
-				}
+					} catch (...) {
+						read_failed(r.get_read_request(), std::current_exception());
+					}
+					break;
+				case compressor_request_kind::WRITE:
+					process_write_request(r.get_write_request(), compress);
+					break;
 			}
+
 			lock.lock();
+			m_activeStreams.erase(std::find(m_activeStreams.begin(), m_activeStreams.end(), stream));
+			// Other threads may have skipped requests for this stream, or may
+			// be waiting for the last request to finish before stopping.
+			if (!m_requests.empty() || m_done) m_newRequest.notify_all();
 			m_requestDone.notify_all();
 		}
 	}
@@ -143,6 +220,15 @@ private:
 		}
 	}
 
+	// Hand the error to the stream waiting for the read, so that it is
+	// thrown there rather than ending the compressor thread.
+	void read_failed(read_request & rr, std::exception_ptr error) {
+		compressor_thread_lock::lock_t lock(mutex());
+		rr.buffer()->transition_state(compressor_buffer_state::reading,
+									  compressor_buffer_state::dirty);
+		rr.set_error(error);
+	}
+
 	void process_read_request(read_request & rr) {
 		stat_timer t(3); // Time reading
 		const bool useCompression = rr.file_accessor().get_compressed();
@@ -155,7 +241,9 @@ private:
 			if (blockSize > rr.buffer()->capacity()) {
 				throw stream_exception("Internal error; blockSize > buffer capacity");
 			}
+			ptime t1 = ptime::now();
 			rr.file_accessor().read(readOffset, rr.buffer()->get(), blockSize);
+			rr.file_accessor().stats().add_read(blockSize, blockSize, ptime::seconds(t1, ptime::now()));
 			rr.buffer()->set_size(blockSize);
 			compressor_thread_lock::lock_t lock(mutex());
 			// Notify that reading has completed.
@@ -170,6 +258,7 @@ private:
 		array<char> scratch;
 		char * compressed;
 		stream_size_type nextReadOffset;
+		ptime t1 = ptime::now();
 		if (backward) {
 			readOffset -= sizeof(blockTrailer);
 			checked_read(rr, readOffset, &blockTrailer, sizeof(blockTrailer));
@@ -199,16 +288,34 @@ private:
 				   sizeof(blockTrailer));
 			nextReadOffset = readOffset + sizeof(blockHeader) + scratch.size();
 		}
+		const double readSeconds = ptime::seconds(t1, ptime::now());
 		if (blockHeader != blockTrailer) {
 			throw exception("Block trailer is different from the block header");
 		}
 
+		memory_size_type compressedSize = blockSize;
+		if (rr.file_accessor().get_checksums()) {
+			uint32_t checksum;
+			if (compressedSize < sizeof(checksum))
+				throw invalid_file_exception("Block is too small to hold a checksum");
+			compressedSize -= sizeof(checksum);
+			memcpy(&checksum, compressed + compressedSize, sizeof(checksum));
+			if (crc32c(compressed, compressedSize, crc32c(&blockHeader, sizeof(blockHeader))) != checksum) {
+				std::stringstream ss;
+				ss << "Block checksum mismatch at offset " << readOffset
+				   << " in " << rr.file_accessor().path();
+				throw invalid_file_exception(ss.str());
+			}
+		}
+
 		const compression_scheme & compressionScheme =
 			get_compression_scheme(blockHeader.get_compression_scheme());
-		size_t uncompressedLength = compressionScheme.uncompressed_length(compressed, blockSize);
+		size_t uncompressedLength = compressionScheme.uncompressed_length(compressed, compressedSize);
 		if (uncompressedLength > rr.buffer()->capacity())
 			throw exception("uncompressedLength exceeds the buffer capacity");
-		compressionScheme.uncompress(rr.buffer()->get(), compressed, blockSize);
+		compressionScheme.uncompress(rr.buffer()->get(), compressed, compressedSize);
+		rr.file_accessor().stats().add_read(sizeof(blockHeader) + blockSize + sizeof(blockTrailer),
+											uncompressedLength, readSeconds);
 
 		compressor_thread_lock::lock_t lock(mutex());
 		rr.buffer()->transition_state(compressor_buffer_state::reading,
@@ -219,12 +326,14 @@ private:
 		rr.set_next_block_offset(nextReadOffset);
 	}
 
-	void process_write_request(write_request & wr) {
+	void process_write_request(write_request & wr, bool compress) {
 		stat_timer t(4); // Time writing
 		size_t inputLength = wr.buffer()->size();
 		if (!wr.file_accessor().get_compressed()) {
 			// Uncompressed case
+			ptime t1 = ptime::now();
 			wr.file_accessor().write(wr.write_offset(), wr.buffer()->get(), wr.buffer()->size());
+			wr.file_accessor().stats().add_write(inputLength, inputLength, ptime::seconds(t1, ptime::now()));
 			compressor_thread_lock::lock_t lock(mutex());
 			wr.buffer()->transition_state(compressor_buffer_state::writing,
 										  compressor_buffer_state::clean);
@@ -237,26 +346,49 @@ private:
 		block_header blockHeader;
 		block_header & blockTrailer = blockHeader;
 		compression_scheme::type schemeType = m_preferredCompression;
-		if (adaptiveCompression && !m_idle) {
+		if (adaptiveCompression && !compress) {
+			schemeType = compression_scheme::none;
+		}
+		// Record the scheme that is actually used, so the block can be read
+		// back by a build that has a different set of libraries.
+		if (!compression_scheme_available(schemeType)) {
 			schemeType = compression_scheme::none;
 		}
-		if (schemeType == compression_scheme::snappy)
-			increment_user(7, 1);
-		if (schemeType == compression_scheme::none)
-			increment_user(8, 1);
+		const bool recordRatio = adaptiveCompression && schemeType != compression_scheme::none;
 		const compression_scheme & compressionScheme = get_compression_scheme(schemeType);
+		const memory_size_type checksumSize =
+			wr.file_accessor().get_checksums() ? sizeof(uint32_t) : 0;
 		const memory_size_type maxBlockSize = compressionScheme.max_compressed_length(inputLength);
-		if (maxBlockSize > blockHeader.max_block_size())
+		if (maxBlockSize + checksumSize > blockHeader.max_block_size())
 			throw exception("process_write_request: MaxCompressedLength > max_block_size");
-		array<char> scratch(sizeof(blockHeader) + maxBlockSize + sizeof(blockTrailer));
+		array<char> scratch(sizeof(blockHeader) + maxBlockSize + checksumSize + sizeof(blockTrailer));
 		memory_size_type blockSize;
 		compressionScheme.compress(scratch.get() + sizeof(blockHeader),
 								   reinterpret_cast<const char *>(wr.buffer()->get()),
 								   inputLength,
 								   &blockSize);
-		blockHeader.set_block_size(blockSize);
+		const memory_size_type compressedSize = blockSize;
+		if (adaptiveCompression && blockSize >= inputLength && inputLength > 0) {
+			// The block did not shrink; store it uncompressed instead.
+			schemeType = compression_scheme::none;
+			memcpy(scratch.get() + sizeof(blockHeader), wr.buffer()->get(), inputLength);
+			blockSize = inputLength;
+		}
+		switch (schemeType) {
+			case compression_scheme::none: increment_user(8, 1); break;
+			case compression_scheme::snappy: increment_user(7, 1); break;
+			case compression_scheme::lz4: increment_user(9, 1); break;
+			case compression_scheme::zstd: increment_user(10, 1); break;
+		}
+		blockHeader.set_block_size(blockSize + checksumSize);
 		blockHeader.set_compression_scheme(schemeType);
 		memcpy(scratch.get(), &blockHeader, sizeof(blockHeader));
+		if (checksumSize != 0) {
+			// The checksum covers the header and the compressed data.
+			const uint32_t checksum = crc32c(scratch.get(), sizeof(blockHeader) + blockSize);
+			memcpy(scratch.get() + sizeof(blockHeader) + blockSize, &checksum, sizeof(checksum));
+			blockSize += checksumSize;
+		}
 		memcpy(scratch.get() + sizeof(blockHeader) + blockSize, &blockTrailer, sizeof(blockTrailer));
 		const memory_size_type writeSize = sizeof(blockHeader) + blockSize + sizeof(blockTrailer);
 		if (!wr.should_append()) {
@@ -266,6 +398,8 @@ private:
 		}
 		{
 			compressor_thread_lock::lock_t lock(mutex());
+			if (recordRatio)
+				adaptive_compression::record(wr.get_compression_history(), inputLength, compressedSize);
 			wr.buffer()->transition_state(compressor_buffer_state::writing,
 										  compressor_buffer_state::clean);
 			wr.buffer()->set_block_size(writeSize);
@@ -275,7 +409,9 @@ private:
 			const stream_size_type newSize = offset + writeSize;
 			wr.update_recorded_size(newSize);
 		}
+		ptime t1 = ptime::now();
 		wr.file_accessor().append(scratch.get(), writeSize);
+		wr.file_accessor().stats().add_write(writeSize, inputLength, ptime::seconds(t1, ptime::now()));
 	}
 
 public:
@@ -286,8 +422,8 @@ public:
 	void request(const compressor_request & r) {
 		tp_assert(request_valid(r), "Invalid request");
 
-		m_requests.push(r);
-		m_requests.back().get_request_base().initiate_request();
+		m_requests.emplace_back(r);
+		m_requests.back().request.get_request_base().initiate_request();
 		m_newRequest.notify_one();
 	}
 
@@ -302,15 +438,50 @@ public:
 	}
 
 private:
+	struct queued_request {
+		queued_request(const compressor_request & r)
+			: request(r)
+			, stream(stream_of(r))
+			, enqueued(ptime::now())
+		{
+		}
+
+		compressor_request request;
+		// The stream that made the request, identified by its file accessor.
+		const void * stream;
+		ptime enqueued;
+	};
+
+	static const void * stream_of(const compressor_request & r) {
+		switch (r.kind()) {
+			case compressor_request_kind::NONE:
+				break;
+			case compressor_request_kind::READ:
+				return &const_cast<compressor_request &>(r).get_read_request().file_accessor();
+			case compressor_request_kind::WRITE:
+				return &const_cast<compressor_request &>(r).get_write_request().file_accessor();
+		}
+		return nullptr;
+	}
+
+	// Find the first queued request whose stream is not being processed by
+	// another thread.
+	std::list<queued_request>::iterator next_request() {
+		std::list<queued_request>::iterator i = m_requests.begin();
+		while (i != m_requests.end()
+			   && std::find(m_activeStreams.begin(), m_activeStreams.end(), i->stream)
+			   != m_activeStreams.end())
+			++i;
+		return i;
+	}
+
 	mutex_t m_mutex;
-	std::queue<compressor_request> m_requests;
+	std::list<queued_request> m_requests;
+	std::vector<const void *> m_activeStreams;
 	std::condition_variable m_newRequest;
 	std::condition_variable m_requestDone;
 	bool m_done;
 	compression_scheme::type m_preferredCompression;
-
-	// Whether the thread was idle prior to handling the current request.
-	bool m_idle;
 };
 
 } // namespace tpie
@@ -318,7 +489,8 @@ private:
 namespace {
 
 tpie::compressor_thread the_compressor_thread;
-std::thread the_compressor_thread_handle;
+std::vector<std::thread> the_compressor_thread_handles;
+tpie::memory_size_type the_compressor_thread_count = 1;
 bool compressor_thread_already_finished = false;
 
 void run_the_compressor_thread() {
@@ -334,17 +506,21 @@ compressor_thread & the_compressor_thread() {
 }
 
 void init_compressor() {
-	if (the_compressor_thread_handle.get_id() != std::thread::id()) {
+	if (!the_compressor_thread_handles.empty()) {
 		log_debug() << "Attempted to initiate compressor thread twice" << std::endl;
 		return;
 	}
-	std::thread t(run_the_compressor_thread);
-	the_compressor_thread_handle.swap(t);
+	{
+		compressor_thread_lock lock(the_compressor_thread());
+		the_compressor_thread().start(lock);
+	}
+	for (memory_size_type i = 0; i < the_compressor_thread_count; ++i)
+		the_compressor_thread_handles.push_back(std::thread(run_the_compressor_thread));
 	compressor_thread_already_finished = false;
 }
 
 void finish_compressor() {
-	if (the_compressor_thread_handle.get_id() == std::thread::id()) {
+	if (the_compressor_thread_handles.empty()) {
 		if (compressor_thread_already_finished) {
 			log_debug() << "Compressor thread already finished" << std::endl;
 		} else {
@@ -356,12 +532,25 @@ void finish_compressor() {
 		compressor_thread_lock lock(the_compressor_thread());
 		the_compressor_thread().stop(lock);
 	}
-	the_compressor_thread_handle.join();
-	std::thread t;
-	the_compressor_thread_handle.swap(t);
+	for (std::thread & t : the_compressor_thread_handles) t.join();
+	the_compressor_thread_handles.clear();
 	compressor_thread_already_finished = true;
 }
 
+void set_compressor_thread_count(memory_size_type threads) {
+	if (threads == 0) threads = 1;
+	if (threads == the_compressor_thread_count) return;
+	the_compressor_thread_count = threads;
+	if (the_compressor_thread_handles.empty()) return;
+	// Restart the pool; pending requests are completed first.
+	finish_compressor();
+	init_compressor();
+}
+
+memory_size_type get_compressor_thread_count() {
+	return the_compressor_thread_count;
+}
+
 compressor_thread::compressor_thread()
 	: pimpl(new impl)
 {
@@ -387,6 +576,10 @@ void compressor_thread::wait_for_request_done(compressor_thread_lock & l) {
 	pimpl->wait_for_request_done(l);
 }
 
+void compressor_thread::start(compressor_thread_lock & lock) {
+	pimpl->start(lock);
+}
+
 void compressor_thread::stop(compressor_thread_lock & lock) {
 	pimpl->stop(lock);
 }
@@ -59,6 +59,9 @@ public:
 
 	void run();
 
+	// Allow run() to be called again after stop().
+	void start(compressor_thread_lock & lock);
+
 	void stop(compressor_thread_lock & lock);
 
 	void set_preferred_compression(compressor_thread_lock &, compression_scheme::type);
@@ -93,6 +96,21 @@ private:
 	ptime t2;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Set the number of threads serving compressor requests.
+///
+/// Requests from different streams are handled concurrently, while requests
+/// from the same stream are handled in order. If the threads are running,
+/// they finish the queued requests and are restarted; no stream may hold the
+/// compressor lock while calling this. The default is one thread.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_compressor_thread_count(memory_size_type threads);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get the number of threads serving compressor requests.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT memory_size_type get_compressor_thread_count();
+
 } // namespace tpie
 
 #endif // TPIE_COMPRESSED_THREAD_H
@@ -7,6 +7,7 @@
 #cmakedefine TPIE_DEPRECATED_WARNINGS
 #cmakedefine TPIE_PARALLEL_SORT
 #cmakedefine TPIE_EXECUTION_TIME_PREDICTOR
+#cmakedefine TPIE_PIPELINING_PROFILE
 
 #if defined (TPIE_HAVE_UNISTD_H)
 #include <unistd.h>
@@ -60,6 +61,8 @@
 #cmakedefine TPIE_HAS_SNAPPY
 #cmakedefine TPIE_HAS_LZ4
 #cmakedefine TPIE_HAS_ZSTD
+#cmakedefine TPIE_HAS_IO_URING
+#cmakedefine TPIE_DEFAULT_IO_URING
 
 // See https://github.com/lz4/lz4/pull/459
 #if __cplusplus >= 201402
@@ -45,6 +45,13 @@ public:
 		throw exception("Block operations not supported");
 	}
 
+	virtual void write_block_data(const void * /*data*/,
+								  stream_size_type /*blockNumber*/,
+								  memory_size_type /*itemCount*/) override
+	{
+		throw exception("Block operations not supported");
+	}
+
 	void set_size(stream_size_type amt) {
 		p_t::set_size(amt);
 	}
@@ -59,14 +66,32 @@ public:
 			- this->header_size();
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Preallocate disk space for the given number of bytes after
+	/// the header; see posix::preallocate_i.
+	///////////////////////////////////////////////////////////////////////////
+	void reserve_bytes(stream_size_type bytes) {
+		this->m_fileAccessor.preallocate_i(this->header_size() + bytes);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Free the disk space of the bytes [begin, end) after the
+	/// header, which have been read and will not be read again; see
+	/// posix::punch_hole_i.
+	/// \returns Where the next range to free should begin.
+	///////////////////////////////////////////////////////////////////////////
+	stream_size_type discard_bytes(stream_size_type begin, stream_size_type end) {
+		const stream_size_type header = this->header_size();
+		return this->m_fileAccessor.punch_hole_i(header + begin, header + end) - header;
+	}
+
 	void truncate_bytes(stream_size_type size) {
 		this->m_fileAccessor.truncate_i(this->header_size() + size);
 	}
 
 	void write(const stream_size_type byteOffset, const void * data, const memory_size_type size) {
 		stream_size_type position = byteOffset + this->header_size();
-		this->m_fileAccessor.seek_i(position);
-		this->m_fileAccessor.write_i(data, size);
+		this->m_fileAccessor.pwrite_i(data, size, position);
 	}
 
 	void append(const void * data, memory_size_type size) {
@@ -75,8 +100,7 @@ public:
 		if (position < this->header_size())
 			position = this->header_size();
 
-		this->m_fileAccessor.seek_i(position);
-		this->m_fileAccessor.write_i(data, size);
+		this->m_fileAccessor.pwrite_i(data, size, position);
 	}
 
 	memory_size_type read(const stream_size_type byteOffset, void * data, memory_size_type size) {
@@ -90,8 +114,7 @@ public:
 
 		stream_size_type position = this->header_size() + byteOffset;
 
-		this->m_fileAccessor.seek_i(position);
-		this->m_fileAccessor.read_i(data, size);
+		this->m_fileAccessor.pread_i(data, size, position);
 		return size;
 	}
 
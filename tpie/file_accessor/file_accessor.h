@@ -38,10 +38,16 @@ typedef stream_accessor_base<win32> file_accessor;
 #else // WIN32
 
 #include <tpie/file_accessor/posix.h>
+#include <tpie/file_accessor/uring.h>
 namespace tpie {
 namespace file_accessor {
+#ifdef TPIE_DEFAULT_IO_URING
+typedef uring raw_file_accessor;
+typedef stream_accessor_base<uring> file_accessor;
+#else // TPIE_DEFAULT_IO_URING
 typedef posix raw_file_accessor;
 typedef stream_accessor_base<posix> file_accessor;
+#endif // TPIE_DEFAULT_IO_URING
 }
 }
 
@@ -25,6 +25,7 @@
 #define _TPIE_FILE_ACCESSOR_POSIX_H
 
 #include <tpie/file_accessor/stream_accessor_base.h>
+#include <atomic>
 namespace tpie {
 namespace file_accessor {
 
@@ -33,12 +34,39 @@ namespace file_accessor {
 ///////////////////////////////////////////////////////////////////////////////
 
 class posix {
-private:
+protected:
+	static const int unopened_fd = -2;
+
 	int m_fd;
+	/** Descriptor of the same file opened with O_DIRECT by direct_fd, -1 if
+	 * direct I/O is off or refused, or unopened_fd until it is needed. */
+	std::atomic<int> m_directFd;
+	/** Path and flags with which direct_fd opens the file. */
+	std::string m_path;
+	int m_directFlags;
 	cache_hint m_cacheHint;
+	/** Current file offset, as set by seek_i and advanced by reads and writes. */
+	stream_size_type m_offset;
+	/** Whether to read and write aligned ranges with O_DIRECT. */
+	bool m_directIO;
+	/** Range of the previous write through the page cache in direct I/O
+	 * mode, to be dropped from the cache once written back. */
+	std::atomic<stream_size_type> m_writtenBegin;
+	std::atomic<stream_size_type> m_writtenEnd;
+	/** Read-only mapping of the file created by map_i, or 0. */
+	void * m_map;
+	memory_size_type m_mapLength;
+	/** Size up to which disk space has been preallocated, or 0. */
+	stream_size_type m_preallocated;
+	/** Whether open_ro opens the file for writing too, for punch_hole_i. */
+	bool m_punchHoles;
+
+	inline void copy_i(const posix & other);
 
 public:
 	inline posix();
+	inline posix(const posix & other);
+	inline posix & operator=(const posix & other);
 	inline ~posix() {close_i();}
 
 	inline void open_ro(const std::string & path);
@@ -54,6 +82,69 @@ public:
 	inline void truncate_i(stream_size_type bytes);
 	inline bool is_open() const;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Read from the given file offset without using or changing the
+	/// offset set by seek_i.
+	///
+	/// Since the descriptor has no file position to share, several threads
+	/// may call pread_i and pwrite_i on the same open accessor concurrently.
+	///////////////////////////////////////////////////////////////////////////
+	inline void pread_i(void * data, memory_size_type size, stream_size_type offset);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Write at the given file offset without using or changing the
+	/// offset set by seek_i.
+	///////////////////////////////////////////////////////////////////////////
+	inline void pwrite_i(const void * data, memory_size_type size, stream_size_type offset);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Map the first length bytes of the file read-only into memory.
+	///
+	/// The mapping is released by unmap_i or when the file is closed. The
+	/// pages are backed by the page cache and are not counted by the memory
+	/// manager.
+	///
+	/// \returns The start of the mapping, or 0 if the file cannot be mapped.
+	///////////////////////////////////////////////////////////////////////////
+	inline const char * map_i(memory_size_type length);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Release the mapping created by map_i, if any.
+	///////////////////////////////////////////////////////////////////////////
+	inline void unmap_i();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Hint that the file will grow to the given number of bytes.
+	///
+	/// On Linux, the disk space is allocated up front with fallocate,
+	/// without changing the file size, so the file is laid out contiguously
+	/// rather than growing extent by extent. Space that is still beyond the
+	/// end of the file when it is closed is released, or when a smaller size
+	/// than before is given, e.g. the current size of a file that will not
+	/// grow any further. Since this is only a hint, errors such as file
+	/// systems without fallocate are ignored.
+	///////////////////////////////////////////////////////////////////////////
+	inline void preallocate_i(stream_size_type bytes);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Open files opened by open_ro with write access as well, so
+	/// that punch_hole_i may free their space. Takes effect in the next open.
+	///////////////////////////////////////////////////////////////////////////
+	inline void set_punch_holes(bool punchHoles);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Free the disk space of the byte range [begin, end), whose
+	/// contents are no longer needed, without changing the file size.
+	///
+	/// Only whole pages of block_alignment bytes are freed, so the bytes
+	/// of a partial page at either end keep their contents. Reading a freed
+	/// range yields zeros.
+	/// \returns The end of the freed range, which is where the next call
+	/// should begin, or begin if nothing was freed (e.g. the range is
+	/// smaller than a page or the file system cannot punch holes).
+	///////////////////////////////////////////////////////////////////////////
+	inline stream_size_type punch_hole_i(stream_size_type begin, stream_size_type end);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Check the global errno variable and throw an exception that
 	/// matches its value.
@@ -62,9 +153,33 @@ public:
 
 	inline void set_cache_hint(cache_hint cacheHint);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Bypass the page cache for the next file opened.
+	///
+	/// When enabled, reads and writes whose buffer and file offset are
+	/// aligned to block_alignment transfer the aligned part of the range
+	/// through a second descriptor opened with O_DIRECT. It is opened at the
+	/// first such transfer, so files that never have one, such as compressed
+	/// streams, use a single descriptor. The unaligned rest, such as the stream header or a partial
+	/// final block, goes through the page cache, but is dropped from the
+	/// cache after it has been read or written back, as the whole file would
+	/// be with O_DIRECT. This is how compressed streams, whose blocks are
+	/// packed at unaligned offsets, avoid filling the cache. If the file
+	/// system does not support O_DIRECT, only the dropping takes effect.
+	///////////////////////////////////////////////////////////////////////////
+	inline void set_direct_io(bool directIO);
+
 private:
 	inline void _open(const std::string & path, int flags, mode_t mode);
 	inline void give_advice();
+	inline void release_preallocation();
+	inline int direct_fd();
+	inline memory_size_type direct_bytes(const void * data, memory_size_type size,
+										 stream_size_type offset);
+	inline void drop_read(stream_size_type offset, memory_size_type size);
+	inline void drop_written(stream_size_type offset, memory_size_type size);
+	static inline void pread_all(int fd, void * data, memory_size_type size, stream_size_type offset);
+	static inline void pwrite_all(int fd, const void * data, memory_size_type size, stream_size_type offset);
 };
 
 }
@@ -23,8 +23,10 @@
 #include <tpie/file_accessor/posix.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -41,14 +43,146 @@ void posix::throw_errno(std::string path /*=std::string()*/) {
 
 posix::posix()
 	: m_fd(-1)
+	, m_directFd(-1)
+	, m_directFlags(0)
 	, m_cacheHint(access_normal)
+	, m_offset(0)
+	, m_directIO(false)
+	, m_writtenBegin(0)
+	, m_writtenEnd(0)
+	, m_map(0)
+	, m_mapLength(0)
+	, m_preallocated(0)
+	, m_punchHoles(false)
 {
 }
 
+posix::posix(const posix & other)
+	: posix()
+{
+	copy_i(other);
+}
+
+posix & posix::operator=(const posix & other) {
+	if (this == &other) return *this;
+	close_i();
+	copy_i(other);
+	return *this;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Make this closed accessor a copy of other.
+///
+/// The copy has its own duplicate of the descriptor, so either may be closed
+/// first. It is not mapped, opens its own O_DIRECT descriptor when needed and
+/// leaves the preallocated space to the original.
+///////////////////////////////////////////////////////////////////////////////
+void posix::copy_i(const posix & other) {
+	if (other.m_fd != -1) {
+		m_fd = ::dup(other.m_fd);
+		if (m_fd == -1) throw_errno(other.m_path);
+		get_file_manager().increment_open_file_count();
+	}
+	const int directFd = other.m_directFd.load();
+	m_directFd = directFd >= 0 ? unopened_fd : directFd;
+	m_path = other.m_path;
+	m_directFlags = other.m_directFlags;
+	m_cacheHint = other.m_cacheHint;
+	m_offset = other.m_offset;
+	m_directIO = other.m_directIO;
+	m_writtenBegin = other.m_writtenBegin.load();
+	m_writtenEnd = other.m_writtenEnd.load();
+	m_punchHoles = other.m_punchHoles;
+}
+
 inline void posix::set_cache_hint(cache_hint cacheHint) {
 	m_cacheHint = cacheHint;
 }
 
+inline void posix::set_direct_io(bool directIO) {
+	m_directIO = directIO;
+}
+
+inline void posix::set_punch_holes(bool punchHoles) {
+	m_punchHoles = punchHoles;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The O_DIRECT descriptor, which is opened on the first call, or -1.
+///
+/// Concurrent first calls may both open the file; the loser closes its
+/// descriptor again.
+///////////////////////////////////////////////////////////////////////////////
+inline int posix::direct_fd() {
+	int fd = m_directFd.load();
+	if (fd != unopened_fd) return fd;
+	int opened = -1;
+#ifdef O_DIRECT
+	// tmpfs and some other file systems refuse O_DIRECT, in which case
+	// we simply use the page cache.
+	opened = ::open(m_path.c_str(), m_directFlags | O_DIRECT);
+	if (opened != -1) get_file_manager().increment_open_file_count();
+#endif // O_DIRECT
+	if (m_directFd.compare_exchange_strong(fd, opened)) return opened;
+	if (opened != -1) {
+		::close(opened);
+		get_file_manager().decrement_open_file_count();
+	}
+	return fd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Number of bytes at the start of the given range that may be
+/// transferred with O_DIRECT.
+///////////////////////////////////////////////////////////////////////////////
+inline memory_size_type posix::direct_bytes(const void * data, memory_size_type size,
+											stream_size_type offset) {
+	if (m_directFd.load() == -1) return 0;
+	if (reinterpret_cast<size_t>(data) % block_alignment != 0) return 0;
+	if (offset % block_alignment != 0) return 0;
+	if (size < block_alignment) return 0;
+	if (direct_fd() == -1) return 0;
+	return size - size % block_alignment;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief In direct I/O mode, drop a range read through the page cache.
+///
+/// Only whole pages are dropped, so a page shared with the next block of a
+/// compressed stream stays cached for the next read.
+///////////////////////////////////////////////////////////////////////////////
+inline void posix::drop_read(stream_size_type offset, memory_size_type size) {
+#ifndef __MACH__
+	if (!m_directIO || size == 0) return;
+	::posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+#else
+	unused(offset); unused(size);
+#endif // __MACH__
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief In direct I/O mode, start writing back a range written through
+/// the page cache, and drop the previous such range.
+///
+/// Dirty pages cannot be dropped, so the range is dropped one write later
+/// to give the writeback time to finish; pages still being written stay
+/// cached until the kernel evicts them.
+///////////////////////////////////////////////////////////////////////////////
+inline void posix::drop_written(stream_size_type offset, memory_size_type size) {
+#ifndef __MACH__
+	if (!m_directIO || size == 0) return;
+#ifdef SYNC_FILE_RANGE_WRITE
+	::sync_file_range(m_fd, static_cast<off64_t>(offset), static_cast<off64_t>(size), SYNC_FILE_RANGE_WRITE);
+#endif // SYNC_FILE_RANGE_WRITE
+	const stream_size_type begin = m_writtenBegin.exchange(offset);
+	const stream_size_type end = m_writtenEnd.exchange(offset + size);
+	if (begin < end)
+		::posix_fadvise(m_fd, static_cast<off_t>(begin), static_cast<off_t>(end - begin), POSIX_FADV_DONTNEED);
+#else
+	unused(offset); unused(size);
+#endif // __MACH__
+}
+
 inline void posix::give_advice() {
 #ifndef __MACH__
 	int advice;
@@ -70,31 +204,96 @@ inline void posix::give_advice() {
 #endif // __MACH__
 }
 
-inline void posix::read_i(void * data, memory_size_type size) {
-	do {
-		memory_offset_type bytesRead = ::read(m_fd, data, size);
-		if (bytesRead == -1)
+inline void posix::pread_all(int fd, void * data, memory_size_type size, stream_size_type offset) {
+	while (size != 0) {
+		memory_offset_type bytesRead = ::pread(fd, data, size, offset);
+		if (bytesRead == -1) {
+			if (errno == EINTR) continue;
 			throw_errno();
+		}
+		if (bytesRead == 0) throw io_exception("Unexpected end of file");
 		data = static_cast<char *>(data) + bytesRead;
 		size -= bytesRead;
+		offset += bytesRead;
 		increment_bytes_read(bytesRead);
-	} while (size != 0);
+	}
 }
 
-inline void posix::write_i(const void * data, memory_size_type size) {
-	do {
-		ssize_t res = ::write(m_fd, data, size);
+inline void posix::pwrite_all(int fd, const void * data, memory_size_type size, stream_size_type offset) {
+	while (size != 0) {
+		ssize_t res = ::pwrite(fd, data, size, offset);
 		if(res == -1) {
+			if (errno == EINTR) continue;
 			throw_errno();
 		}
 		data = static_cast<const char*>(data) + res;
 		size -= res;
+		offset += res;
 		increment_bytes_written(res);
-	} while(size != 0);
+	}
+}
+
+inline void posix::pread_i(void * data, memory_size_type size, stream_size_type offset) {
+	const memory_size_type direct = direct_bytes(data, size, offset);
+	if (direct != 0)
+		pread_all(m_directFd.load(), data, direct, offset);
+	if (direct != size) {
+		pread_all(m_fd, static_cast<char *>(data) + direct, size - direct, offset + direct);
+		drop_read(offset + direct, size - direct);
+	}
+}
+
+inline void posix::pwrite_i(const void * data, memory_size_type size, stream_size_type offset) {
+	const memory_size_type direct = direct_bytes(data, size, offset);
+	if (direct != 0)
+		pwrite_all(m_directFd.load(), data, direct, offset);
+	if (direct != size) {
+		pwrite_all(m_fd, static_cast<const char *>(data) + direct, size - direct, offset + direct);
+		drop_written(offset + direct, size - direct);
+	}
+}
+
+inline void posix::read_i(void * data, memory_size_type size) {
+	pread_i(data, size, m_offset);
+	m_offset += size;
+}
+
+inline void posix::write_i(const void * data, memory_size_type size) {
+	pwrite_i(data, size, m_offset);
+	m_offset += size;
+}
+
+inline void posix::seek_i(stream_size_type offset) {
+	m_offset = offset;
+}
+
+inline const char * posix::map_i(memory_size_type length) {
+	unmap_i();
+	if (length == 0) return 0;
+	void * map = ::mmap(0, length, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED) return 0;
+#ifndef __MACH__
+	switch (m_cacheHint) {
+		case access_sequential:
+			::madvise(map, length, MADV_SEQUENTIAL);
+			break;
+		case access_random:
+			::madvise(map, length, MADV_RANDOM);
+			break;
+		default:
+			break;
+	}
+#endif // __MACH__
+	m_map = map;
+	m_mapLength = length;
+	return static_cast<const char *>(map);
 }
 
-inline void posix::seek_i(stream_size_type size) {
-	if (::lseek(m_fd, size, SEEK_SET) == -1) throw_errno();
+inline void posix::unmap_i() {
+	if (m_map == 0) return;
+	::munmap(m_map, m_mapLength);
+	m_map = 0;
+	m_mapLength = 0;
 }
 
 inline stream_size_type posix::file_size_i() {
@@ -105,12 +304,22 @@ inline stream_size_type posix::file_size_i() {
 }
 
 void posix::_open(const std::string & path, int flags, mode_t mode = 0755) {
+	m_offset = 0;
+	m_writtenBegin = 0;
+	m_writtenEnd = 0;
 	m_fd = ::open(path.c_str(), flags, mode);
 	if (m_fd == -1) {
 		return;
 	}
 	get_file_manager().increment_open_file_count();
 	give_advice();
+#ifdef O_DIRECT
+	if (m_directIO) {
+		m_path = path;
+		m_directFlags = flags & ~(O_CREAT | O_TRUNC);
+		m_directFd = unopened_fd;
+	}
+#endif // O_DIRECT
 }
 
 void posix::open_wo(const std::string & path) {
@@ -119,7 +328,9 @@ void posix::open_wo(const std::string & path) {
 }
 
 void posix::open_ro(const std::string & path) {
-	_open(path, O_RDONLY);
+	// Without write access we cannot punch holes, but we can still read.
+	if (m_punchHoles) _open(path, O_RDWR);
+	if (m_fd == -1) _open(path, O_RDONLY);
 	if (m_fd == -1) throw_errno(path);
 }
 
@@ -141,8 +352,53 @@ bool posix::is_open() const {
 	return m_fd != -1;
 }
 
+void posix::preallocate_i(stream_size_type bytes) {
+	if (m_fd == -1 || bytes == m_preallocated) return;
+	if (bytes < m_preallocated) {
+		release_preallocation();
+		return;
+	}
+#ifdef FALLOC_FL_KEEP_SIZE
+	// Only the space beyond the file and the earlier preallocation is new.
+	const stream_size_type allocated = std::max(m_preallocated, file_size_i());
+	if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(bytes)) == 0) {
+		if (bytes > allocated) increment_bytes_preallocated(bytes - allocated);
+		m_preallocated = bytes;
+	}
+#endif
+}
+
+stream_size_type posix::punch_hole_i(stream_size_type begin, stream_size_type end) {
+	stream_size_type first = (begin + block_alignment - 1) / block_alignment * block_alignment;
+	stream_size_type last = end / block_alignment * block_alignment;
+	if (m_fd == -1 || last <= first) return begin;
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+	if (::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+					static_cast<off_t>(first), static_cast<off_t>(last - first)) == 0)
+		return last;
+#endif
+	return begin;
+}
+
+void posix::release_preallocation() {
+	if (m_preallocated == 0) return;
+	m_preallocated = 0;
+	// Truncating to the current size frees the blocks allocated beyond the
+	// end of the file, which punching a hole does not on ext4.
+	struct stat buf;
+	if (::fstat(m_fd, &buf) == 0 && ::ftruncate(m_fd, buf.st_size) == 0) return;
+	// The file is read-only or gone; the space is released with the file.
+}
+
 void posix::close_i() {
+	unmap_i();
+	const int directFd = m_directFd.exchange(-1);
+	if (directFd >= 0) {
+		get_file_manager().decrement_open_file_count();
+		if (::close(directFd) == -1) throw_errno();
+	}
 	if (m_fd == -1) return;
+	release_preallocation();
 	if (::close(m_fd) == -1) throw_errno();
 	get_file_manager().decrement_open_file_count();
 	m_fd = -1;
@@ -150,6 +406,8 @@ void posix::close_i() {
 
 void posix::truncate_i(stream_size_type bytes) {
 	if (ftruncate(m_fd, bytes) == -1) throw_errno();
+	// Blocks preallocated beyond a smaller size are freed by the truncate.
+	if (bytes < m_preallocated) m_preallocated = 0;
 }
 
 }
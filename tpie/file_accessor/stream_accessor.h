@@ -25,6 +25,13 @@
 namespace tpie {
 namespace file_accessor {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Reads and writes blocks with positional I/O.
+///
+/// With the posix accessor, read_block does not change the state of the
+/// stream_accessor, so several threads may read blocks through the same
+/// open stream_accessor, e.g. to scan disjoint parts of a file in parallel.
+///////////////////////////////////////////////////////////////////////////////
 template <typename file_accessor_t>
 class stream_accessor : public stream_accessor_base<file_accessor_t> {
 public:
@@ -33,27 +40,35 @@ public:
 										memory_size_type itemCount) override
 	{
 		stream_size_type loc = this->header_size() + blockNumber*this->block_size();
-		this->m_fileAccessor.seek_i(loc);
 		stream_size_type offset = blockNumber*this->block_items();
 		if (offset + itemCount > this->size()) itemCount = static_cast<memory_size_type>(this->size() - offset);
 		memory_size_type z=itemCount*this->item_size();
-		this->m_fileAccessor.read_i(data, z);
+		ptime t1 = ptime::now();
+		this->m_fileAccessor.pread_i(data, z, loc);
+		this->m_ioStats.add_read(z, z, ptime::seconds(t1, ptime::now()));
 		return itemCount;
 	}
 
 	virtual void write_block(const void * data,
 							 stream_size_type blockNumber,
 							 memory_size_type itemCount) override
+	{
+		write_block_data(data, blockNumber, itemCount);
+		this->grow_to_block(blockNumber, itemCount);
+	}
+
+	virtual void write_block_data(const void * data,
+								  stream_size_type blockNumber,
+								  memory_size_type itemCount) override
 	{
 		stream_size_type loc = this->header_size() + blockNumber*this->block_size();
-		// Here, we may seek beyond the file size.
-		// However, lseek(2) specifies that the file will be padded with zeroes in this case,
+		// Here, we may write beyond the file size.
+		// However, pwrite(2) specifies that the file will be padded with zeroes in this case,
 		// and on Windows, the file is padded with arbitrary garbage (which is ok).
-		this->m_fileAccessor.seek_i(loc);
-		stream_size_type offset = blockNumber*this->block_items();
 		memory_size_type z=itemCount*this->item_size();
-		this->m_fileAccessor.write_i(data, z);
-		if (offset+itemCount > this->size()) this->set_size(offset+itemCount);
+		ptime t1 = ptime::now();
+		this->m_fileAccessor.pwrite_i(data, z, loc);
+		this->m_ioStats.add_write(z, z, ptime::seconds(t1, ptime::now()));
 	}
 };
 
@@ -26,10 +26,17 @@
 
 #include <tpie/stream_header.h>
 #include <tpie/cache_hint.h>
+#include <tpie/stats.h>
 
 namespace tpie {
 namespace file_accessor {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Alignment in bytes of blocks in stream files and of the buffers
+/// they are read into, as required for direct I/O.
+///////////////////////////////////////////////////////////////////////////////
+constexpr memory_size_type block_alignment = 4096;
+
 template <typename file_accessor_t>
 class stream_accessor_base {
 private:
@@ -42,6 +49,9 @@ private:
 protected:
 	file_accessor_t m_fileAccessor;
 
+	/** Blocks read and written through this accessor. */
+	io_stats m_ioStats;
+
 private:
 	/** Number of logical items in stream. */
 	stream_size_type m_size;
@@ -70,6 +80,12 @@ private:
 	/** Whether compression is used. */
 	bool m_useCompression;
 
+	/** Whether the blocks of a compressed stream carry checksums. */
+	bool m_useChecksums;
+
+	/** Whether a new compressed file should have block checksums. */
+	bool m_checksumsRequested;
+
 	/** Path of the file currently opened. */
 	std::string m_path;
 
@@ -88,7 +104,7 @@ protected:
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Returns the boundary on which we align blocks.
 	///////////////////////////////////////////////////////////////////////////
-	inline memory_size_type boundary() const { return 4096; }
+	inline memory_size_type boundary() const { return block_alignment; }
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Given a memory offset, rounds up to the nearest alignment
@@ -112,6 +128,8 @@ public:
 	inline stream_accessor_base()
 		: m_open(false)
 		, m_write(false)
+		, m_useChecksums(false)
+		, m_checksumsRequested(false)
 	{
 	}
 
@@ -131,6 +149,24 @@ public:
 
 	inline void close();
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Bypass the page cache for block reads and writes in the next
+	/// file opened, if the file accessor supports it.
+	///////////////////////////////////////////////////////////////////////////
+	void set_direct_io(bool directIO) {m_fileAccessor.set_direct_io(directIO);}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Allow punching holes in the next file opened, even if it is
+	/// opened for reading only; see posix::set_punch_holes.
+	///////////////////////////////////////////////////////////////////////////
+	void set_punch_holes(bool punchHoles) {m_fileAccessor.set_punch_holes(punchHoles);}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Store block checksums if the next file opened is created as a
+	/// compressed stream. Existing files keep the format in their header.
+	///////////////////////////////////////////////////////////////////////////
+	void set_checksums(bool checksums) {m_checksumsRequested = checksums;}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Read the given number of items from the given block into the
 	/// given buffer.
@@ -153,6 +189,39 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	virtual void write_block(const void * data, stream_size_type blockNumber, memory_size_type itemCount) = 0;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Write a block like write_block, but without updating size().
+	///
+	/// Used to write blocks in a background thread, see write_behind. The
+	/// stream updates the size with grow_to_block in its own thread, so
+	/// that only one thread touches the size.
+	///////////////////////////////////////////////////////////////////////////
+	virtual void write_block_data(const void * data, stream_size_type blockNumber, memory_size_type itemCount) = 0;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Update size() as if the given block was written.
+	///////////////////////////////////////////////////////////////////////////
+	void grow_to_block(stream_size_type blockNumber, memory_size_type itemCount) {
+		stream_size_type end = blockNumber*m_blockItems + itemCount;
+		if (end > m_size) m_size = end;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Undo grow_to_block for blocks that were not written.
+	///////////////////////////////////////////////////////////////////////////
+	void shrink_to(stream_size_type size) {
+		if (size < m_size) m_size = size;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Preallocate disk space for a stream of the given number of
+	/// items; see posix::preallocate_i.
+	///////////////////////////////////////////////////////////////////////////
+	void reserve(stream_size_type items) {
+		stream_size_type blocks = (items + m_blockItems - 1) / m_blockItems;
+		m_fileAccessor.preallocate_i(header_size() + blocks * m_blockSize);
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Read user data into the given buffer.
 	/// \param data Buffer in which to store user data.
@@ -207,11 +276,36 @@ public:
 
 	inline void truncate(stream_size_type items);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Map the blocks of a file opened for reading into memory.
+	///
+	/// Block b starts block_size()*b bytes after the returned pointer. The
+	/// mapping covers the blocks that exist when this is called and is
+	/// released when the file is closed.
+	///
+	/// \returns The start of block 0, or 0 if the file accessor does not
+	/// support mapping or the stream is empty.
+	///////////////////////////////////////////////////////////////////////////
+	const char * map_blocks() {
+		if (m_size == 0) return 0;
+		const char * map = m_fileAccessor.map_i(static_cast<memory_size_type>(byte_size()));
+		if (map == 0) return 0;
+		return map + header_size();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The counters of the blocks read and written through this
+	/// accessor, kept across files opened.
+	///////////////////////////////////////////////////////////////////////////
+	io_stats & stats() { return m_ioStats; }
+
 	void set_last_block_read_offset(stream_size_type n) { m_lastBlockReadOffset = n; }
 	stream_size_type get_last_block_read_offset() { return m_lastBlockReadOffset; }
 
 	bool get_compressed() { return m_useCompression; }
 
+	bool get_checksums() { return m_useChecksums; }
+
 	int get_compression_flags() { return m_compressionFlags; }
 };
 
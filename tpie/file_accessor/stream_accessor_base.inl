@@ -35,14 +35,14 @@ namespace file_accessor {
 template <typename file_accessor_t>
 void stream_accessor_base<file_accessor_t>::read_header() {
 	stream_header_t header;
-	m_fileAccessor.seek_i(0);
-	m_fileAccessor.read_i(&header, sizeof(header));
+	m_fileAccessor.pread_i(&header, sizeof(header), 0);
 	validate_header(header);
 	m_size = header.size;
 	m_userDataSize = (size_t)header.userDataSize;
 	m_maxUserDataSize = (size_t)header.maxUserDataSize;
 	m_lastBlockReadOffset = header.lastBlockReadOffset;
 	m_useCompression = header.get_compressed();
+	m_useChecksums = header.get_checksums();
 }
 
 template <typename file_accessor_t>
@@ -50,16 +50,14 @@ void stream_accessor_base<file_accessor_t>::write_header(bool clean) {
 	stream_header_t header;
 	memset(&header, 0, sizeof(header));
 	fill_header(header, clean);
-	m_fileAccessor.seek_i(0);
-	m_fileAccessor.write_i(&header, sizeof(header));
+	m_fileAccessor.pwrite_i(&header, sizeof(header), 0);
 }
 
 template <typename file_accessor_t>
 memory_size_type stream_accessor_base<file_accessor_t>::read_user_data(void * data, memory_size_type count) {
 	if (count > m_userDataSize) count = m_userDataSize;
 	if (count) {
-		m_fileAccessor.seek_i(sizeof(stream_header_t));
-		m_fileAccessor.read_i(data, count);
+		m_fileAccessor.pread_i(data, count, sizeof(stream_header_t));
 	}
 	return count;
 }
@@ -69,8 +67,7 @@ void stream_accessor_base<file_accessor_t>::write_user_data(const void * data, m
 	if (count > m_maxUserDataSize)
 		throw stream_exception("Tried to write more user data than stream allows");
 	if (count) {
-		m_fileAccessor.seek_i(sizeof(stream_header_t));
-		m_fileAccessor.write_i(data, count);
+		m_fileAccessor.pwrite_i(data, count, sizeof(stream_header_t));
 	}
 	m_userDataSize = count;
 }
@@ -80,9 +77,16 @@ void stream_accessor_base<file_accessor_t>::validate_header(const stream_header_
 	if (header.magic != stream_header_t::magicConst)
 		throw invalid_file_exception("Invalid file, header magic wrong");
 
-	if (header.version != stream_header_t::versionConst)
+	if (header.version < stream_header_t::oldestVersionConst
+		|| header.version > stream_header_t::versionConst)
 		throw invalid_file_exception("Invalid file, header version wrong");
 
+	if (header.flags & ~stream_header_t::knownFlagsMask)
+		throw invalid_file_exception("Invalid file, unknown header flags");
+
+	if (header.get_checksums() && header.version < stream_header_t::versionConst)
+		throw invalid_file_exception("Invalid file, checksums in old version");
+
 	if (header.itemSize != m_itemSize)
 		throw invalid_file_exception("Invalid file, item size is wrong");
 
@@ -99,7 +103,9 @@ void stream_accessor_base<file_accessor_t>::validate_header(const stream_header_
 template <typename file_accessor_t>
 void stream_accessor_base<file_accessor_t>::fill_header(stream_header_t & header, bool clean) {
 	header.magic = stream_header_t::magicConst;
-	header.version = stream_header_t::versionConst;
+	header.version = m_useChecksums
+		? stream_header_t::versionConst
+		: stream_header_t::oldestVersionConst;
 	header.itemSize = m_itemSize;
 	header.blockSize = m_blockSize;
 	header.set_clean_close(clean);
@@ -108,6 +114,7 @@ void stream_accessor_base<file_accessor_t>::fill_header(stream_header_t & header
 	header.size = m_size;
 	header.lastBlockReadOffset = m_lastBlockReadOffset;
 	header.set_compressed(m_useCompression);
+	header.set_checksums(m_useChecksums);
 }
 
 template <typename file_accessor_t>
@@ -131,6 +138,7 @@ void stream_accessor_base<file_accessor_t>::open(const std::string & path,
 	m_fileAccessor.set_cache_hint(cacheHint);
 	m_compressionFlags = compressionFlags;
 	m_useCompression = compressionFlags != compression_scheme::none;
+	m_useChecksums = m_useCompression && m_checksumsRequested;
 	m_lastBlockReadOffset = std::numeric_limits<stream_size_type>::max();
 	if (!write && !read)
 		throw invalid_argument_exception("Either read or write must be specified");
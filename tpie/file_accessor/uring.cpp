@@ -0,0 +1,365 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/file_accessor/uring.h>
+
+#ifdef TPIE_HAS_IO_URING
+
+#include <tpie/exception.h>
+#include <tpie/file_manager.h>
+#include <tpie/memory.h>
+#include <tpie/stats.h>
+#include <tpie/tpie_log.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+namespace tpie {
+namespace file_accessor {
+
+uring::uring()
+	: m_lastReadEnd(std::numeric_limits<stream_size_type>::max())
+	, m_prefetchOffset(0)
+	, m_noRing(false)
+	, m_writeError(0)
+	, m_ringFd(-1)
+	, m_sqRing(MAP_FAILED)
+	, m_cqRing(MAP_FAILED)
+	, m_sqRingSize(0)
+	, m_cqRingSize(0)
+	, m_sqes(MAP_FAILED)
+	, m_sqesSize(0)
+{
+}
+
+uring::~uring() {
+	try {
+		close_i();
+	} catch (std::exception & e) {
+		log_error() << "Error closing file in uring::~uring: " << e.what() << std::endl;
+	}
+}
+
+bool uring::setup_ring() {
+	if (m_ringFd != -1) return true;
+	if (m_noRing) return false;
+
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = static_cast<int>(::syscall(__NR_io_uring_setup, queue_depth, &p));
+	if (fd < 0) {
+		m_noRing = true;
+		return false;
+	}
+	m_ringFd = fd;
+	get_file_manager().increment_open_file_count();
+
+	m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	const bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap)
+		m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+	m_sqRing = ::mmap(0, m_sqRingSize, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (m_sqRing != MAP_FAILED) {
+		m_cqRing = singleMap
+			? m_sqRing
+			: ::mmap(0, m_cqRingSize, PROT_READ | PROT_WRITE,
+					 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	}
+	if (m_cqRing != MAP_FAILED) {
+		m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+		m_sqes = ::mmap(0, m_sqesSize, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	}
+	if (m_sqes == MAP_FAILED) {
+		teardown_ring();
+		m_noRing = true;
+		return false;
+	}
+
+	char * sq = static_cast<char *>(m_sqRing);
+	char * cq = static_cast<char *>(m_cqRing);
+	m_sqTail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+	m_sqMask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+	m_sqArray = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+	m_cqHead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+	m_cqTail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+	m_cqMask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+	m_cqes = cq + p.cq_off.cqes;
+	return true;
+}
+
+void uring::teardown_ring() {
+	if (m_sqes != MAP_FAILED) ::munmap(m_sqes, m_sqesSize);
+	if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) ::munmap(m_cqRing, m_cqRingSize);
+	if (m_sqRing != MAP_FAILED) ::munmap(m_sqRing, m_sqRingSize);
+	if (m_ringFd != -1) {
+		::close(m_ringFd);
+		get_file_manager().decrement_open_file_count();
+	}
+	m_sqes = m_cqRing = m_sqRing = MAP_FAILED;
+	m_ringFd = -1;
+	for (memory_size_type i = 0; i < queue_depth; ++i) {
+		request & r = m_requests[i];
+		if (r.buffer) tpie_delete_array(r.buffer, r.capacity);
+		r = request();
+	}
+}
+
+void uring::submit(request & r) {
+	const unsigned tail = *m_sqTail;
+	const unsigned index = tail & *m_sqMask;
+	io_uring_sqe & sqe = static_cast<io_uring_sqe *>(m_sqes)[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = r.write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe.fd = m_fd;
+	sqe.addr = reinterpret_cast<unsigned long>(r.buffer);
+	sqe.len = static_cast<unsigned>(r.size);
+	sqe.off = r.offset;
+	sqe.user_data = static_cast<unsigned long long>(&r - m_requests);
+	m_sqArray[index] = index;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	while (::syscall(__NR_io_uring_enter, m_ringFd, 1, 0, 0, NULL, 0) < 0) {
+		if (errno == EINTR) continue;
+		// The kernel only reads the submission queue in io_uring_enter,
+		// so we can take the entry back.
+		__atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+		r.used = false;
+		throw_errno();
+	}
+	r.pending = true;
+}
+
+void uring::complete_one() {
+	while (true) {
+		const unsigned head = *m_cqHead;
+		if (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+			const io_uring_cqe & cqe = static_cast<io_uring_cqe *>(m_cqes)[head & *m_cqMask];
+			request & r = m_requests[cqe.user_data];
+			r.result = cqe.res;
+			r.pending = false;
+			__atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+			if (r.write) finish_write(r);
+			return;
+		}
+		if (::syscall(__NR_io_uring_enter, m_ringFd, 0, 1,
+					  IORING_ENTER_GETEVENTS, NULL, 0) < 0
+			&& errno != EINTR)
+			throw_errno();
+	}
+}
+
+void uring::wait(request & r) {
+	while (r.pending) complete_one();
+}
+
+void uring::finish_write(request & r) {
+	r.used = false;
+	if (r.result < 0) {
+		if (m_writeError == 0) m_writeError = static_cast<int>(-r.result);
+		return;
+	}
+	memory_size_type written = static_cast<memory_size_type>(r.result);
+	increment_bytes_written(written);
+	if (written < r.size)
+		posix::pwrite_i(r.buffer + written, r.size - written, r.offset + written);
+}
+
+void uring::flush_writes() {
+	for (memory_size_type i = 0; i < queue_depth; ++i)
+		if (m_requests[i].used && m_requests[i].write) wait(m_requests[i]);
+	if (m_writeError != 0) {
+		errno = m_writeError;
+		m_writeError = 0;
+		throw_errno();
+	}
+}
+
+void uring::discard_reads() {
+	for (memory_size_type i = 0; i < queue_depth; ++i) {
+		request & r = m_requests[i];
+		if (r.used && !r.write) {
+			wait(r);
+			r.used = false;
+		}
+	}
+	m_prefetchOffset = 0;
+}
+
+uring::request * uring::find_read(stream_size_type offset, memory_size_type size) {
+	for (memory_size_type i = 0; i < queue_depth; ++i) {
+		request & r = m_requests[i];
+		if (r.used && !r.write && r.offset == offset && r.size >= size)
+			return &r;
+	}
+	return 0;
+}
+
+uring::request * uring::free_request(bool write) {
+	while (true) {
+		for (memory_size_type i = 0; i < queue_depth; ++i)
+			if (!m_requests[i].used) return &m_requests[i];
+		// Reads in flight are only worth waiting for by the reader.
+		if (!write) return 0;
+		complete_one();
+	}
+}
+
+void uring::reserve(request & r, memory_size_type size) {
+	if (r.capacity >= size) return;
+	if (r.buffer) tpie_delete_array(r.buffer, r.capacity);
+	r.buffer = 0;
+	r.capacity = 0;
+	r.buffer = tpie_new_array<char>(size);
+	r.capacity = size;
+}
+
+void uring::prefetch(memory_size_type size) {
+	m_prefetchOffset = std::max(m_prefetchOffset, m_offset);
+	while (request * r = free_request(false)) {
+		reserve(*r, size);
+		r->write = false;
+		r->offset = m_prefetchOffset;
+		r->size = size;
+		r->used = true;
+		submit(*r);
+		m_prefetchOffset += size;
+	}
+}
+
+void uring::read_i(void * data, memory_size_type size) {
+	if (!setup_ring()) {
+		posix::pread_i(data, size, m_offset);
+		m_offset += size;
+		return;
+	}
+	flush_writes();
+
+	request * r = find_read(m_offset, size);
+	if (r) {
+		wait(*r);
+		r->used = false;
+		if (r->result < 0) {
+			errno = static_cast<int>(-r->result);
+			discard_reads();
+			throw_errno();
+		}
+		memory_size_type got = std::min(static_cast<memory_size_type>(r->result), size);
+		memcpy(data, r->buffer, got);
+		increment_bytes_read(got);
+		if (got < size)
+			posix::pread_i(static_cast<char *>(data) + got, size - got, m_offset + got);
+	} else {
+		discard_reads();
+		posix::pread_i(data, size, m_offset);
+	}
+
+	const bool sequential = m_offset == m_lastReadEnd;
+	m_offset += size;
+	m_lastReadEnd = m_offset;
+	if (sequential && m_cacheHint != access_random) prefetch(size);
+}
+
+void uring::write_i(const void * data, memory_size_type size) {
+	if (!setup_ring()) {
+		posix::pwrite_i(data, size, m_offset);
+		m_offset += size;
+		return;
+	}
+	discard_reads();
+
+	// Writes in flight may complete in any order, so wait for those that
+	// overlap this one.
+	for (memory_size_type i = 0; i < queue_depth; ++i) {
+		request & o = m_requests[i];
+		if (o.used && o.write
+			&& o.offset < m_offset + size && m_offset < o.offset + o.size)
+			wait(o);
+	}
+	if (m_writeError != 0) flush_writes();
+
+	request * r = free_request(true);
+	reserve(*r, size);
+	memcpy(r->buffer, data, size);
+	r->write = true;
+	r->offset = m_offset;
+	r->size = size;
+	r->used = true;
+	submit(*r);
+	m_offset += size;
+}
+
+void uring::seek_i(stream_size_type offset) {
+	m_offset = offset;
+}
+
+void uring::pread_i(void * data, memory_size_type size, stream_size_type offset) {
+	seek_i(offset);
+	read_i(data, size);
+}
+
+void uring::pwrite_i(const void * data, memory_size_type size, stream_size_type offset) {
+	seek_i(offset);
+	write_i(data, size);
+}
+
+stream_size_type uring::file_size_i() {
+	if (m_ringFd != -1) flush_writes();
+	return posix::file_size_i();
+}
+
+void uring::truncate_i(stream_size_type bytes) {
+	if (m_ringFd != -1) {
+		flush_writes();
+		discard_reads();
+	}
+	posix::truncate_i(bytes);
+}
+
+void uring::close_i() {
+	if (m_fd == -1) return;
+	if (m_ringFd != -1) {
+		try {
+			flush_writes();
+			discard_reads();
+		} catch (...) {
+			teardown_ring();
+			posix::close_i();
+			throw;
+		}
+		teardown_ring();
+	}
+	m_offset = 0;
+	m_lastReadEnd = std::numeric_limits<stream_size_type>::max();
+	m_prefetchOffset = 0;
+	posix::close_i();
+}
+
+}
+}
+
+#endif // TPIE_HAS_IO_URING
@@ -0,0 +1,168 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file uring.h  io_uring file accessor for Linux
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _TPIE_FILE_ACCESSOR_URING_H
+#define _TPIE_FILE_ACCESSOR_URING_H
+
+#include <tpie/config.h>
+
+#ifdef TPIE_HAS_IO_URING
+
+#include <tpie/tpie_export.h>
+#include <tpie/file_accessor/posix.h>
+
+namespace tpie {
+namespace file_accessor {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief File accessor that submits reads and writes through io_uring.
+///
+/// Opening and closing files is done as in the posix accessor. Each open
+/// file gets its own submission ring with queue_depth requests:
+///
+/// - write_i copies the data to a request buffer, submits the write and
+///   returns without waiting for it to complete. Errors are reported by a
+///   later call.
+/// - When reads are sequential, read_i submits reads of the following
+///   ranges of the same size, so the next calls are served from requests
+///   that are already in flight.
+///
+/// Reads wait for all writes in flight, and writes discard the reads in
+/// flight, so the accessor behaves like posix to its user.
+///
+/// If the kernel does not allow io_uring (e.g. in a restricted container),
+/// the accessor falls back to pread and pwrite.
+///
+/// The request buffers are allocated with tpie_new_array and are thus
+/// counted by the memory manager; see memory_usage(). They are not included
+/// in the memory_usage of the streams, so when TPIE is built with
+/// TPIE_DEFAULT_IO_URING, each open stream may use up to memory_usage() more
+/// than the sorters plan for.
+///////////////////////////////////////////////////////////////////////////////
+class TPIE_EXPORT uring: public posix {
+public:
+	static const memory_size_type queue_depth = 4;
+
+	uring();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Close the file. An error from writes still in flight is
+	/// logged; call close_i() first to get it.
+	///////////////////////////////////////////////////////////////////////////
+	~uring();
+
+	uring(const uring &) = delete;
+	uring & operator=(const uring &) = delete;
+
+	void read_i(void * data, memory_size_type size);
+	void write_i(const void * data, memory_size_type size);
+	void seek_i(stream_size_type offset);
+	stream_size_type file_size_i();
+	void close_i();
+	void truncate_i(stream_size_type bytes);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Seek and read. Unlike posix::pread_i, this is not safe to call
+	/// concurrently, since it shares the requests in flight.
+	///////////////////////////////////////////////////////////////////////////
+	void pread_i(void * data, memory_size_type size, stream_size_type offset);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Seek and write; not safe to call concurrently.
+	///////////////////////////////////////////////////////////////////////////
+	void pwrite_i(const void * data, memory_size_type size, stream_size_type offset);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Direct I/O is not supported, since the request buffers are not
+	/// aligned; the page cache is always used.
+	///////////////////////////////////////////////////////////////////////////
+	void set_direct_io(bool) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Memory used by the request buffers when reading and writing
+	/// chunks of the given size, e.g. the block size of a stream.
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr memory_size_type memory_usage(memory_size_type chunkSize) {
+		return queue_depth * chunkSize;
+	}
+
+private:
+	struct request {
+		char * buffer = 0;
+		memory_size_type capacity = 0;
+		stream_size_type offset = 0;
+		memory_size_type size = 0;
+		bool write = false;
+		/** The request holds a write in flight or a read not yet consumed. */
+		bool used = false;
+		/** The request has been submitted and has not completed. */
+		bool pending = false;
+		long long result = 0;
+	};
+
+	bool setup_ring();
+	void teardown_ring();
+	void submit(request & r);
+	void complete_one();
+	void wait(request & r);
+	void finish_write(request & r);
+	void flush_writes();
+	void discard_reads();
+	void prefetch(memory_size_type size);
+	request * find_read(stream_size_type offset, memory_size_type size);
+	request * free_request(bool write);
+	void reserve(request & r, memory_size_type size);
+
+	/** Offset following the last read, used to detect sequential reads. */
+	stream_size_type m_lastReadEnd;
+	/** Offset of the next range to read ahead. */
+	stream_size_type m_prefetchOffset;
+	/** Whether setting up the ring has failed, so we use pread/pwrite. */
+	bool m_noRing;
+	/** Error from a write that has completed since the last call. */
+	int m_writeError;
+
+	int m_ringFd;
+	void * m_sqRing;
+	void * m_cqRing;
+	size_t m_sqRingSize;
+	size_t m_cqRingSize;
+	void * m_sqes;
+	size_t m_sqesSize;
+	unsigned * m_sqTail;
+	unsigned * m_sqMask;
+	unsigned * m_sqArray;
+	unsigned * m_cqHead;
+	unsigned * m_cqTail;
+	unsigned * m_cqMask;
+	void * m_cqes;
+
+	request m_requests[queue_depth];
+};
+
+}
+}
+
+#endif // TPIE_HAS_IO_URING
+
+#endif //_TPIE_FILE_ACCESSOR_URING_H
@@ -62,8 +62,48 @@ public:
 	inline void truncate_i(stream_size_type bytes);
 	inline bool is_open() const;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Read from the given file offset, passed in an OVERLAPPED
+	/// structure so that the handle may be shared between threads.
+	///////////////////////////////////////////////////////////////////////////
+	inline void pread_i(void * data, memory_size_type size, stream_size_type offset);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Write at the given file offset.
+	///////////////////////////////////////////////////////////////////////////
+	inline void pwrite_i(const void * data, memory_size_type size, stream_size_type offset);
+
 	inline void set_cache_hint(cache_hint cacheHint);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Memory mapping is not supported; returns 0 so that callers
+	/// read the file instead.
+	///////////////////////////////////////////////////////////////////////////
+	inline const char * map_i(memory_size_type) {return 0;}
+
+	inline void unmap_i() {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Direct I/O is not supported, since FILE_FLAG_NO_BUFFERING
+	/// requires every read and write to be aligned; the file cache is always
+	/// used.
+	///////////////////////////////////////////////////////////////////////////
+	inline void set_direct_io(bool) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Preallocation is not implemented; NTFS allocates clusters as
+	/// the file grows.
+	///////////////////////////////////////////////////////////////////////////
+	inline void preallocate_i(stream_size_type) {}
+
+	inline void set_punch_holes(bool) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Punching holes is not implemented, since it requires sparse
+	/// files; nothing is freed.
+	///////////////////////////////////////////////////////////////////////////
+	inline stream_size_type punch_hole_i(stream_size_type begin, stream_size_type) {return begin;}
+
 private:
 	inline void _open(const std::string & path, DWORD access, DWORD create_mode);
 };
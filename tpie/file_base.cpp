@@ -36,12 +36,25 @@ file_base::file_base(memory_size_type itemSize,
 }
 
 
+namespace {
+
+// The block_t is stored after the item data, which is padded to the
+// alignment of block_t.
+memory_size_type padded_size(memory_size_type bytes, memory_size_type alignment) {
+	return (bytes + alignment - 1) / alignment * alignment;
+}
+
+} // unnamed namespace
+
 void file_base::create_block() {
 	// alloc heap block
-	block_t * block = reinterpret_cast<block_t*>( tpie_new_array<char>(sizeof(block_t) + m_itemSize*m_blockItems) );
+	const memory_size_type dataSize = padded_size(m_itemSize*m_blockItems, alignof(block_t));
+	char * storage = tpie_new_aligned_array<char>(dataSize + sizeof(block_t),
+												  file_accessor::block_alignment);
 
 	// call ctor
-	new (block) block_t();
+	block_t * block = new (storage + dataSize) block_t();
+	block->data = storage;
 
 	// push to intrusive list
 	m_free.push_front(*block);
@@ -56,10 +69,13 @@ void file_base::delete_block() {
 	m_free.pop_front();
 
 	// call dtor
+	char * storage = block->data;
 	block->~block_t();
 
 	// dealloc
-	tpie_delete_array<char>(reinterpret_cast<char*>(block), sizeof(block_t) + m_itemSize*m_blockItems);
+	tpie_delete_aligned_array<char>(storage,
+									padded_size(m_itemSize*m_blockItems, alignof(block_t)) + sizeof(block_t),
+									file_accessor::block_alignment);
 }
 
 
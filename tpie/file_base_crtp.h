@@ -126,6 +126,7 @@ public:
 	void read_user_data(TT & data) {
 		assert(m_open);
 		if (sizeof(TT) != user_data_size()) throw io_exception("Wrong user data size");
+		self().cancel_read_ahead();
 		m_fileAccessor->read_user_data(reinterpret_cast<void*>(&data), sizeof(TT));
 	}
 
@@ -138,6 +139,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	memory_size_type read_user_data(void * data, memory_size_type count) {
 		assert(m_open);
+		self().cancel_read_ahead();
 		return m_fileAccessor->read_user_data(data, count);
 	}
 
@@ -153,6 +155,7 @@ public:
 	void write_user_data(const TT & data) {
 		assert(m_open);
 		if (sizeof(TT) > max_user_data_size()) throw io_exception("Wrong user data size");
+		self().cancel_read_ahead();
 		m_fileAccessor->write_user_data(reinterpret_cast<const void*>(&data), sizeof(TT));
 	}
 
@@ -167,6 +170,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void write_user_data(const void * data, memory_size_type count) {
 		assert(m_open);
+		self().cancel_read_ahead();
 		m_fileAccessor->write_user_data(data, count);
 	}
 
@@ -270,6 +274,35 @@ public:
 		return m_size;
 	}
 
+	/////////////////////////////////////////////////////////////////////////
+	/// \brief Hint that the file will grow to the given number of items.
+	///
+	/// Disk space for the items is allocated up front, so the file is not
+	/// fragmented as it grows block by block; see posix::preallocate_i.
+	/// Does nothing unless the file is open for writing.
+	/////////////////////////////////////////////////////////////////////////
+	inline void reserve(stream_size_type items) {
+		if (m_open && m_canWrite) m_fileAccessor->reserve(items);
+	}
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \brief The blocks read and written by this object, over all files
+	/// it has opened; see io_stats. Blocks mapped into memory are counted as
+	/// read when they are first used, with no time spent.
+	/////////////////////////////////////////////////////////////////////////
+	inline io_counters get_io_counters() const {
+		return m_fileAccessor->stats().get();
+	}
+
+	/////////////////////////////////////////////////////////////////////////
+	/// \brief Add the blocks read and written from now on to the given
+	/// io_stats as well, e.g. those of a pipelining node, or stop doing so
+	/// if it is null.
+	/////////////////////////////////////////////////////////////////////////
+	inline void set_io_stats_sink(std::shared_ptr<io_stats> sink) {
+		m_fileAccessor->stats().set_sink(std::move(sink));
+	}
+
 protected:
 	inline void open_inner(const std::string & path,
 						   access_type accessType,
@@ -278,6 +311,7 @@ protected:
 		m_canRead = accessType == access_read || accessType == access_read_write;
 		m_canWrite = accessType == access_write || accessType == access_read_write;
 		const bool preferCompression = false;
+		m_fileAccessor->set_direct_io(m_tempFile != NULL && get_direct_io());
 		m_fileAccessor->open(path, m_canRead, m_canWrite, m_itemSize,
 							 m_blockSize, userDataSize, cacheHint,
 							 preferCompression);
@@ -296,6 +330,13 @@ protected:
 
 	template <typename BT>
 	void read_block(BT & b, stream_size_type block);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Called before the file accessor is used outside of reading and
+	/// writing blocks. Children that read blocks in the background override
+	/// this to stop doing so.
+	///////////////////////////////////////////////////////////////////////////
+	void cancel_read_ahead() {}
 	void get_block_check(stream_size_type block);
 
 	memory_size_type m_blockItems;
@@ -17,6 +17,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with TPIE.  If not, see <http://www.gnu.org/licenses/>
 
+#include <tpie/config.h>
 #include <tpie/file_stream_base.h>
 #include <tpie/file_base_crtp.inl>
 #include <tpie/stream_crtp.inl>
@@ -27,6 +28,11 @@ file_stream_base::file_stream_base(memory_size_type itemSize,
 								   double blockFactor,
 								   file_accessor::file_accessor * fileAccessor):
 	file_base_crtp<file_stream_base>(itemSize, blockFactor, fileAccessor)
+	, m_cacheHint(access_sequential)
+	, m_readAheadBlocks(get_read_ahead_blocks())
+	, m_writeBehindBlocks(get_write_behind_blocks())
+	, m_useMmap(false)
+	, m_mapping(0)
 {
 	m_blockStartIndex = 0;
 	m_nextBlock = std::numeric_limits<stream_size_type>::max();
@@ -38,12 +44,103 @@ file_stream_base::file_stream_base(memory_size_type itemSize,
 
 void file_stream_base::get_block(stream_size_type block) {
 	get_block_check(block);
+	if (m_mapping != 0) {
+		// The file is read-only, so the block is never written through
+		// m_block.data.
+		m_block.number = block;
+		m_block.dirty = false;
+		m_block.size = static_cast<memory_size_type>(
+			std::min<stream_size_type>(m_blockItems, m_size - block * m_blockItems));
+		m_block.data = const_cast<char *>(m_mapping) + block * m_blockSize;
+		m_fileAccessor->stats().add_read(m_block.size * m_itemSize, m_block.size * m_itemSize, 0);
+		return;
+	}
+	if (m_readAhead) {
+		if (m_readAhead->fetch(block, m_block.data, m_block.size)) {
+			m_block.number = block;
+			m_block.dirty = false;
+			return;
+		}
+		// The read ahead may be reading other blocks through the file
+		// accessor.
+		cancel_read_ahead();
+	}
+	// The block may be waiting to be written. Blocks appended to the end of
+	// the stream are not read, so sequential writers do not wait here.
+	if (block * static_cast<stream_size_type>(m_blockItems) < m_size)
+		wait_for_writes();
 	read_block(m_block, block);
 }
 
+bool file_stream_base::write_behind_block() {
+#ifdef TPIE_DEFAULT_IO_URING
+	return false;
+#else
+	if (m_writeBehindBlocks == 0 || m_cacheHint != access_sequential
+		|| !job_manager_initialized())
+		return false;
+	if (!m_writeBehind)
+		m_writeBehind.reset(tpie_new<write_behind>(m_fileAccessor, m_itemSize,
+												   m_blockItems, m_writeBehindBlocks));
+	cancel_read_ahead();
+	update_vars();
+	// Queue the block before growing the file, so that the error of an
+	// earlier block is thrown before the size covers this one.
+	try {
+		m_writeBehind->write(m_block.data, m_block.number, m_block.size,
+							 m_fileAccessor->size());
+	} catch (...) {
+		discard_lost_writes();
+		throw;
+	}
+	m_fileAccessor->grow_to_block(m_block.number, m_block.size);
+	if (m_tempFile)
+		m_tempFile->update_recorded_size(m_fileAccessor->byte_size());
+	m_block.dirty = false;
+	return true;
+#endif
+}
+
+void file_stream_base::discard_lost_writes() {
+	stream_size_type o = offset();
+	stream_size_type size = std::min(m_size, m_writeBehind->lost_size());
+	// The current block follows the lost blocks, so it is discarded too.
+	m_block.dirty = false;
+	m_block.number = std::numeric_limits<stream_size_type>::max();
+	m_nextBlock = std::numeric_limits<stream_size_type>::max();
+	m_nextIndex = std::numeric_limits<memory_size_type>::max();
+	m_index = std::numeric_limits<memory_size_type>::max();
+	m_size = size;
+	m_fileAccessor->shrink_to(size);
+	if (m_tempFile)
+		m_tempFile->update_recorded_size(m_fileAccessor->byte_size());
+	seek(std::min(o, size));
+}
+
+void file_stream_base::start_read_ahead(stream_size_type block) {
+	if (m_readAheadBlocks == 0 || !m_canRead || m_cacheHint != access_sequential
+		|| m_mapping != 0 || !job_manager_initialized())
+		return;
+	if (block * static_cast<stream_size_type>(m_blockItems) >= m_size) {
+		cancel_read_ahead();
+		return;
+	}
+	wait_for_writes();
+	if (!m_readAhead)
+		m_readAhead.reset(tpie_new<read_ahead>(m_fileAccessor, m_itemSize,
+											   m_blockItems, m_readAheadBlocks));
+	m_readAhead->start(block, m_size);
+}
+
 void file_stream_base::update_block_core() {
-	flush_block();
+	// A dirty block means that we are writing, and blocks read ahead would
+	// just be overwritten.
+	bool writing = m_block.dirty;
+	bool sequential = m_nextBlock == m_block.number + 1;
+	if (!(writing && sequential && write_behind_block()))
+		flush_block();
 	get_block(m_nextBlock);
+	if (sequential && !writing) start_read_ahead(m_nextBlock + 1);
 }
 
 template class stream_crtp<file_stream_base>;
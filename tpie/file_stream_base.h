@@ -27,7 +27,11 @@
 #include <tpie/tpie_export.h>
 #include <tpie/file_base_crtp.h>
 #include <tpie/stream_crtp.h>
+#include <tpie/read_ahead.h>
+#include <tpie/write_behind.h>
+#include <tpie/tpie_log.h>
 #include <algorithm>
+#include <exception>
 namespace tpie {
 
 class TPIE_EXPORT file_stream_base: public file_base_crtp<file_stream_base>, public stream_crtp<file_stream_base> {
@@ -48,12 +52,28 @@ public:
 	/// \brief Close the file and release resources.
 	///
 	/// This will close the file and resources used by buffers and such.
+	/// If writing the last blocks fails, the file is still closed before
+	/// the error is thrown.
 	/////////////////////////////////////////////////////////////////////////
 	inline void close() {
-		if (m_open) flush_block();
-		tpie_delete_array(m_block.data, m_itemSize * m_blockItems);
+		m_readAhead.reset();
+		std::exception_ptr error;
+		if (m_open) {
+			try {
+				flush_block();
+				wait_for_writes();
+			} catch (...) {
+				error = std::current_exception();
+			}
+		}
+		m_writeBehind.reset();
+		if (m_mapping == 0)
+			tpie_delete_aligned_array(m_block.data, m_itemSize * m_blockItems,
+									  file_accessor::block_alignment);
 		m_block.data = 0;
+		m_mapping = 0;
 		p_t::close();
+		if (error) std::rethrow_exception(error);
 	}
 
 
@@ -67,6 +87,8 @@ public:
 	inline void truncate(stream_size_type size) {
 		stream_size_type o=offset();
 		flush_block();
+		wait_for_writes();
+		cancel_read_ahead();
 		m_block.number = std::numeric_limits<stream_size_type>::max();
 		m_nextBlock = std::numeric_limits<stream_size_type>::max();
 		m_nextIndex = std::numeric_limits<memory_size_type>::max();
@@ -78,13 +100,110 @@ public:
 		seek(std::min(o, size));
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the number of blocks to read ahead of the current block.
+	///
+	/// When the stream is opened with access_sequential and is read block by
+	/// block in increasing order, the given number of following blocks are
+	/// read in a background thread. The read-ahead buffers are allocated with
+	/// tpie_new_aligned_array and are thus counted by the memory manager; see
+	/// read_ahead::memory_usage.
+	///
+	/// The default is given by get_read_ahead_blocks(). Zero disables
+	/// reading ahead.
+	///////////////////////////////////////////////////////////////////////////
+	void set_read_ahead(memory_size_type blocks) {
+		m_readAhead.reset();
+		m_readAheadBlocks = blocks;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Get the number of blocks to read ahead of the current block.
+	///////////////////////////////////////////////////////////////////////////
+	memory_size_type get_read_ahead() const {
+		return m_readAheadBlocks;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the maximum number of full blocks waiting to be written in
+	/// the background.
+	///
+	/// When the stream is opened with access_sequential and is written block
+	/// by block in increasing order, full blocks are written by a job of the
+	/// job pool, and the writer continues in a fresh buffer. The buffers are
+	/// allocated with tpie_new_aligned_array and are thus counted by the
+	/// memory manager; see write_behind::memory_usage. If the job manager is
+	/// not initialized, blocks are written when they are full.
+	///
+	/// An error writing a block is thrown by a later call that writes a
+	/// block, seeks back to a written block, truncates or closes the stream.
+	/// The stream is then shrunk to the size it had before the first lost
+	/// block was written, and the stream position is moved to the new end of
+	/// the stream if it was beyond it.
+	///
+	/// The default is given by get_write_behind_blocks(). Zero disables
+	/// writing behind. The io_uring file accessor already writes in the
+	/// background, so with TPIE_DEFAULT_IO_URING this has no effect.
+	///////////////////////////////////////////////////////////////////////////
+	void set_write_behind(memory_size_type blocks) {
+		wait_for_writes();
+		m_writeBehind.reset();
+		m_writeBehindBlocks = blocks;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Get the maximum number of blocks written in the background.
+	///////////////////////////////////////////////////////////////////////////
+	memory_size_type get_write_behind() const {
+		return m_writeBehindBlocks;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set whether to map the file into memory when it is opened
+	/// read-only.
+	///
+	/// A mapped stream allocates no block buffer. Its blocks are windows into
+	/// the mapping, so read() and peek() return references to items in the
+	/// page cache and nothing is copied. This suits lookups and rescans of
+	/// files that fit in the page cache.
+	///
+	/// The mapped pages belong to the page cache, which the kernel may
+	/// reclaim, and are not counted by the memory manager. memory_usage() is
+	/// still an upper bound on the memory used by a mapped stream.
+	///
+	/// The setting takes effect on the next open. Streams opened for writing,
+	/// empty streams and file accessors that cannot map files read blocks as
+	/// usual.
+	///////////////////////////////////////////////////////////////////////////
+	void set_mmap(bool useMmap) {
+		m_useMmap = useMmap;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Get whether the file is mapped when it is opened read-only.
+	///////////////////////////////////////////////////////////////////////////
+	bool get_mmap() const {
+		return m_useMmap;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Check whether the open file is mapped into memory.
+	///////////////////////////////////////////////////////////////////////////
+	bool is_mapped() const {
+		return m_mapping != 0;
+	}
+
 protected:
 	file_stream_base(memory_size_type itemSize,
 					 double blockFactor,
 					 file_accessor::file_accessor * fileAccessor);
 
 	inline ~file_stream_base() {
-		close();
+		try {
+			close();
+		} catch (std::exception & e) {
+			log_error() << "Error closing file_stream_base: " << e.what() << std::endl;
+		}
 	}
 
 	void swap(file_stream_base & other) {
@@ -107,6 +226,13 @@ protected:
 		swap(m_block.data,      other.m_block.data);
 		swap(m_ownedTempFile,   other.m_ownedTempFile);
 		swap(m_tempFile,        other.m_tempFile);
+		swap(m_cacheHint,       other.m_cacheHint);
+		swap(m_readAheadBlocks, other.m_readAheadBlocks);
+		swap(m_readAhead,       other.m_readAhead);
+		swap(m_writeBehindBlocks, other.m_writeBehindBlocks);
+		swap(m_writeBehind,     other.m_writeBehind);
+		swap(m_useMmap,         other.m_useMmap);
+		swap(m_mapping,         other.m_mapping);
 	}
 
 	inline void open_inner(const std::string & path,
@@ -115,6 +241,7 @@ protected:
 						   cache_hint cacheHint) {
 		p_t::open_inner(path, accessType, userDataSize, cacheHint);
 
+		m_cacheHint = cacheHint;
 		m_blockStartIndex = 0;
 		m_nextBlock = std::numeric_limits<stream_size_type>::max();
 		m_nextIndex = std::numeric_limits<memory_size_type>::max();
@@ -123,7 +250,13 @@ protected:
 		m_block.size = 0;
 		m_block.number = std::numeric_limits<stream_size_type>::max();
 		m_block.dirty = false;
-		m_block.data = tpie_new_array<char>(m_blockItems * m_itemSize);
+		// Blocks start at multiples of the item size in the mapping only
+		// if the block size is a multiple of the item size.
+		const bool map = m_useMmap && !m_canWrite && m_blockSize % m_itemSize == 0;
+		m_mapping = map ? m_fileAccessor->map_blocks() : 0;
+		if (m_mapping == 0)
+			m_block.data = tpie_new_aligned_array<char>(m_blockItems * m_itemSize,
+														 file_accessor::block_alignment);
 
 		initialize();
 		seek(0);
@@ -134,12 +267,55 @@ protected:
 	///////////////////////////////////////////////////////////////////////////
 	void get_block(stream_size_type block);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Read the blocks following the given block in the background
+	/// if read-ahead is enabled for this stream.
+	///////////////////////////////////////////////////////////////////////////
+	void start_read_ahead(stream_size_type block);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait for the read-ahead to stop using the file accessor and
+	/// discard the prefetched blocks.
+	///////////////////////////////////////////////////////////////////////////
+	inline void cancel_read_ahead() {
+		if (m_readAhead) m_readAhead->cancel();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Hand the current block to the background writer if write-behind
+	/// is enabled for this stream.
+	///
+	/// \returns False if the caller must write the block itself.
+	///////////////////////////////////////////////////////////////////////////
+	bool write_behind_block();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait until the blocks written in the background are on disk,
+	/// throwing any error from writing them.
+	///////////////////////////////////////////////////////////////////////////
+	inline void wait_for_writes() {
+		if (!m_writeBehind) return;
+		try {
+			m_writeBehind->flush();
+		} catch (...) {
+			discard_lost_writes();
+			throw;
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief After writing a block in the background failed, shrink the
+	/// stream to the size it had before the first lost block was written.
+	///////////////////////////////////////////////////////////////////////////
+	void discard_lost_writes();
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Write block to disk.
 	///////////////////////////////////////////////////////////////////////////
 	inline void flush_block() {
 		if (m_block.dirty) {
 			assert(m_canWrite);
+			cancel_read_ahead();
 			update_vars();
 			m_fileAccessor->write_block(m_block.data, m_block.number, m_block.size);
 			if (m_tempFile)
@@ -167,6 +343,14 @@ protected:
 
 
 	block_t m_block;
+	cache_hint m_cacheHint;
+	memory_size_type m_readAheadBlocks;
+	tpie::unique_ptr<read_ahead> m_readAhead;
+	memory_size_type m_writeBehindBlocks;
+	tpie::unique_ptr<write_behind> m_writeBehind;
+	bool m_useMmap;
+	/** Start of block 0 in the mapping of the file, or 0 if not mapped. */
+	const char * m_mapping;
 
 private:
 	friend class stream_crtp<file_stream_base>;
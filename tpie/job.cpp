@@ -23,17 +23,43 @@
 
 #include <tpie/job.h>
 #include <tpie/array.h>
-#include <tpie/internal_queue.h>
 #include <tpie/exception.h>
+#include <atomic>
+#include <deque>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <thread>
+#include <vector>
 namespace tpie {
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// Index of the job queue owned by the current thread, or max() when the
+/// thread is not a worker.
+///////////////////////////////////////////////////////////////////////////////
+thread_local size_t local_queue_index = std::numeric_limits<size_t>::max();
+
+} // unnamed namespace
  
 ///////////////////////////////////////////////////////////////////////////////
 /// Job manager singleton.
 ///////////////////////////////////////////////////////////////////////////////
 class job_manager * the_job_manager = 0;
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Work stealing job manager.
+///
+/// Each worker has its own deque of jobs, and threads that are not workers
+/// share one extra deque. A thread pushes jobs to the back of its own deque
+/// and takes jobs from the back of it, and it steals from the front of the
+/// other deques when its own is empty. Each deque has its own mutex, so
+/// spawning many small jobs does not contend on a single lock.
+///
+/// The jobs_mutex only guards the dependency counts of the jobs and is used
+/// for sleeping when no jobs are available.
+///////////////////////////////////////////////////////////////////////////////
 class job_manager {
 
 public:
@@ -41,16 +67,33 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Default constructor.
 	///////////////////////////////////////////////////////////////////////////
-	job_manager() : m_jobs(128), m_kill_job_pool(false) {}
+	job_manager()
+		: m_pending(0)
+		, m_pushes(0)
+		, m_sleeping(0)
+		, m_joining(0)
+		, m_kill_job_pool(false)
+	{
+		m_queues.emplace_back(new job_queue);
+	}
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Initialize the thread pool.
+	///
+	/// Jobs left in the queues by a previous pool are kept.
 	///////////////////////////////////////////////////////////////////////////
 	void init_pool(size_t threads) {
 		m_kill_job_pool = false;
+		std::vector<std::unique_ptr<job_queue> > queues;
+		for (size_t i = 0; i < threads + 1; ++i) queues.emplace_back(new job_queue);
+		for (size_t i = 0; i < m_queues.size(); ++i) {
+			std::deque<job *> & jobs = queues.back()->jobs;
+			jobs.insert(jobs.end(), m_queues[i]->jobs.begin(), m_queues[i]->jobs.end());
+		}
+		m_queues.swap(queues);
 		m_thread_pool.resize(threads);
 		for (size_t i = 0; i < threads; ++i) {
-			std::function<void()> f(worker);
+			std::function<void()> f(std::bind(worker, i));
 			std::thread t(f);
 			// thread is move-constructible
 			m_thread_pool[i].swap(t);
@@ -75,36 +118,161 @@ public:
 	}
 private:
 
-	tpie::internal_queue<tpie::job *> m_jobs;
+	struct job_queue {
+		std::mutex mutex;
+		std::deque<tpie::job *> jobs;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief One queue per worker followed by the queue shared by all other
+	/// threads.
+	///////////////////////////////////////////////////////////////////////////
+	std::vector<std::unique_ptr<job_queue> > m_queues;
 	tpie::array<std::thread> m_thread_pool;
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief The only mutex we will ever need.
+	/// \brief Guards job dependencies and sleeping.
 	///////////////////////////////////////////////////////////////////////////
 	std::mutex jobs_mutex;
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief Notified when a job is added to the queue.
+	/// \brief Notified when a job is added to a queue and a worker sleeps.
 	///////////////////////////////////////////////////////////////////////////
 	std::condition_variable m_has_data;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Notified when a job is added or completed and a thread is
+	/// waiting in job::join().
+	///////////////////////////////////////////////////////////////////////////
+	std::condition_variable m_progress;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of jobs in the queues. Incremented before the job is
+	/// pushed, so it may briefly count a job that is not in a queue yet.
+	///////////////////////////////////////////////////////////////////////////
+	std::atomic<size_t> m_pending;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of jobs pushed so far.
+	///////////////////////////////////////////////////////////////////////////
+	std::atomic<size_t> m_pushes;
+
+	std::atomic<size_t> m_sleeping;
+	std::atomic<size_t> m_joining;
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief True when the workers should quit ASAP.
 	///////////////////////////////////////////////////////////////////////////
 	bool m_kill_job_pool;
 
+	size_t local_queue() const {
+		return std::min(local_queue_index, m_queues.size() - 1);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Add a job to the queue of the calling thread and wake up a
+	/// sleeping thread, if any.
+	///////////////////////////////////////////////////////////////////////////
+	void push(tpie::job * j) {
+		++m_pending;
+		job_queue & q = *m_queues[local_queue()];
+		{
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.jobs.push_back(j);
+		}
+		++m_pushes;
+		if (m_sleeping || m_joining) {
+			std::lock_guard<std::mutex> lock(jobs_mutex);
+			m_has_data.notify_one();
+			m_progress.notify_all();
+		}
+	}
+
+	static bool is_descendant(tpie::job * j, tpie::job * ancestor) {
+		for (tpie::job * p = j; p; p = p->m_parent)
+			if (p == ancestor) return true;
+		return false;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Take a job, preferring the newest job of the calling thread and
+	/// otherwise stealing the oldest job of another thread.
+	///
+	/// \param ancestor If not null, only take this job or its descendants.
+	/// \returns The job, or null if no job was found.
+	///////////////////////////////////////////////////////////////////////////
+	tpie::job * pop(tpie::job * ancestor) {
+		if (!m_pending) return 0;
+		const size_t n = m_queues.size();
+		const size_t own = local_queue();
+		for (size_t k = 0; k < n; ++k) {
+			job_queue & q = *m_queues[(own + k) % n];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (q.jobs.empty()) continue;
+			tpie::job * j = 0;
+			if (k == 0) {
+				for (size_t i = q.jobs.size(); i-- > 0;) {
+					if (ancestor && !is_descendant(q.jobs[i], ancestor)) continue;
+					j = q.jobs[i];
+					q.jobs.erase(q.jobs.begin() + i);
+					break;
+				}
+			} else {
+				for (size_t i = 0; i < q.jobs.size(); ++i) {
+					if (ancestor && !is_descendant(q.jobs[i], ancestor)) continue;
+					j = q.jobs[i];
+					q.jobs.erase(q.jobs.begin() + i);
+					break;
+				}
+			}
+			if (j) {
+				--m_pending;
+				return j;
+			}
+		}
+		return 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Run the given job and its descendants, as long as they are
+	/// queued, and wait for the rest to be done by other threads.
+	///////////////////////////////////////////////////////////////////////////
+	void join(tpie::job * j) {
+		for (;;) {
+			size_t pushes = m_pushes;
+			{
+				std::lock_guard<std::mutex> lock(jobs_mutex);
+				if (!j->m_dependencies) return;
+			}
+			tpie::job * child = pop(j);
+			if (child) {
+				child->run();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(jobs_mutex);
+			++m_joining;
+			while (j->m_dependencies && m_pushes == pushes) m_progress.wait(lock);
+			--m_joining;
+		}
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Worker thread entry point.
 	///////////////////////////////////////////////////////////////////////////
-	static void worker() {
+	static void worker(size_t index) {
+		local_queue_index = index;
+		job_manager & m = *the_job_manager;
 		for (;;) {
-			std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
-			while (the_job_manager->m_jobs.empty() && !the_job_manager->m_kill_job_pool) the_job_manager->m_has_data.wait(lock);
-			if (the_job_manager->m_kill_job_pool) break;
-			tpie::job * j = the_job_manager->m_jobs.front();
-			the_job_manager->m_jobs.pop();
-			lock.unlock();
-			j->run();
+			tpie::job * j = m.pop(0);
+			if (j) {
+				j->run();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m.jobs_mutex);
+			++m.m_sleeping;
+			while (!m.m_pending && !m.m_kill_job_pool) m.m_has_data.wait(lock);
+			--m.m_sleeping;
+			if (m.m_kill_job_pool) break;
 		}
 	};
 
@@ -136,6 +304,14 @@ void set_worker_count(memory_size_type workers) {
 	}
 }
 
+bool job_manager_initialized() {
+	return the_job_manager != 0;
+}
+
+memory_size_type get_worker_count() {
+	return the_job_manager->worker_count();
+}
+
 job::job()
 	: m_dependencies(0)
 	, m_parent(0)
@@ -144,10 +320,7 @@ job::job()
 }
 
 void job::join() {
-	std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
-	while (m_dependencies) {
-		m_done.wait(lock);
-	}
+	the_job_manager->join(this);
 }
 
 bool job::is_done() {
@@ -161,18 +334,14 @@ void job::enqueue(job * parent) {
 
 	m_state = job_enqueued;
 
-	std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
-	if (the_job_manager->m_kill_job_pool) throw job_manager_exception();
-	m_parent = parent;
-	m_dependencies = 1;
-	if (m_parent) ++m_parent->m_dependencies;
-	if (the_job_manager->m_jobs.full()) {
-		lock.unlock();
-		run();
-		return;
+	{
+		std::lock_guard<std::mutex> lock(the_job_manager->jobs_mutex);
+		if (the_job_manager->m_kill_job_pool) throw job_manager_exception();
+		m_parent = parent;
+		m_dependencies = 1;
+		if (m_parent) ++m_parent->m_dependencies;
 	}
-	the_job_manager->m_jobs.push(this);
-	the_job_manager->m_has_data.notify_one();
+	the_job_manager->push(this);
 }
 
 void job::run() {
@@ -196,9 +365,8 @@ void job::done() {
 	m_state = job_idle;
 
 	if (m_parent) m_parent->done();
-	m_done.notify_all();
+	if (the_job_manager->m_joining) the_job_manager->m_progress.notify_all();
 	on_done();
 }
 
 } // namespace tpie
-
@@ -54,6 +54,10 @@ public:
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Wait for this job and its subjobs to complete.
+	///
+	/// While waiting, the calling thread runs this job and its subjobs if
+	/// they are still queued, so a job may join its own subjobs without
+	/// occupying a worker.
 	///////////////////////////////////////////////////////////////////////////
 	void join();
 
@@ -89,21 +93,17 @@ private:
 	job * m_parent;
 	job_state m_state;
 
-	///////////////////////////////////////////////////////////////////////////
-	/// \brief Notified when this job and subjobs are done.
-	///////////////////////////////////////////////////////////////////////////
-	std::condition_variable m_done;
-
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Called when this job or a subjob is done.
 	///
 	/// Decrement m_dependencies and call on_done() and notify
-	/// waiters, if applicable.
+	/// joining threads, if applicable.
 	///////////////////////////////////////////////////////////////////////////
 	void done();
 
 	///////////////////////////////////////////////////////////////////////////
-	/// The job manager needs to invoke run() on us.
+	/// The job manager needs to invoke run() on us and to inspect our
+	/// dependencies.
 	///////////////////////////////////////////////////////////////////////////
 	friend class job_manager;
 };
@@ -125,6 +125,16 @@ TPIE_EXPORT memory_size_type default_worker_count();
 ///////////////////////////////////////////////////////////////////////////////
 TPIE_EXPORT void set_worker_count(memory_size_type);
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Return the number of job threads currently running.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT memory_size_type get_worker_count();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Return true if the job subsystem has been initialized by tpie_init.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT bool job_manager_initialized();
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \internal \brief Used by tpie_init to initialize the job subsystem.
 ///////////////////////////////////////////////////////////////////////////////
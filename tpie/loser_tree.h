@@ -0,0 +1,224 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_LOSER_TREE_H__
+#define __TPIE_LOSER_TREE_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file loser_tree.h
+/// \brief Tournament tree for k-way merging.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/array.h>
+#include <tpie/util.h>
+#include <functional>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \class loser_tree
+/// \brief Tournament (loser) tree with the interface of
+/// internal_priority_queue used by the mergers.
+///
+/// The tree has one leaf per element slot given to the constructor or
+/// resize(). Each internal node stores the leaf that lost the match played
+/// at that node, and the overall winner is kept at the root. Replacing the
+/// minimum replays only the matches on the path from its leaf to the root,
+/// so pop_and_push costs exactly ceil(log2 k) comparisons, compared to about
+/// 2 log2 k for a binary heap.
+///
+/// Elements are never moved between leaves: pop() marks the leaf of the
+/// minimum as exhausted and pop_and_push() puts the new element in the same
+/// leaf. Thus, push() is not supported after make_safe().
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename comp_t = std::less<T> >
+class loser_tree: public linear_memory_base< loser_tree<T, comp_t> > {
+public:
+	typedef memory_size_type size_type;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Construct a loser tree.
+	/// \param max_size Number of leaves.
+	///////////////////////////////////////////////////////////////////////////
+	loser_tree(size_type max_size, comp_t c=comp_t(),
+			   memory_bucket_ref bucket = memory_bucket_ref())
+		: m_items(max_size, bucket)
+		, m_tree(max_size, bucket)
+		, m_exhausted(max_size, bucket)
+		, m_leaves(max_size)
+		, sz(0)
+		, comp(c) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Put an element in the next free leaf without playing any
+	/// matches. Call make_safe() before using the tree.
+	///////////////////////////////////////////////////////////////////////////
+	void unsafe_push(const T & v) {
+		m_items[sz++] = v;
+	}
+
+	void unsafe_push(T && v) {
+		m_items[sz++] = std::move(v);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Play all matches after a sequence of calls to unsafe_push.
+	/// Leaves not filled by unsafe_push are exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	void make_safe() {
+		for (size_type i = 0; i < m_leaves; ++i) m_exhausted[i] = i >= sz;
+		if (m_leaves == 0) return;
+		m_tree[0] = build(1);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Is the tree empty?
+	///////////////////////////////////////////////////////////////////////////
+	bool empty() const {return sz == 0;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of leaves that are not exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	size_type size() const {return sz;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the minimum element.
+	///////////////////////////////////////////////////////////////////////////
+	const T & top() const {return m_items[m_tree[0]];}
+
+	T & top() {return m_items[m_tree[0]];}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Remove the minimum element, exhausting its leaf.
+	///////////////////////////////////////////////////////////////////////////
+	void pop() {
+		assert(!empty());
+		size_type leaf = m_tree[0];
+		m_exhausted[leaf] = true;
+		--sz;
+		replay(leaf);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Replace the minimum element by a new element.
+	///////////////////////////////////////////////////////////////////////////
+	void pop_and_push(const T & v) {
+		assert(!empty());
+		size_type leaf = m_tree[0];
+		m_items[leaf] = v;
+		replay(leaf);
+	}
+
+	void pop_and_push(T && v) {
+		assert(!empty());
+		size_type leaf = m_tree[0];
+		m_items[leaf] = std::move(v);
+		replay(leaf);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \copybrief linear_memory_structure_doc::memory_coefficient()
+	/// \copydetails linear_memory_structure_doc::memory_coefficient()
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr double memory_coefficient() noexcept {
+		return tpie::array<T>::memory_coefficient()
+			+ tpie::array<size_type>::memory_coefficient()
+			+ tpie::array<bool>::memory_coefficient();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \copybrief linear_memory_structure_doc::memory_overhead()
+	/// \copydetails linear_memory_structure_doc::memory_overhead()
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr double memory_overhead() noexcept {
+		return tpie::array<T>::memory_overhead() - sizeof(tpie::array<T>)
+			+ tpie::array<size_type>::memory_overhead() - sizeof(tpie::array<size_type>)
+			+ tpie::array<bool>::memory_overhead() - sizeof(tpie::array<bool>)
+			+ sizeof(loser_tree);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Remove all elements.
+	///////////////////////////////////////////////////////////////////////////
+	void clear() {sz=0;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Resize the tree to the given number of leaves.
+	///////////////////////////////////////////////////////////////////////////
+	void resize(size_t s) {
+		sz = 0;
+		m_leaves = s;
+		m_items.resize(s);
+		m_tree.resize(s);
+		m_exhausted.resize(s);
+	}
+
+private:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if leaf a wins over leaf b.
+	///////////////////////////////////////////////////////////////////////////
+	bool wins(size_type a, size_type b) {
+		if (m_exhausted[a]) return false;
+		if (m_exhausted[b]) return true;
+		return comp(m_items[a], m_items[b]);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Play the matches of the subtree rooted at the given node.
+	///
+	/// Nodes are numbered as in a binary heap; node n has children 2n and
+	/// 2n+1, and leaf i is node m_leaves+i.
+	/// \returns The winning leaf.
+	///////////////////////////////////////////////////////////////////////////
+	size_type build(size_type node) {
+		if (node >= m_leaves) return node - m_leaves;
+		size_type a = build(2*node);
+		size_type b = build(2*node+1);
+		bool aWins = wins(a, b);
+		m_tree[node] = aWins ? b : a;
+		return aWins ? a : b;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Replay the matches from the given leaf to the root.
+	///
+	/// The winner is carried upwards and swapped with the stored loser when
+	/// the loser wins; the selects compile to conditional moves.
+	///////////////////////////////////////////////////////////////////////////
+	void replay(size_type leaf) {
+		size_type winner = leaf;
+		for (size_type node = (leaf + m_leaves) / 2; node > 0; node /= 2) {
+			size_type loser = m_tree[node];
+			bool swap = wins(loser, winner);
+			m_tree[node] = swap ? winner : loser;
+			winner = swap ? loser : winner;
+		}
+		m_tree[0] = winner;
+	}
+
+	tpie::array<T> m_items;
+	tpie::array<size_type> m_tree;
+	tpie::array<bool> m_exhausted;
+	size_type m_leaves;
+	size_type sz;
+	comp_t comp;
+};
+
+}  //  tpie namespace
+#endif //__TPIE_LOSER_TREE_H__
@@ -34,6 +34,7 @@
 #include <type_traits>
 #include <utility>
 #include <memory>
+#include <new>
 #include <atomic>
 #include <typeindex>
 
@@ -296,6 +297,43 @@ inline void tpie_delete_array(T * a, size_t size) throw() {
 	delete[] a;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Allocate a new array whose address is a multiple of the given
+/// alignment and register its memory usage.
+///
+/// Used for buffers that are read and written with direct I/O.
+///
+/// \tparam T A trivial type; the elements are not initialized.
+/// \param size The number of elements in the new array.
+/// \param alignment The alignment in bytes, a power of two.
+/// \return The new array.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T * tpie_new_aligned_array(size_t size, size_t alignment) {
+	static_assert(std::is_trivial<T>::value, "tpie_new_aligned_array requires a trivial type");
+	get_memory_manager().register_allocation(size * sizeof(T), typeid(T));
+	try {
+		return static_cast<T *>(::operator new[](size * sizeof(T), std::align_val_t(alignment)));
+	} catch (...) {
+		get_memory_manager().register_deallocation(size * sizeof(T), typeid(T));
+		throw;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Delete an array allocated with tpie_new_aligned_array.
+/// \param a The array to delete.
+/// \param size The size of the array in elements as passed to
+/// tpie_new_aligned_array.
+/// \param alignment The alignment as passed to tpie_new_aligned_array.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void tpie_delete_aligned_array(T * a, size_t size, size_t alignment) throw() {
+	if (a == 0) return;
+	get_memory_manager().register_deallocation(sizeof(T) * size, typeid(T));
+	::operator delete[](a, std::align_val_t(alignment));
+}
+
 struct tpie_deleter {
 	template <typename T>
 	void operator()(T * t) {
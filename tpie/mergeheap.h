@@ -33,6 +33,7 @@
 #include <tpie/portability.h>
 #include <tpie/memory.h>
 #include <tpie/internal_priority_queue.h>
+#include <tpie/loser_tree.h>
 
 namespace tpie {
 	namespace ami {
@@ -54,8 +55,10 @@ namespace tpie {
 		///////////////////////////////////////////////////////////////////////////
 		/// A record pointer heap base class - also serves as the full
 		/// implementation for objects with a < comparison operator.
+		/// queue_t may be internal_priority_queue or loser_tree.
 		///////////////////////////////////////////////////////////////////////////
-		template<class REC, class comp_t=std::less<REC> >
+		template<class REC, class comp_t=std::less<REC>,
+				 template <typename, typename> class queue_t=internal_priority_queue>
 		class merge_heap_ptr_op {
 		private:
 			struct comp {
@@ -66,7 +69,7 @@ namespace tpie {
 				}
 			};
 			
-			internal_priority_queue<heap_ptr<REC>, comp> pq;
+			queue_t<heap_ptr<REC>, comp> pq;
 			
 		public:
 			merge_heap_ptr_op(comp_t c=comp_t()): pq(0, comp(c)) {}
@@ -137,11 +140,12 @@ namespace tpie {
 		///////////////////////////////////////////////////////////////////////////
 		/// A record pointer heap that uses a comparison object
 		///////////////////////////////////////////////////////////////////////////
-		template<class REC, class CMPR>
-		class merge_heap_ptr_obj: public merge_heap_ptr_op<REC, CMPR>{
+		template<class REC, class CMPR,
+				 template <typename, typename> class queue_t=internal_priority_queue>
+		class merge_heap_ptr_obj: public merge_heap_ptr_op<REC, CMPR, queue_t>{
 		public:
 			merge_heap_ptr_obj(CMPR *cmptr): 
-				merge_heap_ptr_op<REC, CMPR>(cmptr) {};
+				merge_heap_ptr_op<REC, CMPR, queue_t>(cmptr) {};
 		};
 		
 		///////////////////////////////////////////////////////////////////////////
@@ -161,8 +165,10 @@ namespace tpie {
 		///////////////////////////////////////////////////////////////////////////
 		/// A merge heap object base class - also serves as the full
 		/// implementation for objects with a < comparison operator
+		/// queue_t may be internal_priority_queue or loser_tree.
 		///////////////////////////////////////////////////////////////////////////
-		template<class REC, class comp_t=std::less<REC> >
+		template<class REC, class comp_t=std::less<REC>,
+				 template <typename, typename> class queue_t=internal_priority_queue>
 		class merge_heap_op {
 		private:
 			struct comp {
@@ -173,7 +179,7 @@ namespace tpie {
 				}
 			};
 			
-			internal_priority_queue<heap_element<REC>, comp> pq;
+			queue_t<heap_element<REC>, comp> pq;
 			
 		public:
 			merge_heap_op(comp_t c=comp_t()): pq(0, comp(c)) {}
@@ -245,11 +251,12 @@ namespace tpie {
 		// ********************************************************************
 		// * A merge heap that uses a comparison object                       *
 		// ********************************************************************
-		template<class REC, class Compare>
-		class merge_heap_obj: public merge_heap_op<REC, Compare> {
+		template<class REC, class Compare,
+				 template <typename, typename> class queue_t=internal_priority_queue>
+		class merge_heap_obj: public merge_heap_op<REC, Compare, queue_t> {
 		public:
 			merge_heap_obj(Compare cmp): 
-				merge_heap_op<REC, Compare>(cmp) {}
+				merge_heap_op<REC, Compare, queue_t>(cmp) {}
 		};
 
 	}   //  ami namespace
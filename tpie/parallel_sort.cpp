@@ -0,0 +1,39 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet cino+=(0 :
+// Copyright 2026, The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/parallel_sort.h>
+#include <atomic>
+
+namespace {
+
+std::atomic<tpie::parallel_sort_algorithm> algorithm(tpie::parallel_sort_algorithm::quicksort);
+
+} // unnamed namespace
+
+namespace tpie {
+
+void set_parallel_sort_algorithm(parallel_sort_algorithm a) {
+	algorithm = a;
+}
+
+parallel_sort_algorithm get_parallel_sort_algorithm() {
+	return algorithm;
+}
+
+} // namespace tpie
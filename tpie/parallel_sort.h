@@ -31,6 +31,8 @@
 #include <mutex>
 #include <cmath>
 #include <functional>
+#include <memory>
+#include <vector>
 #include <tpie/progress_indicator_base.h>
 #include <tpie/dummy_progress.h>
 #include <tpie/internal_queue.h>
@@ -39,10 +41,34 @@
 
 namespace tpie {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Algorithms used by parallel_sort_impl.
+///////////////////////////////////////////////////////////////////////////////
+enum class parallel_sort_algorithm {
+	/** Quick sort with sequential partitioning. The sorts of the two parts
+	 * of a partition run in parallel, so the top levels limit the speedup. */
+	quicksort,
+	/** Quick sort that partitions ranges of at least two times the std::sort
+	 * threshold using all workers, so all levels run in parallel. The sort
+	 * is still in-place. */
+	parallel_partition
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set the algorithm used by parallel sorts constructed from now on.
+/// The default is parallel_sort_algorithm::quicksort.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_parallel_sort_algorithm(parallel_sort_algorithm algorithm);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Get the algorithm used by parallel sorts.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT parallel_sort_algorithm get_parallel_sort_algorithm();
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief A simple parallel sort implementation with progress tracking.
-/// The partition step is sequential, as a parallel partition only speeds up
-/// the top layer, which does not warrant the hassle of implementation.
+/// By default, the partition step is sequential; see
+/// parallel_sort_algorithm for a parallel partition step.
 /// Uses the TPIE job manager to transparently distribute work across the
 /// machine cores.
 /// Uses the pseudo median of nine as pivot.
@@ -163,6 +189,150 @@ private:
 		return l;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Job running a function, used for parallel partitioning.
+	///////////////////////////////////////////////////////////////////////////
+	class function_job : public job {
+	public:
+		function_job(std::function<void()> f) : f(f) {}
+
+		virtual void operator()() override {
+			f();
+		}
+
+	private:
+		std::function<void()> f;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Call f(0), ..., f(parts-1) in parallel and wait for them.
+	///////////////////////////////////////////////////////////////////////////
+	template <typename F>
+	static void run_in_parallel(size_t parts, F & f) {
+		std::vector<std::unique_ptr<function_job> > jobs;
+		for (size_t i = 1; i < parts; ++i) {
+			jobs.emplace_back(new function_job([&f, i]() { f(i); }));
+			jobs.back()->enqueue();
+		}
+		f(0);
+		for (size_t i = 0; i < jobs.size(); ++i) jobs[i]->join();
+	}
+
+	typedef std::pair<iterator_type, iterator_type> range_t;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Find the element at the given offset into the concatenation of
+	/// the ranges.
+	///////////////////////////////////////////////////////////////////////////
+	static void seek_ranges(const std::vector<range_t> & ranges, size_t offset,
+							size_t & index, iterator_type & it) {
+		index = 0;
+		while (offset >= static_cast<size_t>(ranges[index].second - ranges[index].first)) {
+			offset -= ranges[index].second - ranges[index].first;
+			++index;
+		}
+		it = ranges[index].first + offset;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Swap the elements at offsets [from, to) of the concatenation of
+	/// the ranges x with those of the concatenation of the ranges y.
+	///////////////////////////////////////////////////////////////////////////
+	static void swap_ranges(const std::vector<range_t> & x, const std::vector<range_t> & y,
+							size_t from, size_t to) {
+		if (from == to) return;
+		size_t xi, yi;
+		iterator_type xp, yp;
+		seek_ranges(x, from, xi, xp);
+		seek_ranges(y, from, yi, yp);
+		size_t count = to - from;
+		for (;;) {
+			size_t k = std::min(count, std::min(static_cast<size_t>(x[xi].second - xp),
+												static_cast<size_t>(y[yi].second - yp)));
+			yp = std::swap_ranges(xp, xp + k, yp);
+			xp += k;
+			count -= k;
+			if (count == 0) return;
+			if (xp == x[xi].second) xp = x[++xi].first;
+			if (yp == y[yi].second) yp = y[++yi].first;
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Reorder [a,b) such that the elements satisfying pred come
+	/// first, using the given number of parallel jobs.
+	///
+	/// The range is split into one chunk per job, and each chunk is
+	/// partitioned on its own. Then the elements that ended up on the wrong
+	/// side of the final split point are swapped, again in parallel.
+	/// \returns The first element not satisfying pred.
+	///////////////////////////////////////////////////////////////////////////
+	template <typename pred_t>
+	static iterator_type parallel_partition(iterator_type a, iterator_type b, pred_t pred, size_t parts) {
+		const size_t n = b - a;
+		std::vector<iterator_type> bounds(parts + 1);
+		for (size_t i = 0; i <= parts; ++i) bounds[i] = a + n * i / parts;
+		std::vector<iterator_type> splits(parts);
+		auto partitionChunk = [&](size_t i) {
+			splits[i] = std::partition(bounds[i], bounds[i+1], pred);
+		};
+		run_in_parallel(parts, partitionChunk);
+
+		iterator_type m = a;
+		for (size_t i = 0; i < parts; ++i) m += splits[i] - bounds[i];
+
+		// Elements not satisfying pred before m, and elements satisfying
+		// pred after m.
+		std::vector<range_t> wrongLeft;
+		std::vector<range_t> wrongRight;
+		size_t misplaced = 0;
+		for (size_t i = 0; i < parts; ++i) {
+			iterator_type e = std::min(bounds[i+1], m);
+			if (splits[i] < e) {
+				wrongLeft.push_back(range_t(splits[i], e));
+				misplaced += e - splits[i];
+			}
+			iterator_type f = std::max(bounds[i], m);
+			if (f < splits[i]) wrongRight.push_back(range_t(f, splits[i]));
+		}
+		auto swapPart = [&](size_t i) {
+			swap_ranges(wrongLeft, wrongRight, misplaced * i / parts, misplaced * (i+1) / parts);
+		};
+		run_in_parallel(parts, swapPart);
+		return m;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Partition [a,b) in parallel into elements less than the pivot
+	/// returned by pick_pivot, elements equal to it and greater elements.
+	///
+	/// The equal elements are only separated from the greater elements when
+	/// few elements are less than the pivot, to guarantee progress when there
+	/// are many equal elements.
+	/// \returns The range of elements equal to the pivot, or an empty range
+	/// at the first element not less than the pivot if the equal elements
+	/// were not separated. In either case, the elements before and after the
+	/// range are each fewer than b-a, since at least one element is not less
+	/// than the pivot, and the range is only empty when at least (b-a)/16
+	/// elements are less than it.
+	///////////////////////////////////////////////////////////////////////////
+	static inline range_t parallel_partition(iterator_type a, iterator_type b, comp_type & comp, size_t parts) {
+		const value_type pivot = *pick_pivot(a, b, comp);
+		iterator_type lo = parallel_partition(a, b, [&](const value_type & x) { return comp(x, pivot); }, parts);
+		iterator_type hi = lo;
+		if (static_cast<size_t>(lo - a) < static_cast<size_t>(b - a) / 16)
+			hi = parallel_partition(lo, b, [&](const value_type & x) { return !comp(pivot, x); }, parts);
+		return range_t(lo, hi);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of jobs to use for partitioning a range of n elements.
+	///////////////////////////////////////////////////////////////////////////
+	static inline size_t partition_parts(size_t n, parallel_sort_algorithm algorithm) {
+		if (algorithm != parallel_sort_algorithm::parallel_partition) return 1;
+		return std::min(static_cast<size_t>(get_worker_count()), n / min_size);
+	}
+
 #ifdef DOXYGEN
 public:
 #endif
@@ -174,8 +344,9 @@ public:
 		///////////////////////////////////////////////////////////////////////
 		/// \brief Construct a qsort_job.
 		///////////////////////////////////////////////////////////////////////
-		qsort_job(iterator_type a, iterator_type b, comp_type comp, qsort_job * parent, progress_t & p)
-			: a(a), b(b), comp(comp), parent(parent), progress(p) {
+		qsort_job(iterator_type a, iterator_type b, comp_type comp, qsort_job * parent, progress_t & p,
+				  parallel_sort_algorithm algorithm)
+			: a(a), b(b), comp(comp), parent(parent), progress(p), algorithm(algorithm) {
 
 			// Does nothing.
 		}
@@ -195,13 +366,23 @@ public:
 		virtual void operator()() override {
 			assert(a <= b);
 			while (static_cast<size_t>(b - a) >= min_size) {
-				iterator_type pivot = partition(a, b, comp);
+				iterator_type lo;
+				iterator_type hi;
+				size_t parts = partition_parts(b - a, algorithm);
+				if (parts > 1) {
+					range_t equal = parallel_partition(a, b, comp, parts);
+					lo = equal.first;
+					hi = equal.second;
+				} else {
+					lo = partition(a, b, comp);
+					hi = lo+1;
+				}
 				add_progress(b - a);
 				//qsort_job * j = tpie_new<qsort_job>(a, pivot, comp, this);
-				qsort_job * j = new qsort_job(a, pivot, comp, this, progress);
+				qsort_job * j = new qsort_job(a, lo, comp, this, progress, algorithm);
 				j->enqueue(this);
 				children.push_back(j);
-				a = pivot+1;
+				a = hi;
 			}
 			std::sort(a, b, comp);
 			add_progress(sortWork(b - a));
@@ -226,6 +407,7 @@ public:
 		comp_type comp;
 		qsort_job * parent;
 		progress_t & progress;
+		parallel_sort_algorithm algorithm;
 
 		std::vector<qsort_job *> children;
 
@@ -236,10 +418,19 @@ public:
 		}
 	};
 public:
-	parallel_sort_impl(typename P::base * p) {
+	parallel_sort_impl(typename P::base * p)
+		: m_algorithm(get_parallel_sort_algorithm())
+	{
 		progress.pi = p;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the algorithm used by this sort.
+	///////////////////////////////////////////////////////////////////////////
+	void set_algorithm(parallel_sort_algorithm algorithm) {
+		m_algorithm = algorithm;
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Perform a parallel sort of the items in the interval [a,b).
 	/// Waits until all workers are done. The calling thread handles progress
@@ -256,7 +447,7 @@ public:
 			return;
 		}
 
-		qsort_job * master = new qsort_job(a, b, comp, 0, progress);
+		qsort_job * master = new qsort_job(a, b, comp, 0, progress, m_algorithm);
 		master->enqueue();
 
 		std::uint64_t prev_work_estimate = 0;
@@ -274,6 +465,7 @@ public:
 	}
 private:
 	static const size_t max_job_count=256;
+	parallel_sort_algorithm m_algorithm;
 	progress_t progress;
 	bool kill;
 	size_t working;
@@ -33,6 +33,7 @@
 #include <tpie/pipelining/pair_factory.h>
 #include <tpie/pipelining/pipe_base.h>
 #include <tpie/pipelining/factory_helpers.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/pipelining/virtual.h>
 
 // Library
@@ -43,7 +43,7 @@ public:
 	factory(Args && ... v) : cont(std::forward<Args>(v)...) {}
 
 	template <typename dest_t>
-	using constructed_type = R<typename bits::remove<dest_t>::type>;
+	using constructed_type = bits::profiled_t<R<typename bits::remove<dest_t>::type> >;
 
 	template <typename dest_t>
 	constructed_type<dest_t> construct(dest_t && dest) {
@@ -77,7 +77,7 @@ private:
 template <typename R, typename... T>
 class termfactory : public factory_base {
 public:
-	typedef R constructed_type;
+	typedef bits::profiled_t<R> constructed_type;
 
 	termfactory(const termfactory & o) = delete;
 	termfactory(termfactory && o) = default;
@@ -87,15 +87,15 @@ public:
 	template<typename... Args>
 	termfactory(Args && ... v) : cont(std::forward<Args>(v)...) {}
 
-	R construct() {
-		R r = container_construct<R>(cont);
+	constructed_type construct() {
+		constructed_type r = container_construct<constructed_type>(cont);
 		this->init_node(r);
 		this->add_node_set_edges(r);
 		return r;
 	}
 
-	R construct_copy() {
-		R r = container_construct_copy<R>(cont);
+	constructed_type construct_copy() {
+		constructed_type r = container_construct_copy<constructed_type>(cont);
 		this->init_node(r);
 		this->add_node_set_edges(r);
 		return r;
@@ -128,7 +128,7 @@ public:
 	tfactory(Args && ... v) : cont(std::forward<Args>(v)...) {}
 
 	template<typename dest_t>
-	using constructed_type = R<typename bits::remove<dest_t>::type, TT...>;
+	using constructed_type = bits::profiled_t<R<typename bits::remove<dest_t>::type, TT...> >;
 
 	template <typename dest_t>
 	constructed_type<dest_t> construct(dest_t && dest) {
@@ -25,6 +25,7 @@
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/factory_helpers.h>
 #include <tpie/pipelining/pipe_base.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/maybe.h>
 #include <tpie/flags.h>
 
@@ -67,11 +68,24 @@ public:
 		}
 	}
 
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
+
 	void go() override {
 		if (fs.is_open()) {
-			while (fs.can_read()) {
-				dest.push(fs.read());
-				step();
+			if constexpr (bits::has_push_batch_method<dest_t, item_type>::value) {
+				// Push the items of each block directly from the stream buffer.
+				while (fs.can_read()) {
+					array_view<const item_type> items = fs.read_batch();
+					dest.push_batch(items);
+					step(items.size());
+				}
+			} else {
+				while (fs.can_read()) {
+					dest.push(fs.read());
+					step();
+				}
 			}
 		}
 	}
@@ -105,14 +119,23 @@ public:
 	void propagate() override {
 		fs.construct();
 		fs->open(path, access_read);
+		fs->set_io_stats_sink(get_io_stats());
 		forward("items", fs->size());
 		set_steps(fs->size());
 	}
 
 	void go() override {
-		while (fs->can_read()) {
-			dest.push(fs->read());
-			step();
+		if constexpr (bits::has_push_batch_method<dest_t, item_type>::value) {
+			while (fs->can_read()) {
+				array_view<const item_type> items = fs->read_batch();
+				dest.push_batch(items);
+				step(items.size());
+			}
+		} else {
+			while (fs->can_read()) {
+				dest.push(fs->read());
+				step();
+			}
 		}
 		fs.destruct();
 	}
@@ -144,6 +167,10 @@ public:
 		set_steps(fs.size()-fs.offset());
 	}
 
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
+
 	T pull() {
 		step();
 		return fs.read();
@@ -183,6 +210,10 @@ public:
 		set_steps(fs.offset());
 	}
 
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
+
 	T pull() {
 		step();
 		return fs.read_back();
@@ -219,6 +250,7 @@ public:
 	void propagate() override {
 		fs.construct();
 		fs->open(path, access_read);
+		fs->set_io_stats_sink(get_io_stats());
 		forward("items", fs->size());
 		set_steps(fs->size());
 	}
@@ -257,9 +289,17 @@ public:
 		set_minimum_memory(fs.memory_usage());
 	}
 
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
+
 	void push(const T & item) {
 		fs.write(item);
 	}
+
+	void push_batch(array_view<const T> items) {
+		fs.write(items.data(), items.data() + items.size());
+	}
 private:
 	file_stream<T> & fs;
 };
@@ -282,12 +322,17 @@ public:
 	void begin() override {
 		fs.construct();
 		fs->open(path, access_write);
+		fs->set_io_stats_sink(get_io_stats());
 	}
 	
 	void push(const T & item) {
 		fs->write(item);
 	}
 
+	void push_batch(array_view<const T> items) {
+		fs->write(items.data(), items.data() + items.size());
+	}
+
 	void end() override {
 		fs->close();
 		fs.destruct();
@@ -314,6 +359,10 @@ public:
 		set_minimum_memory(fs.memory_usage());
 	}
 
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
+
 	void go() override {
 		source.begin();
 		while (source.can_pull()) {
@@ -334,6 +383,10 @@ public:
 	tee_t(dest_t dest, file_stream<item_type> & fs): fs(fs), dest(std::move(dest)) {
 		set_minimum_memory(fs.memory_usage());
 	}
+
+	void begin() override {
+		fs.set_io_stats_sink(get_io_stats());
+	}
 	
 	void push(const item_type & i) {
 		fs.write(i);
@@ -46,6 +46,32 @@ public:
 		if (functor(item))
 			dest.push(item);
 	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  If dest accepts batches, gather the accepted items in a buffer
+	/// on the stack and push them as batches.
+	///////////////////////////////////////////////////////////////////////////
+	void push_batch(array_view<const item_type> items) {
+		const item_type * i = items.data();
+		const item_type * end = i + items.size();
+		if constexpr (has_push_batch_method<dest_t, item_type>::value && is_batchable<item_type>::value) {
+			item_type buffer[push_batch_buffer_items<item_type>];
+			memory_size_type n = 0;
+			for (; i != end; ++i) {
+				if (!functor(*i)) continue;
+				buffer[n++] = *i;
+				if (n == push_batch_buffer_items<item_type>) {
+					dest.push_batch(array_view<const item_type>(buffer, n));
+					n = 0;
+				}
+			}
+			if (n != 0) dest.push_batch(array_view<const item_type>(buffer, n));
+		} else {
+			for (; i != end; ++i) {
+				if (functor(*i)) dest.push(*i);
+			}
+		}
+	}
 };
 
 
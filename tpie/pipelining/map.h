@@ -24,6 +24,8 @@
 #include <tpie/pipelining/pipe_base.h>
 #include <tpie/pipelining/factory_helpers.h>
 #include <tpie/pipelining/node_name.h>
+#include <tpie/pipelining/push_batch.h>
+#include <algorithm>
 #include <type_traits>
 
 namespace tpie::pipelining {
@@ -53,6 +55,30 @@ struct unary_traits_imp<R(*)(A)> {
 template <typename T>
 struct unary_traits: public unary_traits_imp<decltype(&T::operator()) > {};
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Push functor(item) for each of the items to dest.
+///
+/// If dest accepts batches, the results are gathered in a buffer on the stack
+/// and pushed as batches.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t, typename F, typename T>
+void push_mapped_batch(dest_t & dest, F & functor, array_view<const T> items) {
+	typedef typename std::decay<decltype(functor(std::declval<const T &>()))>::type out_t;
+	const T * i = items.data();
+	const T * end = i + items.size();
+	if constexpr (has_push_batch_method<dest_t, out_t>::value && is_batchable<out_t>::value) {
+		out_t buffer[push_batch_buffer_items<out_t>];
+		while (i != end) {
+			memory_size_type n = std::min<memory_size_type>(end - i, push_batch_buffer_items<out_t>);
+			for (memory_size_type j = 0; j < n; ++j) buffer[j] = functor(i[j]);
+			dest.push_batch(array_view<const out_t>(buffer, n));
+			i += n;
+		}
+	} else {
+		for (; i != end; ++i) dest.push(functor(*i));
+	}
+}
+
 template <typename dest_t, typename F>
 class map_t: public node {
 private:
@@ -69,6 +95,10 @@ public:
 	void push(const item_type & item) {
 		dest.push(functor(item));
 	}
+
+	void push_batch(array_view<const item_type> items) {
+		push_mapped_batch(dest, functor, items);
+	}
 };
 
 template <typename dest_t, typename F>
@@ -86,6 +116,11 @@ public:
 	void push(const T & item) {
 		dest.push(functor(item));
 	}
+
+	template <typename T>
+	void push_batch(array_view<const T> items) {
+		push_mapped_batch(dest, functor, items);
+	}
 };
 
 template <typename F>
@@ -103,6 +138,11 @@ public:
 	void push(const item_type & item) {
 		functor(item);
 	}
+
+	void push_batch(array_view<const item_type> items) {
+		for (const item_type * i = items.data(); i != items.data() + items.size(); ++i)
+			functor(*i);
+	}
 };
 
 template <typename src_t, typename F>
@@ -202,9 +202,12 @@ merge_sorter_base::merge_sorter_base(
 	, m_element_file_stream_memory_usage(element_file_stream_memory_usage)
 	, m_bucketPtr(new memory_bucket())
 	, m_bucket(memory_bucket_ref(m_bucketPtr.get()))
+	, m_ioStats(std::make_shared<io_stats>())
 	, m_state(stNotStarted)
 	, p()
 	, m_parametersSet(false)
+	, m_parallelRunFormation(false)
+	, m_mergeJobs(1)
 	, m_maxItems(std::numeric_limits<stream_size_type>::max())
 	, m_evacuated(false)
 	, m_finalMergeInitialized(false)
@@ -254,6 +257,8 @@ void merge_sorter_base::set_owner(tpie::pipelining::node * n) {
 	
 	if (n != nullptr)
 		n->bucket(0) = std::move(m_bucketPtr);
+
+	m_ioStats->set_sink(n != nullptr ? n->get_io_stats() : nullptr);
 	
 	m_owning_node = n;
 }
@@ -293,11 +298,14 @@ void merge_sorter_base::calculate_parameters() {
 	// Phase 2 (merge):
 	// Run length: unbounded
 	// Fanout: determined by the size of our merge heap and the stream memory usage.
-	log_pipe_debug() << "Phase 2: " << p.memoryPhase2 << " b available memory\n";
-	p.fanout = calculate_fanout(p.memoryPhase2, p.filesPhase2);
-	if (m_fanout_memory_usage(p.fanout) > p.memoryPhase2) {
-		log_pipe_debug() << "Not enough memory for fanout " << p.fanout << "! (" << p.memoryPhase2 << " < " << m_fanout_memory_usage(p.fanout) << ")\n";
-		p.memoryPhase2 = m_fanout_memory_usage(p.fanout);
+	// With parallel merging, each concurrent merge gets its share of the
+	// memory and files.
+	log_pipe_debug() << "Phase 2: " << p.memoryPhase2 << " b available memory; " << m_mergeJobs << " concurrent merges\n";
+	p.fanout = calculate_fanout(p.memoryPhase2 / m_mergeJobs,
+								clamp(minimumFilesPhase2, p.filesPhase2 / m_mergeJobs, maximumFilesPhase2));
+	if (phase_2_memory(p) > p.memoryPhase2) {
+		log_pipe_debug() << "Not enough memory for fanout " << p.fanout << "! (" << p.memoryPhase2 << " < " << phase_2_memory(p) << ")\n";
+		p.memoryPhase2 = phase_2_memory(p);
 	}
 	
 	// Phase 3 (final merge & report):
@@ -328,6 +336,8 @@ void merge_sorter_base::calculate_parameters() {
 		p.memoryPhase1 = min_m1;
 	}
 	p.runLength = (p.memoryPhase1 - bits::run_positions::memory_usage() - streamMemory - tempFileMemory)/m_item_size;
+	// With double buffered run formation, two run buffers share the memory.
+	p.runLength /= run_buffer_count();
 	
 	p.internalReportThreshold = (std::min(p.memoryPhase1,
 										  std::min(p.memoryPhase2,
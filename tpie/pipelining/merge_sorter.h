@@ -29,6 +29,12 @@
 #include <tpie/dummy_progress.h>
 #include <tpie/array_view.h>
 #include <tpie/parallel_sort.h>
+#include <tpie/radix_sort.h>
+#include <tpie/job.h>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <vector>
 
 namespace tpie {
 
@@ -220,8 +226,45 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void set_items(stream_size_type n);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Give the memory bucket of the sorter to the given node, and
+	/// count the blocks read and written from now on in its io_stats.
+	///////////////////////////////////////////////////////////////////////////
 	void set_owner(tpie::pipelining::node * n);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The blocks read and written by all phases of the sorter.
+	///////////////////////////////////////////////////////////////////////////
+	io_counters get_io_counters() const {
+		return m_ioStats->get();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Enable or disable double buffered run formation.
+	///
+	/// When enabled, the run buffer is split in two halves of runLength
+	/// items each. While one run is sorted and written to disk by a job
+	/// worker, the next run is filled by the caller of push(). The total
+	/// memory used in phase 1 is unchanged, so runs become half as long.
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_run_formation(bool enabled) {
+		m_parallelRunFormation = enabled;
+		check_not_started();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the number of merges to perform concurrently in phase 2.
+	///
+	/// The merges of a merge level are independent, so up to `jobs` of them
+	/// are run at the same time on job workers. The phase 2 memory and file
+	/// limits are divided between the concurrent merges, so the fanout
+	/// decreases accordingly.
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge(memory_size_type jobs) {
+		m_mergeJobs = std::max<memory_size_type>(jobs, 1);
+		check_not_started();
+	}
+
 	void set_phase_1_files(memory_size_type f1) {
 		p.filesPhase1 = f1;
 		check_not_started();
@@ -285,14 +328,14 @@ public:
 	}
 
 	memory_size_type phase_1_memory(const sort_parameters & params) noexcept {
-		return params.runLength * m_item_size
+		return params.runLength * m_item_size * run_buffer_count()
 			+ bits::run_positions::memory_usage()
 			+ m_element_file_stream_memory_usage
 			+ 2*params.fanout*sizeof(temp_file);
 	}
 
 	memory_size_type phase_2_memory(const sort_parameters & params) noexcept {
-		return m_fanout_memory_usage(params.fanout);
+		return m_fanout_memory_usage(params.fanout) * m_mergeJobs;
 	}
 
 	memory_size_type phase_3_memory(const sort_parameters & params) noexcept {
@@ -318,6 +361,13 @@ protected:
 		}
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of run buffers allocated in phase 1.
+	///////////////////////////////////////////////////////////////////////////
+	memory_size_type run_buffer_count() const noexcept {
+		return m_parallelRunFormation ? 2 : 1;
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// initialize_merger helper.
 	///////////////////////////////////////////////////////////////////////////
@@ -342,6 +392,9 @@ protected:
 	std::unique_ptr<memory_bucket> m_bucketPtr;
 	memory_bucket_ref m_bucket;
 
+	// Sink of the run files; forwards to the owning node.
+	std::shared_ptr<io_stats> m_ioStats;
+
 	array<temp_file> m_runFiles;
 
 	state_type m_state;
@@ -349,6 +402,13 @@ protected:
 	sort_parameters p;
 	bool m_parametersSet;
 
+	// Whether runs are sorted and written by a job worker while the next run
+	// is being filled.
+	bool m_parallelRunFormation;
+
+	// Maximum number of concurrent merges in phase 2.
+	memory_size_type m_mergeJobs;
+
 	bits::run_positions m_runPositions;
 
 	// Number of runs already written to disk.
@@ -401,6 +461,7 @@ private:
 	typedef typename specific_store_t::store_type store_type;
 	typedef typename specific_store_t::element_type element_type;	//Should be the same as TT
 	typedef outer_type item_type;
+	typedef merger<specific_store_t, pred_t> merger_t;
 	static const size_t item_size = specific_store_t::item_size;
 public:
 
@@ -412,8 +473,17 @@ public:
 		, m_store(store.template get_specific<element_type>())
 		, m_merger(pred, m_store, m_bucket)
 		, m_currentRunItems(m_bucket)
+		, m_pendingRunItems(m_bucket)
+		, m_pendingRunItemCount(0)
+		, m_doubleBuffered(false)
+		, m_runFormationJob(*this)
+		, m_runFormationJobActive(false)
 		, pred(pred)
 		{}
+
+	~merge_sorter() {
+		if (m_runFormationJobActive) m_runFormationJob.join();
+	}
 	
 
 public:
@@ -426,7 +496,18 @@ public:
 		log_pipe_debug() << "Start forming input runs" << std::endl;
 		m_currentRunItems = array<store_type>(0, allocator<store_type>(m_bucket));
 		m_currentRunItems.resize((size_t)p.runLength);
+		// Double buffering needs a worker to run the sort-and-write job on.
+		m_doubleBuffered = m_parallelRunFormation && get_worker_count() > 0;
+		if (m_doubleBuffered) {
+			m_pendingRunItems = array<store_type>(0, allocator<store_type>(m_bucket));
+			m_pendingRunItems.resize((size_t)p.runLength);
+		}
 		m_runFiles.resize(p.fanout*2);
+		// Runs that are merged together are in different files of the same
+		// half of m_runFiles, so placing the files in turn in the temporary
+		// directories puts them on different devices.
+		for (memory_size_type i = 0; i < m_runFiles.size(); ++i)
+			m_runFiles[i].set_directory(i);
 		m_currentRunItemCount = 0;
 		m_finishedRuns = 0;
 		m_state = stRunFormation;
@@ -438,10 +519,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void push(item_type && item) {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
-		if (m_currentRunItemCount >= p.runLength) {
-			sort_current_run();
-			empty_current_run();
-		}
+		if (m_currentRunItemCount >= p.runLength) flush_current_run();
 		m_currentRunItems[m_currentRunItemCount] = m_store.outer_to_store(std::move(item));
 		++m_currentRunItemCount;
 		++m_itemCount;
@@ -449,20 +527,42 @@ public:
 	
 	void push(const item_type & item) {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
-		if (m_currentRunItemCount >= p.runLength) {
-			sort_current_run();
-			empty_current_run();
-		}
+		if (m_currentRunItemCount >= p.runLength) flush_current_run();
 		m_currentRunItems[m_currentRunItemCount] = m_store.outer_to_store(item);
 		++m_currentRunItemCount;
 		++m_itemCount;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Push a batch of items to merge sorter during phase 1.
+	///
+	/// Has the same effect as pushing the items one at a time, but fills the
+	/// current run in a tight loop.
+	///////////////////////////////////////////////////////////////////////////
+	void push_batch(array_view<const item_type> items) {
+		tp_assert(m_state == stRunFormation, "Wrong phase");
+		const item_type * i = items.data();
+		const item_type * end = i + items.size();
+		while (i != end) {
+			if (m_currentRunItemCount >= p.runLength) flush_current_run();
+			memory_size_type n = std::min<memory_size_type>(end - i, p.runLength - m_currentRunItemCount);
+			for (memory_size_type j = 0; j < n; ++j)
+				m_currentRunItems[m_currentRunItemCount + j] = m_store.outer_to_store(i[j]);
+			m_currentRunItemCount += n;
+			m_itemCount += n;
+			i += n;
+		}
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief End phase 1.
 	///////////////////////////////////////////////////////////////////////////
 	void end() {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
+		if (m_doubleBuffered) {
+			wait_for_run_formation_job();
+			m_pendingRunItems.resize(0);
+		}
 		sort_current_run();
 
 		if (m_itemCount == 0) {
@@ -553,41 +653,151 @@ private:
 	// Phase 1 helpers.
 	///////////////////////////////////////////////////////////////////////////
 
-	void sort_current_run() {
-		parallel_sort(m_currentRunItems.begin(), m_currentRunItems.begin()+m_currentRunItemCount, 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Job sorting and writing the pending run buffer while the
+	/// current run buffer is being filled.
+	///////////////////////////////////////////////////////////////////////////
+	class run_formation_job : public job {
+	public:
+		run_formation_job(merge_sorter & sorter) : m_sorter(sorter) {}
+
+		void operator()() override {
+			try {
+				m_sorter.sort_pending_run();
+				m_sorter.write_run(m_sorter.m_pendingRunItems, m_sorter.m_pendingRunItemCount);
+			} catch (...) {
+				m_sorter.m_runFormationError = std::current_exception();
+			}
+		}
+
+	private:
+		merge_sorter & m_sorter;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Sort the first count items of a run buffer.
+	///
+	/// Uses radix_sort() when pred_t is a radix_pred, and a comparison based
+	/// sort otherwise.
+	/// \param parallel Whether to use parallel_sort or std::sort.
+	///////////////////////////////////////////////////////////////////////////
+	void sort_run(array<store_type> & items, memory_size_type count, bool parallel) {
+		if constexpr (is_radix_pred<pred_t>::value) {
+			const auto & key = pred.key_extractor();
+			radix_sort(items.begin(), items.begin()+count, [&key](const store_type & item) {
+				return key(specific_store_t::store_as_element(item));
+			});
+		} else if (parallel) {
+			parallel_sort(items.begin(), items.begin()+count,
+						  bits::store_pred<pred_t, specific_store_t>(pred));
+		} else {
+			std::sort(items.begin(), items.begin()+count,
 					  bits::store_pred<pred_t, specific_store_t>(pred));
+		}
 	}
 
-	// postcondition: m_currentRunItemCount = 0
-	void empty_current_run() {
+	void sort_current_run() {
+		sort_run(m_currentRunItems, m_currentRunItemCount, true);
+	}
+
+	void sort_pending_run() {
+		// We are running on a job worker. parallel_sort waits for jobs of its
+		// own, so only use it if another worker is around to run them.
+		sort_run(m_pendingRunItems, m_pendingRunItemCount, get_worker_count() > 1);
+	}
+
+	void log_run_write(memory_size_type itemCount) {
 		if (m_finishedRuns < 10)
-			log_pipe_debug() << "Write " << m_currentRunItemCount << " items to run file " << m_finishedRuns << std::endl;
+			log_pipe_debug() << "Write " << itemCount << " items to run file " << m_finishedRuns << std::endl;
 		else if (m_finishedRuns == 10)
 			log_pipe_debug() << "..." << std::endl;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Write the first itemCount items of the given buffer as the next
+	/// run in merge level 0.
+	///////////////////////////////////////////////////////////////////////////
+	void write_run(array<store_type> & items, memory_size_type itemCount) {
 		file_stream<element_type> fs;
 		open_run_file_write(fs, 0, m_finishedRuns);
-		for (memory_size_type i = 0; i < m_currentRunItemCount; ++i)
-			fs.write(m_store.store_to_element(std::move(m_currentRunItems[i])));
-		m_currentRunItemCount = 0;
+		// The first run has no earlier runs to estimate its size on disk from.
+		fs.reserve_bytes(run_bytes(0, m_finishedRuns * static_cast<stream_size_type>(p.runLength), itemCount));
+		for (memory_size_type i = 0; i < itemCount; ++i)
+			fs.write(m_store.store_to_element(std::move(items[i])));
 		++m_finishedRuns;
 	}
 
+	// postcondition: m_currentRunItemCount = 0
+	void empty_current_run() {
+		log_run_write(m_currentRunItemCount);
+		write_run(m_currentRunItems, m_currentRunItemCount);
+		m_currentRunItemCount = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait for the background run formation job, if any, and rethrow
+	/// any exception it raised.
+	///////////////////////////////////////////////////////////////////////////
+	void wait_for_run_formation_job() {
+		if (!m_runFormationJobActive) return;
+		m_runFormationJob.join();
+		m_runFormationJobActive = false;
+		m_pendingRunItemCount = 0;
+		if (m_runFormationError) {
+			std::exception_ptr e = m_runFormationError;
+			m_runFormationError = nullptr;
+			std::rethrow_exception(e);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Sort the full current run and write it to disk.
+	///
+	/// With double buffering, the run is handed to the run formation job
+	/// and the caller may continue filling the other buffer.
+	///////////////////////////////////////////////////////////////////////////
+	// postcondition: m_currentRunItemCount = 0
+	void flush_current_run() {
+		if (!m_doubleBuffered) {
+			sort_current_run();
+			empty_current_run();
+			return;
+		}
+		wait_for_run_formation_job();
+		log_run_write(m_currentRunItemCount);
+		m_currentRunItems.swap(m_pendingRunItems);
+		m_pendingRunItemCount = m_currentRunItemCount;
+		m_currentRunItemCount = 0;
+		m_runFormationJobActive = true;
+		m_runFormationJob.enqueue();
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// Prepare m_merger for merging the runNumber'th to the
 	/// (runNumber+runCount)'th run in mergeLevel.
+	///
+	/// If discardConsumed is true, the run files release their disk space
+	/// as the runs are read, so they must not be read again.
 	///////////////////////////////////////////////////////////////////////////
-	void initialize_merger(memory_size_type mergeLevel, memory_size_type runNumber, memory_size_type runCount) {
+	void initialize_merger(memory_size_type mergeLevel, memory_size_type runNumber, memory_size_type runCount,
+						   bool discardConsumed = false) {
+		initialize_merger(m_merger, mergeLevel, runNumber, runCount, discardConsumed);
+	}
+
+	void initialize_merger(merger_t & m, memory_size_type mergeLevel, memory_size_type runNumber, memory_size_type runCount,
+						   bool discardConsumed = false) {
 		// runCount is a memory_size_type since we must be able to have that
 		// many file_streams open at the same time.
 
 		// Open files and seek to the first item in the run.
 		array<file_stream<element_type> > in(runCount);
 		for (memory_size_type i = 0; i < runCount; ++i) {
+			in[i].set_discard_consumed(discardConsumed);
 			open_run_file_read(in[i], mergeLevel, runNumber+i);
 		}
 		stream_size_type runLength = calculate_run_length(p.runLength, p.fanout, mergeLevel);
 		// Pass file streams with correct stream offsets to the merger
-		m_merger.reset(in, runLength);
+		m.reset(in, runLength);
 	}
 
 	///////////////////////////////////////////////////////////////////////////
@@ -648,10 +858,11 @@ private:
 	///////////////////////////////////////////////////////////////////////////
 	template <typename ProgressIndicator>
 	memory_size_type merge_runs(memory_size_type mergeLevel, memory_size_type runNumber, memory_size_type runCount, ProgressIndicator & pi) {
-		initialize_merger(mergeLevel, runNumber, runCount);
+		initialize_merger(mergeLevel, runNumber, runCount, true);
 		file_stream<element_type> out;
 		memory_size_type nextRunNumber = runNumber/p.fanout;
 		open_run_file_write(out, mergeLevel+1, nextRunNumber);
+		out.reserve_bytes(run_bytes(mergeLevel, m_itemCount, run_items(mergeLevel, runNumber, runCount)));
 		while (m_merger.can_pull()) {
 			pi.step();
 			out.write(m_store.store_to_element(m_merger.pull()));
@@ -659,6 +870,96 @@ private:
 		return nextRunNumber;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Job performing one merge of a merge level in phase 2.
+	///////////////////////////////////////////////////////////////////////////
+	class merge_job : public job {
+	public:
+		merge_job(merge_sorter & sorter)
+			: m_merger(sorter.pred, sorter.m_store, sorter.m_bucket)
+			, m_store(sorter.m_store)
+			, m_items(0)
+		{
+		}
+
+		void operator()() override {
+			try {
+				while (m_merger.can_pull()) {
+					m_out.write(m_store.store_to_element(m_merger.pull()));
+					++m_items;
+				}
+				m_out.close();
+			} catch (...) {
+				m_error = std::current_exception();
+			}
+		}
+
+		merger_t m_merger;
+		file_stream<element_type> m_out;
+		specific_store_t m_store;
+		stream_size_type m_items;
+		std::exception_ptr m_error;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of merges to run concurrently in phase 2.
+	///
+	/// Concurrent merges write to distinct run files, so at most fanout
+	/// merges may run at the same time.
+	///////////////////////////////////////////////////////////////////////////
+	memory_size_type merge_job_count() const {
+		if (get_worker_count() == 0) return 1;
+		return std::min(m_mergeJobs, p.fanout);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Merge all runs in mergeLevel into mergeLevel+1, performing
+	/// several merges at a time on job workers.
+	///
+	/// Run files and run positions are opened on the calling thread in the
+	/// order a sequential merge would use them; only the merging itself
+	/// happens in the jobs.
+	/// \returns The number of runs in mergeLevel+1.
+	///////////////////////////////////////////////////////////////////////////
+	template <typename ProgressIndicator>
+	memory_size_type merge_level_parallel(memory_size_type mergeLevel, memory_size_type runCount, ProgressIndicator & pi) {
+		const memory_size_type jobCount = merge_job_count();
+		std::vector<std::unique_ptr<merge_job> > jobs;
+		for (memory_size_type j = 0; j < jobCount; ++j)
+			jobs.emplace_back(new merge_job(*this));
+
+		memory_size_type newRunCount = 0;
+		memory_size_type i = 0;
+		while (i < runCount) {
+			memory_size_type active = 0;
+			for (; active < jobCount && i < runCount; ++active, i += p.fanout) {
+				memory_size_type n = std::min(runCount-i, p.fanout);
+				if (newRunCount + active < 10)
+					log_pipe_debug() << "Merge " << n << " runs starting from #" << i << " in parallel" << std::endl;
+				else if (newRunCount + active == 10)
+					log_pipe_debug() << "..." << std::endl;
+
+				merge_job & j = *jobs[active];
+				initialize_merger(j.m_merger, mergeLevel, i, n, true);
+				open_run_file_write(j.m_out, mergeLevel+1, i/p.fanout);
+				j.m_out.reserve_bytes(run_bytes(mergeLevel, m_itemCount, run_items(mergeLevel, i, n)));
+				j.m_items = 0;
+			}
+			for (memory_size_type j = 0; j < active; ++j)
+				jobs[j]->enqueue();
+
+			std::exception_ptr error;
+			for (memory_size_type j = 0; j < active; ++j) {
+				jobs[j]->join();
+				pi.step(jobs[j]->m_items);
+				if (jobs[j]->m_error && !error) error = jobs[j]->m_error;
+			}
+			if (error) std::rethrow_exception(error);
+			newRunCount += active;
+		}
+		return newRunCount;
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// Phase 2: Merge all runs and initialize merger for public pulling.
 	///////////////////////////////////////////////////////////////////////////
@@ -676,6 +977,12 @@ private:
 			log_pipe_debug() << "Merge " << runCount << " runs in merge level " << mergeLevel << '\n';
 			m_runPositions.next_level();
 			memory_size_type newRunCount = 0;
+			if (merge_job_count() > 1) {
+				newRunCount = merge_level_parallel(mergeLevel, runCount, pi);
+				++mergeLevel;
+				runCount = newRunCount;
+				continue;
+			}
 			for (memory_size_type i = 0; i < runCount; i += p.fanout) {
 				memory_size_type n = std::min(runCount-i, p.fanout);
 
@@ -766,6 +1073,37 @@ private:
 		return (mergeLevel % 2)*p.fanout + (runNumber % p.fanout);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of items in the runCount runs from runNumber in
+	/// mergeLevel, i.e. the size of the run they are merged into.
+	///////////////////////////////////////////////////////////////////////////
+	stream_size_type run_items(memory_size_type mergeLevel, memory_size_type runNumber, memory_size_type runCount) {
+		stream_size_type runLength = calculate_run_length(p.runLength, p.fanout, mergeLevel);
+		stream_size_type begin = runNumber * runLength;
+		stream_size_type end = std::min(begin + runCount * runLength, m_itemCount);
+		return (end > begin) ? end - begin : 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Estimate the size on disk of the given number of items, from
+	/// the size of the run files of mergeLevel, which hold levelItems items.
+	///
+	/// Runs are compressed, so their size on disk is only known from the
+	/// runs already written. Merging preserves the items and thus about the
+	/// compressed size of each byte.
+	/// \returns The estimate in bytes, or 0 if levelItems is 0.
+	///////////////////////////////////////////////////////////////////////////
+	stream_size_type run_bytes(memory_size_type mergeLevel, stream_size_type levelItems, stream_size_type items) {
+		if (levelItems == 0) return 0;
+		stream_size_type levelBytes = 0;
+		for (memory_size_type i = 0; i < p.fanout; ++i) {
+			std::error_code ec;
+			stream_size_type size = std::filesystem::file_size(m_runFiles[(mergeLevel % 2)*p.fanout + i].path(), ec);
+			if (!ec) levelBytes += size;
+		}
+		return static_cast<stream_size_type>(static_cast<double>(levelBytes) / levelItems * items);
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Open a new run file and seek to the end.
 	///////////////////////////////////////////////////////////////////////////
@@ -775,6 +1113,7 @@ private:
 		memory_size_type idx = run_file_index(mergeLevel, runNumber);
 		if (runNumber < p.fanout) m_runFiles[idx].free();
 		fs.open(m_runFiles[idx], access_read_write, 0, access_sequential, compression_normal);
+		fs.set_io_stats_sink(m_ioStats);
 		fs.seek(0, file_stream_base::end);
 		m_runPositions.set_position(mergeLevel, runNumber, fs.get_position());
 	}
@@ -787,15 +1126,26 @@ private:
 
 		memory_size_type idx = run_file_index(mergeLevel, runNumber);
 		fs.open(m_runFiles[idx], access_read, 0, access_sequential, compression_normal);
+		fs.set_io_stats_sink(m_ioStats);
 		fs.set_position(m_runPositions.get_position(mergeLevel, runNumber));
 	}
 
 	specific_store_t m_store;
-	merger<specific_store_t, pred_t> m_merger;
+	merger_t m_merger;
 
 	// current run buffer. size 0 before begin(), size runLength after begin().
 	array<store_type> m_currentRunItems;
 
+	// With double buffering: the run being sorted and written by
+	// m_runFormationJob. size runLength between begin() and end().
+	array<store_type> m_pendingRunItems;
+	memory_size_type m_pendingRunItemCount;
+
+	bool m_doubleBuffered;
+	run_formation_job m_runFormationJob;
+	bool m_runFormationJobActive;
+	std::exception_ptr m_runFormationError;
+
 	pred_t pred;
 };
 
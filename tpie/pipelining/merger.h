@@ -21,13 +21,21 @@
 #define __TPIE_PIPELINING_MERGER_H__
 
 #include <tpie/internal_priority_queue.h>
+#include <tpie/loser_tree.h>
 #include <tpie/compressed/stream.h>
 #include <tpie/file_stream.h>
 #include <tpie/tpie_assert.h>
 #include <tpie/pipelining/store.h>
 namespace tpie {
 
-template <typename specific_store_t, typename pred_t>
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Merges sorted runs read from file streams.
+///
+/// \tparam queue_t  The structure selecting the next item among the runs;
+/// either loser_tree (the default) or internal_priority_queue.
+///////////////////////////////////////////////////////////////////////////////
+template <typename specific_store_t, typename pred_t,
+		  template <typename, typename> class queue_t = loser_tree>
 class merger {
 private:
 	typedef typename specific_store_t::store_type store_type;
@@ -35,6 +43,9 @@ private:
 
 	typedef bits::store_pred<pred_t, specific_store_t> store_pred_t;
 public:
+	class predwrap;
+	typedef queue_t<std::pair<store_type, size_t>, predwrap> queue_type;
+
 	merger(pred_t pred, specific_store_t store,
 				  memory_bucket_ref bucket = memory_bucket_ref())
 		: pq(0, predwrap(store_pred_t(pred)), bucket)
@@ -95,11 +106,11 @@ public:
 			linear_memory_usage(-sizeof(file_stream<element_type>) //in filestreams,
 								+ file_stream<element_type>::memory_usage(), //in filestreams
 								sizeof(merger) 
-								- sizeof(internal_priority_queue<std::pair<store_type, size_t>, predwrap>) //pq
+								- sizeof(queue_type) //pq
 								- sizeof(array<file_stream<element_type> >) //in
 								- sizeof(array<size_t>)) // itemsRead
 			+ array<size_t>::memory_usage() //itemsRead
-			+ internal_priority_queue<std::pair<store_type, size_t>, predwrap>::memory_usage() //pq
+			+ queue_type::memory_usage() //pq
 			+ array<file_stream<element_type> >::memory_usage(); //in
 	}
 	
@@ -129,7 +140,7 @@ public:
 	};
 
 private:
-	internal_priority_queue<std::pair<store_type, size_t>, predwrap> pq;
+	queue_type pq;
 	array<file_stream<element_type> > in;
 	array<stream_size_type> itemsRead;
 	stream_size_type runLength;
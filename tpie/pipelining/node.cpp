@@ -73,6 +73,7 @@ node::node()
 	, m_pi(0)
 	, m_state(STATE_FRESH)
 	, m_plotOptions()
+	, m_ioStats(std::make_shared<io_stats>())
 {
 }
 
@@ -84,6 +85,8 @@ node::node(node && other)
 	, m_pi(std::move(other.m_pi))
 	, m_state(std::move(other.m_state))
 	, m_plotOptions(std::move(other.m_plotOptions))
+	, m_ioStats(std::move(other.m_ioStats))
+	, m_profile(other.m_profile)
 {
 	if (m_state != STATE_FRESH)
 		throw call_order_exception(
@@ -98,6 +101,8 @@ node & node::operator=(node && other) {
 	m_pi = std::move(other.m_pi);
 	m_state = std::move(other.m_state);
 	m_plotOptions = std::move(other.m_plotOptions);
+	m_ioStats = std::move(other.m_ioStats);
+	m_profile = other.m_profile;
 	return *this;
 }
 
@@ -108,6 +113,7 @@ node::node(const node_token & token)
 	, m_pi(0)
 	, m_state(STATE_FRESH)
 	, m_plotOptions()
+	, m_ioStats(std::make_shared<io_stats>())
 {
 }
 
@@ -29,8 +29,10 @@
 #include <tpie/pipelining/predeclare.h>
 #include <tpie/pipelining/node_name.h>
 #include <tpie/pipelining/node_traits.h>
+#include <tpie/pipelining/profile.h>
 #include <tpie/flags.h>
 #include <tpie/memory.h>
+#include <tpie/stats.h>
 #include <limits>
 #include <tpie/resources.h>
 
@@ -389,6 +391,15 @@ public:
 		m_parameters.name = m_parameters.name.empty() ? breadcrumb : (breadcrumb + " | " + m_parameters.name);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Used internally by node wrappers such as bits::profiled to name
+	/// the node after the wrapped type, unless the node has a name.
+	///////////////////////////////////////////////////////////////////////////
+	void set_name_from_type(const std::type_info & type) {
+		if (m_parameters.name.empty())
+			m_parameters.name = bits::extract_pipe_name(type.name());
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Used internally for progress indication. Get the number of times
 	/// the node expects to call step() at most.
@@ -415,6 +426,29 @@ public:
 		return m_pi;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  The blocks read and written by the streams of this node.
+	///
+	/// Nodes that read or write streams pass this to set_io_stats_sink of
+	/// their streams in begin(), and the runtime reports it for each node
+	/// in the phase when the phase is done.
+	///////////////////////////////////////////////////////////////////////////
+	const std::shared_ptr<io_stats> & get_io_stats() const {
+		return m_ioStats;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  The items passed through and the time spent in this node; see
+	/// profile.h.
+	///////////////////////////////////////////////////////////////////////////
+	node_profile & get_profile() {
+		return m_profile;
+	}
+
+	const node_profile & get_profile() const {
+		return m_profile;
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Used internally to check order of method calls.
 	///////////////////////////////////////////////////////////////////////////
@@ -811,6 +845,8 @@ private:
 	resource_type m_resourceBeingAssigned = NO_RESOURCE;
 	std::unique_ptr<progress_indicator_base> m_piProxy;
 	flags<PLOT> m_plotOptions;
+	std::shared_ptr<io_stats> m_ioStats;
+	node_profile m_profile;
 
 	friend class bits::proxy_progress_indicator;
 };
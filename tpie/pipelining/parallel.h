@@ -37,11 +37,10 @@
 /// parallel_bits::befores running in different threads, and the consumer
 /// receives the items pushed to each after instance.
 ///
-/// All nodes have access to a single parallel_bits::state instance
-/// which has the mutex and the necessary condition variables.
-///    It also has pointers to the parallel_bits::before and
-/// parallel_bits::after instances and it holds an array of worker states (of
-/// enum type parallel_bits::worker_state).
+/// All nodes have access to a single parallel_bits::state instance.
+///    It has pointers to the parallel_bits::before and parallel_bits::after
+/// instances and to the batch rings through which they exchange items with
+/// the main thread.
 ///    It also has a options struct which contains the user-supplied
 /// parameters to the framework (size of item buffer and number of concurrent
 /// workers).
@@ -50,26 +49,43 @@
 /// since we get deadlocks if some of the workers are allowed to wait for a
 /// ready tpie::job worker. Instead, we use std::threads directly.
 ///
-/// Parallel worker states. The main thread has a condition variable
-/// (producerCond) which is signalled every time a worker changes its own
-/// state. Each worker thread has a condition variable (workerCond[]) which is
-/// signalled when the main thread changes the worker's state.
+/// Hand-off. Each worker has an input and an output parallel_bits::batch_ring
+/// of a few batches of bufSize items. Both are single-producer,
+/// single-consumer queues, so the main thread and a worker exchange batches
+/// by updating an atomic counter, without a shared lock. A worker thus holds
+/// 2 * batch_ring::slots batches rather than one input and one output buffer;
+/// the producer asks for the memory of all of them as its minimum memory.
 ///
-/// Initializing: Before the input/output buffers are initialized.
-/// -> Idle (worker thread)
 ///
-/// Idle: Input/output buffers are empty.
-/// -> Processing (main thread)
+/// The producer writes items directly into an input batch of a worker with
+/// room for one, choosing the workers in round-robin order. When the batch is
+/// full, it is pushed to the worker, and the producer consumes the available
+/// output batches before filling the next batch.
 ///
-/// Processing: Input buffer is full; output buffer is empty.
-/// -> Partial output (worker thread; signals main)
-/// -> Outputting (worker thread)
+/// The worker pushes the items of each input batch through its pipeline. The
+/// after instance fills output batches and pushes them to the main thread.
+/// When the order of items must be maintained, the output batch concluding an
+/// input batch is marked as the last one, and the producer only consumes the
+/// output of the worker that got the oldest input batch.
 ///
-/// Partial output: Output buffer is full; input buffer is non-empty.
-/// -> Processing (main thread)
+/// A side only sleeps when it cannot make progress; see
+/// parallel_bits::wakeup. The other side notices this when it notifies,
+/// so a notification costs a lock and a system call only when the other side
+/// actually sleeps.
 ///
-/// Outputting: Output buffer is full; input buffer is empty.
-/// -> Idle (main thread)
+/// In end(), the producer closes the input of all workers, consumes their
+/// output until all worker threads have exited and then lets the after
+/// instances pass items pushed in end() directly to the consumer.
+///
+/// Exceptions thrown in a worker are passed to the main thread, which then
+/// stops all workers and rethrows the exception.
+///
+/// Adaptive mode (parallel_adaptive). The workers measure the time spent on
+/// each batch and the producer measures the time it waits for the workers.
+/// From these, parallel_bits::adaptive_tuning chooses how many items the
+/// producer puts in a batch and how many workers it gives input to; the
+/// other workers are parked, sleeping on their empty input ring. The batch
+/// capacity is chosen to fit the memory assigned to the producer.
 ///
 /// TODO at some future point: Optimize code for the case where the buffer size
 /// is one.
@@ -77,6 +93,8 @@
 
 #include <tpie/pipelining/parallel/options.h>
 #include <tpie/pipelining/parallel/worker_state.h>
+#include <tpie/pipelining/parallel/adaptive.h>
+#include <tpie/pipelining/parallel/batch_ring.h>
 #include <tpie/pipelining/parallel/aligned_array.h>
 #include <tpie/pipelining/parallel/base.h>
 #include <tpie/pipelining/parallel/factory.h>
@@ -0,0 +1,151 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_PARALLEL_ADAPTIVE_H__
+#define __TPIE_PIPELINING_PARALLEL_ADAPTIVE_H__
+
+#include <tpie/types.h>
+#include <algorithm>
+
+namespace tpie::pipelining::parallel_bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Chooses the batch size and the number of active workers of an
+/// adaptive parallel() node from measurements of its recent past.
+///
+/// The producer calls update() every few batches with what it measured since
+/// the previous call. Each update changes at most one of the two parameters:
+///
+/// - If the workers spend less than minBatchTime on a batch, the hand-off
+///   costs too much relative to the work, and the batch size is doubled. If
+///   they spend more than maxBatchTime, it is halved, so that the work is
+///   spread more evenly over the workers.
+/// - If the producer spends more than a tenth of the time waiting for the
+///   workers, another batch of workers is activated. If that does not
+///   improve the throughput by at least 5%, e.g. because there are no idle
+///   cores, the added workers are parked again and the count is held for a
+///   while.
+/// - If the active workers are busy less than half of the time, the producer
+///   (or what consumes the output) is the bottleneck, and a worker is parked.
+///////////////////////////////////////////////////////////////////////////////
+class adaptive_tuning {
+public:
+	/** Smallest batch size used. */
+	static constexpr memory_size_type minBatchSize = 64;
+	/** Batch size used before the first measurement. */
+	static constexpr memory_size_type initialBatchSize = 2048;
+	static constexpr double minBatchTime = 50e-6;
+	static constexpr double maxBatchTime = 5e-3;
+	/** Number of updates to keep the worker count after a failed increase. */
+	static constexpr size_t holdUpdates = 16;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Measurements since the previous update.
+	///////////////////////////////////////////////////////////////////////////
+	struct window {
+		/** Wall clock time. */
+		double seconds;
+		/** Time the producer waited for a worker to take input or to
+		 * produce output. */
+		double stallSeconds;
+		/** Time the workers spent processing batches, summed over the
+		 * workers. */
+		double busySeconds;
+		/** Number of batches the workers have processed. */
+		stream_size_type batches;
+		/** Number of items the producer has dispatched. */
+		stream_size_type items;
+	};
+
+	adaptive_tuning(size_t maxJobs, memory_size_type maxBatchSize)
+		: m_maxJobs(std::max<size_t>(maxJobs, 1))
+		, m_maxBatchSize(std::max(maxBatchSize, static_cast<memory_size_type>(1)))
+		, m_activeJobs(1)
+		, m_batchSize(std::min(initialBatchSize, m_maxBatchSize))
+		, m_ceiling(m_maxJobs)
+		, m_hold(0)
+		, m_previousJobs(0)
+		, m_previousThroughput(0)
+	{
+	}
+
+	size_t active_jobs() const { return m_activeJobs; }
+
+	memory_size_type batch_size() const { return m_batchSize; }
+
+	void update(const window & w) {
+		if (w.seconds <= 0) return;
+		double throughput = w.items / w.seconds;
+
+		if (m_previousJobs != 0) {
+			// The previous update activated more workers; keep them only if
+			// they helped.
+			if (throughput < 1.05 * m_previousThroughput) {
+				m_ceiling = m_previousJobs;
+				m_activeJobs = m_previousJobs;
+				m_hold = holdUpdates;
+			}
+			m_previousJobs = 0;
+			return;
+		}
+
+		if (m_hold > 0 && --m_hold == 0) m_ceiling = m_maxJobs;
+
+		if (w.batches > 0) {
+			double batchTime = w.busySeconds / w.batches;
+			if (batchTime < minBatchTime && m_batchSize < m_maxBatchSize) {
+				m_batchSize = std::min(2 * m_batchSize, m_maxBatchSize);
+				return;
+			}
+			if (batchTime > maxBatchTime && m_batchSize > minBatchSize) {
+				m_batchSize = std::max(m_batchSize / 2, std::min(minBatchSize, m_maxBatchSize));
+				return;
+			}
+		}
+
+		if (w.stallSeconds > 0.1 * w.seconds && m_activeJobs < m_ceiling) {
+			m_previousJobs = m_activeJobs;
+			m_previousThroughput = throughput;
+			m_activeJobs = std::min(2 * m_activeJobs, m_ceiling);
+			return;
+		}
+
+		if (w.busySeconds < 0.5 * w.seconds * m_activeJobs && m_activeJobs > 1) {
+			--m_activeJobs;
+		}
+	}
+
+private:
+	size_t m_maxJobs;
+	memory_size_type m_maxBatchSize;
+	size_t m_activeJobs;
+	memory_size_type m_batchSize;
+	/** Largest number of active workers to try. */
+	size_t m_ceiling;
+	/** Updates left before m_ceiling is reset. */
+	size_t m_hold;
+	/** Number of active workers before the previous update activated more,
+	 * or zero. */
+	size_t m_previousJobs;
+	double m_previousThroughput;
+};
+
+} // namespace tpie::pipelining::parallel_bits
+
+#endif // __TPIE_PIPELINING_PARALLEL_ADAPTIVE_H__
@@ -26,9 +26,11 @@
 #include <memory>
 #include <tpie/pipelining/maintain_order_type.h>
 #include <tpie/pipelining/parallel/options.h>
-#include <tpie/pipelining/parallel/worker_state.h>
+#include <tpie/pipelining/parallel/batch_ring.h>
+#include <tpie/pipelining/parallel/adaptive.h>
 #include <tpie/pipelining/parallel/aligned_array.h>
 #include <thread>
+#include <chrono>
 
 namespace tpie::pipelining::parallel_bits {
 
@@ -179,11 +181,6 @@ public:
 ///////////////////////////////////////////////////////////////////////////////
 class after_base : public node {
 public:
-	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Called by before::worker to initialize buffers.
-	///////////////////////////////////////////////////////////////////////////
-	virtual void worker_initialize() = 0;
-
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Called by before::worker after a batch of items has
 	/// been pushed.
@@ -196,50 +193,78 @@ public:
 	virtual void set_consumer(node *) = 0;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Thrown in a worker thread by after::push when the producer has
+/// stopped the workers, to unwind the worker pipeline.
+///////////////////////////////////////////////////////////////////////////////
+struct worker_aborted {};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Measurements of a worker, maintained when the node is adaptive.
+///////////////////////////////////////////////////////////////////////////////
+struct alignas(64) worker_stats {
+	/** Nanoseconds spent processing input batches, including the time spent
+	 * waiting for the main thread to take the output. */
+	std::atomic<stream_size_type> busyTime;
+	/** Number of input batches processed. */
+	std::atomic<stream_size_type> batches;
+
+	worker_stats()
+		: busyTime(0)
+		, batches(0)
+	{
+	}
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Common state in parallel pipelining library.
 /// This class is instantiated once and kept in a std::shared_ptr, and it is
 /// not copy constructible.
 ///
-/// Unless noted otherwise, a thread must own the state mutex to access other
-/// parts of this instance.
+/// The producer and each worker exchange batches through a pair of
+/// batch_rings (see state), so the members here are only used to wait for
+/// the other side and to stop the workers.
 ///////////////////////////////////////////////////////////////////////////////
 class state_base {
 public:
-	typedef std::mutex mutex_t;
-	typedef std::condition_variable cond_t;
-	typedef std::unique_lock<std::mutex> lock_t;
-
 	const options opts;
 
-	/** Single mutex. */
-	mutex_t mutex;
-
-	/** Condition variable.
-	 *
-	 * Who waits: The producer, with the single mutex (waits until at least one
-	 * worker has state = IDLE or state = OUTPUTTING).
-	 *
-	 * Who signals: The par_after, when a worker is OUTPUTTING. */
-	cond_t producerCond;
-
-	/** Condition variable, one per worker.
-	 *
-	 * Who waits: The worker's par_before when waiting for input (wait for
-	 * state = PROCESSING), the worker's par_after when waiting for output to
-	 * be read (wait for state = IDLE). Waits with the single mutex.
-	 *
-	 * Who signals: par_producer, when input has been written (sets state to PROCESSING).
-	 * par_consumer, when output has been read (sets state to IDLE).
-	 */
-	cond_t * workerCond;
-
-	/** Shared state, must have mutex to write. */
-	size_t runningWorkers;
+	/** Guards eptr. */
+	std::mutex mutex;
+
+	/** Waited on by the producer. Notified by a worker when it has pushed an
+	 * output batch, taken an input batch, failed or stopped. */
+	wakeup producerWakeup;
+
+	/** One per worker, waited on by the worker. Notified by the producer when
+	 * it has pushed an input batch, taken an output batch, closed the input
+	 * or stopped the workers. */
+	std::unique_ptr<wakeup[]> workerWakeup;
+
+	/** One per worker: set by the producer when it will push no more input
+	 * batches to the worker. */
+	std::unique_ptr<std::atomic<bool>[]> inputClosed;
+
+	/** Number of worker threads that have been started and not yet exited. */
+	std::atomic<size_t> runningWorkers;
+
+	/** Set when the workers must stop as soon as possible. */
+	std::atomic<bool> aborted;
+
+	/** Set when eptr has been set. */
+	std::atomic<bool> failed;
 
 	/** Exception thrown in worker thread to be rethrown in main thread. */
 	std::exception_ptr eptr;
 
+	/** Number of items a batch can hold. This is opts.bufSize, unless the
+	 * node is adaptive, in which case the producer lowers it to fit its
+	 * memory assignment before begin(). */
+	memory_size_type batchCapacity;
+
+	/** One per worker if opts.adaptive. */
+	std::unique_ptr<worker_stats[]> stats;
+
 	/// Must not be used concurrently.
 	void set_input_ptr(size_t idx, node * v) {
 		m_inputs[idx] = v;
@@ -254,8 +279,6 @@ public:
 	/// \brief  Get the specified before instance.
 	///
 	/// Enables easy construction of the pipeline graph at runtime.
-	///
-	/// Shared state, must have mutex to use.
 	///////////////////////////////////////////////////////////////////////////
 	node & input(size_t idx) { return *m_inputs[idx]; }
 
@@ -266,97 +289,52 @@ public:
 	/// First, it enables easy construction of the pipeline graph at runtime.
 	/// Second, it is used by before to send batch signals to
 	/// after.
-	///
-	/// Shared state, must have mutex to use.
 	///////////////////////////////////////////////////////////////////////////
 	after_base & output(size_t idx) { return *m_outputs[idx]; }
 
-	/// Shared state, must have mutex to use.
-	worker_state get_state(size_t idx) {
-		return m_states[idx];
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Called in a worker thread to pass an exception to the main
+	/// thread. Only the first exception is kept.
+	///////////////////////////////////////////////////////////////////////////
+	void set_error(std::exception_ptr e) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!eptr) eptr = e;
+		}
+		failed.store(true);
+		producerWakeup.notify();
 	}
 
-	/// Shared state, must have mutex to use.
-	void transition_state(size_t idx, worker_state from, worker_state to) {
-		if (m_states[idx] != from) {
-			std::stringstream ss;
-			ss << idx << " Invalid state transition " << from << " -> " << to << "; current state is " << m_states[idx];
-			log_error() << ss.str() << std::endl;
-			throw exception(ss.str());
-		}
-		m_states[idx] = to;
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Make all workers stop as soon as possible.
+	///////////////////////////////////////////////////////////////////////////
+	void abort() {
+		aborted.store(true);
+		for (size_t i = 0; i < opts.numJobs; ++i)
+			workerWakeup[i].notify();
 	}
 
 protected:
 	std::vector<node *> m_inputs;
 	std::vector<after_base *> m_outputs;
-	std::vector<worker_state> m_states;
 
 	state_base(const options opts)
 		: opts(opts)
+		, workerWakeup(new wakeup[opts.numJobs])
+		, inputClosed(new std::atomic<bool>[opts.numJobs])
 		, runningWorkers(0)
+		, aborted(false)
+		, failed(false)
+		, batchCapacity(opts.bufSize)
+		, stats(opts.adaptive ? new worker_stats[opts.numJobs] : nullptr)
 		, m_inputs(opts.numJobs, 0)
 		, m_outputs(opts.numJobs, 0)
-		, m_states(opts.numJobs, INITIALIZING)
 	{
-		workerCond = new cond_t[opts.numJobs];
-	}
-
-	virtual ~state_base() {
-		delete[] workerCond;
-	}
-};
-
-///////////////////////////////////////////////////////////////////////////////
-/// \brief Instantiated in each thread.
-///////////////////////////////////////////////////////////////////////////////
-template <typename T>
-class parallel_input_buffer {
-	memory_size_type m_inputSize;
-	array<T> m_inputBuffer;
-
-public:
-	array_view<T> get_input() {
-		return array_view<T>(&m_inputBuffer[0], m_inputSize);
-	}
-
-	void set_input(array_view<T> input) {
-		if (input.size() > m_inputBuffer.size())
-			throw tpie::exception(m_inputBuffer.size() ? "Input too large" : "Input buffer not initialized");
-
-		memory_size_type items =
-			std::copy(input.begin(), input.end(), m_inputBuffer.begin())
-			-m_inputBuffer.begin();
-
-		m_inputSize = items;
+		for (size_t i = 0; i < opts.numJobs; ++i)
+			inputClosed[i].store(false);
 	}
 
-	parallel_input_buffer(const options & opts)
-		: m_inputSize(0)
-		, m_inputBuffer(opts.bufSize)
-	{
-	}
-};
-
-///////////////////////////////////////////////////////////////////////////////
-/// \brief Instantiated in each thread.
-///////////////////////////////////////////////////////////////////////////////
-template <typename T>
-class parallel_output_buffer {
-	memory_size_type m_outputSize;
-	array<T> m_outputBuffer;
-	friend class after<T>;
-
-public:
-	array_view<T> get_output() {
-		return array_view<T>(&m_outputBuffer[0], m_outputSize);
-	}
-
-	parallel_output_buffer(const options & opts)
-		: m_outputSize(0)
-		, m_outputBuffer(opts.bufSize)
-	{
-	}
+	virtual ~state_base() {}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -377,18 +355,17 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief State subclass containing the item type specific state, i.e. the
-/// input/output buffers and the concrete pipes.
+/// input/output batch rings and the concrete pipes.
 ///////////////////////////////////////////////////////////////////////////////
 template <typename T1, typename T2>
 class state : public state_base {
 public:
 	typedef std::shared_ptr<state> ptr;
-	typedef state_base::mutex_t mutex_t;
-	typedef state_base::cond_t cond_t;
-	typedef state_base::lock_t lock_t;
 
-	array<parallel_input_buffer<T1> *> m_inputBuffers;
-	array<parallel_output_buffer<T2> *> m_outputBuffers;
+	/** Input ring of each worker, owned by its before. */
+	array<batch_ring<T1> *> m_inputRings;
+	/** Output ring of each worker, owned by its after. */
+	array<batch_ring<T2> *> m_outputRings;
 
 	consumer<T2> * m_cons;
 
@@ -397,8 +374,8 @@ public:
 	template <typename fact_t>
 	state( options opts, fact_t && fact)
 		: state_base(opts)
-		, m_inputBuffers(opts.numJobs)
-		, m_outputBuffers(opts.numJobs)
+		, m_inputRings(opts.numJobs)
+		, m_outputRings(opts.numJobs)
 		, m_cons(0)
 	{
 		typedef threads_impl<T1, T2, fact_t> pipes_impl_t;
@@ -420,13 +397,19 @@ public:
 template <typename T>
 class after : public after_base {
 protected:
+	typedef typename batch_ring<T>::batch batch_t;
+
 	state_base & st;
 	size_t parId;
-	std::unique_ptr<parallel_output_buffer<T> > m_buffer;
-	array<parallel_output_buffer<T> *> & m_outputBuffers;
-	typedef state_base::lock_t lock_t;
+	std::unique_ptr<batch_ring<T> > m_ring;
+	array<batch_ring<T> *> & m_outputRings;
 	consumer<T> * const * m_cons;
 
+	/** Output batch being filled, or nullptr. */
+	batch_t * m_batch;
+	T * m_pos;
+	T * m_end;
+
 public:
 	typedef T item_type;
 
@@ -435,8 +418,11 @@ public:
 				   size_t parId)
 		: st(state)
 		, parId(parId)
-		, m_outputBuffers(state.m_outputBuffers)
+		, m_outputRings(state.m_outputRings)
 		, m_cons(state.get_consumer_ptr_ptr())
+		, m_batch(nullptr)
+		, m_pos(nullptr)
+		, m_end(nullptr)
 	{
 		state.set_output_ptr(parId, this);
 		set_name("Parallel after", PRIORITY_INSIGNIFICANT);
@@ -453,34 +439,39 @@ public:
 		: after_base(std::move(other))
 		, st(other.st)
 		, parId(std::move(other.parId))
-		, m_outputBuffers(other.m_outputBuffers)
-		, m_cons(std::move(other.m_cons)) {
+		, m_outputRings(other.m_outputRings)
+		, m_cons(std::move(other.m_cons))
+		, m_batch(nullptr)
+		, m_pos(nullptr)
+		, m_end(nullptr)
+	{
 		st.set_output_ptr(parId, this);
 		if (m_cons == 0) throw tpie::exception("Unexpected nullptr in move");
 		if (*m_cons != 0) throw tpie::exception("Expected nullptr in move");
 	}
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief Push to thread-local buffer; flush it when full.
+	/// \brief  Allocate the output ring before the worker thread starts.
 	///////////////////////////////////////////////////////////////////////////
-	void push(const T & item) {
-		if (m_buffer->m_outputSize >= m_buffer->m_outputBuffer.size())
-			flush_buffer_impl(false);
-
-		m_buffer->m_outputBuffer[m_buffer->m_outputSize++] = item;
-	}
-
-	void end() override {
-		flush_buffer_impl(true);
-		m_buffer.reset();
+	void begin() override {
+		m_ring.reset(new batch_ring<T>(st.batchCapacity));
+		m_outputRings[parId] = m_ring.get();
 	}
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Invoked by before::worker (in worker thread context).
+	/// \brief Push to the current output batch; hand it over when full.
 	///////////////////////////////////////////////////////////////////////////
-	void worker_initialize() override {
-		m_buffer.reset(new parallel_output_buffer<T>(st.opts));
-		m_outputBuffers[parId] = m_buffer.get();
+	void push(const T & item) {
+		if (m_pos == m_end) flush_batch(false);
+		*m_pos++ = item;
+	}
+
+	void end() override {
+		flush_batch(true);
+		m_batch = nullptr;
+		m_pos = m_end = nullptr;
+		m_outputRings[parId] = nullptr;
+		m_ring.reset();
 	}
 
 	///////////////////////////////////////////////////////////////////////////
@@ -488,67 +479,63 @@ public:
 	/// pushed.
 	///////////////////////////////////////////////////////////////////////////
 	void flush_buffer() override {
-		flush_buffer_impl(true);
+		flush_batch(true);
 	}
 
 private:
-	bool is_done() const {
-		switch (st.get_state(parId)) {
-			case INITIALIZING:
-				throw tpie::exception("INITIALIZING not expected in after::is_done");
-			case IDLE:
-				return true;
-			case PROCESSING:
-				// The main thread may transition us from Outputting to Idle to
-				// Processing without us noticing, or it may transition us from
-				// Partial_Output to Processing. In either case, we are done
-				// flushing the buffer.
-				return true;
-			case PARTIAL_OUTPUT:
-			case OUTPUTTING:
-				return false;
-			case DONE:
-				return true;
-		}
-		throw tpie::exception("Unknown state");
-	}
-
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Send a signal to the main thread that the output buffer must
-	/// be emptied.
+	/// \brief  Hand the current output batch to the main thread.
 	///
-	/// If this is in response to a full output buffer before the input buffer
-	/// has been processed, `complete == false`. In this case, we transition
-	/// to PARTIAL_OUTPUT and the main thread will transition us to PROCESSING
-	/// after consuming our output buffer.
+	/// When the producer maintains the order of items, it needs to know when
+	/// a worker is done with an input batch, so in that case we send a batch
+	/// with `last == true` after each input batch, even if it is empty.
 	///
-	/// If this is in response to an empty input buffer, `complete == true`,
-	/// and we transition to OUTPUTTING and the main thread will transition us
-	/// to IDLE.
+	/// After the producer has ended, the worker threads have exited and we
+	/// are called in the main thread from the end() of the worker pipeline;
+	/// the items are then passed directly to the consumer.
 	///
-	/// \param  complete  Whether the entire input has been processed.
-	///////////////////////////////////////////////////////////////////////////
-	void flush_buffer_impl(bool complete) {
-		// At this point, we could check if the output buffer is empty and
-		// short-circuit when it is without acquiring the lock; however, we
-		// must do a full PROCESSING -> OUTPUTTING -> IDLE transition in this
-		// case to let the main thread know that we are done processing the
-		// input.
-
-		lock_t lock(st.mutex);
-		if (st.get_state(parId) == DONE) {
-			if (*m_cons == 0) throw tpie::exception("Unexpected nullptr in flush_buffer");
-			array_view<T> out = m_buffer->get_output();
-			(*m_cons)->consume(out);
-		} else {
-			st.transition_state(parId, PROCESSING, complete ? OUTPUTTING : PARTIAL_OUTPUT);
-			// notify producer that output is ready
-			st.producerCond.notify_one();
-			while (!is_done()) {
-				st.workerCond[parId].wait(lock);
+	/// \param  last  Whether the entire input batch has been processed.
+	///////////////////////////////////////////////////////////////////////////
+	void flush_batch(bool last) {
+		if (*m_cons != 0) {
+			if (m_batch != nullptr) {
+				(*m_cons)->consume(array_view<T>(m_batch->items.get(), m_pos));
+				m_pos = m_batch->items.get();
+			} else if (!last) {
+				acquire_batch();
+			}
+			return;
+		}
+
+		if (m_batch == nullptr && last && st.opts.maintainOrder)
+			acquire_batch();
+
+		if (m_batch != nullptr) {
+			m_batch->size = m_pos - m_batch->items.get();
+			m_batch->last = last;
+			if (m_batch->size > 0 || (last && st.opts.maintainOrder)) {
+				m_ring->push();
+				st.producerWakeup.notify();
+				m_batch = nullptr;
+				m_pos = m_end = nullptr;
 			}
 		}
-		m_buffer->m_outputSize = 0;
+
+		if (!last && m_batch == nullptr) acquire_batch();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Wait until the main thread has room for another output batch.
+	///////////////////////////////////////////////////////////////////////////
+	void acquire_batch() {
+		batch_t * b = nullptr;
+		st.workerWakeup[parId].wait([&] {
+			return (b = m_ring->back()) != nullptr || st.aborted.load();
+		});
+		if (b == nullptr) throw worker_aborted();
+		m_batch = b;
+		m_pos = b->items.get();
+		m_end = m_pos + b->items.size();
 	}
 };
 
@@ -560,10 +547,12 @@ private:
 template <typename T>
 class before : public node {
 protected:
+	typedef typename batch_ring<T>::batch batch_t;
+
 	state_base & st;
 	size_t parId;
-	std::unique_ptr<parallel_input_buffer<T> > m_buffer;
-	array<parallel_input_buffer<T> *> & m_inputBuffers;
+	std::unique_ptr<batch_ring<T> > m_ring;
+	array<batch_ring<T> *> & m_inputRings;
 	std::thread m_worker;
 
 	///////////////////////////////////////////////////////////////////////////
@@ -575,7 +564,7 @@ protected:
 	before(state<T, Output> & st, size_t parId)
 		: st(st)
 		, parId(parId)
-		, m_inputBuffers(st.m_inputBuffers)
+		, m_inputRings(st.m_inputRings)
 	{
 		set_name("Parallel before", PRIORITY_INSIGNIFICANT);
 		set_plot_options(PLOT_PARALLEL | PLOT_SIMPLIFIED_HIDE);
@@ -585,18 +574,25 @@ protected:
 	before(const before & other)
 		: st(other.st)
 		, parId(other.parId)
-		, m_inputBuffers(other.m_inputBuffers)
+		, m_inputRings(other.m_inputRings)
 	{
 	}
 
 	~before() {
-		state_base::lock_t lock(st.mutex);
-
-		auto s = st.get_state(parId);
-		tp_assert_release(s == INITIALIZING || s == DONE, "State should be INITIALIZING or DONE in before::~before");
+		stop_worker();
+	}
 
-		if (m_worker.joinable())
-			m_worker.join();
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Stop and join the worker thread if it is still running.
+	///
+	/// Normally the producer has already stopped it; this is called from the
+	/// destructor of the subclass as well, since the worker thread uses the
+	/// worker pipeline which is destroyed before ~before runs.
+	///////////////////////////////////////////////////////////////////////////
+	void stop_worker() {
+		if (!m_worker.joinable()) return;
+		st.abort();
+		m_worker.join();
 	}
 
 public:
@@ -604,54 +600,36 @@ public:
 
 	void begin() override {
 		node::begin();
+		m_ring.reset(new batch_ring<T>(st.batchCapacity));
+		m_inputRings[parId] = m_ring.get();
+		// Counted here rather than in the thread, so that the producer does
+		// not think the worker is done before it has started.
+		++st.runningWorkers;
 		std::thread t(run_worker, this);
 		m_worker.swap(t);
 	}
 
 	void end() override {
-		m_buffer.reset();
+		// The producer has waited for the worker thread to exit.
+		if (m_worker.joinable()) m_worker.join();
+		m_inputRings[parId] = nullptr;
+		m_ring.reset();
 	}
 private:
-	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Check if we are ready to process a batch of input.
-	///////////////////////////////////////////////////////////////////////////
-	bool ready() {
-		switch (st.get_state(parId)) {
-			case INITIALIZING:
-				throw tpie::exception("INITIALIZING not expected in before::ready");
-			case IDLE:
-				return false;
-			case PROCESSING:
-				return true;
-			case PARTIAL_OUTPUT:
-				throw tpie::exception("State 'partial_output' was not expected in before::ready");
-			case OUTPUTTING:
-				throw tpie::exception("State 'outputting' was not expected in before::ready");
-			case DONE:
-				return false;
-		}
-		throw tpie::exception("Unknown state");
-	}
-
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Class providing RAII-style bookkeeping of number of workers.
 	///////////////////////////////////////////////////////////////////////////
 	class running_signal {
-		typedef state_base::cond_t cond_t;
-		memory_size_type & sig;
-		cond_t & producerCond;
+		state_base & st;
 	public:
-		running_signal(memory_size_type & sig, cond_t & producerCond)
-			: sig(sig)
-			, producerCond(producerCond)
+		running_signal(state_base & st)
+			: st(st)
 		{
-			++sig;
-			producerCond.notify_one();
 		}
 
 		~running_signal() {
-			--sig;
-			producerCond.notify_one();
+			--st.runningWorkers;
+			st.producerWakeup.notify();
 		}
 	};
 
@@ -663,40 +641,39 @@ private:
 	/// \brief  Worker thread entry point.
 	///////////////////////////////////////////////////////////////////////////
 	void worker() {
-		state_base::lock_t lock(st.mutex);
-
-		m_buffer.reset(new parallel_input_buffer<T>(st.opts));
-		m_inputBuffers[parId] = m_buffer.get();
-
-		// virtual invocation
-		st.output(parId).worker_initialize();
-
-		st.transition_state(parId, INITIALIZING, IDLE);
-		running_signal _(st.runningWorkers, st.producerCond);
+		running_signal _(st);
+		batch_ring<T> & ring = *m_ring;
 		while (true) {
-			// wait for transition IDLE -> PROCESSING
-			while (!ready()) {
-				if (st.get_state(parId) == DONE) {
-					return;
-				}
-				st.workerCond[parId].wait(lock);
-			}
-			lock.unlock();
-
+			batch_t * b = nullptr;
+			st.workerWakeup[parId].wait([&] {
+				return (b = ring.front()) != nullptr
+					|| st.inputClosed[parId].load()
+					|| st.aborted.load();
+			});
+			if (st.aborted.load()) return;
+			// The input may have been closed after the last batch was pushed.
+			if (b == nullptr && (b = ring.front()) == nullptr) return;
+
+			std::chrono::steady_clock::time_point start;
+			if (st.opts.adaptive) start = std::chrono::steady_clock::now();
 			try {
-				// Virtual invocation; eventually calls flush_buffer_impl(true)
-				// to switch state to OUTPUTTING or PARTIAL_OUTPUT.
-				push_all(m_buffer->get_input());
+				// Virtual invocation; eventually calls after::flush_buffer.
+				push_all(array_view<T>(b->items.get(), b->size));
+			} catch (worker_aborted) {
+				return;
 			} catch (...) {
 				// Some node in the pipeline threw an exception.
 				// Pass it to the main thread.
-				lock.lock();
-				st.transition_state(parId, PROCESSING, IDLE);
-				st.eptr = std::current_exception();
-				st.producerCond.notify_one();
-				continue;
+				st.set_error(std::current_exception());
+				return;
+			}
+			if (st.opts.adaptive) {
+				std::chrono::nanoseconds t = std::chrono::steady_clock::now() - start;
+				st.stats[parId].busyTime.fetch_add(t.count(), std::memory_order_relaxed);
+				st.stats[parId].batches.fetch_add(1, std::memory_order_relaxed);
 			}
-			lock.lock();
+			ring.pop();
+			st.producerWakeup.notify();
 		}
 	}
 };
@@ -722,6 +699,10 @@ public:
 		st.set_input_ptr(parId, this);
 	}
 
+	~before_impl() {
+		this->stop_worker();
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Push all items from buffer and flush output buffer afterwards.
 	///
@@ -785,99 +766,50 @@ public:
 private:
 	typedef state<T1, T2> state_t;
 	typedef typename state_t::ptr stateptr;
+	typedef typename batch_ring<T1>::batch input_batch_t;
+	typedef typename batch_ring<T2>::batch output_batch_t;
 	stateptr st;
-	array<T1> inputBuffer;
-	size_t written;
-	size_t readyIdx;
 	std::shared_ptr<consumer<T2> > cons;
 	internal_queue<memory_size_type> m_outputOrder;
 	stream_size_type m_steps;
 
+	/** Worker whose input batch is being filled; the next one to try. */
+	size_t m_worker;
+	/** Input batch being filled, or nullptr. */
+	input_batch_t * m_batch;
+	T1 * m_pos;
+	T1 * m_end;
+
+	/** Batch size and number of active workers if the node is adaptive. */
+	adaptive_tuning m_tuning;
+	/** Start of the current measurement window of an adaptive node. */
+	std::chrono::steady_clock::time_point m_windowStart;
+	/** Nanoseconds spent waiting for the workers in the current window. */
+	stream_size_type m_stallTime;
+	/** Items and batches dispatched in the current window. */
+	stream_size_type m_windowItems;
+	stream_size_type m_windowBatches;
+	/** Sums of the worker_stats at the start of the current window. */
+	stream_size_type m_busyTime;
+	stream_size_type m_batches;
+
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Check if a worker is waiting for the main thread.
-	///
-	/// A worker may wait for output to be fetched, or it may wait for input to
-	/// be sent. If there is a worker waiting, this function returns true and
-	/// sets the index of the waiting worker in this->readyIdx.
+	/// \brief  Number of workers that are given input; the rest are parked.
 	///////////////////////////////////////////////////////////////////////////
-	bool has_ready_pipe() {
-		for (size_t i = 0; i < st->opts.numJobs; ++i) {
-			switch (st->get_state(i)) {
-				case INITIALIZING:
-				case PROCESSING:
-				case DONE:
-					break;
-				case PARTIAL_OUTPUT:
-				case OUTPUTTING:
-					// If we have to maintain order of items, the only
-					// outputting worker we consider to be waiting is the
-					// "front worker".
-					if (st->opts.maintainOrder && m_outputOrder.front() != i)
-						break;
-					// fallthrough
-				case IDLE:
-					readyIdx = i;
-					return true;
-			}
-		}
-		return false;
+	size_t active_jobs() const {
+		return st->opts.adaptive ? m_tuning.active_jobs() : st->opts.numJobs;
 	}
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Check if a worker is waiting for the main thread to process its
-	/// output.
-	///
-	/// This is used in end() instead of has_ready_pipe, since we do not care
-	/// about workers waiting for input when we don't have any input to send.
-	/// This is also used in handle_exceptions() where maintainOrder is forced
-	/// to false since we want to stop all processors ASAP.
-	///
-	/// Like has_ready_pipe, this function sets this->readyIdx if and only if
-	/// it returns true.
+	/// \brief  Number of items to put in an input batch.
 	///////////////////////////////////////////////////////////////////////////
-	bool has_outputting_pipe(bool maintainOrder) {
-		for (size_t i = 0; i < st->opts.numJobs; ++i) {
-			switch (st->get_state(i)) {
-				case INITIALIZING:
-				case IDLE:
-				case PROCESSING:
-				case DONE:
-					break;
-				case PARTIAL_OUTPUT:
-				case OUTPUTTING:
-					if (maintainOrder && m_outputOrder.front() != i)
-						break;
-					readyIdx = i;
-					return true;
-			}
-		}
-		return false;
+	memory_size_type batch_size() const {
+		return st->opts.adaptive ? m_tuning.batch_size() : st->batchCapacity;
 	}
 
-	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Check if a worker is waiting for the main thread to process its
-	/// output.
-	///
-	/// This is used in end() when we are waiting for workers to finish up.
-	/// When no worker is outputting and no worker is processing, all items
-	/// have been processed.
-	///
-	/// Does not modify this->readyIdx.
-	///////////////////////////////////////////////////////////////////////////
-	bool has_processing_pipe() {
-		for (size_t i = 0; i < st->opts.numJobs; ++i) {
-			switch (st->get_state(i)) {
-				case INITIALIZING:
-				case IDLE:
-				case PARTIAL_OUTPUT:
-				case OUTPUTTING:
-				case DONE:
-					break;
-				case PROCESSING:
-					return true;
-			}
-		}
-		return false;
+	static memory_size_type memory_usage(const options & opts, memory_size_type batchCapacity) {
+		return opts.numJobs * (batch_ring<T1>::memory_usage(batchCapacity)
+							   + batch_ring<T2>::memory_usage(batchCapacity));
 	}
 
 	///////////////////////////////////////////////////////////////////////////
@@ -906,95 +838,214 @@ private:
 	/// \brief  Rethrow exception from worker thread.
 	///
 	/// This function either throws an exception or returns normally.
-	/// If it returns normally, then this->eptr is not set.
+	/// If it returns normally, then no worker has failed.
 	///////////////////////////////////////////////////////////////////////////
-	void handle_exceptions(state_base::lock_t & lock) {
-		if (!st->eptr) return;
-		stop_workers(lock);
-		std::rethrow_exception(st->eptr);
+	void handle_exceptions() {
+		if (!st->failed.load()) return;
+		stop_workers();
+		std::exception_ptr e;
+		{
+			std::lock_guard<std::mutex> lock(st->mutex);
+			e = st->eptr;
+		}
+		std::rethrow_exception(e);
 	}
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief  Gracefully stop all worker threads.
+	/// \brief  Stop all worker threads without processing the remaining
+	/// batches.
 	///
-	/// This function will transition all running workers to the done state,
-	/// which should only be useful when an exception has been thrown
-	/// from either a worker thread or the main thread.
+	/// This should only be useful when an exception has been thrown from
+	/// either a worker thread or the main thread.
 	///
 	/// If an exception has been thrown from a worker thread
-	/// handle_exception() will call this.
+	/// handle_exceptions() will call this.
 	///
-	/// Otherwise this will be called from processor::~processor()
+	/// Otherwise this will be called from producer::~producer()
 	/// even if no exception has been thrown from the main thread.
 	///////////////////////////////////////////////////////////////////////////
-	void stop_workers(state_base::lock_t & lock) {
-		if (st->runningWorkers == 0) return;
-
-		bool done = false;
-		while (!done) {
-			// Force maintainOrder == false to avoid deadlock in case processor p
-			// has thrown an exception and processor p+1 is ready to output.
-			while (!has_outputting_pipe(false)) {
-				if (!has_processing_pipe()) {
-					done = true;
-					break;
+	void stop_workers() {
+		if (st->runningWorkers.load() == 0) return;
+		st->abort();
+		st->producerWakeup.wait([&] { return st->runningWorkers.load() == 0; });
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Check if the consumer has output batches to consume.
+	///////////////////////////////////////////////////////////////////////////
+	bool has_output() {
+		if (st->opts.maintainOrder) {
+			return !m_outputOrder.empty()
+				&& st->m_outputRings[m_outputOrder.front()]->front() != nullptr;
+		}
+		for (size_t i = 0; i < st->opts.numJobs; ++i) {
+			if (st->m_outputRings[i]->front() != nullptr) return true;
+		}
+		return false;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Check if some worker has room for another input batch.
+	///////////////////////////////////////////////////////////////////////////
+	bool has_input_space() {
+		for (size_t i = 0; i < active_jobs(); ++i) {
+			if (st->m_inputRings[i]->back() != nullptr) return true;
+		}
+		return false;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Pass the available output batches to the consumer.
+	///
+	/// If we have to maintain the order of items, we only consume the output
+	/// of the worker processing the oldest input batch, until the worker marks
+	/// the end of the output of that batch.
+	///////////////////////////////////////////////////////////////////////////
+	void consume_outputs() {
+		if (st->opts.maintainOrder) {
+			while (!m_outputOrder.empty()) {
+				size_t i = m_outputOrder.front();
+				output_batch_t * b;
+				bool last = false;
+				while (!last && (b = st->m_outputRings[i]->front()) != nullptr) {
+					// virtual invocation
+					cons->consume(array_view<T2>(b->items.get(), b->size));
+					last = b->last;
+					st->m_outputRings[i]->pop();
+					st->workerWakeup[i].notify();
 				}
-				// All items pushed; wait for processors to complete
-				st->producerCond.wait(lock);
+				if (!last) return;
+				m_outputOrder.pop();
 			}
+			return;
+		}
+		for (size_t i = 0; i < st->opts.numJobs; ++i) {
+			bool any = false;
+			while (output_batch_t * b = st->m_outputRings[i]->front()) {
+				// virtual invocation
+				cons->consume(array_view<T2>(b->items.get(), b->size));
+				st->m_outputRings[i]->pop();
+				any = true;
+			}
+			if (any) st->workerWakeup[i].notify();
+		}
+	}
 
-			if (done) break;
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Hand the current input batch to its worker.
+	///////////////////////////////////////////////////////////////////////////
+	void dispatch() {
+		m_batch->size = m_pos - m_batch->items.get();
+		st->m_inputRings[m_worker]->push();
+		st->workerWakeup[m_worker].notify();
+		if (st->opts.maintainOrder)
+			m_outputOrder.push(m_worker);
+		if (st->opts.adaptive) {
+			m_windowItems += m_batch->size;
+			++m_windowBatches;
+		}
+		m_batch = nullptr;
+		m_pos = m_end = nullptr;
+		m_worker = m_worker + 1;
+	}
 
-			// At this point, we have a processor that waiting to output.
-			// Set its state to PROCESSING or IDLE without pushing its items
-			// (since we are currently handling an exception).
-			if (st->get_state(readyIdx) == PARTIAL_OUTPUT) {
-				st->transition_state(readyIdx, PARTIAL_OUTPUT, PROCESSING);
-				st->workerCond[readyIdx].notify_one();
-				continue;
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Get an empty input batch from the first active worker, in
+	/// round-robin order, that has room for one. While all workers are busy,
+	/// consume their output.
+	///////////////////////////////////////////////////////////////////////////
+	void acquire_batch() {
+		const size_t n = active_jobs();
+		while (true) {
+			for (size_t k = 0; k < n; ++k) {
+				size_t i = (m_worker + k) % n;
+				input_batch_t * b = st->m_inputRings[i]->back();
+				if (b == nullptr) continue;
+				m_worker = i;
+				m_batch = b;
+				m_pos = b->items.get();
+				m_end = m_pos + std::min(b->items.size(), batch_size());
+				return;
+			}
+			std::chrono::steady_clock::time_point start;
+			if (st->opts.adaptive) start = std::chrono::steady_clock::now();
+			st->producerWakeup.wait([&] {
+				return st->failed.load() || has_input_space() || has_output();
+			});
+			if (st->opts.adaptive) {
+				std::chrono::nanoseconds t = std::chrono::steady_clock::now() - start;
+				m_stallTime += t.count();
 			}
-			st->transition_state(readyIdx, OUTPUTTING, IDLE);
+			handle_exceptions();
+			consume_outputs();
 		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Pass the measurements of the current window to m_tuning once
+	/// enough batches have been dispatched, and start a new window.
+	///////////////////////////////////////////////////////////////////////////
+	void adapt() {
+		if (m_windowBatches < 2 * batch_ring<T1>::slots * active_jobs()) return;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - m_windowStart < std::chrono::milliseconds(1)) return;
 
-		// Notify all workers that all processing is done
+		stream_size_type busyTime = 0;
+		stream_size_type batches = 0;
 		for (size_t i = 0; i < st->opts.numJobs; ++i) {
-			auto s = st->get_state(i);
-			switch (s) {
-				// Some workers could already be done
-				case DONE:
-					break;
-
-				// If we get an exception before begin() has been called
-				case INITIALIZING:
-
-				// If the worker is idle
-				case IDLE:
-					st->transition_state(i, s, DONE);
-					st->workerCond[i].notify_one();
-					break;
-
-				// These cases should have been handled earlier in this function
-				case PROCESSING:
-					throw tpie::exception("State PROCESSING not expected in stop_workers()");
-				case PARTIAL_OUTPUT:
-					throw tpie::exception("State PARTIAL_OUTPUT not expected in stop_workers()");
-				case OUTPUTTING:
-					throw tpie::exception("State OUTPUTTING not expected in stop_workers()");
-			}
+			busyTime += st->stats[i].busyTime.load(std::memory_order_relaxed);
+			batches += st->stats[i].batches.load(std::memory_order_relaxed);
 		}
 
-		// Wait for workers to stop
-		while (st->runningWorkers > 0)
-			st->producerCond.wait(lock);
+		adaptive_tuning::window w;
+		w.seconds = std::chrono::duration<double>(now - m_windowStart).count();
+		w.stallSeconds = m_stallTime * 1e-9;
+		w.busySeconds = (busyTime - m_busyTime) * 1e-9;
+		w.batches = batches - m_batches;
+		w.items = m_windowItems;
+		m_tuning.update(w);
+
+		m_windowStart = now;
+		m_stallTime = 0;
+		m_windowItems = 0;
+		m_windowBatches = 0;
+		m_busyTime = busyTime;
+		m_batches = batches;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Send off the full input batch and get an empty one.
+	///
+	/// Since the parallel producer and parallel consumer run single-threaded
+	/// in the main thread, this is our only opportunity to have the consumer
+	/// call push on its destination, so we consume the available output here
+	/// as well.
+	///////////////////////////////////////////////////////////////////////////
+	void next_batch() {
+		if (m_batch != nullptr) dispatch();
+		handle_exceptions();
+		consume_outputs();
+		flush_steps();
+		if (st->opts.adaptive) adapt();
+		acquire_batch();
 	}
 
 public:
 	template <typename consumer_t>
 	producer(stateptr st, consumer_t cons)
 		: st(st)
-		, written(0)
 		, cons(new consumer_t(std::move(cons)))
 		, m_steps(0)
+		, m_worker(0)
+		, m_batch(nullptr)
+		, m_pos(nullptr)
+		, m_end(nullptr)
+		, m_tuning(st->opts.numJobs, st->opts.bufSize)
+		, m_stallTime(0)
+		, m_windowItems(0)
+		, m_windowBatches(0)
+		, m_busyTime(0)
+		, m_batches(0)
 	{
 		for (size_t i = 0; i < st->opts.numJobs; ++i) {
 			this->add_push_destination(st->input(i));
@@ -1002,14 +1053,21 @@ public:
 		this->set_name("Parallel input", PRIORITY_INSIGNIFICANT);
 		this->set_plot_options(PLOT_PARALLEL | PLOT_SIMPLIFIED_HIDE);
 
-		memory_size_type usage =
-			st->opts.numJobs * st->opts.bufSize * (sizeof(T1) + sizeof(T2)) // workers
-			+ st->opts.bufSize * sizeof(item_type) // our buffer
-			;
-		this->set_minimum_memory(usage);
+		if (st->opts.adaptive) {
+			// Ask for memory for the largest batches, but make do with less.
+			memory_size_type minCapacity =
+				std::min(adaptive_tuning::minBatchSize, st->opts.bufSize);
+			this->set_minimum_memory(memory_usage(st->opts, minCapacity));
+			this->set_maximum_memory(memory_usage(st->opts, st->opts.bufSize));
+			this->set_memory_fraction(1.0);
+		} else {
+			this->set_minimum_memory(memory_usage(st->opts, st->opts.bufSize));
+		}
 
 		if (st->opts.maintainOrder) {
-			m_outputOrder.resize(st->opts.numJobs);
+			// A worker has at most a full input ring and a full output ring
+			// of batches that have not been consumed.
+			m_outputOrder.resize(st->opts.numJobs * 2 * batch_ring<T1>::slots);
 		}
 	}
 
@@ -1020,161 +1078,64 @@ public:
 	producer & operator=(producer &&) = default;
 
 	virtual ~producer() {
-		if (st) {
-			state_base::lock_t lock(st->mutex);
-			stop_workers(lock);
-		}
+		if (st) stop_workers();
 	}
 
-	void begin() override {
-		inputBuffer.resize(st->opts.bufSize);
-
-		state_base::lock_t lock(st->mutex);
-		while (st->runningWorkers != st->opts.numJobs) {
-			st->producerCond.wait(lock);
-		}
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  For an adaptive node, choose the largest batch capacity that
+	/// fits in the assigned memory.
+	///////////////////////////////////////////////////////////////////////////
+	void set_available_memory(memory_size_type availableMemory) override {
+		node::set_available_memory(availableMemory);
+		if (!st->opts.adaptive) return;
+		memory_size_type fixed = memory_usage(st->opts, 0);
+		memory_size_type perItem =
+			st->opts.numJobs * batch_ring<T1>::slots * (sizeof(T1) + sizeof(T2));
+		memory_size_type capacity =
+			availableMemory > fixed ? (availableMemory - fixed) / perItem : 0;
+		capacity = std::max(capacity, std::min(adaptive_tuning::minBatchSize, st->opts.bufSize));
+		capacity = std::min(capacity, st->opts.bufSize);
+		st->batchCapacity = capacity;
+		m_tuning = adaptive_tuning(st->opts.numJobs, capacity);
+	}
 
-		handle_exceptions(lock);
+	void begin() override {
+		m_windowStart = std::chrono::steady_clock::now();
 	}
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief Accumulate input buffer and send off to workers.
-	///
-	/// Since the parallel producer and parallel consumer run single-threaded
-	/// in the main thread, producer::push is our only opportunity to have the
-	/// consumer call push on its destination. Thus, when we accumulate an
-	/// input buffer, before sending it off to a worker, we might want to have
-	/// the consumer consume an output buffer to free up a parallel worker.
+	/// \brief Write the item to the current input batch, sending it off to a
+	/// worker when it is full.
 	///////////////////////////////////////////////////////////////////////////
 	void push(item_type item) {
-		inputBuffer[written++] = item;
-		if (written < st->opts.bufSize) {
-			// Wait for more items before doing anything expensive such as
-			// locking.
-			return;
-		}
-		state_base::lock_t lock(st->mutex);
-
-		handle_exceptions(lock);
-
-		flush_steps();
-
-		empty_input_buffer(lock);
+		if (m_pos == m_end) next_batch();
+		*m_pos++ = item;
 	}
 
-private:
-	void empty_input_buffer(state_base::lock_t & lock) {
-		while (written > 0) {
-			while (!st->eptr && !has_ready_pipe()) {
-				st->producerCond.wait(lock);
-			}
-
-			// Either st->eptr is set or we have a ready pipe.
-			handle_exceptions(lock);
-			// At this point, we have a ready pipe.
-
-			switch (st->get_state(readyIdx)) {
-				case INITIALIZING:
-					throw tpie::exception("State 'INITIALIZING' not expected at this point");
-				case IDLE:
-				{
-					// Send buffer to ready worker
-					item_type * first = &inputBuffer[0];
-					item_type * last = first + written;
-					parallel_input_buffer<T1> & dest = *st->m_inputBuffers[readyIdx];
-					dest.set_input(array_view<T1>(first, last));
-					st->transition_state(readyIdx, IDLE, PROCESSING);
-					st->workerCond[readyIdx].notify_one();
-					written = 0;
-					if (st->opts.maintainOrder)
-						m_outputOrder.push(readyIdx);
-					break;
-				}
-				case PROCESSING:
-					throw tpie::exception("State 'processing' not expected at this point");
-				case PARTIAL_OUTPUT:
-					// Receive buffer (virtual invocation)
-					cons->consume(st->m_outputBuffers[readyIdx]->get_output());
-					st->transition_state(readyIdx, PARTIAL_OUTPUT, PROCESSING);
-					st->workerCond[readyIdx].notify_one();
-					break;
-				case OUTPUTTING:
-					// Receive buffer (virtual invocation)
-					cons->consume(st->m_outputBuffers[readyIdx]->get_output());
-
-					st->transition_state(readyIdx, OUTPUTTING, IDLE);
-					st->workerCond[readyIdx].notify_one();
-					if (st->opts.maintainOrder) {
-						if (m_outputOrder.front() != readyIdx) {
-							log_error() << "Producer: Expected " << readyIdx << " in front; got "
-								<< m_outputOrder.front() << std::endl;
-							throw tpie::exception("Producer got wrong entry from has_ready_pipe");
-						}
-						m_outputOrder.pop();
-					}
-					break;
-				case DONE:
-					throw tpie::exception("State 'DONE' not expected at this point");
-			}
-		}
-	}
-
-public:
 	void end() override {
-		state_base::lock_t lock(st->mutex);
+		if (m_batch != nullptr && m_pos != m_batch->items.get()) dispatch();
+		m_batch = nullptr;
+		m_pos = m_end = nullptr;
 
-		flush_steps();
-
-		empty_input_buffer(lock);
-
-		inputBuffer.resize(0);
-
-		st->set_consumer_ptr(cons.get());
-
-		bool done = false;
-		while (!done) {
-			while (!st->eptr && !has_outputting_pipe(st->opts.maintainOrder)) {
-				if (!has_processing_pipe()) {
-					done = true;
-					break;
-				}
-				// All items pushed; wait for processors to complete
-				st->producerCond.wait(lock);
-			}
-
-			handle_exceptions(lock);
-
-			if (done) break;
-
-			// virtual invocation
-			cons->consume(st->m_outputBuffers[readyIdx]->get_output());
-
-			if (st->get_state(readyIdx) == PARTIAL_OUTPUT) {
-				st->transition_state(readyIdx, PARTIAL_OUTPUT, PROCESSING);
-				st->workerCond[readyIdx].notify_one();
-				continue;
-			}
-			st->transition_state(readyIdx, OUTPUTTING, IDLE);
-			if (st->opts.maintainOrder) {
-				if (m_outputOrder.front() != readyIdx) {
-					log_error() << "Producer: Expected " << readyIdx << " in front; got "
-						<< m_outputOrder.front() << std::endl;
-					throw tpie::exception("Producer got wrong entry from has_ready_pipe");
-				}
-				m_outputOrder.pop();
-			}
-		}
-		// Notify all workers that all processing is done
 		for (size_t i = 0; i < st->opts.numJobs; ++i) {
-			st->transition_state(i, IDLE, DONE);
-			st->workerCond[i].notify_one();
+			st->inputClosed[i].store(true);
+			st->workerWakeup[i].notify();
 		}
-		while (!st->eptr && st->runningWorkers > 0) {
-			st->producerCond.wait(lock);
+
+		while (true) {
+			handle_exceptions();
+			consume_outputs();
+			if (st->runningWorkers.load() == 0) break;
+			// All items pushed; wait for workers to complete
+			st->producerWakeup.wait([&] {
+				return st->failed.load() || st->runningWorkers.load() == 0 || has_output();
+			});
 		}
-		// All workers terminated
+		// All workers terminated; consume what they pushed before exiting.
+		handle_exceptions();
+		consume_outputs();
 
-		handle_exceptions(lock);
+		st->set_consumer_ptr(cons.get());
 		flush_steps();
 
 		free_structure_memory(m_outputOrder);
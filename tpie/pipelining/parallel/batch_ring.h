@@ -0,0 +1,168 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_PARALLEL_BATCH_RING_H__
+#define __TPIE_PIPELINING_PARALLEL_BATCH_RING_H__
+
+#include <tpie/array.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace tpie::pipelining::parallel_bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Lets a single thread sleep until other threads have changed some
+/// atomic state.
+///
+/// The notifying threads only take the mutex when the waiting thread is
+/// asleep, so as long as the waiting thread keeps up, handing off a batch
+/// costs no locking and no system calls.
+///////////////////////////////////////////////////////////////////////////////
+class wakeup {
+public:
+	/** Number of times the predicate is checked before going to sleep. */
+	static const size_t spins = 64;
+
+	wakeup()
+		: m_sleeping(false)
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Return when pred() is true.
+	///
+	/// Only one thread may wait on a given instance.
+	///////////////////////////////////////////////////////////////////////////
+	template <typename pred_t>
+	void wait(pred_t pred) {
+		for (size_t i = 0; i < spins; ++i) {
+			if (pred()) return;
+			std::this_thread::yield();
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_sleeping.store(true, std::memory_order_relaxed);
+		// Pairs with the fence in notify(): either the notifier sees that we
+		// sleep, or we see the state it changed.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (!pred()) m_cond.wait(lock);
+		m_sleeping.store(false, std::memory_order_relaxed);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Wake the waiting thread if it is asleep. Must be called after
+	/// changing the state checked by the predicate given to wait().
+	///////////////////////////////////////////////////////////////////////////
+	void notify() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!m_sleeping.load(std::memory_order_relaxed)) return;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cond.notify_one();
+	}
+
+private:
+	std::atomic<bool> m_sleeping;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Single-producer, single-consumer ring of item batches.
+///
+/// The writer fills the batch returned by back() and hands it over with
+/// push(); the reader reads the batch returned by front() and hands it back
+/// with pop(). The items are thus written and read in place, and the only
+/// shared state is the head and tail counters.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class batch_ring {
+public:
+	/** Number of batches in the ring. */
+	static constexpr size_t slots = 4;
+
+	struct batch {
+		array<T> items;
+		/** Number of items used. */
+		size_t size;
+		/** For output batches: whether the input batch has been processed. */
+		bool last;
+	};
+
+	batch_ring(memory_size_type batchSize)
+		: m_head(0)
+		, m_tail(0)
+	{
+		for (size_t i = 0; i < slots; ++i) {
+			m_batches[i].items.resize(batchSize);
+			m_batches[i].size = 0;
+			m_batches[i].last = false;
+		}
+	}
+
+	batch_ring(const batch_ring &) = delete;
+	batch_ring & operator=(const batch_ring &) = delete;
+
+	static memory_size_type memory_usage(memory_size_type batchSize) {
+		return sizeof(batch_ring) + slots * array<T>::memory_usage(batchSize);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Writer: the batch to fill next, or nullptr if the ring is full.
+	///////////////////////////////////////////////////////////////////////////
+	batch * back() {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == slots) return nullptr;
+		return &m_batches[tail % slots];
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Writer: hand the batch returned by back() to the reader.
+	///////////////////////////////////////////////////////////////////////////
+	void push() {
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Reader: the oldest batch, or nullptr if the ring is empty.
+	///////////////////////////////////////////////////////////////////////////
+	batch * front() {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return nullptr;
+		return &m_batches[head % slots];
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Reader: hand the batch returned by front() back to the writer.
+	///////////////////////////////////////////////////////////////////////////
+	void pop() {
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	// The counters are on separate cache lines so that the writer and the
+	// reader do not invalidate each other's line on every batch.
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+	alignas(64) batch m_batches[slots];
+};
+
+} // namespace tpie::pipelining::parallel_bits
+
+#endif // __TPIE_PIPELINING_PARALLEL_BATCH_RING_H__
@@ -31,6 +31,9 @@ struct options {
 	bool maintainOrder;
 	size_t numJobs;
 	size_t bufSize;
+	/** Whether to tune the batch size and the number of active workers at
+	 * runtime; numJobs and bufSize are then upper bounds. */
+	bool adaptive;
 };
 
 } // namespace tpie::pipelining::parallel_bits
@@ -33,7 +33,9 @@ namespace tpie::pipelining {
 /// output in the order they are input.
 /// \param numJobs  The number of threads to utilize for parallel execution.
 /// \param bufSize  The number of items to store in the buffer sent between
-/// threads.
+/// threads. Each thread has an input and an output ring of
+/// parallel_bits::batch_ring::slots such buffers, so the node asks for
+/// memory for numJobs * 2 * slots buffers.
 ///////////////////////////////////////////////////////////////////////////////
 template <typename fact_t>
 pipe_middle<parallel_bits::factory<fact_t> >
@@ -49,6 +51,7 @@ parallel(pipe_middle<fact_t> && fact, maintain_order_type maintainOrder, size_t
 	}
 	opts.numJobs = numJobs;
 	opts.bufSize = bufSize;
+	opts.adaptive = false;
 	return pipe_middle<parallel_bits::factory<fact_t> >
 		(parallel_bits::factory<fact_t>
 		 (std::move(fact.factory), std::move(opts)));
@@ -66,6 +69,35 @@ parallel(pipe_middle<fact_t> && fact, maintain_order_type maintainOrder = arbitr
 	return parallel(std::move(fact), maintainOrder, default_worker_count());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Runs a pipeline in multiple threads, tuning the number of items
+/// per batch and the number of threads that get input while running.
+///
+/// The node measures how long the workers spend on each batch and how long
+/// the producer waits for the workers, and adjusts the parameters to
+/// maximize throughput; see parallel_bits::adaptive_tuning. Unlike the
+/// other overloads, the node asks for memory like a sorter does, and the
+/// largest batch size is bounded by the memory it is assigned.
+/// \param maintainOrder  Whether to make sure that items are processed and
+/// output in the order they are input.
+/// \param maxJobs  The largest number of threads to utilize.
+/// \param maxBufSize  The largest number of items to store in a buffer sent
+/// between threads.
+///////////////////////////////////////////////////////////////////////////////
+template <typename fact_t>
+pipe_middle<parallel_bits::factory<fact_t> >
+parallel_adaptive(pipe_middle<fact_t> && fact, maintain_order_type maintainOrder = arbitrary_order,
+				  size_t maxJobs = default_worker_count(), size_t maxBufSize = 65536) {
+	parallel_bits::options opts;
+	opts.maintainOrder = maintainOrder == maintain_order;
+	opts.numJobs = maxJobs;
+	opts.bufSize = maxBufSize;
+	opts.adaptive = true;
+	return pipe_middle<parallel_bits::factory<fact_t> >
+		(parallel_bits::factory<fact_t>
+		 (std::move(fact.factory), std::move(opts)));
+}
+
 template <typename fact_t>
 pipe_middle<parallel_bits::factory<fact_t> >
 parallel(pipe_middle<fact_t> && fact, bool maintainOrder, size_t numJobs, size_t bufSize = 2048) {
@@ -24,6 +24,10 @@ namespace tpie::pipelining::parallel_bits {
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  States of the parallel worker state machine.
+///
+/// parallel() now hands batches over through parallel_bits::batch_ring and
+/// no longer uses these states; the header is kept for code that includes
+/// it.
 ///////////////////////////////////////////////////////////////////////////////
 enum worker_state {
 	/** The input is being written by the producer. */
@@ -22,6 +22,8 @@
 #include <tpie/pipelining/node.h>
 #include <unordered_map>
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
 #include <tpie/pipelining/runtime.h>
 
 namespace {
@@ -44,6 +46,65 @@ namespace {
 	}
 
 	size_t idc = 1;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Items flowing into or out of a node along its push and pull edges.
+	/// The items are counted by the node pushed to or pulled from, so the
+	/// count is only known if those nodes are profiled (see profile.h).
+	///////////////////////////////////////////////////////////////////////////
+	struct item_count {
+		tpie::stream_size_type items = 0;
+		bool edges = false;
+		bool known = true;
+
+		void add(const tpie::pipelining::node_profile & counter, bool pushed) {
+			edges = true;
+			if (!counter.callsTimed) known = false;
+			else items += pushed ? counter.itemsPushed : counter.itemsPulled;
+		}
+
+		std::string str() const {
+			if (!edges || !known) return "-";
+			return std::to_string(items);
+		}
+	};
+
+	struct node_report {
+		item_count in;
+		item_count out;
+		/** Time blocked in block reads and writes; see io_stats. */
+		double ioSeconds = 0;
+	};
+
+	typedef std::unordered_map<S::id_t, node_report> reports_t;
+
+	void get_node_reports(const S & nodeMap, reports_t & reports) {
+		for (S::mapit i = nodeMap.begin(); i != nodeMap.end(); ++i) {
+			tpie::io_counters c = nodeMap.get(i->first)->get_io_stats()->get();
+			reports[i->first].ioSeconds = c.readSeconds + c.writeSeconds;
+		}
+		const S::relmap_t & relations = nodeMap.get_relations();
+		for (S::relmapit i = relations.begin(); i != relations.end(); ++i) {
+			S::id_t from = i->first;
+			S::id_t to = i->second.first;
+			switch (i->second.second) {
+				case tpie::pipelining::bits::pushes: {
+					const tpie::pipelining::node_profile & p = nodeMap.get(to)->get_profile();
+					reports[from].out.add(p, true);
+					reports[to].in.add(p, true);
+					break;
+				}
+				case tpie::pipelining::bits::pulls: {
+					const tpie::pipelining::node_profile & p = nodeMap.get(to)->get_profile();
+					reports[to].out.add(p, false);
+					reports[from].in.add(p, false);
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
 } // default namespace
 
 namespace tpie {
@@ -54,7 +115,7 @@ namespace bits {
 
 typedef std::unordered_map<const node *, size_t> nodes_t;
 
-void pipeline_base_base::plot_impl(std::ostream & out, bool full) {
+void pipeline_base_base::plot_impl(std::ostream & out, bool full, bool profile) {
 	typedef tpie::pipelining::bits::node_map::id_t id_t;
 
 	node_map::ptr nodeMap = m_nodeMap->find_authority();
@@ -71,6 +132,24 @@ void pipeline_base_base::plot_impl(std::ostream & out, bool full) {
 		}
 	}
 	
+	// The time of hidden nodes is shown on the node representing them.
+	reports_t reports;
+	std::unordered_map<id_t, node_profile> profiles;
+	std::unordered_map<id_t, double> ioSeconds;
+	double totalSeconds = 0;
+	if (profile) {
+		get_node_reports(*nodeMap, reports);
+		for (node_map::mapit i = nodeMap->begin(); i != nodeMap->end(); ++i) {
+			id_t r = i->first;
+			while (repr.count(r)) r = repr[r];
+			const node_profile & p = nodeMap->get(i->first)->get_profile();
+			profiles[r].selfSeconds += p.selfSeconds;
+			profiles[r].cpuSeconds += p.cpuSeconds;
+			ioSeconds[r] += reports[i->first].ioSeconds;
+			totalSeconds += p.selfSeconds;
+		}
+	}
+
 	out << "digraph {\n";
 	for (node_map::mapit i = nodeMap->begin(); i != nodeMap->end(); ++i) {
 		if (repr.count(i->first)) continue;
@@ -81,6 +160,22 @@ void pipeline_base_base::plot_impl(std::ostream & out, bool full) {
 			out << '"' << name(nodeMap, i->first) << "\" [shape=polygon];\n";
 		else
 			out << '"' << name(nodeMap, i->first) << "\";\n";
+
+		if (profile) {
+			const node_profile & p = profiles[i->first];
+			const node_report & r = reports[i->first];
+			double share = totalSeconds > 0 ? p.selfSeconds / totalSeconds : 0;
+			// Shade the nodes from white to red by their share of the time.
+			out << '"' << name(nodeMap, i->first) << "\" [label=\"" << name(nodeMap, i->first)
+				<< std::fixed << std::setprecision(3)
+				<< "\\nself " << p.selfSeconds << " s (" << std::setprecision(1) << 100 * share << "%)"
+				<< std::setprecision(3) << ", CPU " << p.cpuSeconds << " s";
+			if (ioSeconds[i->first] > 0)
+				out << ", I/O " << ioSeconds[i->first] << " s";
+			out << "\\nitems in " << r.in.str() << ", out " << r.out.str()
+				<< "\",style=filled,fillcolor=\"0.000 " << std::setprecision(3) << share << " 1.000\"];\n";
+			out.unsetf(std::ios::floatfield);
+		}
 	}
 
 	for (node_map::relmapit i = relations.begin(); i != relations.end(); ++i) {
@@ -133,6 +228,8 @@ void pipeline_base::operator()(stream_size_type items, progress_indicator_base &
 	node_map::ptr map = m_nodeMap->find_authority();
 	runtime rt(map);
 
+	rt.set_concurrent_phases(m_concurrentPhases);
+
 	CurrentPipeSetter cpc(this);
 	rt.go(items, pi, initialFiles, initialMemory, file, function);
 
@@ -235,6 +332,60 @@ void pipeline_base_base::output_memory(std::ostream & o) const {
 	}
 }
 
+void pipeline_base_base::output_profile(std::ostream & o) const {
+	bits::node_map::ptr nodeMap = get_node_map()->find_authority();
+	reports_t reports;
+	get_node_reports(*nodeMap, reports);
+
+	std::vector<std::pair<node *, node_map::id_t> > nodes;
+	double totalSeconds = 0;
+	for (bits::node_map::mapit i = nodeMap->begin(); i != nodeMap->end(); ++i) {
+		node * n = nodeMap->get(i->first);
+		totalSeconds += n->get_profile().selfSeconds;
+		nodes.push_back(std::make_pair(n, i->first));
+	}
+	// The slowest node first
+	std::stable_sort(nodes.begin(), nodes.end(), [](const auto & a, const auto & b) {
+		return a.first->get_profile().selfSeconds > b.first->get_profile().selfSeconds;
+	});
+
+	size_t cw = 12;
+	std::string sep(2, ' ');
+	o	<< "\nPipelining profile\n"
+		<< std::setw(cw) << "Items in"
+		<< std::setw(cw) << "Items out"
+		<< std::setw(cw) << "Wall s"
+		<< std::setw(cw) << "Self s"
+		<< std::setw(cw) << "CPU s"
+		<< std::setw(cw) << "I/O s"
+		<< std::setw(cw) << "Self %"
+		<< sep << "Name\n";
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		const node_profile & p = nodes[i].first->get_profile();
+		const node_report & r = reports[nodes[i].second];
+		o	<< std::fixed << std::setprecision(3)
+			<< std::setw(cw) << r.in.str()
+			<< std::setw(cw) << r.out.str()
+			<< std::setw(cw) << p.wallSeconds
+			<< std::setw(cw) << p.selfSeconds
+			<< std::setw(cw) << p.cpuSeconds
+			<< std::setw(cw) << r.ioSeconds
+			<< std::setw(cw) << std::setprecision(1) << (totalSeconds > 0 ? 100 * p.selfSeconds / totalSeconds : 0)
+			<< sep
+			<< nodes[i].first->get_name().substr(0, 50) << '\n';
+	}
+	o << std::endl;
+	o.unsetf(std::ios::floatfield);
+}
+
+void pipeline_base_base::output_io(std::ostream & o) const {
+	bits::node_map::ptr nodeMap = get_node_map()->find_authority();
+	std::vector<node *> nodes;
+	for (bits::node_map::mapit i = nodeMap->begin(); i != nodeMap->end(); ++i)
+		nodes.push_back(nodeMap->get(i->first));
+	runtime::print_io_usage("pipeline", nodes, o);
+}
+
 void subpipeline_base::begin(stream_size_type items, progress_indicator_base & pi,
 							 memory_size_type filesAvailable, memory_size_type mem,
 							 const char * file, const char * function) {
@@ -61,7 +61,7 @@ public:
 	/// virtual wrapping will not be showed at all
 	///
 	///////////////////////////////////////////////////////////////////////////
-	void plot(std::ostream & out) {plot_impl(out, false);}
+	void plot(std::ostream & out) {plot_impl(out, false, false);}
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Generate a GraphViz plot of the actor graph.
@@ -73,7 +73,14 @@ public:
 	/// Thus, a downwards arrow in the plot is a push edge, and an upwards
 	/// arrow is a pull edge (assuming no cycles in the item flow graph).
 	///////////////////////////////////////////////////////////////////////////
-	void plot_full(std::ostream & out) {plot_impl(out, true);}
+	void plot_full(std::ostream & out) {plot_impl(out, true, false);}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Generate the GraphViz plot of plot(), with each node labelled
+	/// with its time and items and shaded by its share of the time; see
+	/// profile.h.
+	///////////////////////////////////////////////////////////////////////////
+	void plot_profile(std::ostream & out) {plot_impl(out, false, true);}
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Virtual dtor.
@@ -92,13 +99,24 @@ public:
 
 	void output_memory(std::ostream & o) const;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Print the block I/O done by each node since it was created.
+	///////////////////////////////////////////////////////////////////////////
+	void output_io(std::ostream & o) const;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Print the items passed through and the time spent in each
+	/// node since it was created, the slowest node first; see profile.h.
+	///////////////////////////////////////////////////////////////////////////
+	void output_profile(std::ostream & o) const;
+
 	size_t uid() const {return m_uid;};
 protected:
 	
 	node_map::ptr m_nodeMap;	
 	size_t m_uid;
 private:
-	void plot_impl(std::ostream & out, bool full);	
+	void plot_impl(std::ostream & out, bool full, bool profile);	
 };
 	
 
@@ -130,8 +148,33 @@ public:
 	}
 
 	void order_before(pipeline_base & other);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Run phases that do not depend on each other at the same time.
+	///
+	/// When enabled, consecutive phases with no dependency path between them
+	/// are run on the job pool, as many at a time as there are job threads
+	/// plus one. The memory and files given to the pipeline are divided
+	/// between the nodes of the phases that run together, and a node sharing
+	/// memory with such a phase is evacuated first. Phases using
+	/// datastructures are always run by themselves.
+	///
+	/// Nodes of phases that run together are called from different threads,
+	/// so they must not share state without synchronization. Only the first
+	/// phase of each group updates the progress indicator while running.
+	///
+	/// Off by default. Subpipelines always run their phases one at a time.
+	///////////////////////////////////////////////////////////////////////////
+	void set_concurrent_phases(bool enabled) {
+		m_concurrentPhases = enabled;
+	}
+
+	bool get_concurrent_phases() const {
+		return m_concurrentPhases;
+	}
 protected:
 	double m_memory;
+	bool m_concurrentPhases = false;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -228,6 +271,10 @@ public:
 	void plot_full(std::ostream & os = std::cout) {
 		p->plot_full(os);
 	}
+
+	void plot_profile(std::ostream & os = std::cout) {
+		p->plot_profile(os);
+	}
 	
 	inline double memory() const {
 		return p->memory();
@@ -266,6 +313,11 @@ public:
 	}
 
 	void output_memory(std::ostream & o) const {p->output_memory(o);}
+	void output_io(std::ostream & o) const {p->output_io(o);}
+	void output_profile(std::ostream & o) const {p->output_profile(o);}
+
+	void set_concurrent_phases(bool enabled) {p->set_concurrent_phases(enabled);}
+	bool get_concurrent_phases() const {return p->get_concurrent_phases();}
 private:
 	std::shared_ptr<bits::pipeline_base> p;
 };
@@ -0,0 +1,133 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/pipelining/profile.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+
+/** Innermost timed scope of the calling thread. */
+thread_local tpie::pipelining::profile_scope * currentScope = nullptr;
+
+/** Number of outermost calls made in the innermost phase scope. */
+thread_local tpie::stream_size_type outermostCalls = 0;
+
+/** Number of untimed calls the calling thread is in. */
+thread_local tpie::stream_size_type untimedDepth = 0;
+
+} // unnamed namespace
+
+namespace tpie::pipelining {
+
+double thread_cpu_seconds() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	// FILETIME counts 100 nanosecond intervals
+	return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+profile_scope::profile_scope(node_profile & profile)
+	: m_profile(profile)
+	, m_parent(currentScope)
+	, m_childWall(0)
+	, m_childCpu(0)
+	, m_weight(1)
+	, m_call(false)
+	, m_savedCalls(outermostCalls)
+	, m_savedUntimedDepth(untimedDepth)
+{
+	outermostCalls = 0;
+	untimedDepth = 0;
+	start();
+}
+
+profile_scope::profile_scope(node_profile & profile, stream_size_type interval)
+	: m_profile(profile)
+	, m_parent(currentScope)
+	, m_childWall(0)
+	, m_childCpu(0)
+	, m_weight(0)
+	, m_call(true)
+	, m_savedCalls(0)
+	, m_savedUntimedDepth(0)
+{
+	if (m_parent && m_parent->m_call) {
+		m_weight = m_parent->m_weight;
+	} else if (untimedDepth == 0) {
+		stream_size_type n = outermostCalls++;
+		if (n < interval) m_weight = 1;
+		else if (n % interval == 0) m_weight = static_cast<double>(interval);
+	}
+	if (m_weight == 0) {
+		++untimedDepth;
+		return;
+	}
+	start();
+}
+
+void profile_scope::start() {
+	currentScope = this;
+	m_cpuStart = thread_cpu_seconds();
+	m_start = std::chrono::steady_clock::now();
+}
+
+profile_scope::~profile_scope() {
+	if (m_weight == 0) {
+		--untimedDepth;
+		return;
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	double cpu = thread_cpu_seconds() - m_cpuStart;
+	m_profile.wallSeconds += m_weight * wall;
+	m_profile.selfSeconds += m_weight * (wall - m_childWall);
+	m_profile.cpuSeconds += m_weight * (cpu - m_childCpu);
+	currentScope = m_parent;
+	if (!m_call) {
+		outermostCalls = m_savedCalls;
+		untimedDepth = m_savedUntimedDepth;
+		// The time of a phase in an untimed call is part of the estimate
+		// for that call.
+		if (m_savedUntimedDepth != 0) return;
+	}
+	if (m_parent) {
+		// A sampled outermost call stands for m_weight calls in one run of
+		// the parent; a nested call has the weight of its parent.
+		double scale = m_call ? m_weight / m_parent->m_weight : 1;
+		m_parent->m_childWall += scale * wall;
+		m_parent->m_childCpu += scale * cpu;
+	}
+}
+
+} // namespace tpie::pipelining
@@ -0,0 +1,211 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef TPIE_PIPELINING_PROFILE_H
+#define TPIE_PIPELINING_PROFILE_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file profile.h  Time spent in each pipelining node.
+///
+/// The runtime always times begin(), go() and end() of each node. When
+/// TPIE_PIPELINING_PROFILE is defined (configure with
+/// -DTPIE_PIPELINING_PROFILE=ON), the nodes made by factory, tfactory and
+/// termfactory and the input node of sort() are wrapped in bits::profiled,
+/// which also times push, push_batch and pull and counts the items passed.
+/// Without it, the time spent in push and pull is attributed to the node that
+/// calls go().
+///
+/// Reading the clocks costs more than many nodes spend on an item, so push
+/// and pull calls are sampled rather than all timed; see profile_scope. The
+/// item counts are exact.
+///
+/// After running a pipeline, pipeline::output_profile prints a table of the
+/// measurements, and pipeline::plot_profile prints the pipeline graph with
+/// the nodes annotated.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/config.h>
+#include <tpie/tpie_export.h>
+#include <tpie/types.h>
+#include <tpie/pipelining/node_traits.h>
+#include <chrono>
+#include <typeinfo>
+#include <utility>
+
+namespace tpie::pipelining {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Items passed through and time spent in a pipelining node since it
+/// was created; see node::get_profile().
+///
+/// A node is only called from one thread at a time, so the counters are not
+/// atomic.
+///////////////////////////////////////////////////////////////////////////////
+struct node_profile {
+	/** Number of items pushed to the node. */
+	stream_size_type itemsPushed = 0;
+	/** Number of items pulled from the node. */
+	stream_size_type itemsPulled = 0;
+	/** Wall clock time spent in the node, including the time spent in the
+	 * timed nodes it pushes to and pulls from. The times of push and pull
+	 * are estimated from samples. */
+	double wallSeconds = 0;
+	/** Wall clock time spent in the node itself. */
+	double selfSeconds = 0;
+	/** CPU time used by the thread in the node itself. */
+	double cpuSeconds = 0;
+	/** Whether push and pull of the node are timed and counted. */
+	bool callsTimed = false;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  CPU time used by the calling thread, in seconds.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT double thread_cpu_seconds();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Adds the time from construction to destruction to a node_profile.
+///
+/// Scopes nest within each thread: the time spent in a scope opened while
+/// another is open is subtracted from the self time of the outer one.
+///
+/// Scopes of push and pull calls are sampled. Of the calls a thread makes
+/// from outside any other call, e.g. from go(), the first sampleInterval
+/// are timed, and after that one in sampleInterval, whose times are
+/// multiplied by sampleInterval. The calls nested in a timed call are timed
+/// with the same weight, and those nested in an untimed call are not timed,
+/// so the self times stay consistent.
+///////////////////////////////////////////////////////////////////////////////
+class TPIE_EXPORT profile_scope {
+public:
+	/** Sampling interval of push and pull calls. */
+	static const stream_size_type sampleInterval = 64;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Time a phase of a node, such as go().
+	///////////////////////////////////////////////////////////////////////////
+	profile_scope(node_profile & profile);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Time one in the given number of outermost calls, and the
+	/// calls nested in them.
+	///////////////////////////////////////////////////////////////////////////
+	profile_scope(node_profile & profile, stream_size_type interval);
+
+	~profile_scope();
+
+	profile_scope(const profile_scope &) = delete;
+	profile_scope & operator=(const profile_scope &) = delete;
+
+private:
+	void start();
+
+	node_profile & m_profile;
+	profile_scope * m_parent;
+	std::chrono::steady_clock::time_point m_start;
+	double m_cpuStart;
+	/** Time spent in nested scopes. */
+	double m_childWall;
+	double m_childCpu;
+	/** Number of runs the measured time stands for, or 0 if not timed. */
+	double m_weight;
+	/** Whether this is the scope of a call rather than of a phase. */
+	bool m_call;
+	/** Sampling state of the thread when this phase scope was opened. */
+	stream_size_type m_savedCalls;
+	stream_size_type m_savedUntimedDepth;
+};
+
+namespace bits {
+
+template <typename node_t,
+		  bool has_item_type = has_itemtype<node_t>::value,
+		  bool has_push = has_push_method<node_t>::value,
+		  bool has_pull = has_pull_method<node_t>::value>
+struct profiled_item_type {};
+
+// push_type and pull_type cannot look at the push and pull methods of
+// profiled since they are templates; give it the item_type they would find
+// on the wrapped node.
+template <typename node_t, bool has_pull>
+struct profiled_item_type<node_t, false, true, has_pull> {
+	typedef typename push_type<node_t>::type item_type;
+};
+
+template <typename node_t>
+struct profiled_item_type<node_t, false, false, true> {
+	typedef typename pull_type<node_t>::type item_type;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Node wrapper timing push, push_batch and pull of the node and
+/// counting the items passed.
+///////////////////////////////////////////////////////////////////////////////
+template <typename node_t>
+class profiled : public node_t, public profiled_item_type<node_t> {
+public:
+	template <typename... Args>
+	explicit profiled(Args &&... args)
+		: node_t(std::forward<Args>(args)...)
+	{
+		this->set_name_from_type(typeid(node_t));
+		this->get_profile().callsTimed = true;
+	}
+
+	profiled(profiled &&) = default;
+	profiled & operator=(profiled &&) = default;
+
+	// The methods are templates on N so that they are left out when the
+	// wrapped node lacks them.
+	template <typename... Args, typename N = node_t>
+	auto push(Args &&... args) -> decltype(std::declval<N &>().push(std::forward<Args>(args)...)) {
+		++this->get_profile().itemsPushed;
+		profile_scope _(this->get_profile(), profile_scope::sampleInterval);
+		return node_t::push(std::forward<Args>(args)...);
+	}
+
+	template <typename V, typename N = node_t>
+	auto push_batch(V && items) -> decltype(std::declval<N &>().push_batch(std::forward<V>(items))) {
+		// A batch is worth timing by itself.
+		this->get_profile().itemsPushed += items.size();
+		profile_scope _(this->get_profile(), 1);
+		return node_t::push_batch(std::forward<V>(items));
+	}
+
+	template <typename N = node_t>
+	auto pull() -> decltype(std::declval<N &>().pull()) {
+		++this->get_profile().itemsPulled;
+		profile_scope _(this->get_profile(), profile_scope::sampleInterval);
+		return node_t::pull();
+	}
+};
+
+#ifdef TPIE_PIPELINING_PROFILE
+template <typename node_t>
+using profiled_t = profiled<node_t>;
+#else // TPIE_PIPELINING_PROFILE
+template <typename node_t>
+using profiled_t = node_t;
+#endif // TPIE_PIPELINING_PROFILE
+
+} // namespace bits
+
+} // namespace tpie::pipelining
+
+#endif // TPIE_PIPELINING_PROFILE_H
@@ -0,0 +1,102 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef TPIE_PIPELINING_PUSH_BATCH_H
+#define TPIE_PIPELINING_PUSH_BATCH_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file push_batch.h  Pushing contiguous batches of items.
+///
+/// Besides push, a node may implement
+///
+///     void push_batch(array_view<const T> items);
+///
+/// to receive a contiguous batch of items in one call, which lets the node
+/// handle the items in a tight loop. Pushing a batch must have the same
+/// effect as pushing its items one at a time. The items are only valid
+/// during the call.
+///
+/// A node that has its items in contiguous memory pushes them with the free
+/// function push_batch(dest, first, last), which calls dest.push_batch when
+/// the destination implements it and pushes the items one at a time
+/// otherwise.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/types.h>
+#include <tpie/array_view.h>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+namespace tpie::pipelining {
+namespace bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Whether dest_t has a push_batch method accepting items of type T.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t, typename T, typename = void>
+struct has_push_batch_method : std::false_type {};
+
+template <typename dest_t, typename T>
+struct has_push_batch_method<dest_t, T, std::void_t<decltype(
+	std::declval<dest_t &>().push_batch(std::declval<array_view<const T> >()))> >
+	: std::true_type {};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Whether items of type T can be gathered in a buffer to be pushed
+/// as a batch.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+struct is_batchable : std::integral_constant<bool,
+	!std::is_reference<T>::value
+	&& !std::is_const<T>::value
+	&& std::is_default_constructible<T>::value
+	&& std::is_copy_assignable<T>::value> {};
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Number of items a node gathers before pushing them as a batch,
+/// when it cannot pass on the batch it got. The buffer is at most 8 KiB.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+constexpr memory_size_type push_batch_buffer_items =
+	std::max<memory_size_type>(1, 8192 / sizeof(T));
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Push the items in [first, last) to dest, as a batch if dest
+/// implements push_batch and one at a time otherwise.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t, typename T>
+void push_batch(dest_t & dest, const T * first, const T * last) {
+	if constexpr (bits::has_push_batch_method<dest_t, T>::value) {
+		dest.push_batch(array_view<const T>(first, last));
+	} else {
+		for (; first != last; ++first) dest.push(*first);
+	}
+}
+
+template <typename dest_t, typename T>
+void push_batch(dest_t & dest, array_view<const T> items) {
+	push_batch(dest, items.data(), items.data() + items.size());
+}
+
+} // namespace tpie::pipelining
+
+#endif // TPIE_PIPELINING_PUSH_BATCH_H
@@ -20,6 +20,7 @@
 #include <tpie/fractional_progress.h>
 #include <tpie/progress_indicator_null.h>
 #include <tpie/disjoint_sets.h>
+#include <tpie/job.h>
 #include <tpie/pipelining/tokens.h>
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/runtime.h>
@@ -888,6 +889,48 @@ std::string get_phase_name(const std::vector<node *> & phase) {
 	return phase[highest_node]->get_name();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// Return the nodes of the phases [first, first+count).
+///////////////////////////////////////////////////////////////////////////////
+std::vector<node *> get_group_nodes(const std::vector<std::vector<node *> > & phases,
+									size_t first, size_t count) {
+	std::vector<node *> nodes;
+	for (size_t p = first; p < first + count; ++p)
+		nodes.insert(nodes.end(), phases[p].begin(), phases[p].end());
+	return nodes;
+}
+
+void runtime::print_io_usage(const std::string & title, const std::vector<node *> & nodes,
+							 std::ostream & os) {
+	size_t cw = 12;
+	std::string sep(2, ' ');
+	const double mb = 1024.0 * 1024.0;
+
+	os	<< "\nPipelining " << title << " I/O\n"
+		<< std::setw(cw) << "Read MB"
+		<< std::setw(cw) << "Written MB"
+		<< std::setw(cw) << "Blocks"
+		<< std::setw(cw) << "Read s"
+		<< std::setw(cw) << "Write s"
+		<< std::setw(cw) << "Ratio"
+		<< sep << "Name\n";
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		io_counters c = nodes[i]->get_io_stats()->get();
+		if (c.blocksRead == 0 && c.blocksWritten == 0) continue;
+		os	<< std::fixed << std::setprecision(2)
+			<< std::setw(cw) << c.bytesRead / mb
+			<< std::setw(cw) << c.bytesWritten / mb
+			<< std::setw(cw) << c.blocksRead + c.blocksWritten
+			<< std::setw(cw) << c.readSeconds
+			<< std::setw(cw) << c.writeSeconds
+			<< std::setw(cw) << c.compression_ratio()
+			<< sep
+			<< nodes[i]->get_name().substr(0, 50) << '\n';
+	}
+	os << std::endl;
+}
+
 	
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Helper class for RAII-style progress indicators.
@@ -1006,7 +1049,10 @@ public:
 	void begin() {
 		for (size_t i = m_topologicalOrder.size(); i--;) {
 			m_topologicalOrder[i]->set_state(node::STATE_IN_BEGIN);
-			m_topologicalOrder[i]->begin();
+			{
+				profile_scope _(m_topologicalOrder[i]->get_profile());
+				m_topologicalOrder[i]->begin();
+			}
 			m_topologicalOrder[i]->set_state(node::STATE_AFTER_BEGIN);
 		}
 	}
@@ -1014,7 +1060,10 @@ public:
 	void end() {
 		for (size_t i = 0; i < m_topologicalOrder.size(); ++i) {
 			m_topologicalOrder[i]->set_state(node::STATE_IN_END);
-			m_topologicalOrder[i]->end();
+			{
+				profile_scope _(m_topologicalOrder[i]->get_profile());
+				m_topologicalOrder[i]->end();
+			}
 			m_topologicalOrder[i]->set_state(node::STATE_AFTER_END);
 		}
 	}
@@ -1023,6 +1072,42 @@ private:
 	std::vector<node *> m_topologicalOrder;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// Job running begin, go and end of a phase that runs concurrently with
+/// other phases. An exception is kept and rethrown by the runtime after all
+/// phases of the group are done.
+///////////////////////////////////////////////////////////////////////////////
+class phase_job : public job {
+public:
+	phase_job(runtime & rt, graph<node *> & actorGraph, const std::vector<node *> & phase)
+		: m_runtime(rt)
+		, m_actorGraph(actorGraph)
+		, m_phase(phase)
+	{
+	}
+
+	void operator()() override {
+		try {
+			begin_end beginEnd(m_actorGraph);
+			beginEnd.begin();
+			m_runtime.go_initiators(m_phase);
+			beginEnd.end();
+		} catch (...) {
+			m_error = std::current_exception();
+		}
+	}
+
+	void rethrow_error() {
+		if (m_error) std::rethrow_exception(m_error);
+	}
+
+private:
+	runtime & m_runtime;
+	graph<node *> & m_actorGraph;
+	const std::vector<node *> & m_phase;
+	std::exception_ptr m_error;
+};
+
 datastructure_runtime::datastructure_runtime(const std::vector<std::vector<node *> > & phases, node_map & nodeMap)
 	: m_nodeMap(nodeMap)
 {
@@ -1125,6 +1210,7 @@ struct gocontext {
 	graph<size_t> phaseGraph;
 	std::vector<std::vector<node *> > phases;
 	std::unordered_set<node_map::id_t> evacuateWhenDone;
+	std::vector<size_t> groups;
 	std::vector<graph<node *> > itemFlow;
 	std::vector<graph<node *> > actor;
 	datastructure_runtime drt;
@@ -1133,11 +1219,15 @@ struct gocontext {
 	memory_size_type files;
 	memory_size_type memory;
 	phase_progress_indicator phaseProgress;
+	// Progress indicator of the phases run concurrently with the first
+	// phase of a group. Their nodes keep a pointer to it.
+	progress_indicator_null nullProgress;
 };
 
 
 runtime::runtime(node_map::ptr nodeMap)
 	: m_nodeMap(*nodeMap)
+	, m_concurrentPhases(false)
 {
 }
 
@@ -1190,11 +1280,33 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 	// build the datastructure runtime
 	datastructure_runtime drt(phases, m_nodeMap); 
 
-	// Gather node file requirements and assign files to each phase
-	assign_files(phases, files);
+	// Group independent phases that go_until runs at the same time
+	std::vector<size_t> groups;
+	get_concurrent_phases(phaseMap, phaseGraph, phases, drt,
+						  m_concurrentPhases ? get_worker_count() + 1 : 1, groups);
+
+	// The memory of a group is divided between its phases, so a node
+	// sharing memory with a phase in a group of several phases is
+	// evacuated instead of keeping its memory
+	{
+		std::unordered_map<node_map::id_t, size_t> phaseIndex;
+		for (size_t p = 0; p < phases.size(); ++p)
+			for (node * n : phases[p])
+				phaseIndex[n->get_id()] = p;
+		const node_map::relmap_t & relations = m_nodeMap.get_relations();
+		for (node_map::relmapit i = relations.begin(); i != relations.end(); ++i) {
+			if (i->second.second != memory_share_depends) continue;
+			size_t p = phaseIndex[i->first];
+			while (groups[p] == 0) --p;
+			if (groups[p] > 1) evacuateWhenDone.insert(i->second.first);
+		}
+	}
+
+	// Gather node file requirements and assign files to each group of phases
+	assign_files(phases, groups, files);
 
-	// Gather node memory requirements and assign memory to each phase
-	assign_memory(phases, memory, drt);
+	// Gather node memory requirements and assign memory to each group of phases
+	assign_memory(phases, groups, memory, drt);
 
 	// Exception guarantees are the following:
 	//   Progress indicators:
@@ -1218,6 +1330,7 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 				std::move(phaseGraph),
 				std::move(phases),
 				std::move(evacuateWhenDone),
+				std::move(groups),
 				std::move(itemFlow),
 				std::move(actor),
 				std::move(drt),
@@ -1225,7 +1338,8 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 				0,
 				files,
 				memory,
-				phase_progress_indicator()});
+				phase_progress_indicator(),
+				progress_indicator_null()});
 }
 	
 
@@ -1235,30 +1349,38 @@ void runtime::go_until(gocontext * gc, node * node) {
 	if (gc->i != 0) {
 		begin_end beginEnd(gc->actor[gc->i-1]);
 		beginEnd.end();
+#ifndef TPIE_NDEBUG
+		print_io_usage("phase " + get_phase_name(gc->phases[gc->i-1]), gc->phases[gc->i-1], log_pipe_debug());
+#endif // TPIE_NDEBUG
 	}
 
 	for (; gc->i < gc->phases.size(); ++gc->i) {
 		// Run each phase:
 		// Evacuate previous if necessary
+		if (gc->i > 0) {
+			size_t p = gc->i - 1;
+			while (gc->groups[p] == 0) --p;
+			for (; p < gc->i; ++p)
+				evacuate_all(gc->phases[p], gc->evacuateWhenDone);
+		}
+
+		if (gc->groups[gc->i] > 1) {
+			go_concurrently(gc);
+			continue;
+		}
+
 		auto & phase = gc->phases[gc->i];
 		log_debug() << "Running pipe phase " << get_phase_name(phase) << std::endl;
-		
-		if (gc->i > 0) evacuate_all(gc->phases[gc->i-1], gc->evacuateWhenDone);
 			
 		// call propagate in item source to item sink order
 		propagate_all(gc->itemFlow[gc->i]);
 		// reassign files to all nodes in the phase
-		reassign_files(gc->phases, gc->i, gc->files);
+		reassign_files(gc->phases, gc->i, 1, gc->files);
 		// reassign memory to all nodes in the phase
-		reassign_memory(gc->phases, gc->i, gc->memory, gc->drt);
+		reassign_memory(gc->phases, gc->i, 1, gc->memory, gc->drt);
 
-		bool emptyFace = true;
-		for (auto n: phase)
-			if (is_initiator(n) && !n->is_go_free())
-				emptyFace = false;
-		
 		// sum number of steps and call pi.init()
-		gc->phaseProgress = phase_progress_indicator(gc->pi, gc->i, phase, emptyFace);
+		gc->phaseProgress = phase_progress_indicator(gc->pi, gc->i, phase, is_empty_face(phase));
 		
 		// set progress indicators on each node
 		set_progress_indicators(phase, gc->phaseProgress.get());
@@ -1276,6 +1398,9 @@ void runtime::go_until(gocontext * gc, node * node) {
 
 		// call end in root to leaf actor order
 		beginEnd.end();
+#ifndef TPIE_NDEBUG
+		print_io_usage("phase " + get_phase_name(phase), phase, log_pipe_debug());
+#endif // TPIE_NDEBUG
 
 		gc->drt.free_datastructures(gc->i);
 
@@ -1285,6 +1410,57 @@ void runtime::go_until(gocontext * gc, node * node) {
 	// call fp->done in ~progress_indicators
 	gc->i++;
 }
+
+void runtime::go_concurrently(gocontext * gc) {
+	const size_t first = gc->i;
+	const size_t count = gc->groups[first];
+
+	for (size_t p = first; p < first + count; ++p) {
+		log_debug() << "Running pipe phase " << get_phase_name(gc->phases[p])
+					<< " concurrently" << std::endl;
+		// call propagate in item source to item sink order
+		propagate_all(gc->itemFlow[p]);
+	}
+	// divide files and memory between all nodes in the group
+	reassign_files(gc->phases, first, count, gc->files);
+	reassign_memory(gc->phases, first, count, gc->memory, gc->drt);
+
+	// Nodes may not be able to tell if they are go free after end()
+	std::vector<char> emptyFace(count);
+	for (size_t j = 0; j < count; ++j)
+		emptyFace[j] = is_empty_face(gc->phases[first + j]);
+
+	// Progress indicators are not thread safe, so only the first phase,
+	// which runs on this thread, reports progress while running.
+	// The other phases are reported done when the group is done.
+	gc->phaseProgress = phase_progress_indicator(gc->pi, first, gc->phases[first], emptyFace[0]);
+	set_progress_indicators(gc->phases[first], gc->phaseProgress.get());
+	for (size_t p = first + 1; p < first + count; ++p)
+		set_progress_indicators(gc->phases[p], gc->nullProgress);
+
+	std::vector<std::unique_ptr<phase_job> > jobs;
+	for (size_t p = first; p < first + count; ++p)
+		jobs.emplace_back(new phase_job(*this, gc->actor[p], gc->phases[p]));
+	for (size_t j = 1; j < count; ++j)
+		jobs[j]->enqueue();
+	(*jobs[0])();
+	for (size_t j = 1; j < count; ++j)
+		jobs[j]->join();
+	for (size_t j = 0; j < count; ++j)
+		jobs[j]->rethrow_error();
+
+	gc->phaseProgress = phase_progress_indicator();
+	for (size_t p = first; p < first + count; ++p) {
+		// call pi.init() and pi.done() for the other phases
+		if (p != first)
+			phase_progress_indicator(gc->pi, p, gc->phases[p], emptyFace[p - first]);
+#ifndef TPIE_NDEBUG
+		print_io_usage("phase " + get_phase_name(gc->phases[p]), gc->phases[p], log_pipe_debug());
+#endif // TPIE_NDEBUG
+		gc->drt.free_datastructures(p);
+	}
+	gc->i = first + count - 1;
+}
 		
 void runtime::go(stream_size_type items,
 				 progress_indicator_base & progress,
@@ -1613,6 +1789,54 @@ void runtime::get_phases(const std::map<node *, size_t> & phaseMap,
 	}
 }
 
+void runtime::get_concurrent_phases(const std::map<node *, size_t> & phaseMap,
+									const graph<size_t> & phaseGraph,
+									const std::vector<std::vector<node *> > & phases,
+									const datastructure_runtime & drt,
+									size_t maxConcurrency,
+									std::vector<size_t> & groups) {
+	const size_t N = phases.size();
+	groups.assign(N, 1);
+	if (maxConcurrency < 2) return;
+
+	// dependents[i] is the set of phases in the phase graph that depend on
+	// phases[i], directly or indirectly
+	std::vector<std::set<size_t> > dependents(N);
+	for (size_t i = 0; i < N; ++i) {
+		std::vector<size_t> stack(1, phaseMap.find(phases[i].front())->second);
+		while (!stack.empty()) {
+			size_t u = stack.back();
+			stack.pop_back();
+			for (size_t v : phaseGraph.get_edge_list(u))
+				if (dependents[i].insert(v).second) stack.push_back(v);
+		}
+	}
+
+	auto uses_datastructures = [&](size_t p) {
+		return drt.sum_minimum_memory(p) != 0 || drt.sum_fraction(p) != 0.0;
+	};
+
+	// Since phases is in topological order, a phase can only depend on the
+	// phases before it
+	size_t first = 0;
+	while (first < N) {
+		size_t last = first + 1;
+		if (!uses_datastructures(first)) {
+			for (; last < N && last - first < maxConcurrency; ++last) {
+				if (uses_datastructures(last)) break;
+				size_t id = phaseMap.find(phases[last].front())->second;
+				bool independent = true;
+				for (size_t k = first; k < last; ++k)
+					if (dependents[k].count(id)) independent = false;
+				if (!independent) break;
+			}
+		}
+		groups[first] = last - first;
+		for (size_t k = first + 1; k < last; ++k) groups[k] = 0;
+		first = last;
+	}
+}
+
 void runtime::get_item_flow_graphs(std::vector<std::vector<node *> > & phases,
 								   std::vector<graph<node *> > & itemFlow)
 {
@@ -1656,6 +1880,13 @@ bool runtime::is_initiator(node * n) {
 		&& m_nodeMap.in_degree(id, pulls) == 0;
 }
 
+bool runtime::is_empty_face(const std::vector<node *> & phase) {
+	for (auto n: phase)
+		if (is_initiator(n) && !n->is_go_free())
+			return false;
+	return true;
+}
+
 bool runtime::has_initiator(const std::vector<node *> & phase) {
 	for (size_t i = 0; i < phase.size(); ++i)
 		if (is_initiator(phase[i])) return true;
@@ -1716,7 +1947,10 @@ void runtime::go_initiators(const std::vector<node *> & phase) {
 		if (is_initiator(phase[i])) initiators.push_back(phase[i]);
 	for (size_t i = 0; i < initiators.size(); ++i) {
 		initiators[i]->set_state(node::STATE_IN_GO);
-		initiators[i]->go();
+		{
+			profile_scope _(initiators[i]->get_profile());
+			initiators[i]->go();
+		}
 		initiators[i]->set_state(node::STATE_AFTER_BEGIN);
 	}
 }
@@ -1730,32 +1964,37 @@ void runtime::set_resource_being_assigned(const std::vector<node *> & nodes,
 
 /*static*/
 void runtime::assign_files(const std::vector<std::vector<node *> > & phases,
-							memory_size_type files) {
+						   const std::vector<size_t> & groups,
+						   memory_size_type files) {
 	for (size_t phase = 0; phase < phases.size(); ++phase) {
-		file_runtime frt(phases[phase]);
+		if (groups[phase] == 0) continue;
+		std::vector<node *> nodes = get_group_nodes(phases, phase, groups[phase]);
+		file_runtime frt(nodes);
 
 		double c = get_files_factor(files, frt);
 #ifndef TPIE_NDEBUG
 		frt.print_usage(c, log_pipe_debug());
 #endif // TPIE_NDEBUG
-		set_resource_being_assigned(phases[phase], FILES);
+		set_resource_being_assigned(nodes, FILES);
 		frt.assign_usage(c);
-		set_resource_being_assigned(phases[phase], NO_RESOURCE);
+		set_resource_being_assigned(nodes, NO_RESOURCE);
 	}
 }
 
 /*static*/
 void runtime::reassign_files(const std::vector<std::vector<node *> > & phases,
-							  size_t phase,
-							  memory_size_type files) {
-	file_runtime frt(phases[phase]);
+							 size_t phase,
+							 size_t phaseCount,
+							 memory_size_type files) {
+	std::vector<node *> nodes = get_group_nodes(phases, phase, phaseCount);
+	file_runtime frt(nodes);
 	double c = get_files_factor(files, frt);
 #ifndef TPIE_NDEBUG
 	frt.print_usage(c, log_pipe_debug());
 #endif // TPIE_NDEBUG
-	set_resource_being_assigned(phases[phase], FILES);
+	set_resource_being_assigned(nodes, FILES);
 	frt.assign_usage(c);
-	set_resource_being_assigned(phases[phase], NO_RESOURCE);
+	set_resource_being_assigned(nodes, NO_RESOURCE);
 }
 
 /*static*/
@@ -1806,6 +2045,7 @@ double runtime::get_files_factor(memory_size_type files, const file_runtime & fr
 
 /*static*/
 void runtime::assign_memory(const std::vector<std::vector<node *> > & phases,
+							const std::vector<size_t> & groups,
 							memory_size_type memory,
 							datastructure_runtime & drt) {
 	for (size_t phase = 0; phase < phases.size(); ++phase) {
@@ -1815,16 +2055,20 @@ void runtime::assign_memory(const std::vector<std::vector<node *> > & phases,
 		drt.minimize_factor(c, phase);
 	}
 
+	// Phases in a group of several phases do not use datastructures,
+	// so the datastructure memory of the group is that of its first phase
 	for (size_t phase = 0; phase < phases.size(); ++phase) {
-		memory_runtime mrt(phases[phase]);
+		if (groups[phase] == 0) continue;
+		std::vector<node *> nodes = get_group_nodes(phases, phase, groups[phase]);
+		memory_runtime mrt(nodes);
 
 		double c = get_memory_factor(memory, phase, mrt, drt, true);
 #ifndef TPIE_NDEBUG
 		mrt.print_usage(c, log_pipe_debug());
 #endif // TPIE_NDEBUG
-		set_resource_being_assigned(phases[phase], MEMORY);
+		set_resource_being_assigned(nodes, MEMORY);
 		mrt.assign_usage(c);
-		set_resource_being_assigned(phases[phase], NO_RESOURCE);
+		set_resource_being_assigned(nodes, NO_RESOURCE);
 	}
 	drt.assign_memory();
 }
@@ -1832,16 +2076,18 @@ void runtime::assign_memory(const std::vector<std::vector<node *> > & phases,
 /*static*/
 void runtime::reassign_memory(const std::vector<std::vector<node *> > & phases,
 							  size_t phase,
+							  size_t phaseCount,
 							  memory_size_type memory,
 							  const datastructure_runtime & drt) {
-	memory_runtime mrt(phases[phase]);
+	std::vector<node *> nodes = get_group_nodes(phases, phase, phaseCount);
+	memory_runtime mrt(nodes);
 	double c = get_memory_factor(memory, phase, mrt, drt, true);
 #ifndef TPIE_NDEBUG
 	mrt.print_usage(c, log_pipe_debug());
 #endif // TPIE_NDEBUG
-	set_resource_being_assigned(phases[phase], MEMORY);
+	set_resource_being_assigned(nodes, MEMORY);
 	mrt.assign_usage(c);
-	set_resource_being_assigned(phases[phase], NO_RESOURCE);
+	set_resource_being_assigned(nodes, NO_RESOURCE);
 }
 
 /*static*/
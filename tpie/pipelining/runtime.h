@@ -46,6 +46,7 @@ typedef std::unique_ptr<gocontext, gocontextdel> gocontext_ptr;
 ///////////////////////////////////////////////////////////////////////////////
 class runtime {
 	node_map & m_nodeMap;
+	bool m_concurrentPhases;
 
 public:
 	///////////////////////////////////////////////////////////////////////////
@@ -62,6 +63,15 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	size_t get_node_count();
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Allow go() to run independent phases at the same time.
+	///
+	/// See pipeline_base::set_concurrent_phases(). Off by default.
+	///////////////////////////////////////////////////////////////////////////
+	void set_concurrent_phases(bool enabled) {
+		m_concurrentPhases = enabled;
+	}
+
 	gocontext_ptr go_init(stream_size_type items,
 						 progress_indicator_base & progress,
 						 memory_size_type files,
@@ -146,6 +156,23 @@ public:
 					std::unordered_set<node_map::id_t> & evacuateWhenDone,
 					std::vector<std::vector<node *> > & phases);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Group consecutive phases that may run at the same time.
+	///
+	/// On return, phases[i], ..., phases[i+groups[i]-1] form a group for
+	/// each i with groups[i] > 0, and groups[j] is 0 for the other phases
+	/// of the group. Phases in a group do not depend on each other, directly
+	/// or indirectly, and do not use datastructures. A group has at most
+	/// maxConcurrency phases; if maxConcurrency is less than two, every
+	/// phase is a group by itself.
+	///////////////////////////////////////////////////////////////////////////
+	void get_concurrent_phases(const std::map<node *, size_t> & phaseMap,
+							   const graph<size_t> & phaseGraph,
+							   const std::vector<std::vector<node *> > & phases,
+							   const datastructure_runtime & drt,
+							   size_t maxConcurrency,
+							   std::vector<size_t> & groups);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
@@ -172,6 +199,12 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	bool is_initiator(node * n);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Check if no initiator of the phase does any work in go(),
+	/// in which case the phase gets no name in the progress indicator.
+	///////////////////////////////////////////////////////////////////////////
+	bool is_empty_face(const std::vector<node *> & phase);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Equivalent to any_of(begin(phase), end(phase), is_initiator).
 	///////////////////////////////////////////////////////////////////////////
@@ -213,6 +246,12 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void go_initiators(const std::vector<node *> & phase);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Run the group of phases starting at phase gc->i on the job
+	/// pool, and leave gc->i at the last phase of the group.
+	///////////////////////////////////////////////////////////////////////////
+	void go_concurrently(gocontext * gc);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
@@ -223,14 +262,16 @@ public:
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
 	static void assign_files(const std::vector<std::vector<node *> > & phases,
-							  memory_size_type files);
+							 const std::vector<size_t> & groups,
+							 memory_size_type files);
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
 	static void reassign_files(const std::vector<std::vector<node *> > & phases,
-								memory_size_type phase,
-								memory_size_type files);
+							   memory_size_type phase,
+							   memory_size_type phaseCount,
+							   memory_size_type files);
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by assign_memory().
@@ -242,6 +283,7 @@ public:
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
 	static void assign_memory(const std::vector<std::vector<node *> > & phases,
+							  const std::vector<size_t> & groups,
 							  memory_size_type memory, datastructure_runtime & drt);
 
 	///////////////////////////////////////////////////////////////////////////
@@ -249,8 +291,17 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	static void reassign_memory(const std::vector<std::vector<node *> > & phases,
 								memory_size_type phase,
+								memory_size_type phaseCount,
 								memory_size_type memory, const datastructure_runtime & drt);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Print a table of the block I/O counted for the given nodes;
+	/// see node::get_io_stats(). Nodes that did no I/O are left out.
+	///////////////////////////////////////////////////////////////////////////
+	static void print_io_usage(const std::string & title,
+							   const std::vector<node *> & nodes,
+							   std::ostream & os);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by assign_memory().
 	///////////////////////////////////////////////////////////////////////////
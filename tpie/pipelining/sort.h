@@ -349,6 +349,10 @@ public:
 		m_sorter->push(item);
 	}
 
+	void push_batch(array_view<const item_type> items) {
+		m_sorter->push_batch(items);
+	}
+
 	void begin() override {
 		m_sorter->begin();
 		m_sorter->set_owner(this);
@@ -394,7 +398,7 @@ template <typename pred_t, typename store_t>
 class sort_factory : public factory_base {
 public:
 	template <typename dest_t>
-	using constructed_type = sort_input_t<typename push_type<dest_t>::type, pred_t, store_t>;
+	using constructed_type = profiled_t<sort_input_t<typename push_type<dest_t>::type, pred_t, store_t> >;
 	
 	template <typename dest_t>
 	constructed_type<dest_t> construct(dest_t dest) {
@@ -407,7 +411,7 @@ public:
 		this->init_sub_node(output);
 		sort_calc_t<item_type, pred_t, store_t> calc(std::move(output));
 		this->init_sub_node(calc);
-		sort_input_t<item_type, pred_t, store_t> input(std::move(calc));
+		constructed_type<dest_t> input(std::move(calc));
 		this->init_sub_node(input);
 		return input;
 	}
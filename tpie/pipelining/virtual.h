@@ -29,6 +29,7 @@
 #include <tpie/pipelining/pipeline.h>
 #include <tpie/pipelining/factory_helpers.h>
 #include <tpie/pipelining/helpers.h>
+#include <tpie/pipelining/push_batch.h>
 
 namespace tpie::pipelining {
 
@@ -101,17 +102,43 @@ struct maybe_add_const_ref<T *> {
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief Virtual base node that is injected into the beginning of a
 /// virtual chunk. For efficiency, the push method accepts a const reference
-/// type unless the item type is already const/ref/pointer.
+/// type unless the item type is already const/ref/pointer, and batches of
+/// items can be pushed with a single virtual call.
 ///////////////////////////////////////////////////////////////////////////////
 template <typename Input>
 class virtsrc : public node {
 	typedef typename maybe_add_const_ref<Input>::type input_type;
 
 public:
+	typedef typename std::decay<Input>::type value_type;
+
 	virtual const node_token & get_token() = 0; //TODO this need not be virtual
 	virtual void push(input_type v) = 0;
+	virtual void push_batch(array_view<const value_type> items) = 0;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Push a batch received by a virtsrc whose push method accepts
+/// input_type to dest.
+///
+/// The batch is passed on if dest implements push_batch and accepts the
+/// items by const reference, and is otherwise pushed one item at a time.
+/// Items that dest takes by non-const reference are pushed as copies.
+///////////////////////////////////////////////////////////////////////////////
+template <typename input_type, typename dest_t, typename T>
+void push_virtual_batch(dest_t & dest, array_view<const T> items) {
+	if constexpr (!std::is_convertible<const T &, input_type>::value) {
+		for (const T & item : items) {
+			T copy(item);
+			dest.push(copy);
+		}
+	} else if constexpr (bits::has_push_batch_method<dest_t, T>::value) {
+		dest.push_batch(items);
+	} else {
+		for (const T & item : items) dest.push(item);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief Concrete implementation of virtsrc.
 ///////////////////////////////////////////////////////////////////////////////
@@ -140,6 +167,10 @@ public:
 	void push(input_type v) final {
 		dest.push(v);
 	}
+
+	void push_batch(array_view<const typename virtsrc<T>::value_type> items) final {
+		push_virtual_batch<input_type>(dest, items);
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -181,6 +212,10 @@ public:
 		m_virtdest->push(v);
 	}
 
+	void push_batch(array_view<const typename virtsrc<Output>::value_type> items) {
+		m_virtdest->push_batch(items);
+	}
+
 	void set_destination(virtsrc<Output> * dest) {
 		if (m_virtdest != nullptr) {
 			throw tpie::exception("Virtual destination set twice");
@@ -1084,6 +1119,10 @@ public:
 		if (dest) dest->push(v);
 	}
 
+	void push_batch(array_view<const typename virtsrc<T>::value_type> items) {
+		if (dest) dest->push_batch(items);
+	}
+
 private:
 	// This counted reference ensures dest is not deleted prematurely.
 	virt_node::ptr vnode;
@@ -1137,6 +1176,10 @@ public:
 	void push(input_type v) final {
 		dest.push(v);
 	}
+
+	void push_batch(array_view<const typename virtsrc<T>::value_type> items) final {
+		push_virtual_batch<input_type>(dest, items);
+	}
 	
 	virt_node::ptr vnode;
 	virtrecv<T> * recv = nullptr;
@@ -58,6 +58,7 @@ public:
 	queue(cache_hint cacheHint=access_sequential,
 		  compression_flags compressionFlags=compression_normal)
 		: m_size(0)
+		, m_reserved(0)
 		, m_queueA(1.0)
 		, m_queueB(1.0)
 		, m_centerQueue(get_block_size()/sizeof(T))
@@ -79,6 +80,23 @@ public:
 	////////////////////////////////////////////////////////////////////
 	inline stream_size_type size() {return m_size;}
 
+	////////////////////////////////////////////////////////////////////
+	/// \brief Hint that the queue will hold up to the given number of
+	/// items, so disk space for them can be allocated up front.
+	///
+	/// The space is reserved in the stream that items are pushed to. When
+	/// the streams are swapped, the space the new pop stream did not use is
+	/// released, so only one of them holds a reservation at a time.
+	///
+	/// Like file_stream::reserve, this does nothing unless the queue was
+	/// constructed with compression_none.
+	/// \sa file_stream::reserve
+	////////////////////////////////////////////////////////////////////
+	void reserve(stream_size_type items) {
+		m_reserved = items;
+		push_queue().reserve(items);
+	}
+
 	////////////////////////////////////////////////////////////////////
 	/// \brief Enqueue an item
 	/// \param t The item to be enqueued
@@ -156,9 +174,14 @@ private:
 		m_currentQueue = !m_currentQueue;
 		pop_queue().seek(0);
 		push_queue().truncate(0);
+		if (m_reserved != 0) {
+			pop_queue().reserve(pop_queue().size());
+			push_queue().reserve(m_reserved);
+		}
 	}
 
 	stream_size_type m_size;
+	stream_size_type m_reserved;
 	file_stream<T> m_queueA;
 	file_stream<T> m_queueB;
 	internal_queue<T> m_centerQueue;
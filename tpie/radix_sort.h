@@ -0,0 +1,199 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_RADIX_SORT_H__
+#define __TPIE_RADIX_SORT_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file radix_sort.h
+/// \brief In-place radix sort on integer keys.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Less-than predicate comparing the integer keys returned by a key
+/// extractor.
+///
+/// Passing a radix_pred as the predicate of tpie::sort, pipelining::sort,
+/// merge_sorter or serialization_sorter makes them sort runs with
+/// radix_sort() instead of a comparison based sort. The key extractor must
+/// return an integral type of at most 64 bits.
+///////////////////////////////////////////////////////////////////////////////
+template <typename key_extractor_t>
+class radix_pred {
+public:
+	typedef key_extractor_t key_extractor_type;
+
+	radix_pred(key_extractor_t key = key_extractor_t()) : m_key(key) {}
+
+	template <typename T>
+	bool operator()(const T & lhs, const T & rhs) const {
+		return m_key(lhs) < m_key(rhs);
+	}
+
+	const key_extractor_t & key_extractor() const {
+		return m_key;
+	}
+
+private:
+	key_extractor_t m_key;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Construct a radix_pred from a key extractor.
+///////////////////////////////////////////////////////////////////////////////
+template <typename key_extractor_t>
+radix_pred<key_extractor_t> make_radix_pred(key_extractor_t key) {
+	return radix_pred<key_extractor_t>(key);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Key extractor returning the item itself, for sorting integers.
+///////////////////////////////////////////////////////////////////////////////
+struct identity_key {
+	template <typename T>
+	T operator()(const T & item) const {
+		return item;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Whether a predicate is a radix_pred.
+///////////////////////////////////////////////////////////////////////////////
+template <typename pred_t>
+struct is_radix_pred : public std::false_type {};
+
+template <typename key_extractor_t>
+struct is_radix_pred<radix_pred<key_extractor_t> > : public std::true_type {};
+
+namespace bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Map a key to an unsigned integer with the same order.
+///////////////////////////////////////////////////////////////////////////////
+template <typename key_t>
+std::uint64_t radix_key(key_t key) {
+	static_assert(std::is_integral<key_t>::value && sizeof(key_t) <= 8,
+				  "radix_sort requires integral keys of at most 64 bits");
+	typedef typename std::make_unsigned<key_t>::type ukey_t;
+	ukey_t k = static_cast<ukey_t>(key);
+	// Flip the sign bit so negative keys come first.
+	if (std::is_signed<key_t>::value)
+		k ^= static_cast<ukey_t>(1) << (sizeof(key_t) * 8 - 1);
+	return k;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief American flag sort of [first, last) on the byte at the given shift
+/// and all less significant bytes.
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename key_extractor_t>
+void radix_sort_msd(iterator_type first, iterator_type last,
+					const key_extractor_t & key, unsigned shift) {
+	typedef typename std::iterator_traits<iterator_type>::value_type value_type;
+	// Below this size, a comparison based sort is faster than a pass over
+	// 256 buckets.
+	const std::size_t cutoff = 64;
+
+	auto digit = [&key, &shift](const value_type & item) -> std::size_t {
+		return static_cast<std::size_t>((radix_key(key(item)) >> shift) & 0xff);
+	};
+
+	for (;;) {
+		const std::size_t n = static_cast<std::size_t>(last - first);
+		if (n < cutoff) {
+			std::sort(first, last, [&key](const value_type & a, const value_type & b) {
+				return radix_key(key(a)) < radix_key(key(b));
+			});
+			return;
+		}
+
+		std::size_t count[256] = {0};
+		for (iterator_type i = first; i != last; ++i) ++count[digit(*i)];
+
+		// Skip bytes that are equal for all items.
+		if (count[digit(*first)] == n) {
+			if (shift == 0) return;
+			shift -= 8;
+			continue;
+		}
+
+		std::size_t begin[256];
+		std::size_t end[256];
+		std::size_t offset = 0;
+		for (std::size_t b = 0; b < 256; ++b) {
+			begin[b] = offset;
+			offset += count[b];
+			end[b] = offset;
+		}
+
+		// Move every item to its bucket by following cycles of displaced
+		// items.
+		for (std::size_t b = 0; b < 256; ++b) {
+			while (begin[b] < end[b]) {
+				value_type item = std::move(first[begin[b]]);
+				std::size_t d = digit(item);
+				while (d != b) {
+					std::swap(item, first[begin[d]++]);
+					d = digit(item);
+				}
+				first[begin[b]++] = std::move(item);
+			}
+		}
+
+		if (shift == 0) return;
+		offset = 0;
+		for (std::size_t b = 0; b < 256; ++b) {
+			if (count[b] > 1)
+				radix_sort_msd(first + offset, first + offset + count[b], key, shift - 8);
+			offset += count[b];
+		}
+		return;
+	}
+}
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Sort [first, last) by the integer keys returned by the key
+/// extractor.
+///
+/// Uses an in-place most significant digit first radix sort with 8 bit
+/// digits, so the running time is linear in the number of items times the
+/// number of key bytes in which the items differ. The sort is not stable.
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename key_extractor_t>
+void radix_sort(iterator_type first, iterator_type last, const key_extractor_t & key) {
+	typedef typename std::iterator_traits<iterator_type>::value_type value_type;
+	typedef typename std::decay<decltype(key(std::declval<const value_type &>()))>::type key_t;
+	if (last - first < 2) return;
+	bits::radix_sort_msd(first, last, key, static_cast<unsigned>(sizeof(key_t) * 8 - 8));
+}
+
+} // namespace tpie
+
+#endif // __TPIE_RADIX_SORT_H__
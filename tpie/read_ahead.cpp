@@ -0,0 +1,178 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/read_ahead.h>
+#include <tpie/memory.h>
+#include <tpie/exception.h>
+#include <algorithm>
+
+namespace tpie {
+
+read_ahead::read_ahead(file_accessor::file_accessor * fileAccessor,
+					   memory_size_type itemSize,
+					   memory_size_type blockItems,
+					   memory_size_type blocks)
+	: m_fileAccessor(fileAccessor)
+	, m_itemSize(itemSize)
+	, m_blockItems(blockItems)
+	, m_active(false)
+	, m_reading(false)
+	, m_scheduled(false)
+	, m_running(false)
+	, m_generation(0)
+	, m_nextRead(0)
+	, m_nextFetch(0)
+	, m_size(0)
+	, m_reader(*this)
+{
+	m_free.reserve(blocks);
+	m_ready.reserve(blocks);
+	for (memory_size_type i = 0; i < blocks; ++i)
+		m_free.push_back(tpie_new_aligned_array<char>(m_itemSize * m_blockItems,
+													  file_accessor::block_alignment));
+}
+
+read_ahead::~read_ahead() {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		cancel(lock);
+	}
+	// A queued job returns at once since the read_ahead is not active.
+	m_reader.join();
+	for (size_t i = 0; i < m_free.size(); ++i)
+		tpie_delete_aligned_array(m_free[i], m_itemSize * m_blockItems,
+								  file_accessor::block_alignment);
+}
+
+void read_ahead::start(stream_size_type number, stream_size_type size) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_active && m_nextFetch == number && m_size == size) return;
+	cancel(lock);
+	m_active = true;
+	m_nextRead = m_nextFetch = number;
+	m_size = size;
+	schedule(lock);
+}
+
+bool read_ahead::fetch(stream_size_type number, char *& data, memory_size_type & items) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_active || number != m_nextFetch) return false;
+
+	const stream_size_type end = (m_size + m_blockItems - 1) / m_blockItems;
+	while (m_ready.empty() && !m_error && m_nextRead < end) {
+		schedule(lock);
+		if (m_running) {
+			m_changed.wait(lock);
+		} else {
+			// The job is waiting for a worker; run it here instead.
+			lock.unlock();
+			m_reader.join();
+			lock.lock();
+		}
+	}
+
+	if (m_error) {
+		std::exception_ptr e = m_error;
+		cancel(lock);
+		std::rethrow_exception(e);
+	}
+	if (m_ready.empty()) return false;
+
+	block b = m_ready.front();
+	m_ready.erase(m_ready.begin());
+	m_free.push_back(data);
+	data = b.data;
+	items = b.items;
+	++m_nextFetch;
+	schedule(lock);
+	return true;
+}
+
+void read_ahead::cancel() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	cancel(lock);
+}
+
+void read_ahead::cancel(std::unique_lock<std::mutex> & lock) {
+	++m_generation;
+	m_active = false;
+	while (m_reading) m_changed.wait(lock);
+	for (size_t i = 0; i < m_ready.size(); ++i)
+		m_free.push_back(m_ready[i].data);
+	m_ready.clear();
+	m_error = std::exception_ptr();
+}
+
+bool read_ahead::can_read() const {
+	return m_active && !m_free.empty()
+		&& m_nextRead * m_blockItems < m_size
+		&& !m_error;
+}
+
+void read_ahead::schedule(std::unique_lock<std::mutex> & /*lock*/) {
+	if (m_scheduled || !can_read()) return;
+	// run() has returned, but the job may not be marked as done yet.
+	m_reader.join();
+	m_scheduled = true;
+	m_reader.enqueue();
+}
+
+void read_ahead::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_running = true;
+	while (can_read()) {
+		char * data = m_free.back();
+		m_free.pop_back();
+		const stream_size_type number = m_nextRead++;
+		const stream_size_type generation = m_generation;
+		const memory_size_type items = static_cast<memory_size_type>(
+			std::min<stream_size_type>(m_blockItems, m_size - number * m_blockItems));
+		m_reading = true;
+
+		std::exception_ptr error;
+		lock.unlock();
+		try {
+			if (m_fileAccessor->read_block(data, number, items) != items)
+				throw io_exception("Incorrect number of items read");
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		m_reading = false;
+		if (generation != m_generation) {
+			m_free.push_back(data);
+		} else if (error) {
+			m_free.push_back(data);
+			m_error = error;
+		} else {
+			block b;
+			b.data = data;
+			b.number = number;
+			b.items = items;
+			m_ready.push_back(b);
+		}
+		m_changed.notify_all();
+	}
+	m_running = false;
+	m_scheduled = false;
+	m_changed.notify_all();
+}
+
+} // namespace tpie
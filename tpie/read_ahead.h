@@ -0,0 +1,167 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file read_ahead.h  Asynchronous block prefetching for uncompressed streams
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TPIE_READ_AHEAD_H__
+#define __TPIE_READ_AHEAD_H__
+
+#include <tpie/tpie_export.h>
+#include <tpie/types.h>
+#include <tpie/file_accessor/file_accessor.h>
+#include <tpie/job.h>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Reads the blocks following the current block of a stream in a
+/// job of the job pool.
+///
+/// The read_ahead owns a fixed number of block buffers allocated with
+/// tpie_new_aligned_array like the stream's own block buffer, so they are
+/// counted by the memory manager. After start(b)
+/// a job reads blocks b, b+1, ... into the buffers as long as there are free
+/// buffers. fetch() hands a prefetched block to the stream by swapping it
+/// with the stream's block buffer. If the job is still queued when fetch()
+/// needs its block, fetch() runs it in the calling thread, so read ahead
+/// works even when all workers are busy.
+///
+/// While blocks are being prefetched, the job uses the file accessor. The
+/// stream must call cancel() before it uses the file accessor for anything
+/// but reading blocks through fetch(), including when fetch() returns false.
+///////////////////////////////////////////////////////////////////////////////
+class TPIE_EXPORT read_ahead {
+public:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Construct a read_ahead. The job subsystem must be initialized.
+	///
+	/// \param fileAccessor The file accessor of the stream.
+	/// \param itemSize Size of a single item in bytes.
+	/// \param blockItems Number of items in a block.
+	/// \param blocks Number of blocks to read ahead.
+	///////////////////////////////////////////////////////////////////////////
+	read_ahead(file_accessor::file_accessor * fileAccessor,
+			   memory_size_type itemSize,
+			   memory_size_type blockItems,
+			   memory_size_type blocks);
+
+	~read_ahead();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Start reading blocks from the given block.
+	///
+	/// If the read_ahead is already reading from the given block in a stream
+	/// of the given size, this does nothing.
+	///
+	/// \param number The first block to read.
+	/// \param size The number of items in the stream.
+	///////////////////////////////////////////////////////////////////////////
+	void start(stream_size_type number, stream_size_type size);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Get the given block if it is the next prefetched block.
+	///
+	/// Waits for the block to be read if necessary. On success, data is
+	/// swapped with the buffer holding the block and items is set to the
+	/// number of items in it.
+	///
+	/// \returns True if the block was prefetched, false if the caller must
+	/// read it itself.
+	///////////////////////////////////////////////////////////////////////////
+	bool fetch(stream_size_type number, char *& data, memory_size_type & items);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Stop reading ahead and discard the prefetched blocks.
+	///
+	/// Waits for the block currently being read, so the file accessor may
+	/// be used when this returns.
+	///////////////////////////////////////////////////////////////////////////
+	void cancel();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Amount of memory used by a read_ahead.
+	///
+	/// \param blockSize Size of a block in bytes.
+	/// \param blocks Number of blocks to read ahead.
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr memory_size_type memory_usage(memory_size_type blockSize,
+												   memory_size_type blocks) {
+		return sizeof(read_ahead) + blocks * (blockSize + sizeof(block));
+	}
+
+private:
+	struct block {
+		char * data;
+		stream_size_type number;
+		memory_size_type items;
+	};
+
+	class reader : public job {
+	public:
+		reader(read_ahead & owner) : m_owner(owner) {}
+		void operator()() override { m_owner.run(); }
+	private:
+		read_ahead & m_owner;
+	};
+
+	void run();
+	bool can_read() const;
+	void schedule(std::unique_lock<std::mutex> & lock);
+	void cancel(std::unique_lock<std::mutex> & lock);
+
+	file_accessor::file_accessor * m_fileAccessor;
+	memory_size_type m_itemSize;
+	memory_size_type m_blockItems;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+
+	/** Buffers not holding a prefetched block. */
+	std::vector<char *> m_free;
+	/** Prefetched blocks in increasing block order. */
+	std::vector<block> m_ready;
+
+	bool m_active;
+	bool m_reading;
+	/** True from when m_reader is enqueued until run() returns. */
+	bool m_scheduled;
+	/** True while run() runs. */
+	bool m_running;
+	/** Incremented by cancel() so that a read in progress is discarded. */
+	stream_size_type m_generation;
+	/** Next block to read in the job. */
+	stream_size_type m_nextRead;
+	/** Next block to hand out through fetch(). */
+	stream_size_type m_nextFetch;
+	/** Number of items in the stream when start() was called. */
+	stream_size_type m_size;
+	std::exception_ptr m_error;
+
+	reader m_reader;
+};
+
+} // namespace tpie
+
+#endif // __TPIE_READ_AHEAD_H__
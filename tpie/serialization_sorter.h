@@ -29,6 +29,7 @@
 #include <tpie/tpie_log.h>
 #include <tpie/stats.h>
 #include <tpie/parallel_sort.h>
+#include <tpie/radix_sort.h>
 
 #include <tpie/serialization2.h>
 #include <tpie/serialization_stream.h>
@@ -190,7 +191,10 @@ public:
 	}
 
 	void sort() {
-		parallel_sort(m_buffer.get(), m_buffer.get() + m_items, m_pred);
+		if constexpr (is_radix_pred<pred_t>::value)
+			radix_sort(m_buffer.get(), m_buffer.get() + m_items, m_pred.key_extractor());
+		else
+			parallel_sort(m_buffer.get(), m_buffer.get() + m_items, m_pred);
 	}
 
 	const T * begin() const {
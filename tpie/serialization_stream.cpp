@@ -53,8 +53,7 @@ public:
 	}
 
 	void read() {
-		m_fileAccessor.seek_i(0);
-		m_fileAccessor.read_i(&m_header, sizeof(m_header));
+		m_fileAccessor.pread_i(&m_header, sizeof(m_header), 0);
 	}
 
 	void write(bool cleanClose) {
@@ -66,8 +65,7 @@ public:
 		std::copy(headerData, sizeof(m_header) + headerData,
 				  headerArea.begin());
 
-		m_fileAccessor.seek_i(0);
-		m_fileAccessor.write_i(&headerArea[0], headerArea.size());
+		m_fileAccessor.pwrite_i(&headerArea[0], headerArea.size(), 0);
 	}
 
 	void verify() {
@@ -199,8 +197,7 @@ void serialization_writer_base::open(temp_file & tempFile, bool reverse) {
 void serialization_writer_base::write_block(const char * const s, const memory_size_type n) {
 	assert(n <= block_size());
 	stream_size_type offset = m_blocksWritten * block_size();
-	m_fileAccessor.seek_i(bits::serialization_header::header_size() + offset);
-	m_fileAccessor.write_i(s, n);
+	m_fileAccessor.pwrite_i(s, n, bits::serialization_header::header_size() + offset);
 	++m_blocksWritten;
 	m_size = offset + n;
 	if (m_tempFile)
@@ -328,9 +325,8 @@ void serialization_reader_base::read_block(const stream_size_type blk) {
 	if (to <= from) throw end_of_stream_exception();
 	m_index = 0;
 	m_blockSize = to-from;
-	m_fileAccessor.seek_i(bits::serialization_header::header_size()
-						  + from);
-	m_fileAccessor.read_i(m_block.get(), m_blockSize);
+	m_fileAccessor.pread_i(m_block.get(), m_blockSize,
+						   bits::serialization_header::header_size() + from);
 }
 
 void serialization_reader_base::close() {
@@ -289,6 +289,9 @@ void sort_manager<T,I,M>::start_sort(){
 	fp.init();
 
 	tpie::array<temp_file> temporaries(mrgArity*2);
+	// Place the runs merged together in different temporary directories
+	for (memory_size_type i = 0; i < temporaries.size(); ++i)
+		temporaries[i].set_directory(i);
 
 	// PHASE 3: partition and form sorted runs
 	TP_LOG_DEBUG_ID ("Beginning general merge sort.");
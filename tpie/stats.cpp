@@ -21,12 +21,15 @@
 // the number of statistics to be recorded.
 
 #include <tpie/stats.h>
+#include <algorithm>
 #include <atomic>
 
 namespace {
 	std::atomic<tpie::stream_size_type> temp_file_usage;
+	std::atomic<tpie::stream_size_type> temp_directory_usage[tpie::temp_directory_stats];
 	std::atomic<tpie::stream_size_type> bytes_read;
 	std::atomic<tpie::stream_size_type> bytes_written;
+	std::atomic<tpie::stream_size_type> bytes_preallocated;
 	std::atomic<tpie::stream_size_type> user[20];
 } // unnamed namespace
 
@@ -47,6 +50,19 @@ namespace tpie {
 		}
 	}
 
+	stream_size_type get_temp_file_usage(memory_size_type directory) {
+		return (directory < temp_directory_stats) ? temp_directory_usage[directory].load() : 0;
+	}
+
+	void increment_temp_file_usage(memory_size_type directory, stream_offset_type delta) {
+		if (directory >= temp_directory_stats) return;
+		stream_size_type x = temp_directory_usage[directory].fetch_add(delta);
+		if (static_cast<stream_offset_type>(x) < 0) {
+			// See increment_temp_file_usage above.
+			temp_directory_usage[directory].fetch_sub(x);
+		}
+	}
+
 	stream_size_type get_bytes_read() {
 		return bytes_read.load();
 	}
@@ -63,6 +79,14 @@ namespace tpie {
 		bytes_written.fetch_add(delta);
 	}
 
+	stream_size_type get_bytes_preallocated() {
+		return bytes_preallocated.load();
+	}
+
+	void increment_bytes_preallocated(stream_size_type delta) {
+		bytes_preallocated.fetch_add(delta);
+	}
+
 	stream_size_type get_user(size_t i) {
 		return (i < sizeof(user)) ? user[i].load() : 0;
 	}
@@ -70,5 +94,83 @@ namespace tpie {
 	void increment_user(size_t i, stream_size_type delta) {
 		if (i < sizeof(user)) user[i].fetch_add(delta);
 	}
+
+	double io_counters::compression_ratio() const {
+		stream_size_type bytes = bytesRead + bytesWritten;
+		if (bytes == 0) return 1;
+		return static_cast<double>(itemBytesRead + itemBytesWritten) / bytes;
+	}
+
+	io_counters & io_counters::operator+=(const io_counters & other) {
+		bytesRead += other.bytesRead;
+		bytesWritten += other.bytesWritten;
+		blocksRead += other.blocksRead;
+		blocksWritten += other.blocksWritten;
+		itemBytesRead += other.itemBytesRead;
+		itemBytesWritten += other.itemBytesWritten;
+		readSeconds += other.readSeconds;
+		writeSeconds += other.writeSeconds;
+		return *this;
+	}
+
+	io_stats::io_stats()
+		: m_sink(nullptr)
+	{
+		reset();
+	}
+
+	void io_stats::add_read(stream_size_type bytes, stream_size_type itemBytes, double seconds) {
+		m_bytesRead.fetch_add(bytes);
+		m_blocksRead.fetch_add(1);
+		m_itemBytesRead.fetch_add(itemBytes);
+		m_readTime.fetch_add(static_cast<stream_size_type>(seconds*1000000));
+		if (io_stats * sink = m_sink.load()) sink->add_read(bytes, itemBytes, seconds);
+	}
+
+	void io_stats::add_write(stream_size_type bytes, stream_size_type itemBytes, double seconds) {
+		m_bytesWritten.fetch_add(bytes);
+		m_blocksWritten.fetch_add(1);
+		m_itemBytesWritten.fetch_add(itemBytes);
+		m_writeTime.fetch_add(static_cast<stream_size_type>(seconds*1000000));
+		if (io_stats * sink = m_sink.load()) sink->add_write(bytes, itemBytes, seconds);
+	}
+
+	io_counters io_stats::get() const {
+		io_counters c;
+		c.bytesRead = m_bytesRead.load();
+		c.bytesWritten = m_bytesWritten.load();
+		c.blocksRead = m_blocksRead.load();
+		c.blocksWritten = m_blocksWritten.load();
+		c.itemBytesRead = m_itemBytesRead.load();
+		c.itemBytesWritten = m_itemBytesWritten.load();
+		c.readSeconds = m_readTime.load() / 1000000.0;
+		c.writeSeconds = m_writeTime.load() / 1000000.0;
+		return c;
+	}
+
+	void io_stats::reset() {
+		m_bytesRead = 0;
+		m_bytesWritten = 0;
+		m_blocksRead = 0;
+		m_blocksWritten = 0;
+		m_itemBytesRead = 0;
+		m_itemBytesWritten = 0;
+		m_readTime = 0;
+		m_writeTime = 0;
+	}
+
+	void io_stats::set_sink(std::shared_ptr<io_stats> sink) {
+		std::lock_guard<std::mutex> lock(m_sinkMutex);
+		if (sink && std::find(m_sinks.begin(), m_sinks.end(), sink) == m_sinks.end())
+			m_sinks.push_back(sink);
+		m_sink.store(sink.get());
+		m_currentSink = std::move(sink);
+	}
+
+	std::shared_ptr<io_stats> io_stats::get_sink() const {
+		std::lock_guard<std::mutex> lock(m_sinkMutex);
+		return m_currentSink;
+	}
+
 }  //  tpie namespace
 
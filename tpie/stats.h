@@ -26,7 +26,11 @@
 
 #include <tpie/tpie_export.h>
 #include <tpie/types.h>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace tpie {
 
@@ -41,6 +45,28 @@ namespace tpie {
 	///////////////////////////////////////////////////////////////////////////
 	TPIE_EXPORT void increment_temp_file_usage(stream_offset_type delta);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of temporary directories whose usage is tracked
+	/// separately.
+	///////////////////////////////////////////////////////////////////////////
+	const size_t temp_directory_stats = 64;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the number of bytes currently being used by temporary
+	/// files in the given directory of tempname::set_default_paths.
+	///
+	/// Only the first temp_directory_stats directories are tracked; for the
+	/// others 0 is returned.
+	///////////////////////////////////////////////////////////////////////////
+	TPIE_EXPORT stream_size_type get_temp_file_usage(memory_size_type directory);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Increment (possibly by a negative amount) the number of bytes
+	/// being used by temporary files in the given directory. This does not
+	/// change the total reported by get_temp_file_usage().
+	///////////////////////////////////////////////////////////////////////////
+	TPIE_EXPORT void increment_temp_file_usage(memory_size_type directory, stream_offset_type delta);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Return the number of bytes read from disk since program start.
 	///////////////////////////////////////////////////////////////////////////
@@ -63,9 +89,103 @@ namespace tpie {
 	///////////////////////////////////////////////////////////////////////////
 	TPIE_EXPORT void increment_bytes_written(stream_size_type delta);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the number of bytes of disk space preallocated for
+	/// files since program start; see file_accessor::posix::preallocate_i.
+	///////////////////////////////////////////////////////////////////////////
+	TPIE_EXPORT stream_size_type get_bytes_preallocated();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Inform the stats module that an additional delta bytes of disk
+	/// space have been preallocated.
+	///////////////////////////////////////////////////////////////////////////
+	TPIE_EXPORT void increment_bytes_preallocated(stream_size_type delta);
+
 	TPIE_EXPORT stream_size_type get_user(size_t i);
 	TPIE_EXPORT void increment_user(size_t i, stream_size_type delta);
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Snapshot of the block I/O done by a stream or pipelining node;
+/// see io_stats.
+///////////////////////////////////////////////////////////////////////////////
+struct TPIE_EXPORT io_counters {
+	/** Bytes read from and written to the file, after compression. */
+	stream_size_type bytesRead = 0;
+	stream_size_type bytesWritten = 0;
+	/** Number of blocks read and written. */
+	stream_size_type blocksRead = 0;
+	stream_size_type blocksWritten = 0;
+	/** Bytes of items in the blocks read and written, before compression. */
+	stream_size_type itemBytesRead = 0;
+	stream_size_type itemBytesWritten = 0;
+	/** Time spent in block reads and writes. */
+	double readSeconds = 0;
+	double writeSeconds = 0;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Bytes of items per byte transferred, or 1 if nothing was.
+	///////////////////////////////////////////////////////////////////////////
+	double compression_ratio() const;
+
+	io_counters & operator+=(const io_counters & other);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Counters of the blocks read and written through a file accessor.
+///
+/// Each stream counts its block I/O in the io_stats of its file accessor;
+/// see e.g. file_stream_base::get_io_counters. The counts may be forwarded
+/// to a sink shared by several streams, such as the one of a pipelining
+/// node, which can itself forward to another sink.
+///
+/// The counters are updated atomically, since blocks are read and written
+/// by background threads (the compressor thread, read_ahead and
+/// write_behind). The time is the time spent in these threads for streams
+/// that use them, and in the caller otherwise.
+///////////////////////////////////////////////////////////////////////////////
+class TPIE_EXPORT io_stats {
+public:
+	io_stats();
+	io_stats(const io_stats &) = delete;
+	io_stats & operator=(const io_stats &) = delete;
+
+	void add_read(stream_size_type bytes, stream_size_type itemBytes, double seconds);
+	void add_write(stream_size_type bytes, stream_size_type itemBytes, double seconds);
+
+	io_counters get() const;
+
+	void reset();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Forward the counts added from now on to the given sink, or
+	/// stop forwarding if it is null. May be called while background threads
+	/// add counts. The sinks set are kept alive until this io_stats is
+	/// destroyed, so that add_read and add_write can use the current sink
+	/// through a plain pointer.
+	///////////////////////////////////////////////////////////////////////////
+	void set_sink(std::shared_ptr<io_stats> sink);
+
+	std::shared_ptr<io_stats> get_sink() const;
+
+private:
+	std::atomic<stream_size_type> m_bytesRead;
+	std::atomic<stream_size_type> m_bytesWritten;
+	std::atomic<stream_size_type> m_blocksRead;
+	std::atomic<stream_size_type> m_blocksWritten;
+	std::atomic<stream_size_type> m_itemBytesRead;
+	std::atomic<stream_size_type> m_itemBytesWritten;
+	/** Microseconds, as in stat_timer. */
+	std::atomic<stream_size_type> m_readTime;
+	std::atomic<stream_size_type> m_writeTime;
+	/** The current sink, or null. Read for each block without locking. */
+	std::atomic<io_stats *> m_sink;
+	/** The current sink. Guarded by m_sinkMutex. */
+	std::shared_ptr<io_stats> m_currentSink;
+	/** All sinks set so far. Guarded by m_sinkMutex. */
+	std::vector<std::shared_ptr<io_stats> > m_sinks;
+	mutable std::mutex m_sinkMutex;
+};
+
 class ptime {
 private:
 	typedef std::chrono::steady_clock clock;
@@ -30,7 +30,11 @@ namespace tpie {
 
 struct stream_header_t {
 	static const uint64_t magicConst = 0x521cbe927dd6056all;
-	static const uint64_t versionConst = 4;
+	/** Version of files with block checksums. Readers of older versions do
+	 * not know the checksums flag, so files without checksums are still
+	 * written with oldestVersionConst. */
+	static const uint64_t versionConst = 5;
+	static const uint64_t oldestVersionConst = 4;
 
 	uint64_t magic;
 	uint64_t version;
@@ -44,12 +48,19 @@ struct stream_header_t {
 
 	static const uint64_t cleanCloseMask = 0x1;
 	static const uint64_t compressedMask = 0x2;
+	static const uint64_t checksumsMask = 0x4;
+	/** Files with other flags set are rejected. */
+	static const uint64_t knownFlagsMask = cleanCloseMask | compressedMask | checksumsMask;
 
 	bool get_clean_close() const { return flags & cleanCloseMask; }
 	void set_clean_close(bool b) { if (b) flags |= cleanCloseMask; else flags &= ~cleanCloseMask; }
 
 	bool get_compressed() const { return flags & compressedMask; }
 	void set_compressed(bool b) { if (b) flags |= compressedMask; else flags &= ~compressedMask; }
+
+	/** Compressed streams: whether each block ends with a CRC32C checksum. */
+	bool get_checksums() const { return flags & checksumsMask; }
+	void set_checksums(bool b) { if (b) flags |= checksumsMask; else flags &= ~checksumsMask; }
 };
 
 }
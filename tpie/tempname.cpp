@@ -32,8 +32,12 @@
 #include <tpie/util.h>
 #include <tpie/exception.h>
 #include <tpie/file_accessor/file_accessor.h>
+#include <tpie/stats.h>
 #include <stack>
 #include <random>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -50,10 +54,22 @@ using namespace tpie;
 namespace {
 
 std::string default_path;
+std::vector<std::string> default_paths;
 std::string default_base_name = "TPIE";
 std::string default_extension;
 std::stack<std::string> subdirs;
 
+// Subdirectories for the temporary directories after the first, which uses
+// subdirs.top(). Empty signals that the subdirectory has not been created yet.
+std::vector<std::string> extra_subdirs;
+
+temp_placement placement = placement_round_robin;
+std::atomic<memory_size_type> next_directory(0);
+
+// Guards the lazy creation of subdirs and extra_subdirs, since temporary
+// files are named from the parallel jobs of the sorters.
+std::mutex subdir_mutex;
+
 }
 
 std::string _get_system_path() {
@@ -153,20 +169,38 @@ std::string construct_name(std::string post_base, std::string timestamp, std::st
 	return ss.str();
 }
 
-void create_subdir() {
-	std::filesystem::path base_dir = tempname::get_actual_path();
+std::string create_subdir(const std::string & base_dir) {
 	std::filesystem::path p;
-	p = base_dir / construct_name("", get_timestamp(), "");
-	if ( !std::filesystem::exists(p) && std::filesystem::create_directory(p)) {
-		std::string path = p.string();
-		if (!subdirs.empty() && subdirs.top().empty())
-			subdirs.pop();
-		subdirs.push(path);
-		return;
-	}
+	p = std::filesystem::path(base_dir) / construct_name("", get_timestamp(), "");
+	if ( !std::filesystem::exists(p) && std::filesystem::create_directory(p))
+		return p.string();
 	throw tempfile_error("Unable to find free name for temporary folder");
 }
 
+void create_subdir() {
+	std::string path = create_subdir(tempname::get_actual_path());
+	if (!subdirs.empty() && subdirs.top().empty())
+		subdirs.pop();
+	subdirs.push(path);
+}
+
+std::string get_subdir(memory_size_type directory) {
+	std::lock_guard<std::mutex> lock(subdir_mutex);
+	if (directory == 0) {
+		if (subdirs.empty() || subdirs.top().empty()) create_subdir();
+		return subdirs.top();
+	}
+	std::string & subdir = extra_subdirs[directory-1];
+	if (subdir.empty()) subdir = create_subdir(default_paths[directory]);
+	return subdir;
+}
+
+std::string gen_temp_in_directory(const std::string& post_base, memory_size_type directory, const std::string& suffix) {
+	std::filesystem::path p = get_subdir(directory % tempname::get_directory_count());
+	p /= construct_name(post_base, "", suffix);
+	return p.string();
+}
+
 std::string gen_temp(const std::string& post_base, const std::string& dir, const std::string& suffix) {
 	if (!dir.empty()) {
 		std::filesystem::path p;
@@ -177,19 +211,20 @@ std::string gen_temp(const std::string& post_base, const std::string& dir, const
 		throw tempfile_error("Unable to find free name for temporary file");
 	}
 	else {
-		if (subdirs.empty() || subdirs.top().empty()) create_subdir();
-
-		std::filesystem::path p = subdirs.top();
-		p /= construct_name(post_base, "", suffix);
-
-		return p.string();
+		return gen_temp_in_directory(post_base, tempname::choose_directory(), suffix);
 	}
 }
 
+std::string get_suffix(const std::string & ext) {
+	if (ext.empty()) return ".tpie";
+	return "." + ext;
+}
+
 }
 
 namespace tpie {
 	void finish_tempfile() {
+		std::lock_guard<std::mutex> lock(subdir_mutex);
 		while (!subdirs.empty()) {
 			if (!subdirs.top().empty()) {
 				std::error_code c;
@@ -197,12 +232,22 @@ namespace tpie {
 			}
 			subdirs.pop();
 		}
+		for (std::string & subdir: extra_subdirs) {
+			if (!subdir.empty()) {
+				std::error_code c;
+				std::filesystem::remove_all(subdir, c);
+				subdir.clear();
+			}
+		}
 	}
 }
 
 std::string tempname::tpie_name(const std::string& post_base, const std::string& dir, const std::string& ext) {
-	if (ext.empty()) return gen_temp(post_base, dir, ".tpie");
-	else return gen_temp(post_base, dir, "." + ext);
+	return gen_temp(post_base, dir, get_suffix(ext));
+}
+
+std::string tempname::tpie_name_in_directory(memory_size_type directory, const std::string& post_base, const std::string& ext) {
+	return gen_temp_in_directory(post_base, directory, get_suffix(ext));
 }
 
 std::string tempname::tpie_dir_name(const std::string& post_base, const std::string& dir) {
@@ -249,30 +294,93 @@ bool tempname::try_directory(const std::string& path) {
 	return false;
 }
 
-void tempname::set_default_path(const std::string&  path, const std::string& subdir) {
-	if (subdir=="") {
-		default_path = path;
-		subdirs.push(""); // signals that the current global subdirectory has not been created yet
-		return;
-	}
+namespace {
+
+std::string resolve_path(const std::string & path, const std::string & subdir) {
+	if (subdir=="") return path;
 	std::filesystem::path p = path;
 	p = p / subdir;
 	try {
 		if (!std::filesystem::exists(p)) {
 			std::filesystem::create_directory(p);
 		}
-		if (!std::filesystem::is_directory(p)) {	
-			default_path = path;
-			subdirs.push(""); // signals that the current global subdirectory has not been created yet
+		if (!std::filesystem::is_directory(p)) {
 			TP_LOG_WARNING_ID("Could not use " << p << " as directory for temporary files, trying " << path);
+			return path;
 		}
-
-		default_path = p.string();
-		subdirs.push(""); // signals that the current global subdirectory has not been created yet
+		return p.string();
 	} catch (std::filesystem::filesystem_error &) {
 		TP_LOG_WARNING_ID("Could not use " << p << " as directory for temporary files, trying " << path);
-		default_path = path; 
-	}	
+		return path;
+	}
+}
+
+}
+
+void tempname::set_default_path(const std::string&  path, const std::string& subdir) {
+	set_default_paths(std::vector<std::string>(1, path), subdir);
+}
+
+void tempname::set_default_paths(const std::vector<std::string>& paths, const std::string& subdir) {
+	default_paths.clear();
+	for (const std::string & path: paths) {
+		if (path.empty()) continue;
+		default_paths.push_back(resolve_path(path, subdir));
+	}
+	default_path = default_paths.empty() ? std::string() : default_paths[0];
+
+	std::lock_guard<std::mutex> lock(subdir_mutex);
+	// Subdirectories of the previous directories are kept until
+	// finish_tempfile, since temporary files may still live there.
+	for (const std::string & subdir: extra_subdirs)
+		if (!subdir.empty()) subdirs.push(subdir);
+	extra_subdirs.assign(default_paths.empty() ? 0 : default_paths.size()-1, std::string());
+
+	subdirs.push(""); // signals that the current global subdirectory has not been created yet
+	next_directory.store(0);
+}
+
+const std::vector<std::string>& tempname::get_default_paths() {
+	return default_paths;
+}
+
+memory_size_type tempname::get_directory_count() {
+	return default_paths.empty() ? 1 : default_paths.size();
+}
+
+std::string tempname::get_directory(memory_size_type directory) {
+	directory %= get_directory_count();
+	if (directory == 0) return get_actual_path();
+	return default_paths[directory];
+}
+
+void tempname::set_placement(temp_placement p) {
+	placement = p;
+}
+
+temp_placement tempname::get_placement() {
+	return placement;
+}
+
+memory_size_type tempname::choose_directory() {
+	memory_size_type count = get_directory_count();
+	if (count == 1) return 0;
+	if (placement == placement_free_space) {
+		memory_size_type best = count;
+		std::uintmax_t bestSpace = 0;
+		for (memory_size_type i = 0; i < count; ++i) {
+			std::error_code c;
+			std::filesystem::space_info s = std::filesystem::space(default_paths[i], c);
+			if (c) continue;
+			if (best == count || s.available > bestSpace) {
+				best = i;
+				bestSpace = s.available;
+			}
+		}
+		if (best != count) return best;
+		// Fall back to round robin if no directory could be queried.
+	}
+	return next_directory.fetch_add(1) % count;
 }
 
 void tempname::set_default_base_name(const std::string& name) {
@@ -307,19 +415,47 @@ temp_file_inner::~temp_file_inner() {
 	update_recorded_size(0);
 }
 
-temp_file_inner::temp_file_inner() : m_persist(false), m_recordedSize(0), m_count(0) {}
+temp_file_inner::temp_file_inner()
+	: m_persist(false), m_recordedSize(0), m_count(0)
+	, m_requestedDirectory(no_directory), m_directory(no_directory) {}
 
-temp_file_inner::temp_file_inner(const std::string & path, bool persist): m_path(path), m_persist(persist), m_recordedSize(0), m_count(0) {}
+temp_file_inner::temp_file_inner(const std::string & path, bool persist)
+	: m_path(path), m_persist(persist), m_recordedSize(0), m_count(0)
+	, m_requestedDirectory(no_directory), m_directory(no_directory) {}
+
+temp_file_inner::temp_file_inner(memory_size_type directory)
+	: m_persist(false), m_recordedSize(0), m_count(0)
+	, m_requestedDirectory(directory), m_directory(no_directory) {}
 
 const std::string & temp_file_inner::path() {
-	if(m_path.empty())
-		m_path = tempname::tpie_name();
+	if(m_path.empty()) {
+		if (m_requestedDirectory != no_directory)
+			m_directory = m_requestedDirectory % tempname::get_directory_count();
+		else
+			m_directory = tempname::choose_directory();
+		m_path = tempname::tpie_name_in_directory(m_directory);
+	}
 	return m_path;
 }
 
 void temp_file_inner::update_recorded_size(stream_size_type size) {
-	increment_temp_file_usage(static_cast<stream_offset_type>(size) - static_cast<stream_offset_type>(m_recordedSize));
-	m_recordedSize=size;
+	stream_size_type old = m_recordedSize.exchange(size);
+	stream_offset_type delta = static_cast<stream_offset_type>(size) - static_cast<stream_offset_type>(old);
+	increment_temp_file_usage(delta);
+	if (m_directory != no_directory)
+		increment_temp_file_usage(m_directory, delta);
+}
+
+void temp_file_inner::release_recorded_size(stream_size_type bytes) {
+	stream_size_type old = m_recordedSize.load();
+	stream_size_type size;
+	do {
+		size = old - std::min(old, bytes);
+	} while (!m_recordedSize.compare_exchange_weak(old, size));
+	stream_offset_type delta = static_cast<stream_offset_type>(size) - static_cast<stream_offset_type>(old);
+	increment_temp_file_usage(delta);
+	if (m_directory != no_directory)
+		increment_temp_file_usage(m_directory, delta);
 }
 
 TPIE_EXPORT void intrusive_ptr_add_ref(temp_file_inner *p) {
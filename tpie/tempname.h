@@ -28,8 +28,10 @@
 #include <tpie/tpie_export.h>
 #include <tpie/types.h>
 #include <stdexcept>
+#include <atomic>
 #include <boost/intrusive_ptr.hpp>
 #include <string>
+#include <vector>
  // The name of the environment variable pointing to a tmp directory.
 #define TMPDIR_ENV "TMPDIR"
 
@@ -43,6 +45,18 @@ namespace tpie {
 		explicit tempfile_error(const std::string & what): std::runtime_error(what) {}
 	};
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief How new temporary files are spread over the temporary
+	/// directories when more than one is set using
+	/// \ref tempname::set_default_paths.
+	///////////////////////////////////////////////////////////////////////////
+	enum temp_placement {
+		/** Use the directories in turn. */
+		placement_round_robin,
+		/** Use the directory with the most free space. */
+		placement_free_space
+	};
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Static methods for generating temporary file names and finding
 	/// temporary file directories.
@@ -61,8 +75,9 @@ namespace tpie {
 		/// the extension.
 		///
 		/// This file name is suffixed a temporary directory passed as a
-		/// parameter. If no temporary directory is passed, the directory
-		/// reported by \ref get_actual_path is used instead.
+		/// parameter. If no temporary directory is passed, one of the
+		/// directories set using \ref set_default_paths is chosen, or the
+		/// directory reported by \ref get_actual_path is used instead.
 		///
 		/// The path returned does not already exist on the filesystem.
 		///////////////////////////////////////////////////////////////////////
@@ -99,6 +114,64 @@ namespace tpie {
 		///////////////////////////////////////////////////////////////////////
 		static void set_default_path(const std::string& path, const std::string& subdir="");
 
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Sets a list of temporary directories to stripe temporary
+		/// files over, e.g. one for each local disk.
+		///
+		/// New temporary files are placed in the directories according to
+		/// \ref set_placement, and the space used in each directory is
+		/// reported by get_temp_file_usage(memory_size_type).
+		///
+		/// \param paths The directories to use; each must exist in the system.
+		/// \param subdir Subdirectory of each path, created if it does not exist.
+		///////////////////////////////////////////////////////////////////////
+		static void set_default_paths(const std::vector<std::string>& paths, const std::string& subdir="");
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Get the temporary directories set using
+		/// \ref set_default_path or \ref set_default_paths.
+		///////////////////////////////////////////////////////////////////////
+		static const std::vector<std::string>& get_default_paths();
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Number of directories temporary files are striped over;
+		/// at least one.
+		///////////////////////////////////////////////////////////////////////
+		static memory_size_type get_directory_count();
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Get the given temporary directory, taken modulo
+		/// \ref get_directory_count. With no default paths set, this is
+		/// \ref get_actual_path.
+		///////////////////////////////////////////////////////////////////////
+		static std::string get_directory(memory_size_type directory);
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Set how new temporary files are placed in the temporary
+		/// directories. The default is placement_round_robin.
+		///////////////////////////////////////////////////////////////////////
+		static void set_placement(temp_placement placement);
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Get the placement set using \ref set_placement.
+		///////////////////////////////////////////////////////////////////////
+		static temp_placement get_placement();
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Choose the temporary directory for a new temporary file
+		/// according to the placement.
+		///////////////////////////////////////////////////////////////////////
+		static memory_size_type choose_directory();
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Generate path for a new temporary file in the given
+		/// temporary directory, taken modulo \ref get_directory_count.
+		/// \sa tpie_name
+		///////////////////////////////////////////////////////////////////////
+		static std::string tpie_name_in_directory(memory_size_type directory,
+												  const std::string& post_base = "",
+												  const std::string& ext = "");
+
 		///////////////////////////////////////////////////////////////////////
 		/// \brief Set default base name for temporary files.
 		/// \sa tpie_name
@@ -158,6 +231,8 @@ namespace tpie {
 	
 	class TPIE_EXPORT temp_file_inner {
 	public:
+		static const memory_size_type no_directory = static_cast<memory_size_type>(-1);
+
 		temp_file_inner();
 		temp_file_inner(const temp_file_inner & o) = delete;
 		temp_file_inner(temp_file_inner && o) = delete;
@@ -165,10 +240,26 @@ namespace tpie {
 		temp_file_inner & operator=(temp_file_inner && o) = delete;
 		
 		temp_file_inner(const std::string & path, bool persist);
+		explicit temp_file_inner(memory_size_type directory);
 		~temp_file_inner();
 
 		const std::string & path();
 		void update_recorded_size(stream_size_type size);
+		void release_recorded_size(stream_size_type bytes);
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief The directory requested for the file, or no_directory.
+		///////////////////////////////////////////////////////////////////////
+		memory_size_type requested_directory() const {
+			return m_requestedDirectory;
+		}
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Whether the path has been generated or given by the user.
+		///////////////////////////////////////////////////////////////////////
+		bool has_path() const {
+			return !m_path.empty();
+		}
 
 		bool is_persistent() const {
 			return m_persist;
@@ -184,8 +275,13 @@ namespace tpie {
 	private:
 		std::string m_path;
 		bool m_persist;
-		stream_size_type m_recordedSize;
-		memory_size_type m_count;			
+		std::atomic<stream_size_type> m_recordedSize;
+		memory_size_type m_count;
+		/** Directory requested using temp_file::set_directory. */
+		memory_size_type m_requestedDirectory;
+		/** Temporary directory of the file, or no_directory if the path has
+		 * not been generated or was given by the user. */
+		memory_size_type m_directory;
 	};
 
 	TPIE_EXPORT void intrusive_ptr_add_ref(temp_file_inner * p);
@@ -214,6 +310,20 @@ namespace tpie {
 			m_inner = new bits::temp_file_inner(path, persist);
 		}
 
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Place the file in the given temporary directory, taken
+		/// modulo tempname::get_directory_count, rather than the one chosen by
+		/// the placement. Has no effect once the path has been generated or
+		/// was given by the user.
+		///
+		/// The directory is kept by \ref free, so an object can be reused
+		/// for new files on the same device.
+		///////////////////////////////////////////////////////////////////////
+		void set_directory(memory_size_type directory) {
+			if (m_inner->has_path()) return;
+			m_inner = new bits::temp_file_inner(directory);
+		}
+
 		///////////////////////////////////////////////////////////////////////
 		/// \returns Whether this file should not be deleted when this object
 		/// goes out of scope.
@@ -248,12 +358,27 @@ namespace tpie {
 		/// \brief Clears the current object reference
 		///////////////////////////////////////////////////////////////////////////////
 		void free() {
-			m_inner = new bits::temp_file_inner();
+			memory_size_type directory = m_inner->requested_directory();
+			if (directory != bits::temp_file_inner::no_directory)
+				m_inner = new bits::temp_file_inner(directory);
+			else
+				m_inner = new bits::temp_file_inner();
 		}
 
 		void update_recorded_size(stream_size_type size) {
 			m_inner->update_recorded_size(size);
 		}
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Subtract bytes whose disk space has been freed from the
+		/// recorded size, e.g. by a stream discarding consumed blocks.
+		///
+		/// Unlike update_recorded_size, this may be called by several
+		/// streams reading the file at the same time.
+		///////////////////////////////////////////////////////////////////////
+		void release_recorded_size(stream_size_type bytes) {
+			m_inner->release_recorded_size(bytes);
+		}
 	private:
 		boost::intrusive_ptr<bits::temp_file_inner> m_inner;
 	};
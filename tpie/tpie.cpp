@@ -29,6 +29,10 @@
 
 namespace {
 static tpie::memory_size_type the_block_size=0;
+static tpie::memory_size_type the_read_ahead_blocks=std::numeric_limits<tpie::memory_size_type>::max();
+static tpie::memory_size_type the_write_behind_blocks=std::numeric_limits<tpie::memory_size_type>::max();
+static int the_direct_io=-1;
+static int the_block_checksums=-1;
 }
 
 namespace tpie {
@@ -100,4 +104,52 @@ TPIE_EXPORT void set_block_size(memory_size_type block_size) {
 	the_block_size=block_size;
 }
 
+TPIE_EXPORT memory_size_type get_read_ahead_blocks() {
+	if (the_read_ahead_blocks == std::numeric_limits<memory_size_type>::max()) {
+		const char * v = getenv("TPIE_READ_AHEAD_BLOCKS");
+		the_read_ahead_blocks = (v != NULL) ? atol(v) : 0;
+	}
+	return the_read_ahead_blocks;
+}
+
+TPIE_EXPORT void set_read_ahead_blocks(memory_size_type blocks) {
+	the_read_ahead_blocks=blocks;
+}
+
+TPIE_EXPORT memory_size_type get_write_behind_blocks() {
+	if (the_write_behind_blocks == std::numeric_limits<memory_size_type>::max()) {
+		const char * v = getenv("TPIE_WRITE_BEHIND_BLOCKS");
+		the_write_behind_blocks = (v != NULL) ? atol(v) : 0;
+	}
+	return the_write_behind_blocks;
+}
+
+TPIE_EXPORT void set_write_behind_blocks(memory_size_type blocks) {
+	the_write_behind_blocks=blocks;
+}
+
+TPIE_EXPORT bool get_direct_io() {
+	if (the_direct_io == -1) {
+		const char * v = getenv("TPIE_DIRECT_IO");
+		the_direct_io = (v != NULL && atol(v) != 0) ? 1 : 0;
+	}
+	return the_direct_io == 1;
+}
+
+TPIE_EXPORT void set_direct_io(bool directIO) {
+	the_direct_io = directIO ? 1 : 0;
+}
+
+TPIE_EXPORT bool get_block_checksums() {
+	if (the_block_checksums == -1) {
+		const char * v = getenv("TPIE_BLOCK_CHECKSUMS");
+		the_block_checksums = (v != NULL && atol(v) != 0) ? 1 : 0;
+	}
+	return the_block_checksums == 1;
+}
+
+TPIE_EXPORT void set_block_checksums(bool checksums) {
+	the_block_checksums = checksums ? 1 : 0;
+}
+
 }
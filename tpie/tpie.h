@@ -92,6 +92,90 @@ TPIE_EXPORT memory_size_type get_block_size();
 ///////////////////////////////////////////////////////////////////////////////
 TPIE_EXPORT void set_block_size(memory_size_type block_size);
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Get the default number of blocks that uncompressed streams opened
+/// with access_sequential read ahead of the current block.
+/// This can be changed by setting the TPIE_READ_AHEAD_BLOCKS environment
+/// variable or by calling the set_read_ahead_blocks method.
+///
+/// The default is 0, i.e. blocks are read when they are needed.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT memory_size_type get_read_ahead_blocks();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set the default number of blocks to read ahead.
+///
+/// Streams read the default when they are constructed; use
+/// file_stream_base::set_read_ahead to change it for a single stream.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_read_ahead_blocks(memory_size_type blocks);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Get the default maximum number of blocks that uncompressed streams
+/// opened with access_sequential write in the background while the writer
+/// continues.
+/// This can be changed by setting the TPIE_WRITE_BEHIND_BLOCKS environment
+/// variable or by calling the set_write_behind_blocks method.
+///
+/// The default is 0, i.e. blocks are written when they are full.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT memory_size_type get_write_behind_blocks();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set the default number of blocks to write behind.
+///
+/// Streams read the default when they are constructed; use
+/// file_stream_base::set_write_behind to change it for a single stream.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_write_behind_blocks(memory_size_type blocks);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Get whether temporary streams bypass the page cache.
+/// This can be changed by setting the TPIE_DIRECT_IO environment variable
+/// to 1 or by calling the set_direct_io method.
+///
+/// When enabled, streams opened on a temporary file read and write their
+/// blocks with O_DIRECT where the file system supports it, since temporary
+/// data is usually read back once and caching it only evicts other data.
+/// Streams opened on a named file are not affected.
+///
+/// The default is false.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT bool get_direct_io();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set whether temporary streams bypass the page cache.
+///
+/// Streams read the setting when they are opened.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_direct_io(bool directIO);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Get whether new compressed streams store a checksum in each block.
+/// This can be changed by setting the TPIE_BLOCK_CHECKSUMS environment
+/// variable to 1 or by calling the set_block_checksums method.
+///
+/// When enabled, each block written by a stream opened with
+/// compression_normal or compression_all carries a CRC32C checksum of its
+/// header and contents, which is verified when the block is read. A
+/// mismatch is reported by throwing invalid_file_exception from the read.
+/// The setting is recorded in the stream header, so files are read
+/// correctly regardless of the current setting.
+///
+/// Streams opened with compression_none store fixed-size blocks to
+/// support random access, and do not carry checksums.
+///
+/// The default is false.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT bool get_block_checksums();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set whether new compressed streams store block checksums.
+///
+/// Streams read the setting when they create a file.
+///////////////////////////////////////////////////////////////////////////////
+TPIE_EXPORT void set_block_checksums(bool checksums);
+
 } //namespace tpie
 
 #endif //__TPIE_TPIE_H__
@@ -22,6 +22,7 @@
 #include <tpie/file.h>
 #include <tpie/memory.h>
 #include <tpie/file_stream_base.h>
+#include <tpie/tpie.h>
 ///////////////////////////////////////////////////////////////////////////////
 /// \file uncompressed_stream.h
 /// \brief Simple class acting both as a tpie::file and a
@@ -151,19 +152,45 @@ public:
 	/// \param blockFactor The block factor you pass to open.
 	/// \param includeDefaultFileAccessor Unless you are supplying your own
 	/// file accessor to open, leave this to be true.
+	/// \param readAheadBlocks The number of blocks the stream reads ahead;
+	/// see file_stream_base::set_read_ahead.
+	/// \param writeBehindBlocks The number of blocks the stream writes
+	/// behind; see file_stream_base::set_write_behind.
 	/// \returns The amount of memory maximally used by the count file_streams.
 	///////////////////////////////////////////////////////////////////////////
 	static constexpr memory_size_type memory_usage(
-		float blockFactor=1.0,
-		bool includeDefaultFileAccessor=true) noexcept {
+		float blockFactor,
+		bool includeDefaultFileAccessor,
+		memory_size_type readAheadBlocks,
+		memory_size_type writeBehindBlocks) noexcept {
 		// TODO
 		memory_size_type x = sizeof(uncompressed_stream);
 		x += block_memory_usage(blockFactor); // allocated in constructor
 		if (includeDefaultFileAccessor)
 			x += default_file_accessor::memory_usage();
+		if (readAheadBlocks != 0)
+			x += read_ahead::memory_usage(block_memory_usage(blockFactor), readAheadBlocks);
+		if (writeBehindBlocks != 0)
+			x += write_behind::memory_usage(block_memory_usage(blockFactor), writeBehindBlocks);
 		return x;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Calculate the amount of memory used by a single uncompressed_stream
+	/// that reads ahead and writes behind the default number of blocks; see
+	/// get_read_ahead_blocks and get_write_behind_blocks.
+	///
+	/// \param blockFactor The block factor you pass to open.
+	/// \param includeDefaultFileAccessor Unless you are supplying your own
+	/// file accessor to open, leave this to be true.
+	///////////////////////////////////////////////////////////////////////////
+	static memory_size_type memory_usage(
+		float blockFactor=1.0,
+		bool includeDefaultFileAccessor=true) noexcept {
+		return memory_usage(blockFactor, includeDefaultFileAccessor,
+							get_read_ahead_blocks(), get_write_behind_blocks());
+	}
+
 	void swap(uncompressed_stream<T> & other) {
 		file_stream_base::swap(other);
 	}
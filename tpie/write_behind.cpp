@@ -0,0 +1,150 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/write_behind.h>
+#include <tpie/memory.h>
+#include <algorithm>
+
+namespace tpie {
+
+write_behind::write_behind(file_accessor::file_accessor * fileAccessor,
+						   memory_size_type itemSize,
+						   memory_size_type blockItems,
+						   memory_size_type blocks)
+	: m_fileAccessor(fileAccessor)
+	, m_itemSize(itemSize)
+	, m_blockItems(blockItems)
+	, m_scheduled(false)
+	, m_running(false)
+	, m_errorSize(0)
+	, m_lostSize(0)
+	, m_writer(*this)
+{
+	m_free.reserve(blocks);
+	for (memory_size_type i = 0; i < blocks; ++i)
+		m_free.push_back(tpie_new_aligned_array<char>(m_itemSize * m_blockItems,
+													  file_accessor::block_alignment));
+}
+
+write_behind::~write_behind() {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (can_write() || m_running)
+			wait(lock);
+	}
+	m_writer.join();
+	for (size_t i = 0; i < m_queue.size(); ++i)
+		m_free.push_back(m_queue[i].data);
+	for (size_t i = 0; i < m_free.size(); ++i)
+		tpie_delete_aligned_array(m_free[i], m_itemSize * m_blockItems,
+								  file_accessor::block_alignment);
+}
+
+void write_behind::write(char *& data, stream_size_type number, memory_size_type items,
+						 stream_size_type sizeBefore) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	check_error(lock);
+	while (m_free.empty() && !m_error)
+		wait(lock);
+	check_error(lock);
+
+	block b;
+	b.data = data;
+	b.number = number;
+	b.items = items;
+	b.sizeBefore = sizeBefore;
+	m_queue.push_back(b);
+	data = m_free.back();
+	m_free.pop_back();
+	schedule(lock);
+}
+
+void write_behind::flush() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (can_write() || m_running)
+		wait(lock);
+	check_error(lock);
+}
+
+void write_behind::check_error(std::unique_lock<std::mutex> & /*lock*/) {
+	if (!m_error) return;
+	std::exception_ptr e = m_error;
+	m_error = std::exception_ptr();
+	m_lostSize = m_errorSize;
+	for (size_t i = 0; i < m_queue.size(); ++i) {
+		m_lostSize = std::min(m_lostSize, m_queue[i].sizeBefore);
+		m_free.push_back(m_queue[i].data);
+	}
+	m_queue.clear();
+	std::rethrow_exception(e);
+}
+
+bool write_behind::can_write() const {
+	return !m_queue.empty() && !m_error;
+}
+
+void write_behind::schedule(std::unique_lock<std::mutex> & /*lock*/) {
+	if (m_scheduled || !can_write()) return;
+	// run() has returned, but the job may not be marked as done yet.
+	m_writer.join();
+	m_scheduled = true;
+	m_writer.enqueue();
+}
+
+void write_behind::wait(std::unique_lock<std::mutex> & lock) {
+	schedule(lock);
+	if (m_running) {
+		m_changed.wait(lock);
+	} else {
+		// The job is waiting for a worker; run it here instead.
+		lock.unlock();
+		m_writer.join();
+		lock.lock();
+	}
+}
+
+void write_behind::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_running = true;
+	while (can_write()) {
+		block b = m_queue.front();
+
+		std::exception_ptr error;
+		lock.unlock();
+		try {
+			m_fileAccessor->write_block_data(b.data, b.number, b.items);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		m_queue.pop_front();
+		m_free.push_back(b.data);
+		if (error) {
+			m_error = error;
+			m_errorSize = b.sizeBefore;
+		}
+		m_changed.notify_all();
+	}
+	m_running = false;
+	m_scheduled = false;
+	m_changed.notify_all();
+}
+
+} // namespace tpie
@@ -0,0 +1,173 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2026, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file write_behind.h  Asynchronous block writing for uncompressed streams
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TPIE_WRITE_BEHIND_H__
+#define __TPIE_WRITE_BEHIND_H__
+
+#include <tpie/tpie_export.h>
+#include <tpie/types.h>
+#include <tpie/file_accessor/file_accessor.h>
+#include <tpie/job.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Writes the blocks of a stream in a job of the job pool.
+///
+/// The write_behind owns a fixed number of block buffers allocated with
+/// tpie_new_aligned_array like the stream's own block buffer, so they are
+/// counted by the memory manager. write() hands a dirty block to the job by
+/// swapping it with a free buffer, so at most that number of blocks are
+/// waiting to be written. If the job is still queued when write() needs a
+/// free buffer or flush() needs the blocks on disk, the job is run in the
+/// calling thread, so write behind works even when all workers are busy.
+///
+/// The job writes blocks with stream_accessor_base::write_block_data, which
+/// does not change the size of the stream; the stream updates the size with
+/// grow_to_block after it calls write(). Reading blocks and user data
+/// through a posix file accessor is safe while blocks are being written, but
+/// the stream must call flush() before it reads a block that may be waiting
+/// to be written, or before it truncates or closes the file.
+///
+/// If a write fails, the error is thrown by the next call to write() or
+/// flush(), and the blocks still waiting are discarded. lost_size() then
+/// tells the stream which size to roll back to.
+///////////////////////////////////////////////////////////////////////////////
+class TPIE_EXPORT write_behind {
+public:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Construct a write_behind. The job subsystem must be initialized.
+	///
+	/// \param fileAccessor The file accessor of the stream.
+	/// \param itemSize Size of a single item in bytes.
+	/// \param blockItems Number of items in a block.
+	/// \param blocks Maximum number of blocks waiting to be written.
+	///////////////////////////////////////////////////////////////////////////
+	write_behind(file_accessor::file_accessor * fileAccessor,
+				 memory_size_type itemSize,
+				 memory_size_type blockItems,
+				 memory_size_type blocks);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Write the waiting blocks and wait for the job.
+	/// Errors are ignored; call flush() first to get them.
+	///////////////////////////////////////////////////////////////////////////
+	~write_behind();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Queue a block for writing.
+	///
+	/// Waits for a free buffer if the maximum number of blocks are waiting.
+	/// data is swapped with the free buffer, whose contents are undefined.
+	/// If an earlier write failed, its error is thrown and the block is not
+	/// queued.
+	///
+	/// \param data The block to write.
+	/// \param number The block number.
+	/// \param items The number of items in the block.
+	/// \param sizeBefore The number of items in the stream before the block
+	/// was written, which is restored if the block is lost.
+	///////////////////////////////////////////////////////////////////////////
+	void write(char *& data, stream_size_type number, memory_size_type items,
+			   stream_size_type sizeBefore);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait until all queued blocks are written.
+	///
+	/// The file accessor may be used freely when this returns.
+	///////////////////////////////////////////////////////////////////////////
+	void flush();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief After write() or flush() threw, the number of items in the
+	/// stream before the first of the lost blocks was written.
+	///////////////////////////////////////////////////////////////////////////
+	stream_size_type lost_size() const {
+		return m_lostSize;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Amount of memory used by a write_behind.
+	///
+	/// \param blockSize Size of a block in bytes.
+	/// \param blocks Maximum number of blocks waiting to be written.
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr memory_size_type memory_usage(memory_size_type blockSize,
+												   memory_size_type blocks) {
+		return sizeof(write_behind) + blocks * (blockSize + sizeof(block));
+	}
+
+private:
+	struct block {
+		char * data;
+		stream_size_type number;
+		memory_size_type items;
+		stream_size_type sizeBefore;
+	};
+
+	class writer : public job {
+	public:
+		writer(write_behind & owner) : m_owner(owner) {}
+		void operator()() override { m_owner.run(); }
+	private:
+		write_behind & m_owner;
+	};
+
+	void run();
+	bool can_write() const;
+	void schedule(std::unique_lock<std::mutex> & lock);
+	void wait(std::unique_lock<std::mutex> & lock);
+	void check_error(std::unique_lock<std::mutex> & lock);
+
+	file_accessor::file_accessor * m_fileAccessor;
+	memory_size_type m_itemSize;
+	memory_size_type m_blockItems;
+
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+
+	/** Buffers not holding a block waiting to be written. */
+	std::vector<char *> m_free;
+	/** Blocks waiting to be written, in the order they were queued. */
+	std::deque<block> m_queue;
+
+	/** True from when m_writer is enqueued until run() returns. */
+	bool m_scheduled;
+	/** True while run() runs. */
+	bool m_running;
+	std::exception_ptr m_error;
+	/** sizeBefore of the block that failed. */
+	stream_size_type m_errorSize;
+	stream_size_type m_lostSize;
+
+	writer m_writer;
+};
+
+} // namespace tpie
+
+#endif // __TPIE_WRITE_BEHIND_H__